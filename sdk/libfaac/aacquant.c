@@ -30,6 +30,11 @@
 #include "psych.h"
 #include "util.h"
 
+#ifdef FAAC_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
 #define TAKEHIRO_IEEE754_HACK 1
 
 #define XRPOW_FTOI(src,dest) ((dest) = (int)(src))
@@ -37,15 +42,16 @@
 #define ROUNDFAC 0.4054
 
 static int FixNoise(CoderInfo *coderInfo,
-		    const double *xr,
-		    double *xr_pow,
+		    const faac_real *xr,
+		    faac_real *xr_pow,
 		    int *xi,
 		    double *xmin,
-		    double *pow43,
-		    double *adj43);
+		    faac_real *pow43,
+		    faac_real *adj43,
+		    const QuantKernels *kernels);
 
 static void CalcAllowedDist(CoderInfo *coderInfo, PsyInfo *psyInfo,
-			    double *xr, double *xmin, int quality);
+			    faac_real *xr, double *xmin, int quality);
 
 
 void AACQuantizeInit(CoderInfo *coderInfo, unsigned int numChannels,
@@ -53,8 +59,8 @@ void AACQuantizeInit(CoderInfo *coderInfo, unsigned int numChannels,
 {
     unsigned int channel, i;
 
-    aacquantCfg->pow43 = (double*)AllocMemory(PRECALC_SIZE*sizeof(double));
-    aacquantCfg->adj43 = (double*)AllocMemory(PRECALC_SIZE*sizeof(double));
+    aacquantCfg->pow43 = (faac_real*)AllocMemory(PRECALC_SIZE*sizeof(faac_real));
+    aacquantCfg->adj43 = (faac_real*)AllocMemory(PRECALC_SIZE*sizeof(faac_real));
 
     aacquantCfg->pow43[0] = 0.0;
     for(i=1;i<PRECALC_SIZE;i++)
@@ -70,8 +76,14 @@ void AACQuantizeInit(CoderInfo *coderInfo, unsigned int numChannels,
     aacquantCfg->adj43[i] = 0.5;
 #endif
 
+    aacquantCfg->kernels = GetQuantKernels(QUANT_KERNELS_AVX);
+    if (!aacquantCfg->kernels)
+        aacquantCfg->kernels = GetQuantKernels(QUANT_KERNELS_SSE2);
+    if (!aacquantCfg->kernels)
+        aacquantCfg->kernels = GetQuantKernels(QUANT_KERNELS_SCALAR);
+
     for (channel = 0; channel < numChannels; channel++) {
-        coderInfo[channel].requantFreq = (double*)AllocMemory(BLOCK_LEN_LONG*sizeof(double));
+        coderInfo[channel].requantFreq = (faac_real*)AllocMemory(BLOCK_LEN_LONG*sizeof(faac_real));
     }
 }
 
@@ -97,8 +109,8 @@ void AACQuantizeEnd(CoderInfo *coderInfo, unsigned int numChannels,
 }
 
 static void BalanceEnergy(CoderInfo *coderInfo,
-			  const double *xr, const int *xi,
-			  double *pow43)
+			  const faac_real *xr, const int *xi,
+			  faac_real *pow43)
 {
   const double ifqstep = pow(2.0, 0.25);
   const double logstep_1 = 1.0 / log(ifqstep);
@@ -147,9 +159,9 @@ static void BalanceEnergy(CoderInfo *coderInfo,
 }
 
 static void UpdateRequant(CoderInfo *coderInfo, int *xi,
-			  double *pow43)
+			  faac_real *pow43)
 {
-  double *requant_xr = coderInfo->requantFreq;
+  faac_real *requant_xr = coderInfo->requantFreq;
   int sb;
   int i;
 
@@ -170,14 +182,16 @@ int AACQuantize(CoderInfo *coderInfo,
                 ChannelInfo *channelInfo,
                 int *cb_width,
                 int num_cb,
-                double *xr,
-		AACQuantCfg *aacquantCfg)
+                faac_real *xr,
+		AACQuantCfg *aacquantCfg,
+		ScratchArena *scratch)
 {
     int sb, i, do_q = 0;
     int bits = 0, sign;
-    double xr_pow[FRAME_LEN];
-    double xmin[MAX_SCFAC_BANDS];
-    int xi[FRAME_LEN];
+    size_t mark = ScratchMark(scratch);
+    faac_real *xr_pow = (faac_real *)ScratchAlloc(scratch, FRAME_LEN*sizeof(faac_real));
+    double *xmin = (double *)ScratchAlloc(scratch, MAX_SCFAC_BANDS*sizeof(double));
+    int *xi = (int *)ScratchAlloc(scratch, FRAME_LEN*sizeof(int));
 
     /* Use local copy's */
     int *scale_factor = coderInfo->scale_factor;
@@ -188,17 +202,13 @@ int AACQuantize(CoderInfo *coderInfo,
         scale_factor[sb] = 0;
 
     /* Compute xr_pow */
-    for (i = 0; i < FRAME_LEN; i++) {
-        double temp = fabs(xr[i]);
-        xr_pow[i] = sqrt(temp * sqrt(temp));
-        do_q += (temp > 1E-20);
-    }
+    do_q = aacquantCfg->kernels->XrPow(xr, xr_pow, FRAME_LEN);
 
     if (do_q) {
         CalcAllowedDist(coderInfo, psyInfo, xr, xmin, aacquantCfg->quality);
 	coderInfo->global_gain = 0;
 	FixNoise(coderInfo, xr, xr_pow, xi, xmin,
-		 aacquantCfg->pow43, aacquantCfg->adj43);
+		 aacquantCfg->pow43, aacquantCfg->adj43, aacquantCfg->kernels);
 	BalanceEnergy(coderInfo, xr, xi, aacquantCfg->pow43);
 	UpdateRequant(coderInfo, xi, aacquantCfg->pow43);
 
@@ -276,6 +286,8 @@ int AACQuantize(CoderInfo *coderInfo,
     // FIXME: Check those max_sfb/nr_of_sfb. Isn't it the same?
     coderInfo->max_sfb = coderInfo->nr_of_sfb = sb + 1;
 
+    ScratchRelease(scratch, mark);
+
     return bits;
 }
 
@@ -322,8 +334,8 @@ static void Quantize(const double *xp, int *pi, double istep)
     }
 }
 #endif
-static void QuantizeBand(const double *xp, int *pi, double istep,
-			 int offset, int end, double *adj43)
+static void QuantizeBandScalar(const faac_real *xp, int *pi, faac_real istep,
+			       int offset, int end, const faac_real *adj43)
 {
   int j;
   fi_union *fi;
@@ -331,6 +343,7 @@ static void QuantizeBand(const double *xp, int *pi, double istep,
   fi = (fi_union *)pi;
   for (j = offset; j < end; j++)
   {
+    /* the fraction must survive the magic add, keep it in double */
     double x0 = istep * xp[j];
 
     x0 += MAGIC_FLOAT; fi[j].f = (float)x0;
@@ -383,22 +396,371 @@ static void Quantize(const double *xr, int *ix, double istep)
     }
 }
 #endif
-static void QuantizeBand(const double *xp, int *ix, double istep,
-			 int offset, int end, double *adj43)
+static void QuantizeBandScalar(const faac_real *xp, int *ix, faac_real istep,
+			       int offset, int end, const faac_real *adj43)
 {
   int j;
 
   for (j = offset; j < end; j++)
   {
-    double x0 = istep * xp[j];
+    faac_real x0 = istep * xp[j];
     x0 += adj43[(int)x0];
     ix[j] = (int)x0;
   }
 }
 #endif
 
+static int XrPowScalar(const faac_real *xr, faac_real *xr_pow, int n)
+{
+  int i, do_q = 0;
+
+  for (i = 0; i < n; i++)
+  {
+    faac_real temp = FAAC_FABS(xr[i]);
+    xr_pow[i] = FAAC_SQRT(temp * FAAC_SQRT(temp));
+    do_q += (temp > 1E-20);
+  }
+  return do_q;
+}
+
+static double BandMaxScalar(const faac_real *x, int start, int end)
+{
+  double maxx = 0.0;
+  int i;
+
+  for (i = start; i < end; i++)
+  {
+    if (x[i] > maxx)
+      maxx = x[i];
+  }
+  return maxx;
+}
+
+static void ScaleBandScalar(faac_real *x, double fac, int start, int end)
+{
+  int i;
+
+  for (i = start; i < end; i++)
+    x[i] *= fac;
+}
+
+/* the squares of quantized values are integers below 2^27, their sums
+   stay exact in a double in any order */
+static double BandEnergyScalar(const int *xi, int start, int end)
+{
+  double energy = 0.0;
+  int i;
+
+  for (i = start; i < end; i++)
+  {
+    double tmp = xi[i];
+    energy += tmp * tmp;
+  }
+  return energy;
+}
+
+#ifdef FAAC_X86
+
+/*
+ * XrPow and BandMax work on vectors of faac_real. ScaleBand and
+ * QuantizeBand multiply with a double like the scalar code, they work on
+ * doubles and round to faac_real where the scalar code does.
+ */
+#ifdef FAAC_PRECISION_SINGLE
+#define SSE_LANES		4
+#define sse_vec			__m128
+#define sse_load		_mm_loadu_ps
+#define sse_store		_mm_storeu_ps
+#define sse_mul			_mm_mul_ps
+#define sse_sqrt		_mm_sqrt_ps
+#define sse_max			_mm_max_ps
+#define sse_andnot		_mm_andnot_ps
+#define sse_cmpgt		_mm_cmpgt_ps
+#define sse_movemask		_mm_movemask_ps
+#define sse_set1		_mm_set1_ps
+#define AVX_LANES		8
+#define avx_vec			__m256
+#define avx_load		_mm256_loadu_ps
+#define avx_store		_mm256_storeu_ps
+#define avx_mul			_mm256_mul_ps
+#define avx_sqrt		_mm256_sqrt_ps
+#define avx_max			_mm256_max_ps
+#define avx_andnot		_mm256_andnot_ps
+#define avx_cmpgt(a, b)		_mm256_cmp_ps(a, b, _CMP_GT_OQ)
+#define avx_movemask		_mm256_movemask_ps
+#define avx_set1		_mm256_set1_ps
+#define LOAD_REAL2(p)		_mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)(p))))
+#define STORE_REAL2(p, v)	_mm_storel_epi64((__m128i *)(p), _mm_castps_si128(_mm_cvtpd_ps(v)))
+#define ROUND_REAL2(v)		_mm_cvtps_pd(_mm_cvtpd_ps(v))
+#define LOAD_REAL4(p)		_mm256_cvtps_pd(_mm_loadu_ps(p))
+#define STORE_REAL4(p, v)	_mm_storeu_ps(p, _mm256_cvtpd_ps(v))
+#define ROUND_REAL4(v)		_mm256_cvtps_pd(_mm256_cvtpd_ps(v))
+#else
+#define SSE_LANES		2
+#define sse_vec			__m128d
+#define sse_load		_mm_loadu_pd
+#define sse_store		_mm_storeu_pd
+#define sse_mul			_mm_mul_pd
+#define sse_sqrt		_mm_sqrt_pd
+#define sse_max			_mm_max_pd
+#define sse_andnot		_mm_andnot_pd
+#define sse_cmpgt		_mm_cmpgt_pd
+#define sse_movemask		_mm_movemask_pd
+#define sse_set1		_mm_set1_pd
+#define AVX_LANES		4
+#define avx_vec			__m256d
+#define avx_load		_mm256_loadu_pd
+#define avx_store		_mm256_storeu_pd
+#define avx_mul			_mm256_mul_pd
+#define avx_sqrt		_mm256_sqrt_pd
+#define avx_max			_mm256_max_pd
+#define avx_andnot		_mm256_andnot_pd
+#define avx_cmpgt(a, b)		_mm256_cmp_pd(a, b, _CMP_GT_OQ)
+#define avx_movemask		_mm256_movemask_pd
+#define avx_set1		_mm256_set1_pd
+#define LOAD_REAL2(p)		_mm_loadu_pd(p)
+#define STORE_REAL2(p, v)	_mm_storeu_pd(p, v)
+#define ROUND_REAL2(v)		(v)
+#define LOAD_REAL4(p)		_mm256_loadu_pd(p)
+#define STORE_REAL4(p, v)	_mm256_storeu_pd(p, v)
+#define ROUND_REAL4(v)		(v)
+#endif
+
+/* (faac_real)1E-20 is below 1E-20 in both precisions, so comparing with
+   it in faac_real gives the same answer as the scalar double compare */
+static int XrPowSse2(const faac_real *xr, faac_real *xr_pow, int n)
+{
+  const sse_vec sign = sse_set1(-0.0);
+  const sse_vec thr = sse_set1(1E-20);
+  int i, any = 0;
+
+  for (i = 0; i + SSE_LANES <= n; i += SSE_LANES)
+  {
+    sse_vec temp = sse_andnot(sign, sse_load(xr + i));
+
+    sse_store(xr_pow + i, sse_sqrt(sse_mul(temp, sse_sqrt(temp))));
+    any |= sse_movemask(sse_cmpgt(temp, thr));
+  }
+  return any | XrPowScalar(xr + i, xr_pow + i, n - i);
+}
+
+/* two accumulators so consecutive maxes don't wait on each other, bands
+   are short and one chain is bound by the max latency */
+static double BandMaxSse2(const faac_real *x, int start, int end)
+{
+  sse_vec maxv = sse_set1(0.0);
+  sse_vec max2 = maxv;
+  faac_real lanes[SSE_LANES];
+  double maxx;
+  int i;
+
+  for (i = start; i + 2 * SSE_LANES <= end; i += 2 * SSE_LANES)
+  {
+    maxv = sse_max(maxv, sse_load(x + i));
+    max2 = sse_max(max2, sse_load(x + i + SSE_LANES));
+  }
+  if (i + SSE_LANES <= end)
+  {
+    maxv = sse_max(maxv, sse_load(x + i));
+    i += SSE_LANES;
+  }
+  sse_store(lanes, sse_max(maxv, max2));
+
+  maxx = BandMaxScalar(x, i, end);
+  for (i = 0; i < SSE_LANES; i++)
+  {
+    if (lanes[i] > maxx)
+      maxx = lanes[i];
+  }
+  return maxx;
+}
+
+static void ScaleBandSse2(faac_real *x, double fac, int start, int end)
+{
+  const __m128d facv = _mm_set1_pd(fac);
+  int i;
+
+  for (i = start; i + 2 <= end; i += 2)
+    STORE_REAL2(x + i, _mm_mul_pd(LOAD_REAL2(x + i), facv));
+  ScaleBandScalar(x, fac, i, end);
+}
+
+static double BandEnergySse2(const int *xi, int start, int end)
+{
+  __m128d energyv = _mm_setzero_pd();
+  __m128d energy2 = energyv;
+  double lanes[2];
+  int i;
+
+  for (i = start; i + 4 <= end; i += 4)
+  {
+    __m128i q = _mm_loadu_si128((const __m128i *)(xi + i));
+    __m128d v0 = _mm_cvtepi32_pd(q);
+    __m128d v1 = _mm_cvtepi32_pd(_mm_unpackhi_epi64(q, q));
+
+    energyv = _mm_add_pd(energyv, _mm_mul_pd(v0, v0));
+    energy2 = _mm_add_pd(energy2, _mm_mul_pd(v1, v1));
+  }
+  _mm_storeu_pd(lanes, _mm_add_pd(energyv, energy2));
+  return lanes[0] + lanes[1] + BandEnergyScalar(xi, i, end);
+}
+
+FAAC_TARGET_AVX
+static int XrPowAvx(const faac_real *xr, faac_real *xr_pow, int n)
+{
+  const avx_vec sign = avx_set1(-0.0);
+  const avx_vec thr = avx_set1(1E-20);
+  int i, any = 0;
+
+  for (i = 0; i + AVX_LANES <= n; i += AVX_LANES)
+  {
+    avx_vec temp = avx_andnot(sign, avx_load(xr + i));
+
+    avx_store(xr_pow + i, avx_sqrt(avx_mul(temp, avx_sqrt(temp))));
+    any |= avx_movemask(avx_cmpgt(temp, thr));
+  }
+  _mm256_zeroupper();
+  return any | XrPowScalar(xr + i, xr_pow + i, n - i);
+}
+
+FAAC_TARGET_AVX
+static double BandMaxAvx(const faac_real *x, int start, int end)
+{
+  avx_vec maxv = avx_set1(0.0);
+  faac_real lanes[AVX_LANES];
+  double maxx;
+  int i;
+
+  for (i = start; i + AVX_LANES <= end; i += AVX_LANES)
+    maxv = avx_max(maxv, avx_load(x + i));
+  avx_store(lanes, maxv);
+  _mm256_zeroupper();
+
+  maxx = BandMaxScalar(x, i, end);
+  for (i = 0; i < AVX_LANES; i++)
+  {
+    if (lanes[i] > maxx)
+      maxx = lanes[i];
+  }
+  return maxx;
+}
+
+FAAC_TARGET_AVX
+static void ScaleBandAvx(faac_real *x, double fac, int start, int end)
+{
+  const __m256d facv = _mm256_set1_pd(fac);
+  int i;
+
+  for (i = start; i + 4 <= end; i += 4)
+    STORE_REAL4(x + i, _mm256_mul_pd(LOAD_REAL4(x + i), facv));
+  _mm256_zeroupper();
+  ScaleBandScalar(x, fac, i, end);
+}
+
+FAAC_TARGET_AVX
+static double BandEnergyAvx(const int *xi, int start, int end)
+{
+  __m256d energyv = _mm256_setzero_pd();
+  double lanes[4];
+  int i;
+
+  for (i = start; i + 4 <= end; i += 4)
+  {
+    __m256d v = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i *)(xi + i)));
+    energyv = _mm256_add_pd(energyv, _mm256_mul_pd(v, v));
+  }
+  _mm256_storeu_pd(lanes, energyv);
+  _mm256_zeroupper();
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + BandEnergyScalar(xi, i, end);
+}
+
+#if TAKEHIRO_IEEE754_HACK
+/* QuantizeBandScalar() a vector at a time, the adj43 lookups stay scalar */
+static void QuantizeBandSse2(const faac_real *xp, int *pi, faac_real istep,
+			     int offset, int end, const faac_real *adj43)
+{
+  const __m128d step = _mm_set1_pd(istep);
+  const __m128d magic = _mm_set1_pd(MAGIC_FLOAT);
+  const __m128i magic_int = _mm_set1_epi32(MAGIC_INT);
+  int idx[4];
+  int j;
+
+  for (j = offset; j + 2 <= end; j += 2)
+  {
+    __m128d x0 = ROUND_REAL2(_mm_mul_pd(LOAD_REAL2(xp + j), step));
+    __m128i q;
+
+    x0 = _mm_add_pd(x0, magic);
+    q = _mm_sub_epi32(_mm_castps_si128(_mm_cvtpd_ps(x0)), magic_int);
+    _mm_storeu_si128((__m128i *)idx, q);
+    x0 = _mm_add_pd(x0, _mm_set_pd(adj43[idx[1]], adj43[idx[0]]));
+    q = _mm_sub_epi32(_mm_castps_si128(_mm_cvtpd_ps(x0)), magic_int);
+    _mm_storel_epi64((__m128i *)(pi + j), q);
+  }
+  QuantizeBandScalar(xp, pi, istep, j, end, adj43);
+}
+
+FAAC_TARGET_AVX
+static void QuantizeBandAvx(const faac_real *xp, int *pi, faac_real istep,
+			    int offset, int end, const faac_real *adj43)
+{
+  const __m256d step = _mm256_set1_pd(istep);
+  const __m256d magic = _mm256_set1_pd(MAGIC_FLOAT);
+  const __m128i magic_int = _mm_set1_epi32(MAGIC_INT);
+  int idx[4];
+  int j;
+
+  for (j = offset; j + 4 <= end; j += 4)
+  {
+    __m256d x0 = ROUND_REAL4(_mm256_mul_pd(LOAD_REAL4(xp + j), step));
+    __m128i q;
+
+    x0 = _mm256_add_pd(x0, magic);
+    q = _mm_sub_epi32(_mm_castps_si128(_mm256_cvtpd_ps(x0)), magic_int);
+    _mm_storeu_si128((__m128i *)idx, q);
+    x0 = _mm256_add_pd(x0, _mm256_set_pd(adj43[idx[3]], adj43[idx[2]],
+					 adj43[idx[1]], adj43[idx[0]]));
+    q = _mm_sub_epi32(_mm_castps_si128(_mm256_cvtpd_ps(x0)), magic_int);
+    _mm_storeu_si128((__m128i *)(pi + j), q);
+  }
+  _mm256_zeroupper();
+  QuantizeBandScalar(xp, pi, istep, j, end, adj43);
+}
+#else
+#define QuantizeBandSse2 QuantizeBandScalar
+#define QuantizeBandAvx QuantizeBandScalar
+#endif
+
+#endif /* FAAC_X86 */
+
+static const QuantKernels quantKernels[QUANT_KERNELS_COUNT] = {
+  { "scalar", XrPowScalar, BandMaxScalar, ScaleBandScalar,
+    QuantizeBandScalar, BandEnergyScalar },
+#ifdef FAAC_X86
+  { "sse2", XrPowSse2, BandMaxSse2, ScaleBandSse2,
+    QuantizeBandSse2, BandEnergySse2 },
+  { "avx", XrPowAvx, BandMaxAvx, ScaleBandAvx,
+    QuantizeBandAvx, BandEnergyAvx },
+#endif
+};
+
+const QuantKernels *GetQuantKernels(int isa)
+{
+#ifdef FAAC_X86
+  unsigned int flags = GetCpuFlags();
+
+  if ((isa == QUANT_KERNELS_SSE2) && (flags & CPU_FLAG_SSE2))
+    return &quantKernels[isa];
+  if ((isa == QUANT_KERNELS_AVX) && (flags & CPU_FLAG_AVX))
+    return &quantKernels[isa];
+#endif
+  if (isa == QUANT_KERNELS_SCALAR)
+    return &quantKernels[isa];
+  return NULL;
+}
+
 static void CalcAllowedDist(CoderInfo *coderInfo, PsyInfo *psyInfo,
-                            double *xr, double *xmin, int quality)
+                            faac_real *xr, double *xmin, int quality)
 {
   int sfb, start, end, l;
   const double globalthr = 132.0 / (double)quality;
@@ -470,12 +832,13 @@ static void CalcAllowedDist(CoderInfo *coderInfo, PsyInfo *psyInfo,
 }
 
 static int FixNoise(CoderInfo *coderInfo,
-		    const double *xr,
-		    double *xr_pow,
+		    const faac_real *xr,
+		    faac_real *xr_pow,
 		    int *xi,
 		    double *xmin,
-		    double *pow43,
-		    double *adj43)
+		    faac_real *pow43,
+		    faac_real *adj43,
+		    const QuantKernels *kernels)
 {
     int i, sb;
     int start, end;
@@ -501,12 +864,7 @@ static int FixNoise(CoderInfo *coderInfo,
       if (!xmin[sb])
 	goto nullsfb;
 
-      maxx = 0.0;
-      for (i = start; i < end; i++)
-      {
-	if (xr_pow[i] > maxx)
-	  maxx = xr_pow[i];
-      }
+      maxx = kernels->BandMax(xr_pow, start, end);
 
       //printf("band %d: maxx: %f\n", sb, maxx);
       if (maxx < 10.0)
@@ -520,21 +878,15 @@ static int FixNoise(CoderInfo *coderInfo,
 
       sfacfix = 1.0 / maxx;
       sfac = (int)(log(sfacfix) * log_ifqstep - 0.5);
-      for (i = start; i < end; i++)
-	xr_pow[i] *= sfacfix;
+      kernels->ScaleBand(xr_pow, sfacfix, start, end);
       maxx *= sfacfix;
       coderInfo->scale_factor[sb] = sfac;
-      QuantizeBand(xr_pow, xi, IPOW20(coderInfo->global_gain), start, end,
-		   adj43);
+      kernels->QuantizeBand(xr_pow, xi, IPOW20(coderInfo->global_gain), start, end,
+			    adj43);
       //printf("\tsfac: %d\n", sfac);
 
     calcdist:
-      diffvol = 0.0;
-      for (i = start; i < end; i++)
-      {
-	tmp = xi[i];
-	diffvol += tmp * tmp;  // ~x^(3/2)
-      }
+      diffvol = kernels->BandEnergy(xi, start, end);  // ~x^(3/2)
 
       if (diffvol < 1e-6)
 	diffvol = 1e-6;
@@ -595,25 +947,23 @@ static int FixNoise(CoderInfo *coderInfo,
 	{
 	  // restore best noise
 	  fac = sfacfix0 / sfacfix;
-	  for (i = start; i < end; i++)
-	    xr_pow[i] *= fac;
+	  kernels->ScaleBand(xr_pow, fac, start, end);
 	  maxx *= fac;
 	  sfacfix *= fac;
 	  coderInfo->scale_factor[sb] = log(sfacfix) * log_ifqstep - 0.5;
-	  QuantizeBand(xr_pow, xi, IPOW20(coderInfo->global_gain), start, end,
-		       adj43);
+	  kernels->QuantizeBand(xr_pow, xi, IPOW20(coderInfo->global_gain), start, end,
+				adj43);
 	  continue;
 	}
 
 	if (coderInfo->scale_factor[sb] < -10)
 	{
-	  for (i = start; i < end; i++)
-	    xr_pow[i] *= fac;
+	  kernels->ScaleBand(xr_pow, fac, start, end);
           maxx *= fac;
           sfacfix *= fac;
 	  coderInfo->scale_factor[sb] = log(sfacfix) * log_ifqstep - 0.5;
-	  QuantizeBand(xr_pow, xi, IPOW20(coderInfo->global_gain), start, end,
-		       adj43);
+	  kernels->QuantizeBand(xr_pow, xi, IPOW20(coderInfo->global_gain), start, end,
+				adj43);
 	  goto calcdist;
 	}
       }
@@ -625,11 +975,11 @@ int SortForGrouping(CoderInfo* coderInfo,
                            PsyInfo *psyInfo,
                            ChannelInfo *channelInfo,
                            int *sfb_width_table,
-                           double *xr)
+                           faac_real *xr)
 {
     int i,j,ii;
     int index = 0;
-    double xr_tmp[FRAME_LEN];
+    faac_real xr_tmp[FRAME_LEN];
     int group_offset=0;
     int k=0;
     int windowOffset = 0;
@@ -686,7 +1036,7 @@ int SortForGrouping(CoderInfo* coderInfo,
 }
 
 void CalcAvgEnrg(CoderInfo *coderInfo,
-		 const double *xr)
+		 const faac_real *xr)
 {
   int end, l;
   int last = 0;
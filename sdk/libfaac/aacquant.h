@@ -28,6 +28,7 @@ extern "C" {
 
 #include "coder.h"
 #include "psych.h"
+#include "util.h"
 
 #define IXMAX_VAL 8191
 #define PRECALC_SIZE (IXMAX_VAL+2)
@@ -37,15 +38,44 @@ extern "C" {
 #define POW20(x)  pow(2.0,((double)x)*.25)
 #define IPOW20(x)  pow(2.0,-((double)x)*.1875)
 
+/* Inner loops of the quantizer, one set per instruction set. All sets
+   give bit-identical results. */
+enum {
+    QUANT_KERNELS_SCALAR,
+    QUANT_KERNELS_SSE2,
+    QUANT_KERNELS_AVX,
+    QUANT_KERNELS_COUNT
+};
+
+typedef struct
+  {
+    const char *name;
+    /* xr_pow = |xr|^(3/4), returns nonzero if any |xr| is above 1e-20 */
+    int (*XrPow)(const faac_real *xr, faac_real *xr_pow, int n);
+    /* largest x[start..end-1], at least 0 */
+    double (*BandMax)(const faac_real *x, int start, int end);
+    /* x[start..end-1] *= fac */
+    void (*ScaleBand)(faac_real *x, double fac, int start, int end);
+    /* xi = quantized xr_pow * istep, rounded with adj43 */
+    void (*QuantizeBand)(const faac_real *xr_pow, int *xi, faac_real istep,
+                         int start, int end, const faac_real *adj43);
+    /* sum of xi^2 over the band, exact */
+    double (*BandEnergy)(const int *xi, int start, int end);
+  } QuantKernels;
+
 #pragma pack(push, 1)
 typedef struct
   {
-    double *pow43;
-    double *adj43;
+    faac_real *pow43;
+    faac_real *adj43;
     double quality;
+    const QuantKernels *kernels;
   } AACQuantCfg;
 #pragma pack(pop)
 
+/* Returns the QUANT_KERNELS_* set, NULL if the cpu doesn't support it */
+const QuantKernels *GetQuantKernels(int isa);
+
 void AACQuantizeInit(CoderInfo *coderInfo, unsigned int numChannels,
 		     AACQuantCfg *aacquantCfg);
 void AACQuantizeEnd(CoderInfo *coderInfo, unsigned int numChannels,
@@ -56,16 +86,17 @@ int AACQuantize(CoderInfo *coderInfo,
                 ChannelInfo *channelInfo,
                 int *cb_width,
                 int num_cb,
-                double *xr,
-		AACQuantCfg *aacquantcfg);
+                faac_real *xr,
+		AACQuantCfg *aacquantcfg,
+		ScratchArena *scratch);
 
 int SortForGrouping(CoderInfo* coderInfo,
 		    PsyInfo *psyInfo,
 		    ChannelInfo *channelInfo,
 		    int *sfb_width_table,
-		    double *xr);
+		    faac_real *xr);
 void CalcAvgEnrg(CoderInfo *coderInfo,
-		 const double *xr);
+		 const faac_real *xr);
 
 #ifdef __cplusplus
 }
@@ -46,7 +46,7 @@ void PredInit(faacEncHandle hEncoder)
     }
 }
 
-void PredCalcPrediction(double *act_spec, double *last_spec, int btype,
+void PredCalcPrediction(faac_real *act_spec, faac_real *last_spec, int btype,
                         int nsfb,
                         int *isfb_width,
                         CoderInfo *coderInfo,
@@ -56,17 +56,17 @@ void PredCalcPrediction(double *act_spec, double *last_spec, int btype,
     int i, k, j, cb_long;
     int leftChanNum;
     int isRightWithCommonWindow;
-    double num_bit, snr[SBMAX_L];
-    double energy[BLOCK_LEN_LONG], snr_p[BLOCK_LEN_LONG], temp1, temp2;
+    faac_real num_bit, snr[SBMAX_L];
+    faac_real energy[BLOCK_LEN_LONG], snr_p[BLOCK_LEN_LONG], temp1, temp2;
     ChannelInfo *thisChannel;
 
     /* Set pointers for specified channel number */
     /* int psy_init; */
     int *psy_init;
-    double (*dr)[BLOCK_LEN_LONG],(*e)[BLOCK_LEN_LONG];
-    double (*K)[BLOCK_LEN_LONG], (*R)[BLOCK_LEN_LONG];
-    double (*VAR)[BLOCK_LEN_LONG], (*KOR)[BLOCK_LEN_LONG];
-    double *sb_samples_pred;
+    faac_real (*dr)[BLOCK_LEN_LONG],(*e)[BLOCK_LEN_LONG];
+    faac_real (*K)[BLOCK_LEN_LONG], (*R)[BLOCK_LEN_LONG];
+    faac_real (*VAR)[BLOCK_LEN_LONG], (*KOR)[BLOCK_LEN_LONG];
+    faac_real *sb_samples_pred;
     int *thisLineNeedsResetting;
     /* int reset_count; */
     int *reset_count;
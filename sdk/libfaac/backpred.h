@@ -34,8 +34,8 @@
 /* Reset every RESET_FRAME frames. */
 #define RESET_FRAME 8
 
-void PredCalcPrediction(double *act_spec,
-                        double *last_spec,
+void PredCalcPrediction(faac_real *act_spec,
+                        faac_real *last_spec,
                         int btype,
                         int nsfb,
                         int *isfb_width,
@@ -37,11 +37,9 @@ Copyright (c) 1997.
 #include "ltp.h"
 #include "util.h"
 
-static int CountBitstream(faacEncHandle hEncoder,
-                          CoderInfo *coderInfo,
-                          ChannelInfo *channelInfo,
-                          BitStream *bitStream,
-                          int numChannels);
+/* bit offset of the 13 bit frame length in the adts header */
+#define ADTS_FRAME_LENGTH_POS 30
+
 static int WriteADTSHeader(faacEncHandle hEncoder,
                            BitStream *bitStream,
                            int writeFlag);
@@ -94,12 +92,19 @@ static int WriteAACFillBits(BitStream* bitStream,
                             int writeFlag);
 static int FindGroupingBits(CoderInfo *coderInfo);
 static long BufferNumBit(BitStream *bitStream);
-static int WriteByte(BitStream *bitStream,
-                     unsigned long data,
-                     int numBit);
+static void WriteWord(BitStream *bitStream,
+                      long idx,
+                      unsigned long word,
+                      int numByte);
+static void FlushBitCache(BitStream *bitStream);
+static void PatchBits(BitStream *bitStream,
+                      long pos,
+                      unsigned long data,
+                      int numBit);
 static int ByteAlign(BitStream* bitStream,
                      int writeFlag, int bitsSoFar);
 #ifdef DRM
+static void SeekBitStream(BitStream *bitStream, long pos);
 static int PutBitHcr(BitStream *bitStream,
                      unsigned long curpos,
                      unsigned long data,
@@ -161,8 +166,7 @@ int WriteBitstream(faacEncHandle hEncoder,
     int channel;
     int bits = 0;
     int bitsLeftAfterFill, numFillBits;
-
-    CountBitstream(hEncoder, coderInfo, channelInfo, bitStream, numChannel);
+    long startBit = BufferNumBit(bitStream);
 
     if(hEncoder->config.outputFormat == 1){
         bits += WriteADTSHeader(hEncoder, bitStream, 1);
@@ -240,91 +244,10 @@ int WriteBitstream(faacEncHandle hEncoder,
      */
     bits += ByteAlign(bitStream, 1, bits);
 
-    return bits;
-}
-
-static int CountBitstream(faacEncHandle hEncoder,
-                          CoderInfo *coderInfo,
-                          ChannelInfo *channelInfo,
-                          BitStream *bitStream,
-                          int numChannel)
-{
-    int channel;
-    int bits = 0;
-    int bitsLeftAfterFill, numFillBits;
-
-
-    if(hEncoder->config.outputFormat == 1){
-        bits += WriteADTSHeader(hEncoder, bitStream, 0);
-    }else{
-        bits = 0; // compilier will remove it, byt anyone will see that current size of bitstream is 0
-    }
-
-/* sur: faad2 complains about scalefactor error if we are writing FAAC String */
-#ifndef DRM
-    if (hEncoder->frameNum == 4)
-      bits += WriteFAACStr(bitStream, hEncoder->config.name, 0);
-#endif
-
-    for (channel = 0; channel < numChannel; channel++) {
-
-        if (channelInfo[channel].present) {
-
-            /* Write out a single_channel_element */
-            if (!channelInfo[channel].cpe) {
-
-                if (channelInfo[channel].lfe) {
-                    /* Write out lfe */
-                    bits += WriteLFE(&coderInfo[channel],
-                        &channelInfo[channel],
-                        bitStream,
-                        hEncoder->config.aacObjectType,
-                        0);
-                } else {
-                    /* Write out sce */
-                    bits += WriteSCE(&coderInfo[channel],
-                        &channelInfo[channel],
-                        bitStream,
-                        hEncoder->config.aacObjectType,
-                        0);
-                }
-
-            } else {
-
-                if (channelInfo[channel].ch_is_left) {
-                    /* Write out cpe */
-                    bits += WriteCPE(&coderInfo[channel],
-                        &coderInfo[channelInfo[channel].paired_ch],
-                        &channelInfo[channel],
-                        bitStream,
-                        hEncoder->config.aacObjectType,
-                        0);
-                }
-            }
-        }
-    }
-
-    /* Compute how many fill bits are needed to avoid overflowing bit reservoir */
-    /* Save room for ID_END terminator */
-    if (bits < (8 - LEN_SE_ID) ) {
-        numFillBits = 8 - LEN_SE_ID - bits;
-    } else {
-        numFillBits = 0;
-    }
-
-    /* Write AAC fill_elements, smallest fill element is 7 bits. */
-    /* Function may leave up to 6 bits left after fill, so tell it to fill a few extra */
-    numFillBits += 6;
-    bitsLeftAfterFill = WriteAACFillBits(bitStream, numFillBits, 0);
-    bits += (numFillBits - bitsLeftAfterFill);
-
-    /* Write ID_END terminator */
-    bits += LEN_SE_ID;
-
-    /* Now byte align the bitstream */
-    bits += ByteAlign(bitStream, 0, bits);
-
-    hEncoder->usedBytes = bit2byte(bits);
+    /* the frame is written in one pass, its length goes into the header last */
+    hEncoder->usedBytes = bit2byte(BufferNumBit(bitStream) - startBit);
+    if (hEncoder->config.outputFormat == 1)
+        PatchBits(bitStream, startBit + ADTS_FRAME_LENGTH_POS, hEncoder->usedBytes, 13);
 
     return bits;
 }
@@ -359,7 +282,7 @@ static int WriteADTSHeader(faacEncHandle hEncoder,
         /* Variable ADTS header */
         PutBit(bitStream, 0, 1); /* copyr. id. bit */
         PutBit(bitStream, 0, 1); /* copyr. id. start */
-        PutBit(bitStream, hEncoder->usedBytes, 13);
+        PutBit(bitStream, 0, 13); /* frame length, see WriteBitstream() */
         PutBit(bitStream, 0x7FF, 11); /* buffer fullness (0x7FF for VBR) */
         PutBit(bitStream, 0, 2); /* raw data blocks (0+1=1) */
 
@@ -929,12 +852,12 @@ static int FindGroupingBits(CoderInfo *coderInfo)
     return grouping_bits;
 }
 
-/* size in bytes! */
-BitStream *OpenBitStream(int size, unsigned char *buffer)
+/* size in bytes! the BitStream lives in scratch until the caller releases it */
+BitStream *OpenBitStream(int size, unsigned char *buffer, ScratchArena *scratch)
 {
     BitStream *bitStream;
 
-    bitStream = AllocMemory(sizeof(BitStream));
+    bitStream = ScratchAlloc(scratch, sizeof(BitStream));
     bitStream->size = size;
 #ifdef DRM
     /* skip first byte for CRC */
@@ -945,6 +868,8 @@ BitStream *OpenBitStream(int size, unsigned char *buffer)
     bitStream->currentBit = 0;
 #endif
     bitStream->data = buffer;
+    bitStream->cache = 0;
+    bitStream->cacheBits = (int)(bitStream->currentBit % BYTE_NUMBIT);
     SetMemory(bitStream->data, 0, size);
 
     return bitStream;
@@ -954,7 +879,7 @@ int CloseBitStream(BitStream *bitStream)
 {
     int bytes = bit2byte(bitStream->numBit);
 
-    FreeMemory(bitStream);
+    FlushBitCache(bitStream);
 
     return bytes;
 }
@@ -964,47 +889,83 @@ static long BufferNumBit(BitStream *bitStream)
     return bitStream->numBit;
 }
 
-static int WriteByte(BitStream *bitStream,
-                     unsigned long data,
-                     int numBit)
+/* ORs the numByte top bytes of a 32 bit word into the buffer at byte idx,
+   the buffer is cleared when opened */
+static void WriteWord(BitStream *bitStream,
+                      long idx,
+                      unsigned long word,
+                      int numByte)
 {
-    long numUsed,idx;
+    unsigned char *data = bitStream->data;
+    int i;
+
+    if (idx + 4 <= bitStream->size && numByte == 4) {
+        data[idx] |= (unsigned char)(word >> 24);
+        data[idx + 1] |= (unsigned char)(word >> 16);
+        data[idx + 2] |= (unsigned char)(word >> 8);
+        data[idx + 3] |= (unsigned char)word;
+    } else {
+        for (i = 0; i < numByte; i++)
+            data[(idx + i) % bitStream->size] |= (unsigned char)(word >> (24 - 8 * i));
+    }
+}
 
-    idx = (bitStream->currentBit / BYTE_NUMBIT) % bitStream->size;
-    numUsed = bitStream->currentBit % BYTE_NUMBIT;
-#ifndef DRM
-    if (numUsed == 0)
-        bitStream->data[idx] = 0;
-#endif
-    bitStream->data[idx] |= (data & ((1<<numBit)-1)) <<
-        (BYTE_NUMBIT-numUsed-numBit);
-    bitStream->currentBit += numBit;
-    bitStream->numBit = bitStream->currentBit;
+/* Writes out the whole cache, a partial last byte stays cached since
+   PutBit() adds to it */
+static void FlushBitCache(BitStream *bitStream)
+{
+    long idx = (bitStream->currentBit - bitStream->cacheBits) / BYTE_NUMBIT;
+    unsigned long word;
 
-    return 0;
+    while (bitStream->cacheBits >= 32) {
+        bitStream->cacheBits -= 32;
+        WriteWord(bitStream, idx, (unsigned long)(bitStream->cache >> bitStream->cacheBits) & 0xFFFFFFFFUL, 4);
+        idx += 4;
+    }
+    if (bitStream->cacheBits > 0) {
+        word = (unsigned long)(bitStream->cache << (32 - bitStream->cacheBits)) & 0xFFFFFFFFUL;
+        WriteWord(bitStream, idx, word, bit2byte(bitStream->cacheBits));
+        bitStream->cacheBits %= BYTE_NUMBIT;
+    }
 }
 
+/* Sets numBit bits written as zeros at bit pos */
+static void PatchBits(BitStream *bitStream,
+                      long pos,
+                      unsigned long data,
+                      int numBit)
+{
+    long bit;
+    int i;
+
+    FlushBitCache(bitStream);
+    for (i = 0; i < numBit; i++) {
+        bit = pos + i;
+        if ((data >> (numBit - 1 - i)) & 1)
+            bitStream->data[(bit / BYTE_NUMBIT) % bitStream->size] |= 0x80 >> (bit % BYTE_NUMBIT);
+    }
+}
+
+/* Collects the bits in a 64 bit cache and writes whole 32 bit words,
+   numBit is at most 32 */
 int PutBit(BitStream *bitStream,
            unsigned long data,
            int numBit)
 {
-    int num,maxNum,curNum;
-    unsigned long bits;
-
     if (numBit == 0)
         return 0;
 
-    /* write bits in packets according to buffer byte boundaries */
-    num = 0;
-    maxNum = BYTE_NUMBIT - bitStream->currentBit % BYTE_NUMBIT;
-    while (num < numBit) {
-        curNum = min(numBit-num,maxNum);
-        bits = data>>(numBit-num-curNum);
-        if (WriteByte(bitStream, bits, curNum)) {
-            return 1;
-        }
-        num += curNum;
-        maxNum = BYTE_NUMBIT;
+    bitStream->cache = (bitStream->cache << numBit)
+        | (data & ((1ULL << numBit) - 1));
+    bitStream->cacheBits += numBit;
+    bitStream->currentBit += numBit;
+    bitStream->numBit = bitStream->currentBit;
+
+    if (bitStream->cacheBits >= 32) {
+        bitStream->cacheBits -= 32;
+        WriteWord(bitStream,
+            (bitStream->currentBit - bitStream->cacheBits) / BYTE_NUMBIT - 4,
+            (unsigned long)(bitStream->cache >> bitStream->cacheBits) & 0xFFFFFFFFUL, 4);
     }
 
     return 0;
@@ -1062,12 +1023,20 @@ typedef struct { /* codeword parameters */
     unsigned short num_data; /* number of data cells for codeword */
 } cw_info_t;
 
+static void SeekBitStream(BitStream *bitStream, long pos)
+{ /* the bits before pos in its byte are kept, the cache ORs them in */
+    FlushBitCache(bitStream);
+    bitStream->currentBit = pos;
+    bitStream->cache = 0;
+    bitStream->cacheBits = (int)(pos % BYTE_NUMBIT);
+}
+
 static int PutBitHcr(BitStream *bitStream,
                      unsigned long curpos,
                      unsigned long data,
                      int numBit)
 { /* data can be written at an arbitrary position in the bitstream */
-    bitStream->currentBit = curpos;
+    SeekBitStream(bitStream, curpos);
     return PutBit(bitStream, data, numBit);
 }
 
@@ -1350,7 +1319,7 @@ static int WriteReorderedSpectralData(CoderInfo *coderInfo,
         }
 
         /* set parameter for bit stream to current correct position */
-        bitStream->currentBit = startbitpos + coderInfo->iLenReordSpData;
+        SeekBitStream(bitStream, startbitpos + coderInfo->iLenReordSpData);
         bitStream->numBit = bitStream->currentBit;
     }
 
@@ -1408,7 +1377,10 @@ static void calc_CRC(BitStream *bitStream, int len)
     unsigned int taillen    = len & 0x7;
     unsigned char* pb       = &bitStream->data[1];
     //compatible, but slower unsigned char b         = ( bitStream->data[cb + 1] ) >> ( 8 - taillen );
-    unsigned char b         = bitStream->data[cb + 1];
+    unsigned char b;
+
+    FlushBitCache(bitStream);
+    b = bitStream->data[cb + 1];
     
 //#define GPOLY 0435
 //
@@ -145,6 +145,8 @@ typedef struct
   long size;            /* buffer size in bytes */
   long currentBit;      /* current bit position in bit stream */
   long numByte;         /* number of bytes read/written (only file) */
+  unsigned long long cache; /* bits not yet in data, the last cacheBits ones */
+  int cacheBits;        /* counted from the byte boundary before them */
 } BitStream;
 
 
@@ -156,7 +158,7 @@ int WriteBitstream(faacEncHandle hEncoder,
                    int numChannels);
 
 
-BitStream *OpenBitStream(int size, unsigned char *buffer);
+BitStream *OpenBitStream(int size, unsigned char *buffer, ScratchArena *scratch);
 
 int CloseBitStream(BitStream *bitStream);
 
@@ -32,6 +32,23 @@ extern "C" {
 /* Allow encoding of Digital Radio Mondiale (DRM) with transform length 1024 */
 //#define DRM_1024
 
+/* Run the encode path in single instead of double precision */
+//#define FAAC_PRECISION_SINGLE
+
+#ifdef FAAC_PRECISION_SINGLE
+typedef float faac_real;
+#define FAAC_SQRT sqrtf
+#define FAAC_FABS fabsf
+#define FAAC_POW powf
+#define FAAC_LOG10 log10f
+#else
+typedef double faac_real;
+#define FAAC_SQRT sqrt
+#define FAAC_FABS fabs
+#define FAAC_POW pow
+#define FAAC_LOG10 log10
+#endif
+
 #define MAX_CHANNELS 64
 
 #ifdef DRM
@@ -93,8 +110,8 @@ typedef struct {
     int direction;                       /* Filtering direction */
     int coefCompress;                    /* Are coeffs compressed? */
     int length;                          /* Length, in bands */
-    double aCoeffs[TNS_MAX_ORDER+1];     /* AR Coefficients */
-    double kCoeffs[TNS_MAX_ORDER+1];     /* Reflection Coefficients */
+    faac_real aCoeffs[TNS_MAX_ORDER+1];  /* AR Coefficients */
+    faac_real kCoeffs[TNS_MAX_ORDER+1];  /* Reflection Coefficients */
     int index[TNS_MAX_ORDER+1];          /* Coefficient indices */
 } TnsFilterData;
 
@@ -124,20 +141,20 @@ typedef struct
     int delay[MAX_SHORT_WINDOWS];
     int global_pred_flag;
     int side_info;
-    double *buffer;
-    double *mdct_predicted;
+    faac_real *buffer;
+    faac_real *mdct_predicted;
 
-    double *time_buffer;
-    double *ltp_overlap_buffer;
+    faac_real *time_buffer;
+    faac_real *ltp_overlap_buffer;
 } LtpInfo;
 
 typedef struct
 {
     int psy_init_mc;
-    double dr_mc[LPC][BLOCK_LEN_LONG],e_mc[LPC+1+1][BLOCK_LEN_LONG];
-    double K_mc[LPC+1][BLOCK_LEN_LONG], R_mc[LPC+1][BLOCK_LEN_LONG];
-    double VAR_mc[LPC+1][BLOCK_LEN_LONG], KOR_mc[LPC+1][BLOCK_LEN_LONG];
-    double sb_samples_pred_mc[BLOCK_LEN_LONG];
+    faac_real dr_mc[LPC][BLOCK_LEN_LONG],e_mc[LPC+1+1][BLOCK_LEN_LONG];
+    faac_real K_mc[LPC+1][BLOCK_LEN_LONG], R_mc[LPC+1][BLOCK_LEN_LONG];
+    faac_real VAR_mc[LPC+1][BLOCK_LEN_LONG], KOR_mc[LPC+1][BLOCK_LEN_LONG];
+    faac_real sb_samples_pred_mc[BLOCK_LEN_LONG];
     int thisLineNeedsResetting_mc[BLOCK_LEN_LONG];
     int reset_count_mc;
 } BwpInfo;
@@ -172,6 +189,9 @@ typedef struct {
     /* Lengths of spectral bitstream elements */
     int *len;
 
+    /* Packed codeword lengths for NoiselessBitCount(), shared by all channels */
+    unsigned long long *packedBits;
+
 #ifdef DRM
     int *num_data_cw;
     int cur_cw;
@@ -182,7 +202,7 @@ typedef struct {
 #endif
 
     /* Holds the requantized spectrum */
-    double *requantFreq;
+    faac_real *requantFreq;
 
     TnsInfo tnsInfo;
     LtpInfo ltpInfo;
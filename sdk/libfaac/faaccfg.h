@@ -22,7 +22,7 @@
 #ifndef _FAACCFG_H_
 #define _FAACCFG_H_
 
-#define FAAC_CFG_VERSION 104
+#define FAAC_CFG_VERSION 105
 
 /* MPEG ID's */
 #define MPEG2 1
@@ -115,6 +115,10 @@ typedef struct faacEncConfiguration
 	*/
 	int channel_map[64];	
 
+    /* threads encoding the channel elements of a frame in parallel,
+       0 or 1 encodes on the calling thread only */
+    unsigned int numThreads;
+
 } faacEncConfiguration, *faacEncConfigurationPtr;
 
 #pragma pack(pop)
@@ -29,6 +29,55 @@
 #define MAXLOGM 9
 #define MAXLOGR 8
 
+static void init_mdct_tables( FFT_Tables *fft_tables )
+{
+	int i;
+	fft_tables->mdctcos	= AllocMemory( (MAXLOGM+1) * sizeof( fft_tables->mdctcos[0] ) );
+	fft_tables->mdctsin	= AllocMemory( (MAXLOGM+1) * sizeof( fft_tables->mdctsin[0] ) );
+
+	for( i = 0; i< MAXLOGM+1; i++ )
+	{
+		fft_tables->mdctcos[i]	= NULL;
+		fft_tables->mdctsin[i]	= NULL;
+	}
+}
+
+/* pre/post twiddles of the N point MDCT done with an N / 4 point fft */
+static void make_mdct_tables( FFT_Tables *fft_tables, int logm, int size )
+{
+	int i;
+	double freq = 2.0 * M_PI / (4 * size);
+
+	fft_tables->mdctcos[logm]	= AllocMemory( size * sizeof( faac_real ) );
+	fft_tables->mdctsin[logm]	= AllocMemory( size * sizeof( faac_real ) );
+
+	for (i = 0; i < size; i++)
+	{
+		fft_tables->mdctcos[logm][i]	= cos( freq * (i + 0.125) );
+		fft_tables->mdctsin[logm][i]	= sin( freq * (i + 0.125) );
+	}
+}
+
+static void free_mdct_tables( FFT_Tables *fft_tables )
+{
+	int i;
+
+	for( i = 0; i< MAXLOGM+1; i++ )
+	{
+		if( fft_tables->mdctcos[i] != NULL )
+			FreeMemory( fft_tables->mdctcos[i] );
+
+		if( fft_tables->mdctsin[i] != NULL )
+			FreeMemory( fft_tables->mdctsin[i] );
+	}
+
+	FreeMemory( fft_tables->mdctcos );
+	FreeMemory( fft_tables->mdctsin );
+
+	fft_tables->mdctcos	= NULL;
+	fft_tables->mdctsin	= NULL;
+}
+
 #if defined DRM && !defined DRM_1024
 
 #include "kiss_fft/kiss_fft.h"
@@ -46,7 +95,15 @@ static const int logm_to_nfft[] =
 
 void fft_initialize( FFT_Tables *fft_tables )
 {
+    int i;
     memset( fft_tables->cfg, 0, sizeof( fft_tables->cfg ) );
+
+    init_mdct_tables( fft_tables );
+    for ( i = 0; i < MAXLOGM+1; i++ )
+    {
+        if ( logm_to_nfft[i] )
+            make_mdct_tables( fft_tables, i, logm_to_nfft[i] );
+    }
 }
 void fft_terminate( FFT_Tables *fft_tables )
 {
@@ -64,13 +121,14 @@ void fft_terminate( FFT_Tables *fft_tables )
             fft_tables->cfg[i][1] = NULL;
         }
     }
+    free_mdct_tables( fft_tables );
 }
 
-void rfft( FFT_Tables *fft_tables, double *x, int logm )
+void rfft( FFT_Tables *fft_tables, faac_real *x, int logm )
 {
 #if 0
 /* sur: do not use real-only optimized FFT */
-    double xi[1 << MAXLOGR];
+    faac_real xi[1 << MAXLOGR];
 
     int nfft;
 
@@ -155,7 +213,7 @@ void rfft( FFT_Tables *fft_tables, double *x, int logm )
 #endif
 }
 
-void fft( FFT_Tables *fft_tables, double *xr, double *xi, int logm )
+void fft( FFT_Tables *fft_tables, faac_real *xr, faac_real *xi, int logm )
 {
     int nfft = 0;
 
@@ -208,7 +266,7 @@ void fft( FFT_Tables *fft_tables, double *xr, double *xi, int logm )
     }
 }
 
-void ffti( FFT_Tables *fft_tables, double *xr, double *xi, int logm )
+void ffti( FFT_Tables *fft_tables, faac_real *xr, faac_real *xi, int logm )
 {
     int nfft = 0;
 
@@ -239,7 +297,7 @@ void ffti( FFT_Tables *fft_tables, double *xr, double *xi, int logm )
     if ( fft_tables->cfg[logm][1] )
     {
         unsigned int i;
-        double fac = 1.0 / (double)nfft;
+        faac_real fac = 1.0 / (faac_real)nfft;
         
         for ( i = 0; i < nfft; i++ )
         {
@@ -469,19 +527,92 @@ void ffti( FFT_Tables *fft_tables, double *xr, double *xi, int logm )
 
 #else /* !defined DRM || defined DRM_1024 */
 
+#ifdef FAAC_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+static void make_tables( FFT_Tables *fft_tables, int logm )
+{
+	int i, h;
+	int size = 1 << logm;
+	unsigned short *r;
+	faac_real *w;
+
+	/* bit reversing table */
+	r = AllocMemory(size * sizeof(*r));
+	for (i = 0; i < size; i++)
+	{
+		int reversed = 0;
+		int b0;
+		int tmp = i;
+
+		for (b0 = 0; b0 < logm; b0++)
+		{
+			reversed = (reversed << 1) | (tmp & 1);
+			tmp >>= 1;
+		}
+		r[i] = reversed;
+	}
+	fft_tables->reordertbl[logm] = r;
+
+	/* twiddles of the radix-4 passes after the first one, the 6h values
+	   of all passes add up to less than 2 * size */
+	w = AllocMemory(2 * size * sizeof(*w));
+	fft_tables->twiddletbl[logm] = w;
+	for (h = (logm & 1) ? 2 : 4; 4 * h <= size; h *= 4)
+	{
+		for (i = 0; i < h; i++)
+		{
+			double theta = -2.0 * M_PI * ((double) i) / (double) (4 * h);
+
+			w[i]		= cos(theta);
+			w[h + i]	= sin(theta);
+			w[2 * h + i]	= cos(2.0 * theta);
+			w[3 * h + i]	= sin(2.0 * theta);
+			w[4 * h + i]	= cos(3.0 * theta);
+			w[5 * h + i]	= sin(3.0 * theta);
+		}
+		w += 6 * h;
+	}
+
+	if (logm <= MAXLOGR)
+	{
+		fft_tables->rcostbl[logm] = AllocMemory((size / 2) * sizeof(faac_real));
+		fft_tables->rsintbl[logm] = AllocMemory((size / 2) * sizeof(faac_real));
+
+		for (i = 0; i < (size >> 1); i++)
+		{
+			double theta = 2.0 * M_PI * ((double) i) / (double) size;
+			fft_tables->rcostbl[logm][i] = cos(theta);
+			fft_tables->rsintbl[logm][i] = sin(theta);
+		}
+	}
+
+	make_mdct_tables( fft_tables, logm, size );
+}
+
 void fft_initialize( FFT_Tables *fft_tables )
 {
 	int i;
-	fft_tables->costbl		= AllocMemory( (MAXLOGM+1) * sizeof( fft_tables->costbl[0] ) );
-	fft_tables->negsintbl	= AllocMemory( (MAXLOGM+1) * sizeof( fft_tables->negsintbl[0] ) );
 	fft_tables->reordertbl	= AllocMemory( (MAXLOGM+1) * sizeof( fft_tables->reordertbl[0] ) );
-	
+	fft_tables->twiddletbl	= AllocMemory( (MAXLOGM+1) * sizeof( fft_tables->twiddletbl[0] ) );
+	fft_tables->rcostbl		= AllocMemory( (MAXLOGM+1) * sizeof( fft_tables->rcostbl[0] ) );
+	fft_tables->rsintbl		= AllocMemory( (MAXLOGM+1) * sizeof( fft_tables->rsintbl[0] ) );
+	init_mdct_tables( fft_tables );
+
 	for( i = 0; i< MAXLOGM+1; i++ )
 	{
-		fft_tables->costbl[i]		= NULL;
-		fft_tables->negsintbl[i]	= NULL;
 		fft_tables->reordertbl[i]	= NULL;
+		fft_tables->twiddletbl[i]	= NULL;
+		fft_tables->rcostbl[i]		= NULL;
+		fft_tables->rsintbl[i]		= NULL;
 	}
+
+	/* all sizes are built up front, so encoder threads can share the
+	   tables read-only */
+	for( i = 1; i< MAXLOGM+1; i++ )
+		make_tables( fft_tables, i );
 }
 
 void fft_terminate( FFT_Tables *fft_tables )
@@ -490,135 +621,231 @@ void fft_terminate( FFT_Tables *fft_tables )
 
 	for( i = 0; i< MAXLOGM+1; i++ )
 	{
-		if( fft_tables->costbl[i] != NULL )
-			FreeMemory( fft_tables->costbl[i] );
-		
-		if( fft_tables->negsintbl[i] != NULL )
-			FreeMemory( fft_tables->negsintbl[i] );
-			
 		if( fft_tables->reordertbl[i] != NULL )
 			FreeMemory( fft_tables->reordertbl[i] );
+
+		if( fft_tables->twiddletbl[i] != NULL )
+			FreeMemory( fft_tables->twiddletbl[i] );
+
+		if( fft_tables->rcostbl[i] != NULL )
+			FreeMemory( fft_tables->rcostbl[i] );
+
+		if( fft_tables->rsintbl[i] != NULL )
+			FreeMemory( fft_tables->rsintbl[i] );
 	}
 
-	FreeMemory( fft_tables->costbl );
-	FreeMemory( fft_tables->negsintbl );
 	FreeMemory( fft_tables->reordertbl );
+	FreeMemory( fft_tables->twiddletbl );
+	FreeMemory( fft_tables->rcostbl );
+	FreeMemory( fft_tables->rsintbl );
+	free_mdct_tables( fft_tables );
 
-	fft_tables->costbl		= NULL;
-	fft_tables->negsintbl	= NULL;
 	fft_tables->reordertbl	= NULL;
+	fft_tables->twiddletbl	= NULL;
+	fft_tables->rcostbl		= NULL;
+	fft_tables->rsintbl		= NULL;
 }
 
-static void reorder( FFT_Tables *fft_tables, double *x, int logm)
+static void reorder( const unsigned short *r, faac_real *xr, faac_real *xi, int size)
 {
 	int i;
-	int size = 1 << logm;
-	unsigned short *r;	//size
-
-
-	if ( fft_tables->reordertbl[logm] == NULL ) // create bit reversing table
-	{
-		fft_tables->reordertbl[logm] = AllocMemory(size * sizeof(*(fft_tables->reordertbl[0])));
-
-		for (i = 0; i < size; i++)
-		{
-			int reversed = 0;
-			int b0;
-			int tmp = i;
-
-			for (b0 = 0; b0 < logm; b0++)
-			{
-				reversed = (reversed << 1) | (tmp & 1);
-				tmp >>= 1;
-			}
-			fft_tables->reordertbl[logm][i] = reversed;
-		}
-	}
-
-	r = fft_tables->reordertbl[logm];
 
 	for (i = 0; i < size; i++)
 	{
 		int j = r[i];
-		double tmp;
+		faac_real tmp;
 
 		if (j <= i)
 			continue;
 
-		tmp = x[i];
-		x[i] = x[j];
-		x[j] = tmp;
+		tmp = xr[i];
+		xr[i] = xr[j];
+		xr[j] = tmp;
+
+		tmp = xi[i];
+		xi[i] = xi[j];
+		xi[j] = tmp;
 	}
 }
 
-static void fft_proc(
-		double *xr, 
-		double *xi,
-		fftfloat *refac, 
-		fftfloat *imfac, 
-		int size)	
+/* first pass for odd logm: 2 point dfts */
+static void radix2_first( faac_real *xr, faac_real *xi, int size )
 {
-	int step, shift, pos;
-	int exp, estep;
+	int pos;
 
-	estep = size;
-	for (step = 1; step < size; step *= 2)
+	for (pos = 0; pos < size; pos += 2)
 	{
-		int x1;
-		int x2 = 0;
-		estep >>= 1;
-		for (pos = 0; pos < size; pos += (2 * step))
-		{
-			x1 = x2;
-			x2 += step;
-			exp = 0;
-			for (shift = 0; shift < step; shift++)
-			{
-				double v2r, v2i;
+		faac_real ar = xr[pos], ai = xi[pos];
+		faac_real br = xr[pos + 1], bi = xi[pos + 1];
 
-				v2r = xr[x2] * refac[exp] - xi[x2] * imfac[exp];
-				v2i = xr[x2] * imfac[exp] + xi[x2] * refac[exp];
+		xr[pos] = ar + br;
+		xi[pos] = ai + bi;
+		xr[pos + 1] = ar - br;
+		xi[pos + 1] = ai - bi;
+	}
+}
 
-				xr[x2] = xr[x1] - v2r;
-				xr[x1] += v2r;
+/* first pass for even logm: 4 point dfts, all twiddles are 1 */
+static void radix4_first( faac_real *xr, faac_real *xi, int size )
+{
+	int pos;
 
-				xi[x2] = xi[x1] - v2i;
+	for (pos = 0; pos < size; pos += 4)
+	{
+		faac_real t0r = xr[pos] + xr[pos + 1], t0i = xi[pos] + xi[pos + 1];
+		faac_real t1r = xr[pos] - xr[pos + 1], t1i = xi[pos] - xi[pos + 1];
+		faac_real t2r = xr[pos + 2] + xr[pos + 3], t2i = xi[pos + 2] + xi[pos + 3];
+		faac_real t3r = xr[pos + 2] - xr[pos + 3], t3i = xi[pos + 2] - xi[pos + 3];
+
+		xr[pos] = t0r + t2r;
+		xi[pos] = t0i + t2i;
+		xr[pos + 2] = t0r - t2r;
+		xi[pos + 2] = t0i - t2i;
+		xr[pos + 1] = t1r + t3i;
+		xi[pos + 1] = t1i - t3r;
+		xr[pos + 3] = t1r - t3i;
+		xi[pos + 3] = t1i + t3r;
+	}
+}
 
-				xi[x1] += v2i;
+/*
+ * Radix-4 decimation in time pass combining 4 dfts of size h into one of
+ * size 4h. With bit reversed input the quarters of a block hold the dfts
+ * of the inputs 0, 2, 1, 3 mod 4, the outputs X[k + q*h] go back in order.
+ */
+static void radix4_pass( faac_real *xr, faac_real *xi, const faac_real *w, int h, int size )
+{
+	int pos, k;
 
-				exp += estep;
+	for (pos = 0; pos < size; pos += 4 * h)
+	{
+		faac_real *r0 = xr + pos, *r1 = r0 + h, *r2 = r1 + h, *r3 = r2 + h;
+		faac_real *i0 = xi + pos, *i1 = i0 + h, *i2 = i1 + h, *i3 = i2 + h;
 
-				x1++;
-				x2++;
-			}
+		for (k = 0; k < h; k++)
+		{
+			faac_real br = r2[k] * w[k] - i2[k] * w[h + k];
+			faac_real bi = r2[k] * w[h + k] + i2[k] * w[k];
+			faac_real cr = r1[k] * w[2 * h + k] - i1[k] * w[3 * h + k];
+			faac_real ci = r1[k] * w[3 * h + k] + i1[k] * w[2 * h + k];
+			faac_real dr = r3[k] * w[4 * h + k] - i3[k] * w[5 * h + k];
+			faac_real di = r3[k] * w[5 * h + k] + i3[k] * w[4 * h + k];
+			faac_real t0r = r0[k] + cr, t0i = i0[k] + ci;
+			faac_real t1r = r0[k] - cr, t1i = i0[k] - ci;
+			faac_real t2r = br + dr, t2i = bi + di;
+			faac_real t3r = br - dr, t3i = bi - di;
+
+			r0[k] = t0r + t2r;
+			i0[k] = t0i + t2i;
+			r2[k] = t0r - t2r;
+			i2[k] = t0i - t2i;
+			r1[k] = t1r + t3i;
+			i1[k] = t1i - t3r;
+			r3[k] = t1r - t3i;
+			i3[k] = t1i + t3r;
 		}
 	}
 }
 
-static void check_tables( FFT_Tables *fft_tables, int logm)
-{
-	if( fft_tables->costbl[logm] == NULL )
-	{
-		int i;
-		int size = 1 << logm;
+#ifdef FAAC_X86
+
+/* vectors of faac_real, SSE_LANES and AVX_LANES values wide */
+#ifdef FAAC_PRECISION_SINGLE
+#define SSE_LANES		4
+#define sse_vec			__m128
+#define sse_load		_mm_loadu_ps
+#define sse_store		_mm_storeu_ps
+#define sse_add			_mm_add_ps
+#define sse_sub			_mm_sub_ps
+#define sse_mul			_mm_mul_ps
+#define AVX_LANES		8
+#define avx_vec			__m256
+#define avx_load		_mm256_loadu_ps
+#define avx_store		_mm256_storeu_ps
+#define avx_add			_mm256_add_ps
+#define avx_sub			_mm256_sub_ps
+#define avx_mul			_mm256_mul_ps
+#else
+#define SSE_LANES		2
+#define sse_vec			__m128d
+#define sse_load		_mm_loadu_pd
+#define sse_store		_mm_storeu_pd
+#define sse_add			_mm_add_pd
+#define sse_sub			_mm_sub_pd
+#define sse_mul			_mm_mul_pd
+#define AVX_LANES		4
+#define avx_vec			__m256d
+#define avx_load		_mm256_loadu_pd
+#define avx_store		_mm256_storeu_pd
+#define avx_add			_mm256_add_pd
+#define avx_sub			_mm256_sub_pd
+#define avx_mul			_mm256_mul_pd
+#endif
 
-		if( fft_tables->negsintbl[logm] != NULL )
-			FreeMemory( fft_tables->negsintbl[logm] );
+/* radix4_pass() body working on lanes k at a time */
+#define RADIX4_PASS_VEC(vec, load, store, add, sub, mul, lanes) \
+{ \
+	int pos, k; \
+ \
+	for (pos = 0; pos < size; pos += 4 * h) \
+	{ \
+		faac_real *r0 = xr + pos, *r1 = r0 + h, *r2 = r1 + h, *r3 = r2 + h; \
+		faac_real *i0 = xi + pos, *i1 = i0 + h, *i2 = i1 + h, *i3 = i2 + h; \
+ \
+		for (k = 0; k < h; k += lanes) \
+		{ \
+			vec w1r = load(w + k), w1i = load(w + h + k); \
+			vec w2r = load(w + 2 * h + k), w2i = load(w + 3 * h + k); \
+			vec w3r = load(w + 4 * h + k), w3i = load(w + 5 * h + k); \
+			vec ar = load(r0 + k), ai = load(i0 + k); \
+			vec xr1 = load(r1 + k), xi1 = load(i1 + k); \
+			vec xr2 = load(r2 + k), xi2 = load(i2 + k); \
+			vec xr3 = load(r3 + k), xi3 = load(i3 + k); \
+			vec br = sub(mul(xr2, w1r), mul(xi2, w1i)); \
+			vec bi = add(mul(xr2, w1i), mul(xi2, w1r)); \
+			vec cr = sub(mul(xr1, w2r), mul(xi1, w2i)); \
+			vec ci = add(mul(xr1, w2i), mul(xi1, w2r)); \
+			vec dr = sub(mul(xr3, w3r), mul(xi3, w3i)); \
+			vec di = add(mul(xr3, w3i), mul(xi3, w3r)); \
+			vec t0r = add(ar, cr), t0i = add(ai, ci); \
+			vec t1r = sub(ar, cr), t1i = sub(ai, ci); \
+			vec t2r = add(br, dr), t2i = add(bi, di); \
+			vec t3r = sub(br, dr), t3i = sub(bi, di); \
+ \
+			store(r0 + k, add(t0r, t2r)); \
+			store(i0 + k, add(t0i, t2i)); \
+			store(r2 + k, sub(t0r, t2r)); \
+			store(i2 + k, sub(t0i, t2i)); \
+			store(r1 + k, add(t1r, t3i)); \
+			store(i1 + k, sub(t1i, t3r)); \
+			store(r3 + k, sub(t1r, t3i)); \
+			store(i3 + k, add(t1i, t3r)); \
+		} \
+	} \
+}
 
-		fft_tables->costbl[logm]	= AllocMemory((size / 2) * sizeof(*(fft_tables->costbl[0])));
-		fft_tables->negsintbl[logm]	= AllocMemory((size / 2) * sizeof(*(fft_tables->negsintbl[0])));
+/* radix4_pass() SSE_LANES k at a time, h must be a multiple of SSE_LANES */
+static void radix4_pass_sse2( faac_real *xr, faac_real *xi, const faac_real *w, int h, int size )
+RADIX4_PASS_VEC(sse_vec, sse_load, sse_store, sse_add, sse_sub, sse_mul, SSE_LANES)
 
-		for (i = 0; i < (size >> 1); i++)
-		{
-			double theta = 2.0 * M_PI * ((double) i) / (double) size;
-			fft_tables->costbl[logm][i]		= cos(theta);
-			fft_tables->negsintbl[logm][i]	= -sin(theta);
-		}
-	}
+/* radix4_pass() AVX_LANES k at a time, h must be a multiple of AVX_LANES */
+FAAC_TARGET_AVX
+static void radix4_pass_avx( faac_real *xr, faac_real *xi, const faac_real *w, int h, int size )
+{
+	RADIX4_PASS_VEC(avx_vec, avx_load, avx_store, avx_add, avx_sub, avx_mul, AVX_LANES)
+	_mm256_zeroupper();
 }
 
-void fft( FFT_Tables *fft_tables, double *xr, double *xi, int logm)
+#endif /* FAAC_X86 */
+
+void fft( FFT_Tables *fft_tables, faac_real *xr, faac_real *xi, int logm)
 {
+	int size, h;
+	const faac_real *w;
+#ifdef FAAC_X86
+	unsigned int flags = GetCpuFlags();
+#endif
+
 	if (logm > MAXLOGM)
 	{
 		fprintf(stderr, "fft size too big\n");
@@ -631,17 +858,44 @@ void fft( FFT_Tables *fft_tables, double *xr, double *xi, int logm)
 		return;
 	}
 
-	check_tables( fft_tables, logm);
+	size = 1 << logm;
+	reorder( fft_tables->reordertbl[logm], xr, xi, size);
 
-	reorder( fft_tables, xr, logm);
-	reorder( fft_tables, xi, logm);
+	if (logm & 1)
+	{
+		radix2_first( xr, xi, size );
+		h = 2;
+	}
+	else
+	{
+		radix4_first( xr, xi, size );
+		h = 4;
+	}
 
-	fft_proc( xr, xi, fft_tables->costbl[logm], fft_tables->negsintbl[logm], 1 << logm );
+	for (w = fft_tables->twiddletbl[logm]; 4 * h <= size; w += 6 * h, h *= 4)
+	{
+#ifdef FAAC_X86
+		if ((flags & CPU_FLAG_AVX) && h >= AVX_LANES)
+			radix4_pass_avx( xr, xi, w, h, size );
+		else if ((flags & CPU_FLAG_SSE2) && h >= SSE_LANES)
+			radix4_pass_sse2( xr, xi, w, h, size );
+		else
+#endif
+			radix4_pass( xr, xi, w, h, size );
+	}
 }
 
-void rfft( FFT_Tables *fft_tables, double *x, int logm)
+/*
+ * Real input fft: the even and odd samples are packed into one complex
+ * fft of half the size and separated again afterwards. Returns the real
+ * parts of X[0 .. N/2) in x[0 .. N/2) and the imaginary parts in x[N/2 .. N).
+ */
+void rfft( FFT_Tables *fft_tables, faac_real *x, int logm)
 {
-	double xi[1 << MAXLOGR];
+	faac_real zr[1 << (MAXLOGR - 1)];
+	faac_real zi[1 << (MAXLOGR - 1)];
+	const faac_real *c, *s;
+	int half, k;
 
 	if (logm > MAXLOGR)
 	{
@@ -649,18 +903,42 @@ void rfft( FFT_Tables *fft_tables, double *x, int logm)
 		exit(1);
 	}
 
-	memset(xi, 0, (1 << logm) * sizeof(xi[0]));
+	if (logm < 1)
+		return;
+
+	half = 1 << (logm - 1);
+	for (k = 0; k < half; k++)
+	{
+		zr[k] = x[2 * k];
+		zi[k] = x[2 * k + 1];
+	}
+
+	fft( fft_tables, zr, zi, logm - 1);
 
-	fft( fft_tables, x, xi, logm);
+	c = fft_tables->rcostbl[logm];
+	s = fft_tables->rsintbl[logm];
 
-	memcpy(x + (1 << (logm - 1)), xi, (1 << (logm - 1)) * sizeof(*x));
+	x[0] = zr[0] + zi[0];
+	x[half] = 0.0;
+	for (k = 1; k < half; k++)
+	{
+		/* even part E = (Z[k] + Z*[half-k]) / 2, odd part O = (Z[k] - Z*[half-k]) / 2i */
+		faac_real er = 0.5 * (zr[k] + zr[half - k]);
+		faac_real ei = 0.5 * (zi[k] - zi[half - k]);
+		faac_real odr = 0.5 * (zi[k] + zi[half - k]);
+		faac_real odi = -0.5 * (zr[k] - zr[half - k]);
+
+		/* X[k] = E + exp(-2*pi*i*k/N) * O */
+		x[k] = er + c[k] * odr + s[k] * odi;
+		x[half + k] = ei + c[k] * odi - s[k] * odr;
+	}
 }
 
-void ffti( FFT_Tables *fft_tables, double *xr, double *xi, int logm)
+void ffti( FFT_Tables *fft_tables, faac_real *xr, faac_real *xi, int logm)
 {
 	int i, size;
-	double fac;
-	double *xrp, *xip;
+	faac_real fac;
+	faac_real *xrp, *xip;
 
 	fft( fft_tables, xi, xr, logm);
 
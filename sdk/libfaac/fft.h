@@ -22,7 +22,7 @@
 #ifndef _FFT_H_
 #define _FFT_H_
 
-typedef float fftfloat;
+#include "coder.h"
 
 #if defined DRM && !defined DRM_1024
 
@@ -32,15 +32,26 @@ typedef struct
 {
     /*      cfg[Max FFT][FFT and inverse FFT] */
     void*   cfg[MAX_FFT][2];
+    /* MDCT pre/post twiddles for the N / 4 point fft of size logm */
+    faac_real **mdctcos;
+    faac_real **mdctsin;
 } FFT_Tables;
 
 #else  /* use own FFT */
 
 typedef struct
 {
-    fftfloat **costbl;
-    fftfloat **negsintbl;
+    /* bit reversing permutation */
     unsigned short **reordertbl;
+    /* radix-4 twiddles, per pass W^k, W^2k, W^3k real and imaginary parts */
+    faac_real **twiddletbl;
+    /* real fft post-processing twiddles cos and sin of 2*pi*k/N */
+    faac_real **rcostbl;
+    faac_real **rsintbl;
+    /* MDCT pre/post twiddles for the N / 4 point fft of size logm:
+       cos and sin of 2*pi/N*(i + 1/8) */
+    faac_real **mdctcos;
+    faac_real **mdctsin;
 } FFT_Tables;
 
 #endif /* defined DRM && !defined DRM_1024 */
@@ -48,8 +59,8 @@ typedef struct
 void fft_initialize		( FFT_Tables *fft_tables );
 void fft_terminate	( FFT_Tables *fft_tables );
 
-void rfft			( FFT_Tables *fft_tables, double *x, int logm );
-void fft			( FFT_Tables *fft_tables, double *xr, double *xi, int logm );
-void ffti			( FFT_Tables *fft_tables, double *xr, double *xi, int logm );
+void rfft			( FFT_Tables *fft_tables, faac_real *x, int logm );
+void fft			( FFT_Tables *fft_tables, faac_real *xr, faac_real *xi, int logm );
+void ffti			( FFT_Tables *fft_tables, faac_real *xr, faac_real *xi, int logm );
 
 #endif
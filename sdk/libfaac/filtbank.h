@@ -47,19 +47,26 @@ void			FilterBankEnd		( faacEncHandle hEncoder );
 
 void			FilterBank( faacEncHandle hEncoder,
 						CoderInfo *coderInfo,
-						double *p_in_data,
-						double *p_out_mdct,
-						double *p_overlap,
-						int overlap_select );
+						faac_real *p_in_data,
+						faac_real *p_out_mdct,
+						faac_real *p_overlap,
+						int overlap_select,
+						ScratchArena *scratch );
 
 void			IFilterBank( faacEncHandle hEncoder,
 						CoderInfo *coderInfo,
-						double *p_in_data,
-						double *p_out_mdct,
-						double *p_overlap,
-						int overlap_select );
+						faac_real *p_in_data,
+						faac_real *p_out_mdct,
+						faac_real *p_overlap,
+						int overlap_select,
+						ScratchArena *scratch );
 
-void			specFilter(	double *freqBuff,
+/* N point MDCT and inverse MDCT in place, N is 2*BLOCK_LEN_LONG or 2*BLOCK_LEN_SHORT */
+void			MDCT( FFT_Tables *fft_tables, faac_real *data, int N, ScratchArena *scratch );
+
+void			IMDCT( FFT_Tables *fft_tables, faac_real *data, int N, ScratchArena *scratch );
+
+void			specFilter(	faac_real *freqBuff,
 						int sampleRate,
 						int lowpassFreq,
 						int specLen );
@@ -53,6 +53,17 @@ static char *libfaacName = FAAC_VERSION;
 #else
 static char *libfaacName = FAAC_VERSION ".1 (" __DATE__ ") UNSTABLE";
 #endif
+#ifdef FAAC_ENCODER_STATS
+#define STAGE_START(stats) ((stats)->start = GetTimer())
+#define STAGE_STOP(stats, stage) \
+    ((stats)->time[stage] += GetTimer() - (stats)->start)
+#define COLLECT_STATS(hEncoder) CollectStats(hEncoder)
+#else
+#define STAGE_START(stats)
+#define STAGE_STOP(stats, stage)
+#define COLLECT_STATS(hEncoder)
+#endif
+
 static char *libCopyright =
   "FAAC - Freeware Advanced Audio Coder (http://www.audiocoding.com/)\n"
   " Copyright (C) 1999,2000,2001  Menno Bakker\n"
@@ -90,6 +101,7 @@ int FAACAPI faacEncGetVersion( char **faac_id_string,
 int FAACAPI faacEncGetDecoderSpecificInfo(faacEncHandle hEncoder,unsigned char** ppBuffer,unsigned long* pSizeOfDecoderSpecificInfo)
 {
     BitStream* pBitStream = NULL;
+    size_t mark;
 
     if((hEncoder == NULL) || (ppBuffer == NULL) || (pSizeOfDecoderSpecificInfo == NULL)) {
         return -1;
@@ -105,11 +117,14 @@ int FAACAPI faacEncGetDecoderSpecificInfo(faacEncHandle hEncoder,unsigned char**
     if(*ppBuffer != NULL){
 
         memset(*ppBuffer,0,*pSizeOfDecoderSpecificInfo);
-        pBitStream = OpenBitStream(*pSizeOfDecoderSpecificInfo, *ppBuffer);
+        mark = ScratchMark(&hEncoder->scratch[0]);
+        pBitStream = OpenBitStream(*pSizeOfDecoderSpecificInfo, *ppBuffer,
+                &hEncoder->scratch[0]);
         PutBit(pBitStream, hEncoder->config.aacObjectType, 5);
         PutBit(pBitStream, hEncoder->sampleRateIdx, 4);
         PutBit(pBitStream, hEncoder->numChannels, 4);
         CloseBitStream(pBitStream);
+        ScratchRelease(&hEncoder->scratch[0], mark);
 
         return 0;
     } else {
@@ -287,6 +302,19 @@ int FAACAPI faacEncSetConfiguration(faacEncHandle hEncoder,
 	for( i = 0; i < 64; i++ )
 		hEncoder->config.channel_map[i] = config->channel_map[i];
 
+    /* (re)start the worker threads, there is no work for more threads
+       than channels */
+    if (config->numThreads != hEncoder->config.numThreads)
+    {
+        unsigned int numThreads = min(config->numThreads, hEncoder->numChannels);
+
+        WorkerPoolClose(hEncoder->workers);
+        hEncoder->workers = NULL;
+        if (numThreads > 1)
+            hEncoder->workers = WorkerPoolOpen(numThreads);
+        hEncoder->config.numThreads = config->numThreads;
+    }
+
     /* OK */
     return 1;
 }
@@ -340,6 +368,8 @@ faacEncHandle FAACAPI faacEncOpen(unsigned long sampleRate,
 	/* default channel map is straight-through */
 	for( channel = 0; channel < 64; channel++ )
 		hEncoder->config.channel_map[channel] = channel;
+
+    hEncoder->config.numThreads = 1;
 	
     /*
         by default we have to be compatible with all previous software
@@ -367,15 +397,25 @@ faacEncHandle FAACAPI faacEncOpen(unsigned long sampleRate,
         /* FIXME: Use sr_idx here */
         hEncoder->coderInfo[channel].max_pred_sfb = GetMaxPredSfb(hEncoder->sampleRateIdx);
 
-        hEncoder->sampleBuff[channel] = NULL;
-        hEncoder->nextSampleBuff[channel] = NULL;
-        hEncoder->next2SampleBuff[channel] = NULL;
-        hEncoder->ltpTimeBuff[channel] = (double*)AllocMemory(2*BLOCK_LEN_LONG*sizeof(double));
-        SetMemory(hEncoder->ltpTimeBuff[channel], 0, 2*BLOCK_LEN_LONG*sizeof(double));
+        /* sample buffers start out silent, faacEncEncode() only rotates them */
+        hEncoder->sampleBuff[channel] = (faac_real*)AllocMemory(FRAME_LEN*sizeof(faac_real));
+        hEncoder->nextSampleBuff[channel] = (faac_real*)AllocMemory(FRAME_LEN*sizeof(faac_real));
+        hEncoder->next2SampleBuff[channel] = (faac_real*)AllocMemory(FRAME_LEN*sizeof(faac_real));
+        hEncoder->next3SampleBuff[channel] = (faac_real*)AllocMemory(FRAME_LEN*sizeof(faac_real));
+        SetMemory(hEncoder->sampleBuff[channel], 0, FRAME_LEN*sizeof(faac_real));
+        SetMemory(hEncoder->nextSampleBuff[channel], 0, FRAME_LEN*sizeof(faac_real));
+        SetMemory(hEncoder->next2SampleBuff[channel], 0, FRAME_LEN*sizeof(faac_real));
+        SetMemory(hEncoder->next3SampleBuff[channel], 0, FRAME_LEN*sizeof(faac_real));
+        hEncoder->ltpTimeBuff[channel] = (faac_real*)AllocMemory(2*BLOCK_LEN_LONG*sizeof(faac_real));
+        SetMemory(hEncoder->ltpTimeBuff[channel], 0, 2*BLOCK_LEN_LONG*sizeof(faac_real));
     }
 
     /* Initialize coder functions */
 	fft_initialize( &hEncoder->fft_tables );
+
+    for (channel = 0; channel < numChannels; channel++) {
+        ScratchInit(&hEncoder->scratch[channel], ENC_SCRATCH_SIZE);
+    }
     
 	hEncoder->psymodel->PsyInit(&hEncoder->gpsyInfo, hEncoder->psyInfo, hEncoder->numChannels,
         hEncoder->sampleRate, hEncoder->srInfo->cb_width_long,
@@ -419,6 +459,11 @@ int FAACAPI faacEncClose(faacEncHandle hEncoder)
 
 	fft_terminate( &hEncoder->fft_tables );
 
+    WorkerPoolClose(hEncoder->workers);
+
+    for (channel = 0; channel < hEncoder->numChannels; channel++)
+        ScratchEnd(&hEncoder->scratch[channel]);
+
     /* Free remaining buffer memory */
     for (channel = 0; channel < hEncoder->numChannels; channel++) 
 	{
@@ -441,181 +486,167 @@ int FAACAPI faacEncClose(faacEncHandle hEncoder)
     return 0;
 }
 
-int FAACAPI faacEncEncode(faacEncHandle hEncoder,
-                          int32_t *inputBuffer,
-                          unsigned int samplesInput,
-                          unsigned char *outputBuffer,
-                          unsigned int bufferSize
-                          )
+/* State shared by the channel and channel element jobs of one frame */
+typedef struct {
+    faacEncHandle hEncoder;
+    int32_t *inputBuffer;
+    unsigned int samplesInput;
+
+    /* channel elements (SCE, CPE, LFE) as first and one past the last channel */
+    int numElements;
+    int elementStart[MAX_CHANNELS];
+    int elementEnd[MAX_CHANNELS];
+} EncodeJob;
+
+#ifdef FAAC_ENCODER_STATS
+/* Adds the statistics the channel jobs collected to the encoder totals */
+static void CollectStats(faacEncHandle hEncoder)
 {
-    unsigned int channel, i;
-    int sb, frameBytes;
-    unsigned int offset;
-    BitStream *bitStream; /* bitstream used for writing the frame to */
-    TnsInfo *tnsInfo_for_LTP;
-    TnsInfo *tnsDecInfo;
-#ifdef DRM
-    int desbits, diff;
-    double fix;
+    unsigned int channel;
+    int stage;
+
+    for (channel = 0; channel < hEncoder->numChannels; channel++)
+    {
+        EncoderStats *stats = &hEncoder->channelStats[channel];
+
+        for (stage = 0; stage < STAGE_COUNT; stage++)
+            hEncoder->stats.time[stage] += stats->time[stage];
+        hEncoder->stats.quantSignal += stats->quantSignal;
+        hEncoder->stats.quantNoise += stats->quantNoise;
+        SetMemory(stats, 0, sizeof(EncoderStats));
+    }
+}
 #endif
 
-    /* local copy's of parameters */
+/* Takes in the next input frame of one channel and runs the
+   psychoacoustic FFTs on it */
+static void ChannelInput(void *arg, int channel)
+{
+    EncodeJob *job = (EncodeJob *)arg;
+    faacEncHandle hEncoder = job->hEncoder;
     ChannelInfo *channelInfo = hEncoder->channelInfo;
-    CoderInfo *coderInfo = hEncoder->coderInfo;
+    int32_t *inputBuffer = job->inputBuffer;
+    unsigned int samplesInput = job->samplesInput;
     unsigned int numChannels = hEncoder->numChannels;
-    unsigned int sampleRate = hEncoder->sampleRate;
-    unsigned int aacObjectType = hEncoder->config.aacObjectType;
-    unsigned int mpegVersion = hEncoder->config.mpegVersion;
-    unsigned int useLfe = hEncoder->config.useLfe;
-    unsigned int useTns = hEncoder->config.useTns;
-    unsigned int allowMidside = hEncoder->config.allowMidside;
     unsigned int bandWidth = hEncoder->config.bandWidth;
-    unsigned int shortctl = hEncoder->config.shortctl;
-
-    /* Increase frame number */
-    hEncoder->frameNum++;
-
-    if (samplesInput == 0)
-        hEncoder->flushFrame++;
-
-    /* After 4 flush frames all samples have been encoded,
-       return 0 bytes written */
-    if (hEncoder->flushFrame > 4)
-        return 0;
-
-    /* Determine the channel configuration */
-    GetChannelInfo(channelInfo, numChannels, useLfe);
+    unsigned int i;
+    faac_real *tmp;
+#ifdef FAAC_ENCODER_STATS
+    EncoderStats *stats = &hEncoder->channelStats[channel];
+#endif
 
-    /* Update current sample buffers */
-    for (channel = 0; channel < numChannels; channel++) 
-	{
-		double *tmp;
+    STAGE_START(stats);
+    for(i = 0; i < FRAME_LEN; i++) {
+        hEncoder->ltpTimeBuff[channel][i] = hEncoder->sampleBuff[channel][i];
+    }
+    for(i = 0; i < FRAME_LEN; i++) {
+        hEncoder->ltpTimeBuff[channel][FRAME_LEN + i] =
+				hEncoder->nextSampleBuff[channel][i];
+    }
 
-        if (hEncoder->sampleBuff[channel]) {
-            for(i = 0; i < FRAME_LEN; i++) {
-                hEncoder->ltpTimeBuff[channel][i] = hEncoder->sampleBuff[channel][i];
-            }
-        }
-        if (hEncoder->nextSampleBuff[channel]) {
-            for(i = 0; i < FRAME_LEN; i++) {
-                hEncoder->ltpTimeBuff[channel][FRAME_LEN + i] =
-						hEncoder->nextSampleBuff[channel][i];
-            }
-        }
+	tmp = hEncoder->sampleBuff[channel];
 
-		if (!hEncoder->sampleBuff[channel])
-			hEncoder->sampleBuff[channel] = (double*)AllocMemory(FRAME_LEN*sizeof(double));
-		
-		tmp = hEncoder->sampleBuff[channel];
+    hEncoder->sampleBuff[channel]		= hEncoder->nextSampleBuff[channel];
+    hEncoder->nextSampleBuff[channel]	= hEncoder->next2SampleBuff[channel];
+    hEncoder->next2SampleBuff[channel]	= hEncoder->next3SampleBuff[channel];
+	hEncoder->next3SampleBuff[channel]	= tmp;
 
-        hEncoder->sampleBuff[channel]		= hEncoder->nextSampleBuff[channel];
-        hEncoder->nextSampleBuff[channel]	= hEncoder->next2SampleBuff[channel];
-        hEncoder->next2SampleBuff[channel]	= hEncoder->next3SampleBuff[channel];
-		hEncoder->next3SampleBuff[channel]	= tmp;
+    if (samplesInput == 0)
+    {
+        /* start flushing*/
+        for (i = 0; i < FRAME_LEN; i++)
+            hEncoder->next3SampleBuff[channel][i] = 0.0;
+    }
+    else
+    {
+		int samples_per_channel = samplesInput/numChannels;
 
-        if (samplesInput == 0)
-        {
-            /* start flushing*/
-            for (i = 0; i < FRAME_LEN; i++)
-                hEncoder->next3SampleBuff[channel][i] = 0.0;
-        }
-        else
-        {
-			int samples_per_channel = samplesInput/numChannels;
+        /* handle the various input formats and channel remapping */
+        switch( hEncoder->config.inputFormat )
+		{
+            case FAAC_INPUT_16BIT:
+				{
+					short *input_channel = (short*)inputBuffer + hEncoder->config.channel_map[channel];
 
-            /* handle the various input formats and channel remapping */
-            switch( hEncoder->config.inputFormat )
-			{
-                case FAAC_INPUT_16BIT:
+					for (i = 0; i < samples_per_channel; i++)
 					{
-						short *input_channel = (short*)inputBuffer + hEncoder->config.channel_map[channel];
-
-						for (i = 0; i < samples_per_channel; i++)
-						{
-							hEncoder->next3SampleBuff[channel][i] = (double)*input_channel;
-							input_channel += numChannels;
-						}
+						hEncoder->next3SampleBuff[channel][i] = (faac_real)*input_channel;
+						input_channel += numChannels;
 					}
-                    break;
-
-                case FAAC_INPUT_32BIT:
+				}
+                break;
+
+            case FAAC_INPUT_32BIT:
+				{
+					int32_t *input_channel = (int32_t*)inputBuffer + hEncoder->config.channel_map[channel];
+					
+					for (i = 0; i < samples_per_channel; i++)
 					{
-						int32_t *input_channel = (int32_t*)inputBuffer + hEncoder->config.channel_map[channel];
-						
-						for (i = 0; i < samples_per_channel; i++)
-						{
-							hEncoder->next3SampleBuff[channel][i] = (1.0/256) * (double)*input_channel;
-							input_channel += numChannels;
-						}
+						hEncoder->next3SampleBuff[channel][i] = (1.0/256) * (double)*input_channel;
+						input_channel += numChannels;
 					}
-                    break;
+				}
+                break;
 
-                case FAAC_INPUT_FLOAT:
-					{
-						float *input_channel = (float*)inputBuffer + hEncoder->config.channel_map[channel];
+            case FAAC_INPUT_FLOAT:
+				{
+					float *input_channel = (float*)inputBuffer + hEncoder->config.channel_map[channel];
 
-						for (i = 0; i < samples_per_channel; i++)
-						{
-							hEncoder->next3SampleBuff[channel][i] = (double)*input_channel;
-							input_channel += numChannels;
-						}
+					for (i = 0; i < samples_per_channel; i++)
+					{
+						hEncoder->next3SampleBuff[channel][i] = (faac_real)*input_channel;
+						input_channel += numChannels;
 					}
-                    break;
-
-                default:
-                    return -1; /* invalid input format */
-                    break;
-            }
-
-            for (i = (int)(samplesInput/numChannels); i < FRAME_LEN; i++)
-                hEncoder->next3SampleBuff[channel][i] = 0.0;
-		}
-
-		/* Psychoacoustics */
-		/* Update buffers and run FFT on new samples */
-		/* LFE psychoacoustic can run without it */
-		if (!channelInfo[channel].lfe || channelInfo[channel].cpe)
-		{
-			hEncoder->psymodel->PsyBufferUpdate( 
-					&hEncoder->fft_tables, 
-					&hEncoder->gpsyInfo, 
-					&hEncoder->psyInfo[channel],
-					hEncoder->next3SampleBuff[channel], 
-					bandWidth,
-					hEncoder->srInfo->cb_width_short,
-					hEncoder->srInfo->num_cb_short);
-		}
-    }
+				}
+                break;
+        }
 
-    if (hEncoder->frameNum <= 3) /* Still filling up the buffers */
-        return 0;
+        for (i = (int)(samplesInput/numChannels); i < FRAME_LEN; i++)
+            hEncoder->next3SampleBuff[channel][i] = 0.0;
+	}
+    STAGE_STOP(stats, STAGE_INPUT);
 
-    /* Psychoacoustics */
-    hEncoder->psymodel->PsyCalculate(channelInfo, &hEncoder->gpsyInfo, hEncoder->psyInfo,
-        hEncoder->srInfo->cb_width_long, hEncoder->srInfo->num_cb_long,
-        hEncoder->srInfo->cb_width_short,
-        hEncoder->srInfo->num_cb_short, numChannels);
+	/* Psychoacoustics */
+	/* Update buffers and run FFT on new samples */
+	/* LFE psychoacoustic can run without it */
+	STAGE_START(stats);
+	if (!channelInfo[channel].lfe || channelInfo[channel].cpe)
+	{
+		hEncoder->psymodel->PsyBufferUpdate( 
+				&hEncoder->fft_tables, 
+				&hEncoder->gpsyInfo, 
+				&hEncoder->psyInfo[channel],
+				hEncoder->next3SampleBuff[channel], 
+				bandWidth,
+				hEncoder->srInfo->cb_width_short,
+				hEncoder->srInfo->num_cb_short);
+	}
+	STAGE_STOP(stats, STAGE_PSYCH);
+}
 
-    hEncoder->psymodel->BlockSwitch(coderInfo, hEncoder->psyInfo, numChannels);
+/* Filterbank, TNS, prediction and mid/side coding of the channels
+   first..last-1 of one channel element */
+static void ElementAnalysis(faacEncHandle hEncoder, int first, int last)
+{
+    int channel, sb;
+    unsigned int offset;
+    TnsInfo *tnsInfo_for_LTP;
 
-    /* force block type */
-    if (shortctl == SHORTCTL_NOSHORT)
-    {
-		for (channel = 0; channel < numChannels; channel++)
-		{
-			coderInfo[channel].block_type = ONLY_LONG_WINDOW;
-		}
-    }
-    if (shortctl == SHORTCTL_NOLONG)
-    {
-		for (channel = 0; channel < numChannels; channel++)
-		{
-			coderInfo[channel].block_type = ONLY_SHORT_WINDOW;
-		}
-    }
+    ChannelInfo *channelInfo = hEncoder->channelInfo;
+    CoderInfo *coderInfo = hEncoder->coderInfo;
+    unsigned int sampleRate = hEncoder->sampleRate;
+    unsigned int aacObjectType = hEncoder->config.aacObjectType;
+    unsigned int mpegVersion = hEncoder->config.mpegVersion;
+    unsigned int useTns = hEncoder->config.useTns;
+    unsigned int allowMidside = hEncoder->config.allowMidside;
+    unsigned int bandWidth = hEncoder->config.bandWidth;
+#ifdef FAAC_ENCODER_STATS
+    EncoderStats *stats = &hEncoder->channelStats[first];
+#endif
 
     /* AAC Filterbank, MDCT with overlap and add */
-    for (channel = 0; channel < numChannels; channel++) {
+    STAGE_START(stats);
+    for (channel = first; channel < last; channel++) {
         int k;
 
         FilterBank(hEncoder,
@@ -623,7 +654,8 @@ int FAACAPI faacEncEncode(faacEncHandle hEncoder,
             hEncoder->sampleBuff[channel],
             hEncoder->freqBuff[channel],
             hEncoder->overlapBuff[channel],
-            MOVERLAPPED);
+            MOVERLAPPED,
+            &hEncoder->scratch[first]);
 
         if (coderInfo[channel].block_type == ONLY_SHORT_WINDOW) {
             for (k = 0; k < 8; k++) {
@@ -635,9 +667,9 @@ int FAACAPI faacEncEncode(faacEncHandle hEncoder,
 					bandWidth, BLOCK_LEN_LONG);
         }
     }
-
+    STAGE_STOP(stats, STAGE_FILTERBANK);
     /* TMP: Build sfb offset table and other stuff */
-    for (channel = 0; channel < numChannels; channel++) {
+    for (channel = first; channel < last; channel++) {
         channelInfo[channel].msInfo.is_present = 0;
 
         if (coderInfo[channel].block_type == ONLY_SHORT_WINDOW) {
@@ -677,20 +709,24 @@ int FAACAPI faacEncEncode(faacEncHandle hEncoder,
     }
 
     /* Perform TNS analysis and filtering */
-    for (channel = 0; channel < numChannels; channel++) {
+    STAGE_START(stats);
+    for (channel = first; channel < last; channel++) {
         if ((!channelInfo[channel].lfe) && (useTns)) {
             TnsEncode(&(coderInfo[channel].tnsInfo),
 					coderInfo[channel].max_sfb,
 					coderInfo[channel].max_sfb,
 					coderInfo[channel].block_type,
 					coderInfo[channel].sfb_offset,
-					hEncoder->freqBuff[channel]);
+					hEncoder->freqBuff[channel],
+					&hEncoder->scratch[first]);
         } else {
             coderInfo[channel].tnsInfo.tnsDataPresent = 0;      /* TNS not used for LFE */
         }
     }
+    STAGE_STOP(stats, STAGE_TNS);
 
-    for(channel = 0; channel < numChannels; channel++)
+    STAGE_START(stats);
+    for(channel = first; channel < last; channel++)
     {
         if((coderInfo[channel].tnsInfo.tnsDataPresent != 0) && (useTns))
             tnsInfo_for_LTP = &(coderInfo[channel].tnsInfo);
@@ -706,13 +742,14 @@ int FAACAPI faacEncEncode(faacEncHandle hEncoder,
 					&(coderInfo[channel].ltpInfo),
 					tnsInfo_for_LTP,
 					hEncoder->freqBuff[channel],
-					hEncoder->ltpTimeBuff[channel]);
+					hEncoder->ltpTimeBuff[channel],
+					&hEncoder->scratch[first]);
         } else {
             coderInfo[channel].ltpInfo.global_pred_flag = 0;
         }
     }
 
-    for(channel = 0; channel < numChannels; channel++)
+    for(channel = first; channel < last; channel++)
     {
         if ((aacObjectType == MAIN) && (!channelInfo[channel].lfe)) {
             int numPredBands = min(coderInfo[channel].max_pred_sfb, coderInfo[channel].nr_of_sfb);
@@ -729,8 +766,11 @@ int FAACAPI faacEncEncode(faacEncHandle hEncoder,
             coderInfo[channel].pred_global_flag = 0;
         }
     }
+    STAGE_STOP(stats, STAGE_PREDICTION);
 
-    for (channel = 0; channel < numChannels; channel++) {
+    STAGE_START(stats);
+
+    for (channel = first; channel < last; channel++) {
 		if (coderInfo[channel].block_type == ONLY_SHORT_WINDOW) {
 			SortForGrouping(&coderInfo[channel],
 					&hEncoder->psyInfo[channel],
@@ -747,65 +787,87 @@ int FAACAPI faacEncEncode(faacEncHandle hEncoder,
 		}
 	}
 
-    MSEncode(coderInfo, channelInfo, hEncoder->freqBuff, numChannels, allowMidside);
+    MSEncode(coderInfo, channelInfo, hEncoder->freqBuff, first, last, allowMidside);
 
-    for (channel = 0; channel < numChannels; channel++)
+    for (channel = first; channel < last; channel++)
     {
         CalcAvgEnrg(&coderInfo[channel], hEncoder->freqBuff[channel]);
     }
+    STAGE_STOP(stats, STAGE_MIDSIDE);
+}
 
-#ifdef DRM
-    /* loop the quantization until the desired bit-rate is reached */
-    diff = 1; /* to enter while loop */
-    hEncoder->aacquantCfg.quality = 120; /* init quality setting */
-    while (diff > 0) { /* if too many bits, do it again */
+/* Quantizes the channels first..last-1 of one channel element */
+static void ElementQuantize(faacEncHandle hEncoder, int first, int last)
+{
+    int channel;
+
+    ChannelInfo *channelInfo = hEncoder->channelInfo;
+    CoderInfo *coderInfo = hEncoder->coderInfo;
+#ifdef FAAC_ENCODER_STATS
+    EncoderStats *stats = &hEncoder->channelStats[first];
+    int i;
 #endif
+
     /* Quantize and code the signal */
-    for (channel = 0; channel < numChannels; channel++) {
+    STAGE_START(stats);
+    for (channel = first; channel < last; channel++) {
         if (coderInfo[channel].block_type == ONLY_SHORT_WINDOW) {
             AACQuantize(&coderInfo[channel], &hEncoder->psyInfo[channel],
 					&channelInfo[channel], hEncoder->srInfo->cb_width_short,
 					hEncoder->srInfo->num_cb_short, hEncoder->freqBuff[channel],
-					&(hEncoder->aacquantCfg));
+					&(hEncoder->aacquantCfg), &hEncoder->scratch[first]);
         } else {
             AACQuantize(&coderInfo[channel], &hEncoder->psyInfo[channel],
 					&channelInfo[channel], hEncoder->srInfo->cb_width_long,
 					hEncoder->srInfo->num_cb_long, hEncoder->freqBuff[channel],
-					&(hEncoder->aacquantCfg));
+					&(hEncoder->aacquantCfg), &hEncoder->scratch[first]);
         }
     }
+    STAGE_STOP(stats, STAGE_QUANTIZE);
+
+#ifdef FAAC_ENCODER_STATS
+    /* quantization noise, channels that were all zero have no requantized
+       spectrum */
+    for (channel = first; channel < last; channel++) {
+        faac_real *xr = hEncoder->freqBuff[channel];
+        faac_real *rq = coderInfo[channel].requantFreq;
+        double signal = 0.0, noise = 0.0;
+        int coded = 0;
+
+        if (channelInfo[channel].lfe)
+            continue;
+        for (i = 0; i < FRAME_LEN; i++) {
+            double d = (double)xr[i] - (double)rq[i];
+
+            coded |= (FAAC_FABS(xr[i]) > 1E-20);
+            signal += (double)xr[i] * xr[i];
+            noise += d * d;
+        }
+        if (coded) {
+            stats->quantSignal += signal;
+            stats->quantNoise += noise;
+        }
+    }
+#endif
+}
 
-#ifdef DRM
-    /* Write the AAC bitstream */
-    bitStream = OpenBitStream(bufferSize, outputBuffer);
-    WriteBitstream(hEncoder, coderInfo, channelInfo, bitStream, numChannels);
-
-    /* Close the bitstream and return the number of bytes written */
-    frameBytes = CloseBitStream(bitStream);
-
-    /* now calculate desired bits and compare with actual encoded bits */
-    desbits = (int) ((double) numChannels * (hEncoder->config.bitRate * FRAME_LEN)
-            / hEncoder->sampleRate);
-
-    diff = ((frameBytes - 1 /* CRC */) * 8) - desbits;
-
-    /* do linear correction according to relative difference */
-    fix = (double) desbits / ((frameBytes - 1 /* CRC */) * 8);
-
-    /* speed up convergence. A value of 0.92 gives approx up to 10 iterations */
-    if (fix > 0.92)
-        fix = 0.92;
-
-    hEncoder->aacquantCfg.quality *= fix;
+/* Rebuilds the decoder's view of the channels first..last-1 of one
+   channel element for the next frame's prediction */
+static void ElementReconstruct(faacEncHandle hEncoder, int first, int last)
+{
+    int channel;
+    TnsInfo *tnsDecInfo;
 
-    /* quality should not go lower than 1, set diff to exit loop */
-    if (hEncoder->aacquantCfg.quality <= 1)
-        diff = -1;
-    }
+    ChannelInfo *channelInfo = hEncoder->channelInfo;
+    CoderInfo *coderInfo = hEncoder->coderInfo;
+    unsigned int aacObjectType = hEncoder->config.aacObjectType;
+    unsigned int useTns = hEncoder->config.useTns;
+#ifdef FAAC_ENCODER_STATS
+    EncoderStats *stats = &hEncoder->channelStats[first];
 #endif
 
     // fix max_sfb in CPE mode
-    for (channel = 0; channel < numChannels; channel++)
+    for (channel = first; channel < last; channel++)
     {
 		if (channelInfo[channel].present
 				&& (channelInfo[channel].cpe)
@@ -821,9 +883,10 @@ int FAACAPI faacEncEncode(faacEncHandle hEncoder,
 		}
     }
 
-    MSReconstruct(coderInfo, channelInfo, numChannels);
+    STAGE_START(stats);
+    MSReconstruct(coderInfo, channelInfo, first, last);
 
-    for (channel = 0; channel < numChannels; channel++)
+    for (channel = first; channel < last; channel++)
     {
         /* If short window, reconstruction not needed for prediction */
         if ((coderInfo[channel].block_type == ONLY_SHORT_WINDOW)) {
@@ -852,7 +915,8 @@ int FAACAPI faacEncEncode(faacEncHandle hEncoder,
 						coderInfo[channel].requantFreq,
 						coderInfo[channel].ltpInfo.time_buffer,
 						coderInfo[channel].ltpInfo.ltp_overlap_buffer,
-						MOVERLAPPED);
+						MOVERLAPPED,
+						&hEncoder->scratch[first]);
 
                 LtpUpdate(&(coderInfo[channel].ltpInfo),
 						coderInfo[channel].ltpInfo.time_buffer,
@@ -861,16 +925,193 @@ int FAACAPI faacEncEncode(faacEncHandle hEncoder,
             }
         }
     }
+    STAGE_STOP(stats, STAGE_RECONSTRUCT);
+}
 
 #ifndef DRM
-    /* Write the AAC bitstream */
-    bitStream = OpenBitStream(bufferSize, outputBuffer);
+/* Codes one channel element up to the bitstream */
+static void EncodeElement(void *arg, int element)
+{
+    EncodeJob *job = (EncodeJob *)arg;
+    int first = job->elementStart[element];
+    int last = job->elementEnd[element];
+
+    ElementAnalysis(job->hEncoder, first, last);
+    ElementQuantize(job->hEncoder, first, last);
+    ElementReconstruct(job->hEncoder, first, last);
+}
+#else
+/* DRM iterates the quantizer over all channels, the analysis and
+   reconstruction around it still run per element */
+static void AnalyzeElement(void *arg, int element)
+{
+    EncodeJob *job = (EncodeJob *)arg;
+
+    ElementAnalysis(job->hEncoder, job->elementStart[element], job->elementEnd[element]);
+}
 
+static void ReconstructElement(void *arg, int element)
+{
+    EncodeJob *job = (EncodeJob *)arg;
+
+    ElementReconstruct(job->hEncoder, job->elementStart[element], job->elementEnd[element]);
+}
+#endif
+
+int FAACAPI faacEncEncode(faacEncHandle hEncoder,
+                          int32_t *inputBuffer,
+                          unsigned int samplesInput,
+                          unsigned char *outputBuffer,
+                          unsigned int bufferSize
+                          )
+{
+    unsigned int channel;
+    int frameBytes;
+    BitStream *bitStream; /* bitstream used for writing the frame to */
+    EncodeJob job;
+#ifdef DRM
+    int desbits, diff;
+    double fix;
+    int element;
+#endif
+
+    /* local copy's of parameters */
+    ChannelInfo *channelInfo = hEncoder->channelInfo;
+    CoderInfo *coderInfo = hEncoder->coderInfo;
+    unsigned int numChannels = hEncoder->numChannels;
+    unsigned int useLfe = hEncoder->config.useLfe;
+    unsigned int shortctl = hEncoder->config.shortctl;
+#ifdef FAAC_ENCODER_STATS
+    EncoderStats *stats = &hEncoder->stats;
+#endif
+
+    switch (hEncoder->config.inputFormat)
+    {
+        case FAAC_INPUT_16BIT:
+        case FAAC_INPUT_32BIT:
+        case FAAC_INPUT_FLOAT:
+            break;
+
+        default:
+            return -1; /* invalid input format */
+    }
+
+    /* Increase frame number */
+    hEncoder->frameNum++;
+
+    if (samplesInput == 0)
+        hEncoder->flushFrame++;
+
+    /* After 4 flush frames all samples have been encoded,
+       return 0 bytes written */
+    if (hEncoder->flushFrame > 4)
+        return 0;
+
+    /* Determine the channel configuration */
+    GetChannelInfo(channelInfo, numChannels, useLfe);
+
+    job.hEncoder = hEncoder;
+    job.inputBuffer = inputBuffer;
+    job.samplesInput = samplesInput;
+    job.numElements = 0;
+    for (channel = 0; channel < numChannels; channel++)
+    {
+        if (channelInfo[channel].cpe && !channelInfo[channel].ch_is_left)
+            continue;
+        job.elementStart[job.numElements] = channel;
+        job.elementEnd[job.numElements] = channelInfo[channel].cpe ?
+            channelInfo[channel].paired_ch + 1 : channel + 1;
+        job.numElements++;
+    }
+
+    /* Update current sample buffers */
+    WorkerPoolRun(hEncoder->workers, ChannelInput, &job, numChannels);
+    COLLECT_STATS(hEncoder);
+
+    if (hEncoder->frameNum <= 3) /* Still filling up the buffers */
+        return 0;
+
+    /* Psychoacoustics */
+    STAGE_START(stats);
+    hEncoder->psymodel->PsyCalculate(channelInfo, &hEncoder->gpsyInfo, hEncoder->psyInfo,
+        hEncoder->srInfo->cb_width_long, hEncoder->srInfo->num_cb_long,
+        hEncoder->srInfo->cb_width_short,
+        hEncoder->srInfo->num_cb_short, numChannels);
+
+    hEncoder->psymodel->BlockSwitch(coderInfo, hEncoder->psyInfo, numChannels);
+    STAGE_STOP(stats, STAGE_PSYCH);
+
+    /* force block type */
+    if (shortctl == SHORTCTL_NOSHORT)
+    {
+		for (channel = 0; channel < numChannels; channel++)
+		{
+			coderInfo[channel].block_type = ONLY_LONG_WINDOW;
+		}
+    }
+    if (shortctl == SHORTCTL_NOLONG)
+    {
+		for (channel = 0; channel < numChannels; channel++)
+		{
+			coderInfo[channel].block_type = ONLY_SHORT_WINDOW;
+		}
+    }
+
+#ifdef DRM
+    WorkerPoolRun(hEncoder->workers, AnalyzeElement, &job, job.numElements);
+
+    /* loop the quantization until the desired bit-rate is reached */
+    diff = 1; /* to enter while loop */
+    hEncoder->aacquantCfg.quality = 120; /* init quality setting */
+    while (diff > 0) { /* if too many bits, do it again */
+    for (element = 0; element < job.numElements; element++)
+        ElementQuantize(hEncoder, job.elementStart[element], job.elementEnd[element]);
+
+    /* Write the AAC bitstream */
+    bitStream = OpenBitStream(bufferSize, outputBuffer, &hEncoder->scratch[0]);
     WriteBitstream(hEncoder, coderInfo, channelInfo, bitStream, numChannels);
 
     /* Close the bitstream and return the number of bytes written */
     frameBytes = CloseBitStream(bitStream);
+    ScratchRelease(&hEncoder->scratch[0], 0);
+
+    /* now calculate desired bits and compare with actual encoded bits */
+    desbits = (int) ((double) numChannels * (hEncoder->config.bitRate * FRAME_LEN)
+            / hEncoder->sampleRate);
+
+    diff = ((frameBytes - 1 /* CRC */) * 8) - desbits;
+
+    /* do linear correction according to relative difference */
+    fix = (double) desbits / ((frameBytes - 1 /* CRC */) * 8);
 
+    /* speed up convergence. A value of 0.92 gives approx up to 10 iterations */
+    if (fix > 0.92)
+        fix = 0.92;
+
+    hEncoder->aacquantCfg.quality *= fix;
+
+    /* quality should not go lower than 1, set diff to exit loop */
+    if (hEncoder->aacquantCfg.quality <= 1)
+        diff = -1;
+    }
+
+    WorkerPoolRun(hEncoder->workers, ReconstructElement, &job, job.numElements);
+    COLLECT_STATS(hEncoder);
+#else
+    /* Channel elements are independent up to the bitstream */
+    WorkerPoolRun(hEncoder->workers, EncodeElement, &job, job.numElements);
+    COLLECT_STATS(hEncoder);
+
+    /* Write the AAC bitstream */
+    STAGE_START(stats);
+    bitStream = OpenBitStream(bufferSize, outputBuffer, &hEncoder->scratch[0]);
+
+    WriteBitstream(hEncoder, coderInfo, channelInfo, bitStream, numChannels);
+
+    /* Close the bitstream and return the number of bytes written */
+    frameBytes = CloseBitStream(bitStream);
+    ScratchRelease(&hEncoder->scratch[0], 0);
+    STAGE_STOP(stats, STAGE_BITSTREAM);
     /* Adjust quality to get correct average bitrate */
     if (hEncoder->config.bitRate)
 	{
@@ -49,6 +49,8 @@ extern "C" {
 #include "psych.h"
 #include "aacquant.h"
 #include "fft.h"
+#include "util.h"
+#include "workers.h"
 
 #if defined(_WIN32) && !defined(__MINGW32__)
   #ifndef FAACAPI
@@ -69,6 +71,34 @@ typedef struct {
 
 #include <faaccfg.h>
 
+/* Per-frame scratch memory, the deepest users are LtpEncode() and
+   IFilterBank() with 5*BLOCK_LEN_LONG reals */
+#define ENC_SCRATCH_SIZE (6 * BLOCK_LEN_LONG * sizeof(faac_real))
+
+#ifdef FAAC_ENCODER_STATS
+/* Encode stages timed in faacEncEncode() */
+enum {
+    STAGE_INPUT,
+    STAGE_PSYCH,
+    STAGE_FILTERBANK,
+    STAGE_TNS,
+    STAGE_PREDICTION,
+    STAGE_MIDSIDE,
+    STAGE_QUANTIZE,
+    STAGE_RECONSTRUCT,
+    STAGE_BITSTREAM,
+    STAGE_COUNT
+};
+
+/* seconds spent per stage and quantizer signal/noise energy */
+typedef struct {
+    double start;
+    double time[STAGE_COUNT];
+    double quantSignal;
+    double quantNoise;
+} EncoderStats;
+#endif
+
 typedef struct {
     /* number of channels in AAC file */
     unsigned int numChannels;
@@ -87,21 +117,21 @@ typedef struct {
     SR_INFO *srInfo;
 
     /* sample buffers of current next and next next frame*/
-    double *sampleBuff[MAX_CHANNELS];
-    double *nextSampleBuff[MAX_CHANNELS];
-    double *next2SampleBuff[MAX_CHANNELS];
-    double *next3SampleBuff[MAX_CHANNELS];
-    double *ltpTimeBuff[MAX_CHANNELS];
+    faac_real *sampleBuff[MAX_CHANNELS];
+    faac_real *nextSampleBuff[MAX_CHANNELS];
+    faac_real *next2SampleBuff[MAX_CHANNELS];
+    faac_real *next3SampleBuff[MAX_CHANNELS];
+    faac_real *ltpTimeBuff[MAX_CHANNELS];
 
     /* Filterbank buffers */
-    double *sin_window_long;
-    double *sin_window_short;
-    double *kbd_window_long;
-    double *kbd_window_short;
-    double *freqBuff[MAX_CHANNELS];
-    double *overlapBuff[MAX_CHANNELS];
+    faac_real *sin_window_long;
+    faac_real *sin_window_short;
+    faac_real *kbd_window_long;
+    faac_real *kbd_window_short;
+    faac_real *freqBuff[MAX_CHANNELS];
+    faac_real *overlapBuff[MAX_CHANNELS];
 
-    double *msSpectrum[MAX_CHANNELS];
+    faac_real *msSpectrum[MAX_CHANNELS];
 
     /* Channel and Coder data for all channels */
     CoderInfo coderInfo[MAX_CHANNELS];
@@ -122,8 +152,23 @@ typedef struct {
 	/* FFT Tables */
 	FFT_Tables	fft_tables;
 
+    /* per-frame temporaries, one arena per channel element job, indexed
+       by the first channel of the element */
+    ScratchArena scratch[MAX_CHANNELS];
+
+    /* threads sharing the channel work, NULL when encoding on the
+       calling thread only */
+    WorkerPool *workers;
+
     /* output bits difference in average bitrate mode */
     int bitDiff;
+
+#ifdef FAAC_ENCODER_STATS
+    /* totals over all frames, the channel jobs collect into
+       channelStats[] and are added up after each parallel section */
+    EncoderStats stats;
+    EncoderStats channelStats[MAX_CHANNELS];
+#endif
 } faacEncStruct, *faacEncHandle;
 
 int FAACAPI faacEncGetVersion(char **faac_id_string,
@@ -36,13 +36,77 @@ must be included in all copies or derivative works. Copyright 1996.
 
 #include "hufftab.h"
 
+#define PACK_BITS(a, b, c) ((unsigned long long)(a) \
+    | ((unsigned long long)(b) << PACKED_FIELD_BITS) \
+    | ((unsigned long long)(c) << (2 * PACKED_FIELD_BITS)))
+
+/* number of sign bits of a pair */
+#define PAIR_SIGNS(a, b) (((a) != 0) + ((b) != 0))
+
+static void PackBookBits(unsigned long long *packed)
+{
+    int a, b, c, d, i;
+
+    for (a = -1; a <= 1; a++)
+        for (b = -1; b <= 1; b++)
+            for (c = -1; c <= 1; c++)
+                for (d = -1; d <= 1; d++) {
+                    i = 27*a + 9*b + 3*c + d + 40;
+                    packed[PACKED_QUAD1 + i] = PACK_BITS(huff1[i][FIRSTINTAB],
+                        huff2[i][FIRSTINTAB],
+                        huff3[27*ABS(a) + 9*ABS(b) + 3*ABS(c) + ABS(d)][FIRSTINTAB]
+                        + PAIR_SIGNS(a, b) + PAIR_SIGNS(c, d));
+                }
+
+    for (a = -2; a <= 2; a++)
+        for (b = -2; b <= 2; b++)
+            for (c = -2; c <= 2; c++)
+                for (d = -2; d <= 2; d++) {
+                    int idx = 27*ABS(a) + 9*ABS(b) + 3*ABS(c) + ABS(d);
+                    int signs = PAIR_SIGNS(a, b) + PAIR_SIGNS(c, d);
+
+                    packed[PACKED_QUAD2 + 125*a + 25*b + 5*c + d + 312] = PACK_BITS(
+                        huff3[idx][FIRSTINTAB] + signs,
+                        huff4[idx][FIRSTINTAB] + signs,
+                        huff5[9*a + b + 40][FIRSTINTAB] + huff5[9*c + d + 40][FIRSTINTAB]);
+                }
+
+    for (a = -4; a <= 4; a++)
+        for (b = -4; b <= 4; b++) {
+            i = 9*a + b + 40;
+            packed[PACKED_PAIR4 + i] = PACK_BITS(huff5[i][FIRSTINTAB], huff6[i][FIRSTINTAB],
+                huff7[8*ABS(a) + ABS(b)][FIRSTINTAB] + PAIR_SIGNS(a, b));
+        }
+
+    for (a = 0; a < 8; a++)
+        for (b = 0; b < 8; b++) {
+            int signs = PAIR_SIGNS(a, b);
+
+            packed[PACKED_PAIR7 + 8*a + b] = PACK_BITS(huff7[8*a + b][FIRSTINTAB] + signs,
+                huff8[8*a + b][FIRSTINTAB] + signs, huff9[13*a + b][FIRSTINTAB] + signs);
+        }
+
+    for (a = 0; a < 13; a++)
+        for (b = 0; b < 13; b++) {
+            int signs = PAIR_SIGNS(a, b);
+
+            packed[PACKED_PAIR12 + 13*a + b] = PACK_BITS(huff9[13*a + b][FIRSTINTAB] + signs,
+                huff10[13*a + b][FIRSTINTAB] + signs, 0);
+        }
+}
+
 void HuffmanInit(CoderInfo *coderInfo, unsigned int numChannels)
 {
     unsigned int channel;
+    unsigned long long *packed;
+
+    packed = (unsigned long long*)AllocMemory(PACKED_SIZE*sizeof(unsigned long long));
+    PackBookBits(packed);
 
     for (channel = 0; channel < numChannels; channel++) {
         coderInfo[channel].data = (int*)AllocMemory(5*FRAME_LEN*sizeof(int));
         coderInfo[channel].len = (int*)AllocMemory(5*FRAME_LEN*sizeof(int));
+        coderInfo[channel].packedBits = packed;
 
 #ifdef DRM
         coderInfo[channel].num_data_cw = (int*)AllocMemory(FRAME_LEN*sizeof(int));
@@ -54,9 +118,12 @@ void HuffmanEnd(CoderInfo *coderInfo, unsigned int numChannels)
 {
     unsigned int channel;
 
+    if (numChannels && coderInfo[0].packedBits) FreeMemory(coderInfo[0].packedBits);
+
     for (channel = 0; channel < numChannels; channel++) {
         if (coderInfo[channel].data) FreeMemory(coderInfo[channel].data);
         if (coderInfo[channel].len) FreeMemory(coderInfo[channel].len);
+        coderInfo[channel].packedBits = NULL;
 
 #ifdef DRM
         if (coderInfo[channel].num_data_cw) FreeMemory(coderInfo[channel].num_data_cw);
@@ -200,6 +267,9 @@ int NoiselessBitCount(CoderInfo *coderInfo,
     int total_bits_cost = 0;
     int offset, length, end;
     int q;
+    int first_book;
+    unsigned long long packed;
+    const unsigned long long *packedBits = coderInfo->packedBits;
 
     /* set local pointer to sfb_offset */
     int *sfb_offset = coderInfo->sfb_offset;
@@ -240,48 +310,47 @@ int NoiselessBitCount(CoderInfo *coderInfo,
 
             }
             else {  /* if the section does have non-zero coefficients */
+                packed = 0;
                 if(max_sb_coeff < 2){
-                    book_choice[j][0] = CalcBits(coderInfo,1,quant,offset,length);
-                    book_choice[j++][1] = 1;
-                    book_choice[j][0] = CalcBits(coderInfo,2,quant,offset,length);
-                    book_choice[j++][1] = 2;
-                    book_choice[j][0] = CalcBits(coderInfo,3,quant,offset,length);
-                    book_choice[j++][1] = 3;
+                    for (k = offset; k < end; k += 4)
+                        packed += packedBits[PACKED_QUAD1 + 27*quant[k] + 9*quant[k+1]
+                            + 3*quant[k+2] + quant[k+3] + 40];
+                    first_book = 1;
                 }
                 else if (max_sb_coeff < 3){
-                    book_choice[j][0] = CalcBits(coderInfo,3,quant,offset,length);
-                    book_choice[j++][1] = 3;
-                    book_choice[j][0] = CalcBits(coderInfo,4,quant,offset,length);
-                    book_choice[j++][1] = 4;
-                    book_choice[j][0] = CalcBits(coderInfo,5,quant,offset,length);
-                    book_choice[j++][1] = 5;
+                    for (k = offset; k < end; k += 4)
+                        packed += packedBits[PACKED_QUAD2 + 125*quant[k] + 25*quant[k+1]
+                            + 5*quant[k+2] + quant[k+3] + 312];
+                    first_book = 3;
                 }
                 else if (max_sb_coeff < 5){
-                    book_choice[j][0] = CalcBits(coderInfo,5,quant,offset,length);
-                    book_choice[j++][1] = 5;
-                    book_choice[j][0] = CalcBits(coderInfo,6,quant,offset,length);
-                    book_choice[j++][1] = 6;
-                    book_choice[j][0] = CalcBits(coderInfo,7,quant,offset,length);
-                    book_choice[j++][1] = 7;
+                    for (k = offset; k < end; k += 2)
+                        packed += packedBits[PACKED_PAIR4 + 9*quant[k] + quant[k+1] + 40];
+                    first_book = 5;
                 }
                 else if (max_sb_coeff < 8){
-                    book_choice[j][0] = CalcBits(coderInfo,7,quant,offset,length);
-                    book_choice[j++][1] = 7;
-                    book_choice[j][0] = CalcBits(coderInfo,8,quant,offset,length);
-                    book_choice[j++][1] = 8;
-                    book_choice[j][0] = CalcBits(coderInfo,9,quant,offset,length);
-                    book_choice[j++][1] = 9;
+                    for (k = offset; k < end; k += 2)
+                        packed += packedBits[PACKED_PAIR7 + 8*ABS(quant[k]) + ABS(quant[k+1])];
+                    first_book = 7;
                 }
                 else if (max_sb_coeff < 13){
-                    book_choice[j][0] = CalcBits(coderInfo,9,quant,offset,length);
-                    book_choice[j++][1] = 9;
-                    book_choice[j][0] = CalcBits(coderInfo,10,quant,offset,length);
-                    book_choice[j++][1] = 10;
+                    for (k = offset; k < end; k += 2)
+                        packed += packedBits[PACKED_PAIR12 + 13*ABS(quant[k]) + ABS(quant[k+1])];
+                    first_book = 9;
                 }
                 /* (max_sb_coeff >= 13), choose table 11 */
                 else {
                     book_choice[j][0] = CalcBits(coderInfo,11,quant,offset,length);
                     book_choice[j++][1] = 11;
+                    first_book = 0;
+                }
+
+                /* unpack the bits of the three (two for books 9 and 10) candidates */
+                if (first_book) {
+                    for (k = 0; k < (first_book == 9 ? 2 : 3); k++) {
+                        book_choice[j][0] = (int)(packed >> (k * PACKED_FIELD_BITS)) & PACKED_FIELD_MASK;
+                        book_choice[j++][1] = first_book + k;
+                    }
                 }
             }
 
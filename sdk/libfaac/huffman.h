@@ -47,6 +47,18 @@ extern "C" {
 
 #define ABS(A) ((A) < 0 ? (-A) : (A))
 
+/* NoiselessBitCount() scores the candidate books of a section at once with
+   tables of their codeword lengths, sign bits included, packed into 21 bit
+   fields and indexed by the quad or pair of quantized values */
+#define PACKED_FIELD_BITS 21
+#define PACKED_FIELD_MASK ((1 << PACKED_FIELD_BITS) - 1)
+#define PACKED_QUAD1  0     /* books 1, 2, 3 by quads in -1..1 */
+#define PACKED_QUAD2  81    /* books 3, 4, 5 by quads in -2..2 */
+#define PACKED_PAIR4  706   /* books 5, 6, 7 by pairs in -4..4 */
+#define PACKED_PAIR7  787   /* books 7, 8, 9 by absolute pairs up to 7 */
+#define PACKED_PAIR12 851   /* books 9, 10 by absolute pairs up to 12 */
+#define PACKED_SIZE   1020
+
 #include "frame.h"
 
 void HuffmanInit(CoderInfo *coderInfo, unsigned int numChannels);
@@ -59,14 +59,14 @@ static double codebook[CODESIZE] =
 };
 
 
-static double snr_pred(double *mdct_in, double *mdct_pred, int *sfb_flag, int *sfb_offset,
+static double snr_pred(faac_real *mdct_in, faac_real *mdct_pred, int *sfb_flag, int *sfb_offset,
                 int block_type, int side_info, int num_of_sfb)
 {
     int i, j, flen;
     double snr_limit;
     double num_bit, snr[NSFB_LONG];
     double temp1, temp2;
-    double energy[BLOCK_LEN_LONG], snr_p[BLOCK_LEN_LONG];
+    faac_real energy[BLOCK_LEN_LONG], snr_p[BLOCK_LEN_LONG];
 
     if (block_type != ONLY_SHORT_WINDOW)
     {
@@ -134,7 +134,7 @@ static double snr_pred(double *mdct_in, double *mdct_pred, int *sfb_flag, int *s
     return (num_bit);
 }
 
-static void prediction(double *buffer, double *predicted_samples, double *weight, int lag,
+static void prediction(faac_real *buffer, faac_real *predicted_samples, double *weight, int lag,
                 int flen)
 {
     int i, offset;
@@ -174,8 +174,8 @@ static void w_quantize(double *freq, int *ltp_idx)
     *freq = codebook[*ltp_idx];
 }
 
-static int pitch(double *sb_samples, double *x_buffer, int flen, int lag0, int lag1,
-          double *predicted_samples, double *gain, int *cb_idx)
+static int pitch(faac_real *sb_samples, faac_real *x_buffer, int flen, int lag0, int lag1,
+          faac_real *predicted_samples, double *gain, int *cb_idx)
 {
     int i, j, delay;
     double corr1, corr2, lag_corr;
@@ -252,21 +252,22 @@ static int pitch(double *sb_samples, double *x_buffer, int flen, int lag0, int l
 }
 
 static double ltp_enc_tf(faacEncHandle hEncoder,
-                CoderInfo *coderInfo, double *p_spectrum, double *predicted_samples,
-                         double *mdct_predicted, int *sfb_offset,
+                CoderInfo *coderInfo, faac_real *p_spectrum, faac_real *predicted_samples,
+                         faac_real *mdct_predicted, int *sfb_offset,
                          int num_of_sfb, int last_band, int side_info,
-                         int *sfb_prediction_used, TnsInfo *tnsInfo)
+                         int *sfb_prediction_used, TnsInfo *tnsInfo,
+                         ScratchArena *scratch)
 {
     double bit_gain;
 
     /* Transform prediction to frequency domain. */
     FilterBank(hEncoder, coderInfo, predicted_samples, mdct_predicted,
-        NULL, MNON_OVERLAPPED);
+        NULL, MNON_OVERLAPPED, scratch);
 	
     /* Apply TNS analysis filter to the predicted spectrum. */
     if(tnsInfo != NULL)
         TnsEncodeFilterOnly(tnsInfo, num_of_sfb, num_of_sfb, coderInfo->block_type, sfb_offset,
-        mdct_predicted);
+        mdct_predicted, scratch);
 	
     /* Get the prediction gain. */
     bit_gain = snr_pred(p_spectrum, mdct_predicted, sfb_prediction_used,
@@ -283,10 +284,10 @@ void LtpInit(faacEncHandle hEncoder)
     for (channel = 0; channel < hEncoder->numChannels; channel++) {
         LtpInfo *ltpInfo = &(hEncoder->coderInfo[channel].ltpInfo);
 
-        ltpInfo->buffer = AllocMemory(NOK_LT_BLEN * sizeof(double));
-        ltpInfo->mdct_predicted = AllocMemory(2*BLOCK_LEN_LONG*sizeof(double));
-        ltpInfo->time_buffer = AllocMemory(BLOCK_LEN_LONG*sizeof(double));
-        ltpInfo->ltp_overlap_buffer = AllocMemory(BLOCK_LEN_LONG*sizeof(double));
+        ltpInfo->buffer = AllocMemory(NOK_LT_BLEN * sizeof(faac_real));
+        ltpInfo->mdct_predicted = AllocMemory(2*BLOCK_LEN_LONG*sizeof(faac_real));
+        ltpInfo->time_buffer = AllocMemory(BLOCK_LEN_LONG*sizeof(faac_real));
+        ltpInfo->ltp_overlap_buffer = AllocMemory(BLOCK_LEN_LONG*sizeof(faac_real));
 
         for (i = 0; i < NOK_LT_BLEN; i++)
             ltpInfo->buffer[i] = 0;
@@ -328,17 +329,20 @@ int LtpEncode(faacEncHandle hEncoder,
                 CoderInfo *coderInfo,
                 LtpInfo *ltpInfo,
                 TnsInfo *tnsInfo,
-                double *p_spectrum,
-                double *p_time_signal)
+                faac_real *p_spectrum,
+                faac_real *p_time_signal,
+                ScratchArena *scratch)
 {
     int i, last_band;
     double num_bit[MAX_SHORT_WINDOWS];
-    double *predicted_samples;
+    faac_real *predicted_samples;
+    size_t mark = ScratchMark(scratch);
 
     ltpInfo->global_pred_flag = 0;
     ltpInfo->side_info = 0;
 
-    predicted_samples = (double*)AllocMemory(2*BLOCK_LEN_LONG*sizeof(double));
+    predicted_samples = (faac_real*)ScratchAlloc(scratch,
+            2*BLOCK_LEN_LONG*sizeof(faac_real));
 
     switch(coderInfo->block_type)
     {
@@ -358,7 +362,7 @@ int LtpEncode(faacEncHandle hEncoder,
                 ltpInfo->mdct_predicted,
                 coderInfo->sfb_offset, coderInfo->nr_of_sfb,
                 last_band, ltpInfo->side_info, ltpInfo->sfb_prediction_used,
-                tnsInfo);
+                tnsInfo, scratch);
 
 
 		ltpInfo->global_pred_flag = (num_bit[0] == 0.0) ? 0 : 1;
@@ -375,12 +379,12 @@ int LtpEncode(faacEncHandle hEncoder,
         break;
     }
 
-    if (predicted_samples) FreeMemory(predicted_samples);
+    ScratchRelease(scratch, mark);
 
     return (ltpInfo->global_pred_flag);
 }
 
-void LtpReconstruct(CoderInfo *coderInfo, LtpInfo *ltpInfo, double *p_spectrum)
+void LtpReconstruct(CoderInfo *coderInfo, LtpInfo *ltpInfo, faac_real *p_spectrum)
 {
     int i, last_band;
 
@@ -404,8 +408,8 @@ void LtpReconstruct(CoderInfo *coderInfo, LtpInfo *ltpInfo, double *p_spectrum)
     }
 }
 
-void  LtpUpdate(LtpInfo *ltpInfo, double *time_signal,
-                     double *overlap_signal, int block_size_long)
+void  LtpUpdate(LtpInfo *ltpInfo, faac_real *time_signal,
+                     faac_real *overlap_signal, int block_size_long)
 {
     int i;
 
@@ -26,13 +26,14 @@
 
 void MSEncode(CoderInfo *coderInfo,
 	      ChannelInfo *channelInfo,
-	      double *spectrum[MAX_CHANNELS],
-	      int maxchan,
+	      faac_real *spectrum[MAX_CHANNELS],
+	      int firstchan,
+	      int lastchan,
 	      int allowms)
 {
   int chn;
 
-  for (chn = 0; chn < maxchan; chn++)
+  for (chn = firstchan; chn < lastchan; chn++)
   {
     if (channelInfo[chn].present)
     {
@@ -64,9 +65,9 @@ void MSEncode(CoderInfo *coderInfo,
 	  {
             int ms = 0;
 	    int l, start, end;
-	    double sum, diff;
-            double enrgs, enrgd, enrgl, enrgr;
-	    double maxs, maxd, maxl, maxr;
+	    faac_real sum, diff;
+            faac_real enrgs, enrgd, enrgl, enrgr;
+	    faac_real maxs, maxd, maxl, maxr;
 
 	    start = coderInfo[chn].sfb_offset[sfb];
             end = coderInfo[chn].sfb_offset[sfb + 1];
@@ -75,23 +76,23 @@ void MSEncode(CoderInfo *coderInfo,
 	    maxs = maxd = maxl = maxr = 0.0;
 	    for (l = start; l < end; l++)
 	    {
-              double lx = spectrum[chn][l];
-	      double rx = spectrum[rch][l];
+              faac_real lx = spectrum[chn][l];
+	      faac_real rx = spectrum[rch][l];
 
 	      sum = 0.5 * (lx + rx);
 	      diff = 0.5 * (lx - rx);
 
 	      enrgs += sum * sum;
-	      maxs = max(maxs, fabs(sum));
+	      maxs = max(maxs, FAAC_FABS(sum));
 
 	      enrgd += diff * diff;
-	      maxd = max(maxd, fabs(diff));
+	      maxd = max(maxd, FAAC_FABS(diff));
 
 	      enrgl += lx * lx;
 	      enrgr += rx * rx;
 
-              maxl = max(maxl, fabs(lx));
-              maxr = max(maxr, fabs(rx));
+              maxl = max(maxl, FAAC_FABS(lx));
+              maxr = max(maxr, FAAC_FABS(rx));
 	    }
 
 #if 1
@@ -124,11 +125,12 @@ void MSEncode(CoderInfo *coderInfo,
 
 void MSReconstruct(CoderInfo *coderInfo,
 		   ChannelInfo *channelInfo,
-		   int maxchan)
+		   int firstchan,
+		   int lastchan)
 {
   int chn;
 
-  for (chn = 0; chn < maxchan; chn++)
+  for (chn = firstchan; chn < lastchan; chn++)
   {
     if (channelInfo[chn].present)
     {
@@ -153,7 +155,7 @@ void MSReconstruct(CoderInfo *coderInfo,
 	    {
 	      for (l = start; l < end; l++)
 	      {
-		double sum, diff;
+		faac_real sum, diff;
 
 		sum = coderInfo[chn].requantFreq[l];
 		diff = coderInfo[rch].requantFreq[l];
@@ -29,9 +29,10 @@ extern "C" {
 #include "coder.h"
 
 
-void MSEncode(CoderInfo *coderInfo, ChannelInfo *channelInfo, double *spectrum[MAX_CHANNELS],
-              unsigned int numberOfChannels, unsigned int msenable);
-void MSReconstruct(CoderInfo *coderInfo, ChannelInfo *channelInfo, int numberOfChannels);
+/* both work on the channels firstchan..lastchan-1 */
+void MSEncode(CoderInfo *coderInfo, ChannelInfo *channelInfo, faac_real *spectrum[MAX_CHANNELS],
+              int firstchan, int lastchan, unsigned int msenable);
+void MSReconstruct(CoderInfo *coderInfo, ChannelInfo *channelInfo, int firstchan, int lastchan);
 
 #ifdef __cplusplus
 }
@@ -39,8 +39,8 @@ typedef struct {
 	int sizeS;
 
 	/* Previous input samples */
-	double *prevSamples;
-	double *prevSamplesS;
+	faac_real *prevSamples;
+	faac_real *prevSamplesS;
 
 	int block_type;
 
@@ -51,8 +51,8 @@ typedef struct {
 	double sampleRate;
 
 	/* Hann window */
-	double *hannWindow;
-	double *hannWindowS;
+	faac_real *hannWindow;
+	faac_real *hannWindowS;
 
         void *data;
 } GlobalPsyInfo;
@@ -70,7 +70,7 @@ void (*PsyCalculate) (ChannelInfo *channelInfo, GlobalPsyInfo *gpsyInfo,
 		int *cb_width_short, int num_cb_short,
 		unsigned int numChannels);
 void (*PsyBufferUpdate) ( FFT_Tables *fft_tables, GlobalPsyInfo * gpsyInfo, PsyInfo * psyInfo,
-		double *newSamples, unsigned int bandwidth,
+		faac_real *newSamples, unsigned int bandwidth,
 		int *cb_width_short, int num_cb_short);
 void (*BlockSwitch) (CoderInfo *coderInfo, PsyInfo *psyInfo,
 		unsigned int numChannels);
@@ -45,7 +45,7 @@ typedef struct
 psydata_t;
 
 
-static void Hann(GlobalPsyInfo * gpsyInfo, double *inSamples, int size)
+static void Hann(GlobalPsyInfo * gpsyInfo, faac_real *inSamples, int size)
 {
   int i;
 
@@ -196,9 +196,9 @@ static void PsyInit(GlobalPsyInfo * gpsyInfo, PsyInfo * psyInfo, unsigned int nu
   int i, j, size;
 
   gpsyInfo->hannWindow =
-    (double *) AllocMemory(2 * BLOCK_LEN_LONG * sizeof(double));
+    (faac_real *) AllocMemory(2 * BLOCK_LEN_LONG * sizeof(faac_real));
   gpsyInfo->hannWindowS =
-    (double *) AllocMemory(2 * BLOCK_LEN_SHORT * sizeof(double));
+    (faac_real *) AllocMemory(2 * BLOCK_LEN_SHORT * sizeof(faac_real));
 
   for (i = 0; i < BLOCK_LEN_LONG * 2; i++)
     gpsyInfo->hannWindow[i] = 0.5 * (1 - cos(2.0 * M_PI * (i + 0.5) /
@@ -220,8 +220,8 @@ static void PsyInit(GlobalPsyInfo * gpsyInfo, PsyInfo * psyInfo, unsigned int nu
     psyInfo[channel].size = size;
 
     psyInfo[channel].prevSamples =
-      (double *) AllocMemory(size * sizeof(double));
-    memset(psyInfo[channel].prevSamples, 0, size * sizeof(double));
+      (faac_real *) AllocMemory(size * sizeof(faac_real));
+    memset(psyInfo[channel].prevSamples, 0, size * sizeof(faac_real));
   }
 
   size = BLOCK_LEN_SHORT;
@@ -232,8 +232,8 @@ static void PsyInit(GlobalPsyInfo * gpsyInfo, PsyInfo * psyInfo, unsigned int nu
     psyInfo[channel].sizeS = size;
 
     psyInfo[channel].prevSamplesS =
-      (double *) AllocMemory(size * sizeof(double));
-    memset(psyInfo[channel].prevSamplesS, 0, size * sizeof(double));
+      (faac_real *) AllocMemory(size * sizeof(faac_real));
+    memset(psyInfo[channel].prevSamplesS, 0, size * sizeof(faac_real));
 
     for (j = 0; j < 8; j++)
     {
@@ -333,20 +333,20 @@ static void PsyCalculate(ChannelInfo * channelInfo, GlobalPsyInfo * gpsyInfo,
 }
 
 static void PsyBufferUpdate( FFT_Tables *fft_tables, GlobalPsyInfo * gpsyInfo, PsyInfo * psyInfo,
-			    double *newSamples, unsigned int bandwidth,
+			    faac_real *newSamples, unsigned int bandwidth,
 			    int *cb_width_short, int num_cb_short)
 {
   int win;
-  double transBuff[2 * BLOCK_LEN_LONG];
-  double transBuffS[2 * BLOCK_LEN_SHORT];
+  faac_real transBuff[2 * BLOCK_LEN_LONG];
+  faac_real transBuffS[2 * BLOCK_LEN_SHORT];
   psydata_t *psydata = psyInfo->data;
   psyfloat *tmp;
   int sfb;
 
   psydata->bandS = psyInfo->sizeS * bandwidth * 2 / gpsyInfo->sampleRate;
 
-  memcpy(transBuff, psyInfo->prevSamples, psyInfo->size * sizeof(double));
-  memcpy(transBuff + psyInfo->size, newSamples, psyInfo->size * sizeof(double));
+  memcpy(transBuff, psyInfo->prevSamples, psyInfo->size * sizeof(faac_real));
+  memcpy(transBuff + psyInfo->size, newSamples, psyInfo->size * sizeof(faac_real));
 
   for (win = 0; win < 8; win++)
   {
@@ -354,7 +354,7 @@ static void PsyBufferUpdate( FFT_Tables *fft_tables, GlobalPsyInfo * gpsyInfo, P
     int last = 0;
 
     memcpy(transBuffS, transBuff + (win * BLOCK_LEN_SHORT) + (BLOCK_LEN_LONG - BLOCK_LEN_SHORT) / 2,
-	   2 * psyInfo->sizeS * sizeof(double));
+	   2 * psyInfo->sizeS * sizeof(faac_real));
 
     Hann(gpsyInfo, transBuffS, 2 * psyInfo->sizeS);
     rfft( fft_tables, transBuffS, 8);
@@ -368,7 +368,7 @@ static void PsyBufferUpdate( FFT_Tables *fft_tables, GlobalPsyInfo * gpsyInfo, P
 
     for (sfb = 0; sfb < num_cb_short; sfb++)
     {
-      double e;
+      faac_real e;
       int l;
 
       first = last;
@@ -384,8 +384,8 @@ static void PsyBufferUpdate( FFT_Tables *fft_tables, GlobalPsyInfo * gpsyInfo, P
       e = 0.0;
       for (l = first; l < last; l++)
       {
-	double a = transBuffS[l];
-	double b = transBuffS[l + psyInfo->sizeS];
+	faac_real a = transBuffS[l];
+	faac_real b = transBuffS[l + psyInfo->sizeS];
 
 	e += a * a + b * b;
       }
@@ -399,7 +399,7 @@ static void PsyBufferUpdate( FFT_Tables *fft_tables, GlobalPsyInfo * gpsyInfo, P
     }
   }
 
-  memcpy(psyInfo->prevSamples, newSamples, psyInfo->size * sizeof(double));
+  memcpy(psyInfo->prevSamples, newSamples, psyInfo->size * sizeof(faac_real));
 }
 
 static void BlockSwitch(CoderInfo * coderInfo, PsyInfo * psyInfo, unsigned int numChannels)
@@ -65,20 +65,20 @@ static unsigned short tnsMaxOrderShortMainLow = 7;
 /*************************/
 static void Autocorrelation(int maxOrder,        /* Maximum autocorr order */
                      int dataSize,        /* Size of the data array */
-                     double* data,        /* Data array */
+                     faac_real* data,     /* Data array */
                      double* rArray);     /* Autocorrelation array */
 
 static double LevinsonDurbin(int maxOrder,        /* Maximum filter order */
                       int dataSize,        /* Size of the data array */
-                      double* data,        /* Data array */
-                      double* kArray);     /* Reflection coeff array */
+                      faac_real* data,     /* Data array */
+                      faac_real* kArray);  /* Reflection coeff array */
 
-static void StepUp(int fOrder, double* kArray, double* aArray);
+static void StepUp(int fOrder, faac_real* kArray, faac_real* aArray);
 
-static void QuantizeReflectionCoeffs(int fOrder,int coeffRes,double* rArray,int* indexArray);
-static int TruncateCoeffs(int fOrder,double threshold,double* kArray);
-static void TnsFilter(int length,double* spec,TnsFilterData* filter);
-static void TnsInvFilter(int length,double* spec,TnsFilterData* filter);
+static void QuantizeReflectionCoeffs(int fOrder,int coeffRes,faac_real* rArray,int* indexArray);
+static int TruncateCoeffs(int fOrder,double threshold,faac_real* kArray);
+static void TnsFilter(int length,faac_real* spec,TnsFilterData* filter);
+static void TnsInvFilter(int length,faac_real* spec,TnsFilterData* filter,ScratchArena* scratch);
 
 
 /*****************************************************/
@@ -136,7 +136,8 @@ void TnsEncode(TnsInfo* tnsInfo,       /* TNS info */
                int maxSfb,              /* max_sfb */
                enum WINDOW_TYPE blockType,   /* block type */
                int* sfbOffsetTable,     /* Scalefactor band offset table */
-               double* spec)            /* Spectral data array */
+               faac_real* spec,         /* Spectral data array */
+               ScratchArena* scratch)   /* Filter temporaries */
 {
     int numberOfWindows,windowSize;
     int startBand,stopBand,order;    /* Bands over which to apply TNS */
@@ -188,8 +189,8 @@ void TnsEncode(TnsInfo* tnsInfo,       /* TNS info */
 
         TnsWindowData* windowData = &tnsInfo->windowData[w];
         TnsFilterData* tnsFilter = windowData->tnsFilter;
-        double* k = tnsFilter->kCoeffs;    /* reflection coeffs */
-        double* a = tnsFilter->aCoeffs;    /* prediction coeffs */
+        faac_real* k = tnsFilter->kCoeffs;    /* reflection coeffs */
+        faac_real* a = tnsFilter->aCoeffs;    /* prediction coeffs */
 
         windowData->numFilters=0;
         windowData->coefResolution = DEF_TNS_COEFF_RES;
@@ -208,7 +209,7 @@ void TnsEncode(TnsInfo* tnsInfo,       /* TNS info */
             truncatedOrder = TruncateCoeffs(order,DEF_TNS_COEFF_THRESH,k);
             tnsFilter->order = truncatedOrder;
             StepUp(truncatedOrder,k,a);    /* Compute predictor coefficients */
-            TnsInvFilter(length,&spec[startIndex],tnsFilter);      /* Filter */
+            TnsInvFilter(length,&spec[startIndex],tnsFilter,scratch);      /* Filter */
         }
     }
 }
@@ -224,7 +225,8 @@ void TnsEncodeFilterOnly(TnsInfo* tnsInfo,           /* TNS info */
                          int maxSfb,                 /* max_sfb */
                          enum WINDOW_TYPE blockType, /* block type */
                          int* sfbOffsetTable,        /* Scalefactor band offset table */
-                         double* spec)               /* Spectral data array */
+                         faac_real* spec,            /* Spectral data array */
+                         ScratchArena* scratch)      /* Filter temporaries */
 {
     int numberOfWindows,windowSize;
     int startBand,stopBand;    /* Bands over which to apply TNS */
@@ -269,7 +271,7 @@ void TnsEncodeFilterOnly(TnsInfo* tnsInfo,           /* TNS info */
         length = sfbOffsetTable[stopBand] - sfbOffsetTable[startBand];
 
         if (tnsInfo->tnsDataPresent  &&  windowData->numFilters) {  /* Use TNS */
-            TnsInvFilter(length,&spec[startIndex],tnsFilter);
+            TnsInvFilter(length,&spec[startIndex],tnsFilter,scratch);
         }
     }
 }
@@ -285,7 +287,7 @@ void TnsDecodeFilterOnly(TnsInfo* tnsInfo,           /* TNS info */
                          int maxSfb,                 /* max_sfb */
                          enum WINDOW_TYPE blockType, /* block type */
                          int* sfbOffsetTable,        /* Scalefactor band offset table */
-                         double* spec)               /* Spectral data array */
+                         faac_real* spec)            /* Spectral data array */
 {
     int numberOfWindows,windowSize;
     int startBand,stopBand;    /* Bands over which to apply TNS */
@@ -343,11 +345,11 @@ void TnsDecodeFilterOnly(TnsInfo* tnsInfo,           /* TNS info */
 /*   Not that the order and direction are specified  */
 /*   withing the TNS_FILTER_DATA structure.          */
 /*****************************************************/
-static void TnsFilter(int length,double* spec,TnsFilterData* filter)
+static void TnsFilter(int length,faac_real* spec,TnsFilterData* filter)
 {
     int i,j,k=0;
     int order=filter->order;
-    double* a=filter->aCoeffs;
+    faac_real* a=filter->aCoeffs;
 
     /* Determine loop parameters for given direction */
     if (filter->direction) {
@@ -394,14 +396,15 @@ static void TnsFilter(int length,double* spec,TnsFilterData* filter)
 /*   Not that the order and direction are specified     */
 /*   withing the TNS_FILTER_DATA structure.             */
 /********************************************************/
-static void TnsInvFilter(int length,double* spec,TnsFilterData* filter)
+static void TnsInvFilter(int length,faac_real* spec,TnsFilterData* filter,ScratchArena* scratch)
 {
     int i,j,k=0;
     int order=filter->order;
-    double* a=filter->aCoeffs;
-    double* temp;
+    faac_real* a=filter->aCoeffs;
+    faac_real* temp;
+    size_t mark = ScratchMark(scratch);
 
-    temp = (double *)AllocMemory(length * sizeof (double));
+    temp = (faac_real *)ScratchAlloc(scratch, length * sizeof (faac_real));
 
     /* Determine loop parameters for given direction */
     if (filter->direction) {
@@ -444,7 +447,7 @@ static void TnsInvFilter(int length,double* spec,TnsFilterData* filter)
             }
         }
     }
-    if (temp) FreeMemory(temp);
+    ScratchRelease(scratch, mark);
 }
 
 
@@ -458,7 +461,7 @@ static void TnsInvFilter(int length,double* spec,TnsFilterData* filter)
 /*   less than the specified threshold.  Return the  */
 /*   truncated filter order.                         */
 /*****************************************************/
-static int TruncateCoeffs(int fOrder,double threshold,double* kArray)
+static int TruncateCoeffs(int fOrder,double threshold,faac_real* kArray)
 {
     int i;
 
@@ -477,7 +480,7 @@ static int TruncateCoeffs(int fOrder,double threshold,double* kArray)
 /*****************************************************/
 static void QuantizeReflectionCoeffs(int fOrder,
                               int coeffRes,
-                              double* kArray,
+                              faac_real* kArray,
                               int* indexArray)
 {
     double iqfac,iqfac_m;
@@ -500,7 +503,7 @@ static void QuantizeReflectionCoeffs(int fOrder,
 /*****************************************************/
 static void Autocorrelation(int maxOrder,        /* Maximum autocorr order */
                      int dataSize,        /* Size of the data array */
-                     double* data,        /* Data array */
+                     faac_real* data,     /* Data array */
                      double* rArray)      /* Autocorrelation array */
 {
     int order,index;
@@ -524,8 +527,8 @@ static void Autocorrelation(int maxOrder,        /* Maximum autocorr order */
 /*****************************************************/
 static double LevinsonDurbin(int fOrder,          /* Filter order */
                       int dataSize,        /* Size of the data array */
-                      double* data,        /* Data array */
-                      double* kArray)      /* Reflection coeff array */
+                      faac_real* data,     /* Data array */
+                      faac_real* kArray)   /* Reflection coeff array */
 {
     int order,i;
     double signal;
@@ -590,7 +593,7 @@ static double LevinsonDurbin(int fOrder,          /* Filter order */
 /*   Convert reflection coefficients into            */
 /*   predictor coefficients.                         */
 /*****************************************************/
-static void StepUp(int fOrder,double* kArray,double* aArray)
+static void StepUp(int fOrder,faac_real* kArray,faac_real* aArray)
 {
     double aTemp[TNS_MAX_ORDER+2];
     int i,order;
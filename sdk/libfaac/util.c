@@ -20,6 +20,7 @@
  */
 
 #include <math.h>
+#include <assert.h>
 
 #include "util.h"
 #include "coder.h"  // FRAME_LEN
@@ -93,3 +94,126 @@ unsigned int MaxBitresSize(unsigned long bitRate, unsigned long sampleRate)
 {
     return 6144 - (unsigned int)((double)bitRate/(double)sampleRate*(double)FRAME_LEN);
 }
+
+#ifdef FAAC_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+static void CpuId(int info[4], int leaf)
+{
+#if defined(_MSC_VER)
+    __cpuidex(info, leaf, 0);
+#else
+    unsigned int a, b, c, d;
+    __cpuid_count(leaf, 0, a, b, c, d);
+    info[0] = a; info[1] = b; info[2] = c; info[3] = d;
+#endif
+}
+
+static unsigned int DetectCpuFlags(void)
+{
+    unsigned int flags = 0;
+    unsigned int xcr0;
+    int info[4];
+
+    CpuId(info, 1);
+    if (!(info[3] & (1 << 26)))
+        return flags;
+    flags |= CPU_FLAG_SSE2;
+
+    /* avx also needs the os to save ymm registers (osxsave + xcr0) */
+    if ((info[2] & (1 << 27)) && (info[2] & (1 << 28)))
+    {
+#if defined(_MSC_VER)
+        xcr0 = (unsigned int)_xgetbv(0);
+#else
+        unsigned int edx;
+        __asm__ volatile("xgetbv" : "=a"(xcr0), "=d"(edx) : "c"(0));
+#endif
+        if ((xcr0 & 6) == 6)
+            flags |= CPU_FLAG_AVX;
+    }
+    return flags;
+}
+
+#else
+
+static unsigned int DetectCpuFlags(void)
+{
+    return 0;
+}
+
+#endif
+
+/* Returns the CPU_FLAG_* bits supported by the running cpu and os */
+unsigned int GetCpuFlags(void)
+{
+    /* racing threads all store the same value */
+    static volatile int flags = -1;
+
+    if (flags < 0)
+        flags = (int)DetectCpuFlags();
+    return (unsigned int)flags;
+}
+
+int ScratchInit(ScratchArena *scratch, size_t size)
+{
+    scratch->block = AllocMemory(size + SCRATCH_ALIGN - 1);
+    scratch->base = (unsigned char *)(((size_t)scratch->block + SCRATCH_ALIGN - 1)
+        & ~(size_t)(SCRATCH_ALIGN - 1));
+    scratch->size = scratch->block ? size : 0;
+    scratch->used = 0;
+
+    return scratch->block != NULL;
+}
+
+void ScratchEnd(ScratchArena *scratch)
+{
+    if (scratch->block) FreeMemory(scratch->block);
+    scratch->block = NULL;
+    scratch->base = NULL;
+    scratch->size = scratch->used = 0;
+}
+
+/* The arena is sized for the deepest call chain in faacEncEncode(),
+   running out is a bug */
+void *ScratchAlloc(ScratchArena *scratch, size_t size)
+{
+    unsigned char *p = scratch->base + scratch->used;
+
+    size = (size + SCRATCH_ALIGN - 1) & ~(size_t)(SCRATCH_ALIGN - 1);
+    assert(scratch->used + size <= scratch->size);
+    scratch->used += size;
+
+    return p;
+}
+
+#ifdef FAAC_ENCODER_STATS
+unsigned long faacAllocCount = 0;
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/* Monotonic clock in seconds, only used for the per-stage encoder timing */
+double GetTimer(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER freq, count;
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+#endif
@@ -40,17 +40,61 @@ extern "C" {
 #define M_PI        3.14159265358979323846
 #endif
 
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define FAAC_X86 1
+#endif
+
+/* gcc and clang only emit avx code in functions marked for it */
+#if defined(__GNUC__)
+#define FAAC_TARGET_AVX __attribute__((target("avx")))
+#else
+#define FAAC_TARGET_AVX
+#endif
+
+/* GetCpuFlags() bits */
+#define CPU_FLAG_SSE2   0x1
+#define CPU_FLAG_AVX    0x2
+
 /* Memory functions */
 #define AllocMemory(size) malloc(size)
 #define FreeMemory(block) free(block)
 #define SetMemory(block, value, size) memset(block, value, size)
 
+#ifdef FAAC_ENCODER_STATS
+/* every AllocMemory() is counted, so harnesses can check the steady state */
+extern unsigned long faacAllocCount;
+#undef AllocMemory
+#define AllocMemory(size) (faacAllocCount++, malloc(size))
+#endif
+
+/* Scratch memory for the per-frame temporaries of one encoder, allocated
+   once when the encoder is opened. Allocations are cache line aligned and
+   released in stack order by resetting to an earlier ScratchMark(). */
+#define SCRATCH_ALIGN 64
+
+typedef struct {
+    unsigned char *base;
+    void *block;
+    size_t size;
+    size_t used;
+} ScratchArena;
+
+#define ScratchMark(scratch) ((scratch)->used)
+#define ScratchRelease(scratch, mark) ((scratch)->used = (mark))
+
 int GetSRIndex(unsigned int sampleRate);
 int GetMaxPredSfb(int samplingRateIdx);
 unsigned int MaxBitrate(unsigned long sampleRate);
 unsigned int MinBitrate();
 unsigned int MaxBitresSize(unsigned long bitRate, unsigned long sampleRate);
 unsigned int BitAllocation(double pe, int short_block);
+unsigned int GetCpuFlags(void);
+int ScratchInit(ScratchArena *scratch, size_t size);
+void ScratchEnd(ScratchArena *scratch);
+void *ScratchAlloc(ScratchArena *scratch, size_t size);
+#ifdef FAAC_ENCODER_STATS
+double GetTimer(void);
+#endif
 
 #ifdef __cplusplus
 }
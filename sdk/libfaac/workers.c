@@ -0,0 +1,211 @@
+/*
+ * FAAC - Freeware Advanced Audio Coder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "workers.h"
+#include "util.h"
+
+#if defined(_WIN32) && !defined(__MINGW32__)
+#include <windows.h>
+
+typedef HANDLE worker_thread_t;
+typedef CRITICAL_SECTION worker_mutex_t;
+typedef CONDITION_VARIABLE worker_cond_t;
+
+#define MutexInit(m) InitializeCriticalSection(m)
+#define MutexDestroy(m) DeleteCriticalSection(m)
+#define MutexLock(m) EnterCriticalSection(m)
+#define MutexUnlock(m) LeaveCriticalSection(m)
+#define CondInit(c) InitializeConditionVariable(c)
+#define CondDestroy(c)
+#define CondWait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define CondBroadcast(c) WakeAllConditionVariable(c)
+#else
+#include <pthread.h>
+
+typedef pthread_t worker_thread_t;
+typedef pthread_mutex_t worker_mutex_t;
+typedef pthread_cond_t worker_cond_t;
+
+#define MutexInit(m) pthread_mutex_init(m, NULL)
+#define MutexDestroy(m) pthread_mutex_destroy(m)
+#define MutexLock(m) pthread_mutex_lock(m)
+#define MutexUnlock(m) pthread_mutex_unlock(m)
+#define CondInit(c) pthread_cond_init(c, NULL)
+#define CondDestroy(c) pthread_cond_destroy(c)
+#define CondWait(c, m) pthread_cond_wait(c, m)
+#define CondBroadcast(c) pthread_cond_broadcast(c)
+#endif
+
+struct WorkerPool {
+    int numThreads;
+    worker_thread_t *threads;
+
+    worker_mutex_t lock;
+    worker_cond_t start;    /* a new batch of jobs or shutdown */
+    worker_cond_t done;     /* the last job of a batch finished */
+
+    /* current batch, protected by lock */
+    WorkerJob job;
+    void *arg;
+    int count;
+    int next;
+    int finished;
+    unsigned int batch;
+    int quit;
+};
+
+/* Runs jobs of the current batch until none are left, called with the
+   lock held */
+static void RunJobs(WorkerPool *pool)
+{
+    while (pool->next < pool->count)
+    {
+        int index = pool->next++;
+
+        MutexUnlock(&pool->lock);
+        pool->job(pool->arg, index);
+        MutexLock(&pool->lock);
+
+        if (++pool->finished == pool->count)
+            CondBroadcast(&pool->done);
+    }
+}
+
+#if defined(_WIN32) && !defined(__MINGW32__)
+static DWORD WINAPI WorkerMain(LPVOID param)
+#else
+static void *WorkerMain(void *param)
+#endif
+{
+    WorkerPool *pool = (WorkerPool *)param;
+    unsigned int batch = 0;
+
+    MutexLock(&pool->lock);
+    for (;;)
+    {
+        while (!pool->quit && pool->batch == batch)
+            CondWait(&pool->start, &pool->lock);
+        if (pool->quit)
+            break;
+        batch = pool->batch;
+        RunJobs(pool);
+    }
+    MutexUnlock(&pool->lock);
+
+    return 0;
+}
+
+WorkerPool *WorkerPoolOpen(int numThreads)
+{
+    WorkerPool *pool;
+    int i;
+
+    if (numThreads < 2)
+        return NULL;
+
+    pool = (WorkerPool *)AllocMemory(sizeof(WorkerPool));
+    if (!pool)
+        return NULL;
+    SetMemory(pool, 0, sizeof(WorkerPool));
+    pool->threads = (worker_thread_t *)AllocMemory((numThreads - 1) * sizeof(worker_thread_t));
+    if (!pool->threads)
+    {
+        FreeMemory(pool);
+        return NULL;
+    }
+
+    MutexInit(&pool->lock);
+    CondInit(&pool->start);
+    CondInit(&pool->done);
+
+    for (i = 0; i < numThreads - 1; i++)
+    {
+#if defined(_WIN32) && !defined(__MINGW32__)
+        pool->threads[i] = CreateThread(NULL, 0, WorkerMain, pool, 0, NULL);
+        if (!pool->threads[i])
+            break;
+#else
+        if (pthread_create(&pool->threads[i], NULL, WorkerMain, pool) != 0)
+            break;
+#endif
+    }
+    pool->numThreads = i + 1;
+
+    if (pool->numThreads < 2)
+    {
+        WorkerPoolClose(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+void WorkerPoolClose(WorkerPool *pool)
+{
+    int i;
+
+    if (!pool)
+        return;
+
+    MutexLock(&pool->lock);
+    pool->quit = 1;
+    CondBroadcast(&pool->start);
+    MutexUnlock(&pool->lock);
+
+    for (i = 0; i < pool->numThreads - 1; i++)
+    {
+#if defined(_WIN32) && !defined(__MINGW32__)
+        WaitForSingleObject(pool->threads[i], INFINITE);
+        CloseHandle(pool->threads[i]);
+#else
+        pthread_join(pool->threads[i], NULL);
+#endif
+    }
+
+    CondDestroy(&pool->done);
+    CondDestroy(&pool->start);
+    MutexDestroy(&pool->lock);
+    FreeMemory(pool->threads);
+    FreeMemory(pool);
+}
+
+void WorkerPoolRun(WorkerPool *pool, WorkerJob job, void *arg, int count)
+{
+    int i;
+
+    if (!pool || count < 2)
+    {
+        for (i = 0; i < count; i++)
+            job(arg, i);
+        return;
+    }
+
+    MutexLock(&pool->lock);
+    pool->job = job;
+    pool->arg = arg;
+    pool->count = count;
+    pool->next = 0;
+    pool->finished = 0;
+    pool->batch++;
+    CondBroadcast(&pool->start);
+
+    RunJobs(pool);
+    while (pool->finished < pool->count)
+        CondWait(&pool->done, &pool->lock);
+    MutexUnlock(&pool->lock);
+}
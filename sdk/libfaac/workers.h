@@ -0,0 +1,46 @@
+/*
+ * FAAC - Freeware Advanced Audio Coder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* Fixed set of threads that run the independent jobs of one stage
+   (channels, channel elements) of faacEncEncode(). */
+typedef struct WorkerPool WorkerPool;
+
+typedef void (*WorkerJob)(void *arg, int index);
+
+/* Starts numThreads - 1 threads, the thread calling WorkerPoolRun() is
+   the last worker. Returns NULL if threads can't be created. */
+WorkerPool *WorkerPoolOpen(int numThreads);
+
+void WorkerPoolClose(WorkerPool *pool);
+
+/* Calls job(arg, i) for i in 0..count-1 and returns when all have
+   finished. Runs the jobs in order on the calling thread if pool is NULL. */
+void WorkerPoolRun(WorkerPool *pool, WorkerJob job, void *arg, int count);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* WORKERS_H */
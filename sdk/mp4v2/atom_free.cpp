@@ -38,8 +38,9 @@ void MP4FreeAtom::Write()
 	bool use64 = (GetSize() > (0xFFFFFFFF - 8)); 
 	BeginWrite(use64);
 #if 1
-	for (uint64_t ix = 0; ix < GetSize(); ix++) {
-	  m_pFile->WriteUInt8(0);
+	static u_int8_t zeros[4096];
+	for (uint64_t ix = 0; ix < GetSize(); ix += sizeof(zeros)) {
+	  m_pFile->WriteBytes(zeros, (u_int32_t)MIN(sizeof(zeros), GetSize() - ix));
 	}
 #else
 	m_pFile->SetPosition(m_pFile->GetPosition() + GetSize());
@@ -31,12 +31,14 @@ MP4RootAtom::MP4RootAtom()
 	ExpectChildAtom("skip", Optional, Many);
 	ExpectChildAtom("udta", Optional, Many);
 	ExpectChildAtom("moof", Optional, Many);
+	ExpectChildAtom("mfra", Optional, OnlyOne);
 }
 
 void MP4RootAtom::BeginWrite(bool use64) 
 {
 	// only call under MP4Create() control
 	WriteAtomType("ftyp", OnlyOne);
+	WriteAtomType("free", OnlyOne);	// fast start moov reservation
 
 	m_pChildAtoms[GetLastMdatIndex()]->BeginWrite(m_pFile->Use64Bits("mdat"));
 }
@@ -239,6 +239,15 @@ MP4StandardAtom::MP4StandardAtom (const char *type) : MP4Atom(type)
     AddProperty( /* 2 */
 		new MP4Integer32Property("sequenceNumber"));
 
+  } else if (ATOMID(type) == ATOMID("mfra")) {
+    ExpectChildAtom("tfra", Optional, Many);
+    ExpectChildAtom("mfro", Required, OnlyOne);
+
+  } else if (ATOMID(type) == ATOMID("mfro")) {
+    AddVersionAndFlags();	/* 0, 1 */
+    AddProperty( /* 2 */
+		new MP4Integer32Property("size"));
+
   } else if (ATOMID(type) == ATOMID("minf")) {
     ExpectChildAtom("vmhd", Optional, OnlyOne);
     ExpectChildAtom("smhd", Optional, OnlyOne);
@@ -392,6 +401,7 @@ MP4StandardAtom::MP4StandardAtom (const char *type) : MP4Atom(type)
 
   } else if (ATOMID(type) == ATOMID("traf")) {
     ExpectChildAtom("tfhd", Required, OnlyOne);
+    ExpectChildAtom("tfdt", Optional, OnlyOne);
     ExpectChildAtom("trun", Optional, Many);
 
   } else if (ATOMID(type) == ATOMID("trak")) {
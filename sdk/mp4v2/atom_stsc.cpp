@@ -53,6 +53,21 @@ void MP4StscAtom::Read()
 	// Read as usual
 	MP4Atom::Read();
 
+	if (!IsDeferred()) {
+		ComputeFirstSamples();
+	}
+}
+
+void MP4StscAtom::ReadDeferred() 
+{
+	if (IsDeferred()) {
+		MP4Atom::ReadDeferred();
+		ComputeFirstSamples();
+	}
+}
+
+void MP4StscAtom::ComputeFirstSamples() 
+{
 	// Compute the firstSample values for later use
 	u_int32_t count = 
 		((MP4Integer32Property*)m_pProperties[2])->GetValue();
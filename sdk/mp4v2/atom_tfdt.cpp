@@ -0,0 +1,63 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ * 
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ * 
+ * The Original Code is MPEG4IP.
+ * 
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2001.  All Rights Reserved.
+ * 
+ * Contributor(s): 
+ *		Dave Mackie		dmackie@cisco.com
+ */
+
+
+#include "mp4common.h"
+
+MP4TfdtAtom::MP4TfdtAtom() 
+	: MP4Atom("tfdt")
+{
+	AddVersionAndFlags();	/* 0, 1 */
+}
+
+void MP4TfdtAtom::AddProperties(u_int8_t version)
+{
+	if (version == 1) {
+		AddProperty( /* 2 */
+			new MP4Integer64Property("baseMediaDecodeTime"));
+	} else {
+		AddProperty( /* 2 */
+			new MP4Integer32Property("baseMediaDecodeTime"));
+	}
+}
+
+void MP4TfdtAtom::Generate()
+{
+	// decode times of long recordings don't fit 32 bits
+	SetVersion(1);
+	AddProperties(1);
+
+	MP4Atom::Generate();
+}
+
+void MP4TfdtAtom::Read()
+{
+	/* read atom version */
+	ReadProperties(0, 1);
+
+	/* need to create the properties based on the atom version */
+	AddProperties(GetVersion());
+
+	/* now we can read the remaining properties */
+	ReadProperties(1);
+
+	Skip();	// to end of atom
+}
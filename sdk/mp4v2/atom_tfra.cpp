@@ -0,0 +1,118 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ * 
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ * 
+ * The Original Code is MPEG4IP.
+ * 
+ * The Initial Developer of the Original Code is Cisco Systems Inc.
+ * Portions created by Cisco Systems Inc. are
+ * Copyright (C) Cisco Systems Inc. 2001.  All Rights Reserved.
+ * 
+ * Contributor(s): 
+ *		Dave Mackie		dmackie@cisco.com
+ */
+
+
+#include "mp4common.h"
+
+MP4TfraAtom::MP4TfraAtom() 
+	: MP4Atom("tfra")
+{
+	AddVersionAndFlags();	/* 0, 1 */
+	AddProperty( /* 2 */
+		new MP4Integer32Property("trackId"));
+	AddProperty( /* 3 */
+		new MP4Integer32Property("lengthSizes"));
+	AddProperty( /* 4 */
+		new MP4Integer32Property("numberOfEntry"));
+}
+
+// traf, trun and sample numbers are 1 to 4 bytes wide
+static MP4Property* NewNumberProperty(char* name, u_int32_t lengthSize)
+{
+	switch (lengthSize & 3) {
+	case 0:
+		return new MP4Integer8Property(name);
+	case 1:
+		return new MP4Integer16Property(name);
+	case 2:
+		return new MP4Integer24Property(name);
+	default:
+		return new MP4Integer32Property(name);
+	}
+}
+
+void MP4TfraAtom::AddProperties(u_int8_t version, u_int32_t lengthSizes)
+{
+	MP4TableProperty* pTable = 
+		new MP4TableProperty("entries", 
+			(MP4Integer32Property*)m_pProperties[4]);
+	AddProperty(pTable); /* 5 */
+
+	if (version == 1) {
+		pTable->AddProperty( /* 0 */
+			new MP4Integer64Property("time"));
+		pTable->AddProperty( /* 1 */
+			new MP4Integer64Property("moofOffset"));
+	} else {
+		pTable->AddProperty( /* 0 */
+			new MP4Integer32Property("time"));
+		pTable->AddProperty( /* 1 */
+			new MP4Integer32Property("moofOffset"));
+	}
+	pTable->AddProperty( /* 2 */
+		NewNumberProperty("trafNumber", lengthSizes >> 4));
+	pTable->AddProperty( /* 3 */
+		NewNumberProperty("trunNumber", lengthSizes >> 2));
+	pTable->AddProperty( /* 4 */
+		NewNumberProperty("sampleNumber", lengthSizes));
+}
+
+void MP4TfraAtom::Generate()
+{
+	// 64 bit times and offsets, 32 bit numbers
+	SetVersion(1);
+	((MP4Integer32Property*)m_pProperties[3])->SetValue(0x3F);
+	AddProperties(1, 0x3F);
+
+	MP4Atom::Generate();
+}
+
+void MP4TfraAtom::Read()
+{
+	/* read atom version, flags, trackId, lengthSizes and numberOfEntry */
+	ReadProperties(0, 5);
+
+	/* need to create the properties based on the version and sizes */
+	AddProperties(GetVersion(),
+		((MP4Integer32Property*)m_pProperties[3])->GetValue());
+
+	/* now we can read the remaining properties */
+	ReadProperties(5);
+
+	Skip();	// to end of atom
+}
+
+void MP4TfraAtom::AddEntry(MP4Timestamp time, u_int64_t moofOffset,
+	u_int32_t trafNumber, u_int32_t trunNumber, u_int32_t sampleNumber)
+{
+	// only entries of a generated (version 1, 32 bit numbers) tfra
+	ASSERT(GetVersion() == 1);
+
+	MP4TableProperty* pTable = (MP4TableProperty*)m_pProperties[5];
+
+	((MP4Integer64Property*)pTable->GetProperty(0))->AddValue(time);
+	((MP4Integer64Property*)pTable->GetProperty(1))->AddValue(moofOffset);
+	((MP4Integer32Property*)pTable->GetProperty(2))->AddValue(trafNumber);
+	((MP4Integer32Property*)pTable->GetProperty(3))->AddValue(trunNumber);
+	((MP4Integer32Property*)pTable->GetProperty(4))->AddValue(sampleNumber);
+
+	((MP4Integer32Property*)m_pProperties[4])->IncrementValue();
+}
@@ -324,6 +324,9 @@ class MP4StscAtom : public MP4Atom {
 public:
 	MP4StscAtom();
 	void Read();
+	void ReadDeferred();
+protected:
+	void ComputeFirstSamples();
 };
 
 class MP4StsdAtom : public MP4Atom {
@@ -358,14 +361,33 @@ protected:
 	void GenerateGmhdType();
 };
 
+class MP4TfdtAtom : public MP4Atom {
+public:
+	MP4TfdtAtom();
+	void Generate();
+	void Read();
+protected:
+	void AddProperties(u_int8_t version);
+};
+
 class MP4TfhdAtom : public MP4Atom {
 public:
 	MP4TfhdAtom();
 	void Read();
-protected:
 	void AddProperties(u_int32_t flags);
 };
 
+class MP4TfraAtom : public MP4Atom {
+public:
+	MP4TfraAtom();
+	void Generate();
+	void Read();
+	void AddEntry(MP4Timestamp time, u_int64_t moofOffset,
+		u_int32_t trafNumber, u_int32_t trunNumber, u_int32_t sampleNumber);
+protected:
+	void AddProperties(u_int8_t version, u_int32_t lengthSizes);
+};
+
 class MP4TkhdAtom : public MP4Atom {
 public:
 	MP4TkhdAtom();
@@ -378,7 +400,6 @@ class MP4TrunAtom : public MP4Atom {
 public:
 	MP4TrunAtom();
 	void Read();
-protected:
 	void AddProperties(u_int32_t flags);
 };
 
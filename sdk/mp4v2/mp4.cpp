@@ -78,6 +78,28 @@ extern "C" MP4FileHandle MP4Read(const char* fileName, u_int32_t verbosity)
 	}
 }
 
+extern "C" MP4FileHandle MP4ReadMapped(const char* fileName, u_int32_t verbosity)
+{
+	return MP4ReadWithFlags(fileName, verbosity, MP4_READ_MAPPED);
+}
+
+extern "C" MP4FileHandle MP4ReadWithFlags(const char* fileName, 
+	u_int32_t verbosity, u_int32_t flags)
+{
+	MP4File* pFile = NULL;
+	try {
+		pFile = new MP4File(verbosity);
+		pFile->Read(fileName, flags);
+		return (MP4FileHandle)pFile;
+	}
+	catch (MP4Error* e) {
+		VERBOSE_ERROR(verbosity, e->Print());
+		delete e;
+		delete pFile;
+		return MP4_INVALID_FILE_HANDLE;
+	}
+}
+
 extern "C" MP4FileHandle MP4Create (const char* fileName,
 				    u_int32_t verbosity, 
 				    u_int32_t  flags)
@@ -112,6 +134,50 @@ extern "C" MP4FileHandle MP4CreateEx (const char* fileName,
 	}
 }
 
+extern "C" MP4FileHandle MP4CreateFastStart (const char* fileName,
+					     u_int32_t moovReserveSize,
+					     u_int32_t verbosity, 
+					     u_int32_t flags)
+{
+	MP4File* pFile = NULL;
+	try {
+		pFile = new MP4File(verbosity);
+		pFile->Create(fileName, flags, 1, 1, NULL, 0, NULL, 0,
+			      moovReserveSize);
+		return (MP4FileHandle)pFile;
+	}
+	catch (MP4Error* e) {
+		VERBOSE_ERROR(verbosity, e->Print());
+		delete e;
+		delete pFile;
+		return MP4_INVALID_FILE_HANDLE;
+	}
+}
+
+extern "C" MP4FileHandle MP4CreateFragmented (const char* fileName,
+					      u_int32_t fragmentMsecs,
+					      u_int32_t verbosity, 
+					      u_int32_t flags)
+{
+	MP4File* pFile = NULL;
+	try {
+		if (fragmentMsecs == 0) {
+			throw new MP4Error("fragment duration can't be 0", 
+				"MP4CreateFragmented");
+		}
+		pFile = new MP4File(verbosity);
+		pFile->Create(fileName, flags, 1, 1, NULL, 0, NULL, 0,
+			      0, fragmentMsecs);
+		return (MP4FileHandle)pFile;
+	}
+	catch (MP4Error* e) {
+		VERBOSE_ERROR(verbosity, e->Print());
+		delete e;
+		delete pFile;
+		return MP4_INVALID_FILE_HANDLE;
+	}
+}
+
 extern "C" MP4FileHandle MP4Modify(const char* fileName, 
 	u_int32_t verbosity, u_int32_t flags)
 {
@@ -2330,6 +2396,115 @@ extern "C" bool MP4ReadSample(
 	return false;
 }
 
+extern "C" bool MP4ReadSamplePtr(
+	/* input parameters */
+	MP4FileHandle hFile,
+	MP4TrackId trackId, 
+	MP4SampleId sampleId,
+	/* output parameters */
+	const u_int8_t** ppBytes, 
+	u_int32_t* pNumBytes, 
+	MP4Timestamp* pStartTime, 
+	MP4Duration* pDuration,
+	MP4Duration* pRenderingOffset, 
+	bool* pIsSyncSample)
+{
+	if (MP4_IS_VALID_FILE_HANDLE(hFile)) {
+		try {
+			((MP4File*)hFile)->ReadSamplePtr(
+				trackId, 
+				sampleId, 
+				ppBytes, 
+				pNumBytes, 
+				pStartTime, 
+				pDuration, 
+				pRenderingOffset, 
+				pIsSyncSample);
+			return true;
+		}
+		catch (MP4Error* e) {
+			PRINT_ERROR(e);
+			delete e;
+		}
+	}
+	*ppBytes = NULL;
+	*pNumBytes = 0;
+	return false;
+}
+
+extern "C" MP4SampleCursorHandle MP4OpenSampleCursor(
+	MP4FileHandle hFile,
+	MP4TrackId trackId)
+{
+	if (MP4_IS_VALID_FILE_HANDLE(hFile)) {
+		try {
+			return (MP4SampleCursorHandle)
+				((MP4File*)hFile)->OpenSampleCursor(trackId);
+		}
+		catch (MP4Error* e) {
+			PRINT_ERROR(e);
+			delete e;
+		}
+	}
+	return MP4_INVALID_SAMPLE_CURSOR_HANDLE;
+}
+
+extern "C" MP4SampleId MP4NextSample(
+	/* input parameters */
+	MP4SampleCursorHandle hCursor,
+	/* output parameters */
+	const u_int8_t** ppBytes, 
+	u_int32_t* pNumBytes, 
+	MP4Timestamp* pStartTime, 
+	MP4Duration* pDuration,
+	MP4Duration* pRenderingOffset, 
+	bool* pIsSyncSample)
+{
+	if (hCursor != MP4_INVALID_SAMPLE_CURSOR_HANDLE) {
+		MP4SampleCursor* pCursor = (MP4SampleCursor*)hCursor;
+		try {
+			return pCursor->Next(
+				ppBytes, 
+				pNumBytes, 
+				pStartTime, 
+				pDuration, 
+				pRenderingOffset, 
+				pIsSyncSample);
+		}
+		catch (MP4Error* e) {
+			VERBOSE_ERROR(pCursor->GetFile()->GetVerbosity(), e->Print());
+			delete e;
+		}
+	}
+	*ppBytes = NULL;
+	*pNumBytes = 0;
+	return MP4_INVALID_SAMPLE_ID;
+}
+
+extern "C" bool MP4SeekSampleCursor(
+	MP4SampleCursorHandle hCursor,
+	MP4SampleId sampleId)
+{
+	if (hCursor != MP4_INVALID_SAMPLE_CURSOR_HANDLE) {
+		MP4SampleCursor* pCursor = (MP4SampleCursor*)hCursor;
+		try {
+			pCursor->Seek(sampleId);
+			return true;
+		}
+		catch (MP4Error* e) {
+			VERBOSE_ERROR(pCursor->GetFile()->GetVerbosity(), e->Print());
+			delete e;
+		}
+	}
+	return false;
+}
+
+extern "C" void MP4CloseSampleCursor(
+	MP4SampleCursorHandle hCursor)
+{
+	delete (MP4SampleCursor*)hCursor;
+}
+
 extern "C" bool MP4ReadSampleFromTime(
 	/* input parameters */
 	MP4FileHandle hFile,
@@ -2398,6 +2573,79 @@ extern "C" bool MP4WriteSample(
 	return false;
 }
 
+extern "C" bool MP4WriteSampleV(
+	MP4FileHandle hFile,
+	MP4TrackId trackId,
+	const struct iovec* pIov,
+	u_int32_t iovCount,
+	MP4Duration duration,
+	MP4Duration renderingOffset, 
+	bool isSyncSample)
+{
+	if (MP4_IS_VALID_FILE_HANDLE(hFile)) {
+		try {
+			((MP4File*)hFile)->WriteSampleV(
+				trackId, 
+				pIov, 
+				iovCount, 
+				duration, 
+				renderingOffset, 
+				isSyncSample);
+			return true;
+		}
+		catch (MP4Error* e) {
+			PRINT_ERROR(e);
+			delete e;
+		}
+	}
+	return false;
+}
+
+extern "C" u_int8_t* MP4BeginWriteSample(
+	MP4FileHandle hFile,
+	MP4TrackId trackId,
+	u_int32_t maxBytes)
+{
+	if (MP4_IS_VALID_FILE_HANDLE(hFile)) {
+		try {
+			return ((MP4File*)hFile)->BeginWriteSample(
+				trackId, 
+				maxBytes);
+		}
+		catch (MP4Error* e) {
+			PRINT_ERROR(e);
+			delete e;
+		}
+	}
+	return NULL;
+}
+
+extern "C" bool MP4EndWriteSample(
+	MP4FileHandle hFile,
+	MP4TrackId trackId,
+	u_int32_t numBytes,
+	MP4Duration duration,
+	MP4Duration renderingOffset, 
+	bool isSyncSample)
+{
+	if (MP4_IS_VALID_FILE_HANDLE(hFile)) {
+		try {
+			((MP4File*)hFile)->EndWriteSample(
+				trackId, 
+				numBytes, 
+				duration, 
+				renderingOffset, 
+				isSyncSample);
+			return true;
+		}
+		catch (MP4Error* e) {
+			PRINT_ERROR(e);
+			delete e;
+		}
+	}
+	return false;
+}
+
 extern "C" bool MP4CopySample(
 	MP4FileHandle srcFile,
 	MP4TrackId srcTrackId, 
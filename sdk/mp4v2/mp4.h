@@ -54,6 +54,7 @@ typedef u_int32_t	MP4SampleId;
 typedef u_int64_t	MP4Timestamp;
 typedef u_int64_t	MP4Duration;
 typedef u_int32_t	MP4EditId;
+typedef void*		MP4SampleCursorHandle;
 
 typedef u_int64_t (*VIRTUALIO_GETFILELENGTH)(void *user); // return file length in bytes
 typedef int (*VIRTUALIO_SETPOSITION)(void *user, u_int64_t position); // return 0 on success
@@ -82,6 +83,7 @@ typedef struct Virtual_IO
 #define MP4_INVALID_TIMESTAMP	((MP4Timestamp)-1)
 #define MP4_INVALID_DURATION	((MP4Duration)-1)
 #define MP4_INVALID_EDIT_ID		((MP4EditId)0)
+#define MP4_INVALID_SAMPLE_CURSOR_HANDLE	((MP4SampleCursorHandle)NULL)
 
 /* Macros to test for API type validity */
 #define MP4_IS_VALID_FILE_HANDLE(x)	((x) != MP4_INVALID_FILE_HANDLE) 
@@ -331,6 +333,32 @@ MP4FileHandle MP4CreateEx(
 	char** supportedBrands DEFAULT(0),
 	u_int32_t supportedBrandsCount DEFAULT(0));
 
+/* 
+ * like MP4Create, but reserves moovReserveSize bytes ahead of mdat and
+ * writes moov there on MP4Close, so the file is ready for progressive
+ * playback without MP4Optimize. If moov outgrows the reservation the
+ * mdat is shifted in place.
+ */
+MP4FileHandle MP4CreateFastStart(
+	const char* fileName, 
+	u_int32_t moovReserveSize,
+	u_int32_t verbosity DEFAULT(0),
+	u_int32_t flags DEFAULT(0));
+
+/*
+ * like MP4Create, but writes a fragmented file: moov with mvex goes out
+ * with the first sample, then a moof/mdat pair about every fragmentMsecs
+ * (cut at sync samples of the first video track), and an mfra index on
+ * MP4Close. The sample tables don't grow, and a file that isn't closed
+ * stays playable up to its last complete fragment. Tracks must be set up
+ * before the first sample is written.
+ */
+MP4FileHandle MP4CreateFragmented(
+	const char* fileName, 
+	u_int32_t fragmentMsecs,
+	u_int32_t verbosity DEFAULT(0),
+	u_int32_t flags DEFAULT(0));
+
 MP4FileHandle MP4Modify(
 	const char* fileName, 
 	u_int32_t verbosity DEFAULT(0),
@@ -345,6 +373,30 @@ MP4FileHandle MP4ReadEx(const char* fileName,
 			void *user, 
 			Virtual_IO_t *virtual_IO,
 			u_int32_t verbosity DEFAULT(0));
+
+/*
+ * like MP4Read, but maps the whole file read only into memory. Atoms are
+ * parsed straight out of the mapping and MP4ReadSamplePtr hands out the
+ * samples without copying them.
+ */
+MP4FileHandle MP4ReadMapped(
+	const char* fileName, 
+	u_int32_t verbosity DEFAULT(0));
+
+/*
+ * MP4_READ_MAPPED maps the file like MP4ReadMapped. MP4_READ_LAZY_TABLES
+ * skips the entries of the sample tables (stsz, stco, stts, ...) while
+ * the file is opened and reads each table the first time a track needs
+ * it, so reading only the file and track metadata stays cheap for files
+ * with millions of samples.
+ */
+#define MP4_READ_MAPPED (0x01)
+#define MP4_READ_LAZY_TABLES (0x02)
+
+MP4FileHandle MP4ReadWithFlags(
+	const char* fileName, 
+	u_int32_t verbosity DEFAULT(0),
+	u_int32_t flags DEFAULT(0));
  
 void MP4Close(
 	MP4FileHandle hFile);
@@ -828,6 +880,58 @@ bool MP4ReadSample(
 	MP4Duration* pRenderingOffset DEFAULT(NULL), 
 	bool* pIsSyncSample DEFAULT(NULL));
 
+/*
+ * like MP4ReadSample, but *ppBytes points into the mapping of a file
+ * opened with MP4ReadMapped or MP4_READ_MAPPED, valid until MP4Close.
+ * Fails for other files and for samples kept in external data references.
+ */
+bool MP4ReadSamplePtr(
+	/* input parameters */
+	MP4FileHandle hFile,
+	MP4TrackId trackId, 
+	MP4SampleId sampleId,
+	/* output parameters */
+	const u_int8_t** ppBytes, 
+	u_int32_t* pNumBytes, 
+	MP4Timestamp* pStartTime DEFAULT(NULL), 
+	MP4Duration* pDuration DEFAULT(NULL),
+	MP4Duration* pRenderingOffset DEFAULT(NULL), 
+	bool* pIsSyncSample DEFAULT(NULL));
+
+/*
+ * sample cursors read the samples of a track in order with O(1) work per
+ * sample, reading the bytes of each chunk at once. MP4NextSample returns
+ * the id of the sample it read, or MP4_INVALID_SAMPLE_ID at the end of
+ * the track or on error. *ppBytes points into the cursor (or into the
+ * mapping of a file opened with MP4_READ_MAPPED) and stays valid until
+ * the next MP4NextSample or MP4SeekSampleCursor. After an error or a
+ * change to samples the cursor has passed, e.g. with
+ * MP4SetSampleRenderingOffset, seek before reading on. Cursors have to
+ * be closed before their file.
+ */
+MP4SampleCursorHandle MP4OpenSampleCursor(
+	MP4FileHandle hFile,
+	MP4TrackId trackId);
+
+MP4SampleId MP4NextSample(
+	/* input parameters */
+	MP4SampleCursorHandle hCursor,
+	/* output parameters */
+	const u_int8_t** ppBytes, 
+	u_int32_t* pNumBytes, 
+	MP4Timestamp* pStartTime DEFAULT(NULL), 
+	MP4Duration* pDuration DEFAULT(NULL),
+	MP4Duration* pRenderingOffset DEFAULT(NULL), 
+	bool* pIsSyncSample DEFAULT(NULL));
+
+/* makes sampleId the next sample read */
+bool MP4SeekSampleCursor(
+	MP4SampleCursorHandle hCursor,
+	MP4SampleId sampleId);
+
+void MP4CloseSampleCursor(
+	MP4SampleCursorHandle hCursor);
+
 /* uses (unedited) time to specify sample instead of sample id */
 bool MP4ReadSampleFromTime(
 	/* input parameters */
@@ -852,6 +956,35 @@ bool MP4WriteSample(
 	MP4Duration renderingOffset DEFAULT(0), 
 	bool isSyncSample DEFAULT(true));
 
+/* writes the concatenation of iovCount buffers as a single sample */
+bool MP4WriteSampleV(
+	MP4FileHandle hFile,
+	MP4TrackId trackId,
+	const struct iovec* pIov,
+	u_int32_t iovCount,
+	MP4Duration duration DEFAULT(MP4_INVALID_DURATION),
+	MP4Duration renderingOffset DEFAULT(0), 
+	bool isSyncSample DEFAULT(true));
+
+/* 
+ * write a sample in place: MP4BeginWriteSample returns room for up to
+ * maxBytes inside the track's chunk buffer (NULL on error), fill it and
+ * commit the used size with MP4EndWriteSample. The pointer is only valid
+ * until the next write call on the file.
+ */
+u_int8_t* MP4BeginWriteSample(
+	MP4FileHandle hFile,
+	MP4TrackId trackId,
+	u_int32_t maxBytes);
+
+bool MP4EndWriteSample(
+	MP4FileHandle hFile,
+	MP4TrackId trackId,
+	u_int32_t numBytes,
+	MP4Duration duration DEFAULT(MP4_INVALID_DURATION),
+	MP4Duration renderingOffset DEFAULT(0), 
+	bool isSyncSample DEFAULT(true));
+
 bool MP4CopySample(
 	MP4FileHandle srcFile,
 	MP4TrackId srcTrackId, 
@@ -52,6 +52,9 @@ MP4Atom::MP4Atom(const char* type)
 	m_size = 0;
 	m_pParentAtom = NULL;
 	m_depth = 0xFF;
+	m_deferred = false;
+	m_deferredIndex = 0;
+	m_deferredPosition = 0;
 }
 
 MP4Atom::~MP4Atom()
@@ -227,8 +230,12 @@ MP4Atom* MP4Atom::CreateAtom(const char* type)
 	pAtom = new MP4TextAtom();
       } else if (ATOMID(type) == ATOMID("tkhd")) {
 	pAtom = new MP4TkhdAtom();
+      } else if (ATOMID(type) == ATOMID("tfdt")) {
+	pAtom = new MP4TfdtAtom();
       } else if (ATOMID(type) == ATOMID("tfhd")) {
 	pAtom = new MP4TfhdAtom();
+      } else if (ATOMID(type) == ATOMID("tfra")) {
+	pAtom = new MP4TfraAtom();
       } else if (ATOMID(type) == ATOMID("trun")) {
 	pAtom = new MP4TrunAtom();
       } else if (ATOMID(type) == ATOMID("twos")) {
@@ -446,6 +453,23 @@ void MP4Atom::Read()
 	Skip();	// to end of atom
 }
 
+void MP4Atom::ReadDeferred()
+{
+	if (!m_deferred) {
+		return;
+	}
+
+	VERBOSE_READ(GetVerbosity(),
+		printf("ReadDeferred: %s table at 0x"X64"\n", 
+			m_type, m_deferredPosition));
+
+	u_int64_t position = m_pFile->GetPosition();
+	m_deferred = false;
+	m_pFile->SetPosition(m_deferredPosition);
+	ReadProperties(m_deferredIndex);
+	m_pFile->SetPosition(position);
+}
+
 void MP4Atom::Skip()
 {
 	if (m_pFile->GetPosition() != m_end) {
@@ -582,6 +606,20 @@ void MP4Atom::ReadProperties(u_int32_t startIndex, u_int32_t count)
 	// read any properties of the atom
 	for (u_int32_t i = startIndex; i < startIndex + numProperties; i++) {
 
+		// leave the entries of a sample table in the file, the
+		// atom is skipped to its end right after its last property
+		if (m_pFile->IsDeferringTables()
+		  && m_pProperties[i]->GetType() == TableProperty
+		  && !m_pProperties[i]->IsImplicit()
+		  && i == m_pProperties.Size() - 1
+		  && m_pChildAtomInfos.Size() == 0
+		  && m_pParentAtom && ATOMID(m_pParentAtom->GetType()) == ATOMID("stbl")) {
+			m_deferred = true;
+			m_deferredIndex = i;
+			m_deferredPosition = m_pFile->GetPosition();
+			return;
+		}
+
 		m_pProperties[i]->Read(m_pFile);
 
 		if (m_pFile->GetPosition() > m_end) {
@@ -872,6 +910,9 @@ void MP4Atom::Dump(FILE* pFile, u_int8_t indent, bool dumpImplicits)
 			fprintf(pFile, "<table entries suppressed>\n");
 			continue;
 		}
+		if (m_deferred && i >= m_deferredIndex) {
+			ReadDeferred();
+		}
 
 		m_pProperties[i]->Dump(pFile, indent + 1, dumpImplicits);
 	}
@@ -193,6 +193,11 @@ public:
 
 	virtual void Generate();
 	virtual void Read();
+	// reads the table left in the file by MP4_READ_LAZY_TABLES
+	virtual void ReadDeferred();
+	bool IsDeferred() {
+		return m_deferred;
+	}
 	virtual void BeginWrite(bool use64 = false);
 	virtual void Write();
 	virtual void Rewrite();
@@ -242,6 +247,10 @@ protected:
 	MP4Atom*	m_pParentAtom;
 	u_int8_t	m_depth;
 
+	bool		m_deferred;			// m_pProperties from m_deferredIndex on
+	u_int32_t	m_deferredIndex;	// are still to be read, they start at
+	u_int64_t	m_deferredPosition;	// m_deferredPosition
+
 	MP4PropertyArray	m_pProperties;
 	MP4AtomInfoArray 	m_pChildAtomInfos;
 	MP4AtomArray		m_pChildAtoms;
@@ -31,7 +31,9 @@
 #include "mp4.h"
 #include "mp4util.h"
 #include "mp4array.h"
+#include "mp4sampleindex.h"
 #include "mp4track.h"
+#include "mp4samplecursor.h"
 #include "mp4file.h"
 #include "mp4property.h"
 #include "mp4container.h"
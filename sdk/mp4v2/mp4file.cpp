@@ -38,6 +38,8 @@ MP4File::MP4File(u_int32_t verbosity)
 	#endif
 	m_pFile = NULL;
 	m_virtual_IO = NULL;
+	m_pMappedFile = NULL;
+	m_deferTables = false;
 	m_orgFileSize = 0;
 	m_fileSize = 0;
 	m_pRootAtom = NULL;
@@ -47,6 +49,12 @@ MP4File::MP4File(u_int32_t verbosity)
 	m_mode = 0;
 	m_createFlags = 0;
 	m_useIsma = false;
+	m_pMoovReserveAtom = NULL;
+	m_fragmentMsecs = 0;
+	m_fragmentMoovWritten = false;
+	m_pFragmentLeadTrack = NULL;
+	m_fragmentSequence = 0;
+	m_pMfraAtom = NULL;
 
 	m_pModificationProperty = NULL;
 	m_pTimeScaleProperty = NULL;
@@ -77,8 +85,10 @@ MP4File::~MP4File()
 	  // not closed ?
 	  m_virtual_IO->Close(m_pFile);
 	  m_pFile = NULL;
+	  m_pMappedFile = NULL;
 	}
 	delete m_pRootAtom;
+	delete m_pMfraAtom;
 	for (u_int32_t i = 0; i < m_pTracks.Size(); i++) {
 		delete m_pTracks[i];
 	}
@@ -87,14 +97,28 @@ MP4File::~MP4File()
 	
 }
 
-void MP4File::Read(const char* fileName)
+void MP4File::Read(const char* fileName, u_int32_t flags)
 {
 	m_fileName = MP4Stralloc(fileName);
 	m_mode = 'r';
 
-	Open("rb");
+	if (flags & MP4_READ_MAPPED) {
+		m_pMappedFile = MP4MapFile(fileName);
+		if (m_pMappedFile == NULL) {
+			throw new MP4Error(errno, "failed", "MP4File::Read");
+		}
+		m_pFile = m_pMappedFile;
+		m_virtual_IO = &MMAP_virtual_IO;
+		m_orgFileSize = m_fileSize = m_pMappedFile->size;
+	} else {
+		Open("rb");
+	}
 
+	// the tables of the sample table atoms are left in the file
+	// until a track first needs them
+	m_deferTables = (flags & MP4_READ_LAZY_TABLES) != 0;
 	ReadFromFile();
+	m_deferTables = false;
 
 	CacheProperties();
 }
@@ -126,17 +150,21 @@ void MP4File::ReadEx(const char *fileName, void *user, Virtual_IO *virtual_IO)
 	ASSERT(m_virtual_IO)
 	
 	m_orgFileSize = m_fileSize = m_virtual_IO->GetFileLength(m_pFile); 
+	if (m_virtual_IO == &MMAP_virtual_IO) {
+		m_pMappedFile = (MP4MappedFile*)m_pFile;
+	}
 
 	ReadFromFile();
 
 	CacheProperties();
 }
 
-
 void MP4File::Create(const char* fileName, u_int32_t flags, 
 		     int add_ftyp, int add_iods, 
 		     char* majorBrand, u_int32_t minorVersion, 
-		     char** supportedBrands, u_int32_t supportedBrandsCount)
+		     char** supportedBrands, u_int32_t supportedBrandsCount,
+		     u_int32_t moovReserveSize,
+		     u_int32_t fragmentMsecs)
 {
 	m_fileName = MP4Stralloc(fileName);
 	m_mode = 'w';
@@ -156,12 +184,25 @@ void MP4File::Create(const char* fileName, u_int32_t flags,
 
 	CacheProperties();
 
-	// create mdat, and insert it after ftyp, and before moov
-	(void)InsertChildAtom(m_pRootAtom, "mdat", 
-			      add_ftyp != 0 ? 1 : 0);
+	if (fragmentMsecs) {
+		// ftyp and moov are written with the first sample,
+		// each fragment brings its own mdat
+		m_fragmentMsecs = fragmentMsecs;
+	} else {
+		// create mdat, and insert it after ftyp, and before moov
+		(void)InsertChildAtom(m_pRootAtom, "mdat", 
+				      add_ftyp != 0 ? 1 : 0);
+
+		// for fast start, reserve space for moov between ftyp and mdat
+		if (moovReserveSize >= 8) {
+			m_pMoovReserveAtom = InsertChildAtom(m_pRootAtom, "free", 
+				add_ftyp != 0 ? 1 : 0);
+			m_pMoovReserveAtom->SetSize(moovReserveSize - 8);
+		}
 
-	// start writing
-	m_pRootAtom->BeginWrite();
+		// start writing
+		m_pRootAtom->BeginWrite();
+	}
 	if (add_iods != 0) {
 	  (void)AddChildAtom("moov", "iods");
 	}
@@ -621,12 +662,21 @@ void MP4File::BeginWrite()
 
 void MP4File::FinishWrite()
 {
+	if (IsFragmented()) {
+		FinishFragmentedWrite();
+		return;
+	}
+
 	// for all tracks, flush chunking buffers
 	for (u_int32_t i = 0; i < m_pTracks.Size(); i++) {
 		ASSERT(m_pTracks[i]);
 		m_pTracks[i]->FinishWrite();
 	}
 	// ask root atom to write
+	if (m_pMoovReserveAtom) {
+		FinishFastStartWrite();
+		return;
+	}
 	m_pRootAtom->FinishWrite();
 
 	// check if file shrunk, e.g. we deleted a track
@@ -644,6 +694,262 @@ void MP4File::FinishWrite()
 	}
 }
 
+void MP4File::FinishFastStartWrite()
+{
+	// finish writing the mdat
+	u_int32_t numAtoms = m_pRootAtom->GetNumberOfChildAtoms();
+	u_int32_t mdatIndex;
+	for (mdatIndex = numAtoms - 1; mdatIndex > 0; mdatIndex--) {
+		if (!strcmp("mdat", m_pRootAtom->GetChildAtom(mdatIndex)->GetType())) {
+			break;
+		}
+	}
+	MP4Atom* pMdatAtom = m_pRootAtom->GetChildAtom(mdatIndex);
+	pMdatAtom->FinishWrite(Use64Bits("mdat"));
+
+	u_int64_t reserveStart = m_pMoovReserveAtom->GetStart();
+	u_int64_t reserveSize = m_pMoovReserveAtom->GetEnd() - reserveStart;
+	u_int64_t mdatEnd = GetPosition();
+
+	// render everything that follows the mdat (moov, udta) to memory
+	u_int8_t* pMoov = NULL;
+	u_int64_t moovSize = 0;
+
+	EnableMemoryBuffer();
+	for (u_int32_t i = mdatIndex + 1; i < numAtoms; i++) {
+		m_pRootAtom->GetChildAtom(i)->Write();
+	}
+	DisableMemoryBuffer(&pMoov, &moovSize);
+
+	// what's left of the reservation needs to hold a free atom header
+	bool fits = moovSize == reserveSize || moovSize + 8 <= reserveSize;
+
+	if (!fits) {
+		u_int64_t delta = moovSize > reserveSize ? 
+			moovSize - reserveSize : moovSize + 8 - reserveSize;
+
+		bool canShift = true;
+		for (u_int32_t i = 0; i < m_pTracks.Size(); i++) {
+			canShift &= m_pTracks[i]->CanShiftChunkOffsets(delta);
+		}
+
+		if (!canShift) {
+			// 32 bit chunk offsets would overflow, keep moov at the end
+			VERBOSE_WRITE(GetVerbosity(),
+				printf("FastStart: moov "U64" bytes doesn't fit "U64", written at end\n",
+					moovSize, reserveSize));
+			WriteBytes(pMoov, (u_int32_t)moovSize);
+			MP4Free(pMoov);
+			return;
+		}
+
+		VERBOSE_WRITE(GetVerbosity(),
+			printf("FastStart: moov "U64" bytes doesn't fit "U64", shifting mdat\n",
+				moovSize, reserveSize));
+
+		// make room in place and render moov again with the new offsets,
+		// its size doesn't change as offsets keep their width
+		ShiftMdat(reserveStart + reserveSize, mdatEnd, delta);
+		for (u_int32_t i = 0; i < m_pTracks.Size(); i++) {
+			m_pTracks[i]->ShiftChunkOffsets(delta);
+		}
+		reserveSize += delta;
+		mdatEnd += delta;
+
+		MP4Free(pMoov);
+		EnableMemoryBuffer(NULL, moovSize);
+		for (u_int32_t i = mdatIndex + 1; i < numAtoms; i++) {
+			m_pRootAtom->GetChildAtom(i)->Write();
+		}
+		DisableMemoryBuffer(&pMoov, &moovSize);
+	}
+
+	// write moov into the reservation, then mark the rest as free
+	SetPosition(reserveStart);
+	WriteBytes(pMoov, (u_int32_t)moovSize);
+	MP4Free(pMoov);
+
+	if (reserveSize > moovSize) {
+		WriteUInt32((u_int32_t)(reserveSize - moovSize));
+		WriteBytes((u_int8_t*)"free", 4);
+	}
+
+	SetPosition(mdatEnd);
+}
+
+void MP4File::CheckFragment(MP4Track* pTrack, bool isSyncSample)
+{
+	if (!m_fragmentMoovWritten) {
+		BeginFragmentedWrite();
+		return;
+	}
+
+	// cut once the lead track has collected enough at one of its
+	// sync samples, so every fragment is decodable on its own
+	if (pTrack != m_pFragmentLeadTrack || !isSyncSample
+	  || pTrack->GetFragmentSamples() == 0) {
+		return;
+	}
+
+	MP4Duration fragmentDuration = 
+		((u_int64_t)m_fragmentMsecs * pTrack->GetTimeScale()) / 1000;
+
+	if (pTrack->GetFragmentDuration() >= fragmentDuration) {
+		WriteFragment();
+	}
+}
+
+void MP4File::BeginFragmentedWrite()
+{
+	// mvex announces the fragments, mfra collects their index
+	MP4Atom* pMvexAtom = AddChildAtom("moov", "mvex");
+
+	m_pMfraAtom = MP4Atom::CreateAtom("mfra");
+	m_pMfraAtom->SetFile(this);
+	m_pMfraAtom->Generate();
+
+	for (u_int32_t i = 0; i < m_pTracks.Size(); i++) {
+		m_pTracks[i]->BeginFragmentedWrite(pMvexAtom, m_pMfraAtom);
+
+		if (m_pFragmentLeadTrack == NULL 
+		  && !strcmp(m_pTracks[i]->GetType(), MP4_VIDEO_TRACK_TYPE)) {
+			m_pFragmentLeadTrack = m_pTracks[i];
+		}
+	}
+	if (m_pFragmentLeadTrack == NULL && m_pTracks.Size() > 0) {
+		m_pFragmentLeadTrack = m_pTracks[0];
+	}
+
+	// only ftyp and moov exist at this point, the sample tables are empty
+	u_int32_t numAtoms = m_pRootAtom->GetNumberOfChildAtoms();
+	for (u_int32_t i = 0; i < numAtoms; i++) {
+		m_pRootAtom->GetChildAtom(i)->Write();
+	}
+
+	m_fragmentMoovWritten = true;
+}
+
+void MP4File::WriteFragment()
+{
+	MP4Atom* pMoofAtom = MP4Atom::CreateAtom("moof");
+	pMoofAtom->SetFile(this);
+	pMoofAtom->Generate();
+
+	MP4Integer32Property* pSequenceProperty;
+	(void)pMoofAtom->FindProperty("moof.mfhd.sequenceNumber", 
+		(MP4Property**)&pSequenceProperty);
+	pSequenceProperty->SetValue(++m_fragmentSequence);
+
+	// one traf for every track with samples in this fragment
+	MP4TrackArray pFragmentTracks;
+	u_int64_t dataSize = 0;
+
+	for (u_int32_t i = 0; i < m_pTracks.Size(); i++) {
+		if (m_pTracks[i]->GetFragmentSamples() == 0) {
+			continue;
+		}
+		m_pTracks[i]->AddFragmentTraf(pMoofAtom);
+		pFragmentTracks.Add(m_pTracks[i]);
+		dataSize += m_pTracks[i]->GetFragmentDataSize();
+	}
+
+	if (pFragmentTracks.Size() == 0) {
+		m_fragmentSequence--;
+		delete pMoofAtom;
+		return;
+	}
+
+	// the moof size doesn't depend on the data offsets, 
+	// render it once to learn where the samples go
+	u_int8_t* pMoof = NULL;
+	u_int64_t moofSize = 0;
+
+	EnableMemoryBuffer();
+	pMoofAtom->Write();
+	DisableMemoryBuffer(&pMoof, &moofSize);
+	MP4Free(pMoof);
+
+	bool use64 = dataSize + 8 > 0xFFFFFFFF;
+	u_int64_t moofStart = GetPosition();
+	u_int64_t dataOffset = moofStart + moofSize + (use64 ? 16 : 8);
+
+	for (u_int32_t i = 0; i < pFragmentTracks.Size(); i++) {
+		MP4Integer64Property* pOffsetProperty;
+		(void)pMoofAtom->GetChildAtom(i + 1)->FindProperty(
+			"traf.tfhd.baseDataOffset", 
+			(MP4Property**)&pOffsetProperty);
+		pOffsetProperty->SetValue(dataOffset);
+		dataOffset += pFragmentTracks[i]->GetFragmentDataSize();
+	}
+
+	pMoofAtom->Write();
+	delete pMoofAtom;
+
+	VERBOSE_WRITE(GetVerbosity(),
+		printf("WriteFragment: %u at 0x"X64" data "U64" bytes\n",
+			m_fragmentSequence, moofStart, dataSize));
+
+	// the mdat size is known up front, no need to seek back
+	if (use64) {
+		WriteUInt32(1);
+		WriteBytes((u_int8_t*)"mdat", 4);
+		WriteUInt64(dataSize + 16);
+	} else {
+		WriteUInt32((u_int32_t)(dataSize + 8));
+		WriteBytes((u_int8_t*)"mdat", 4);
+	}
+
+	for (u_int32_t i = 0; i < pFragmentTracks.Size(); i++) {
+		pFragmentTracks[i]->WriteFragmentData(moofStart, i + 1);
+	}
+}
+
+void MP4File::FinishFragmentedWrite()
+{
+	if (!m_fragmentMoovWritten) {
+		BeginFragmentedWrite();
+	}
+
+	WriteFragment();
+
+	// mfro closes mfra with the size of the whole mfra,
+	// so readers can find the index from the end of the file
+	u_int8_t* pMfra = NULL;
+	u_int64_t mfraSize = 0;
+
+	EnableMemoryBuffer();
+	m_pMfraAtom->Write();
+	DisableMemoryBuffer(&pMfra, &mfraSize);
+	MP4Free(pMfra);
+
+	MP4Integer32Property* pSizeProperty;
+	(void)m_pMfraAtom->FindProperty("mfra.mfro.size", 
+		(MP4Property**)&pSizeProperty);
+	pSizeProperty->SetValue((u_int32_t)mfraSize);
+
+	m_pMfraAtom->Write();
+}
+
+void MP4File::ShiftMdat(u_int64_t start, u_int64_t end, u_int64_t delta)
+{
+	// copy back to front so the source is never overwritten
+	const u_int32_t blockSize = 1024 * 1024;
+	u_int8_t* pBlock = (u_int8_t*)MP4Malloc(blockSize);
+
+	u_int64_t pos = end;
+	while (pos > start) {
+		u_int32_t size = (u_int32_t)MIN(blockSize, pos - start);
+		pos -= size;
+
+		SetPosition(pos);
+		ReadBytes(pBlock, size);
+		SetPosition(pos + delta);
+		WriteBytes(pBlock, size);
+	}
+
+	MP4Free(pBlock);
+}
+
 void MP4File::UpdateDuration(MP4Duration duration)
 {
 	MP4Duration currentDuration = GetDuration();
@@ -659,6 +965,7 @@ void MP4File::Dump(FILE* pDumpFile, bool dumpImplicits)
 	}
 
 	fprintf(pDumpFile, "Dumping %s meta-information...\n", m_fileName);
+	UpdateSampleTables();
 	m_pRootAtom->Dump(pDumpFile, 0, dumpImplicits);
 }
 
@@ -673,6 +980,7 @@ void MP4File::Close()
 
 	m_virtual_IO->Close(m_pFile);
 	m_pFile = NULL;
+	m_pMappedFile = NULL;
 }
 
 const char* MP4File::TempFileName()
@@ -824,7 +1132,28 @@ bool MP4File::FindProperty(const char* name,
 		*pIndex = 0;	// set the default answer for index
 	}
 
-	return m_pRootAtom->FindProperty(name, ppProperty, pIndex);
+	if (!m_pRootAtom->FindProperty(name, ppProperty, pIndex)) {
+		return false;
+	}
+
+	// a table skipped by MP4_READ_LAZY_TABLES is read on first access,
+	// the sample tables get the samples the tracks still hold back
+	MP4Atom* pAtom = (*ppProperty)->GetParentAtom();
+	if (pAtom && pAtom->IsDeferred()) {
+		pAtom->ReadDeferred();
+	}
+	if (pAtom && pAtom->GetParentAtom()
+	  && ATOMID(pAtom->GetParentAtom()->GetType()) == ATOMID("stbl")) {
+		UpdateSampleTables();
+	}
+	return true;
+}
+
+void MP4File::UpdateSampleTables()
+{
+	for (u_int32_t i = 0; i < m_pTracks.Size(); i++) {
+		m_pTracks[i]->UpdateSampleTables();
+	}
 }
 
 void MP4File::FindIntegerProperty(const char* name, 
@@ -980,6 +1309,11 @@ MP4TrackId MP4File::AddTrack(const char* type, u_int32_t timeScale)
 {
 	ProtectWriteOperation("AddTrack");
 
+	if (m_fragmentMoovWritten) {
+		throw new MP4Error("can't add a track after fragments were written",
+			"AddTrack");
+	}
+
 	// create and add new trak atom
 	MP4Atom* pTrakAtom = AddChildAtom("moov", "trak");
 
@@ -2388,6 +2722,21 @@ void MP4File::ReadSample(MP4TrackId trackId, MP4SampleId sampleId,
 			pStartTime, pDuration, pRenderingOffset, pIsSyncSample);
 }
 
+void MP4File::ReadSamplePtr(MP4TrackId trackId, MP4SampleId sampleId,
+		const u_int8_t** ppBytes, u_int32_t* pNumBytes, 
+		MP4Timestamp* pStartTime, MP4Duration* pDuration,
+		MP4Duration* pRenderingOffset, bool* pIsSyncSample)
+{
+	m_pTracks[FindTrackIndex(trackId)]->
+		ReadSamplePtr(sampleId, ppBytes, pNumBytes, 
+			pStartTime, pDuration, pRenderingOffset, pIsSyncSample);
+}
+
+MP4SampleCursor* MP4File::OpenSampleCursor(MP4TrackId trackId)
+{
+	return new MP4SampleCursor(m_pTracks[FindTrackIndex(trackId)]);
+}
+
 void MP4File::WriteSample(MP4TrackId trackId,
 		const u_int8_t* pBytes, u_int32_t numBytes,
 		MP4Duration duration, MP4Duration renderingOffset, bool isSyncSample)
@@ -2400,6 +2749,36 @@ void MP4File::WriteSample(MP4TrackId trackId,
 	m_pModificationProperty->SetValue(MP4GetAbsTimestamp());
 }
 
+void MP4File::WriteSampleV(MP4TrackId trackId,
+		const struct iovec* pIov, u_int32_t iovCount,
+		MP4Duration duration, MP4Duration renderingOffset, bool isSyncSample)
+{
+	ProtectWriteOperation("MP4WriteSampleV");
+
+	m_pTracks[FindTrackIndex(trackId)]->
+		WriteSampleV(pIov, iovCount, duration, renderingOffset, isSyncSample);
+
+	m_pModificationProperty->SetValue(MP4GetAbsTimestamp());
+}
+
+u_int8_t* MP4File::BeginWriteSample(MP4TrackId trackId, u_int32_t maxBytes)
+{
+	ProtectWriteOperation("MP4BeginWriteSample");
+
+	return m_pTracks[FindTrackIndex(trackId)]->BeginWriteSample(maxBytes);
+}
+
+void MP4File::EndWriteSample(MP4TrackId trackId, u_int32_t numBytes,
+		MP4Duration duration, MP4Duration renderingOffset, bool isSyncSample)
+{
+	ProtectWriteOperation("MP4EndWriteSample");
+
+	m_pTracks[FindTrackIndex(trackId)]->
+		EndWriteSample(numBytes, duration, renderingOffset, isSyncSample);
+
+	m_pModificationProperty->SetValue(MP4GetAbsTimestamp());
+}
+
 void MP4File::SetSampleRenderingOffset(MP4TrackId trackId, 
 	MP4SampleId sampleId, MP4Duration renderingOffset)
 {
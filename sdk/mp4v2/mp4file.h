@@ -39,6 +39,7 @@ class MP4BytesProperty;
 class MP4Descriptor;
 class MP4DescriptorProperty;
 struct Virtual_IO;
+struct MP4MappedFile;
 
 class MP4File {
 public: /* equivalent to MP4 library API */
@@ -46,7 +47,7 @@ public: /* equivalent to MP4 library API */
 	~MP4File();
 
 	/* file operations */
-	void Read(const char* fileName);
+	void Read(const char* fileName, u_int32_t flags = 0);
 	#ifdef _WIN32
 	void Read(const wchar_t* fileName);
 	#endif
@@ -55,7 +56,9 @@ public: /* equivalent to MP4 library API */
 		    int add_ftyp = 1, int add_iods = 1,
 		    char* majorBrand = NULL, 
 		    u_int32_t minorVersion = 0, char** supportedBrands = NULL, 
-		    u_int32_t supportedBrandsCount = 0);
+		    u_int32_t supportedBrandsCount = 0,
+		    u_int32_t moovReserveSize = 0,
+		    u_int32_t fragmentMsecs = 0);
 	bool Modify(const char* fileName);
 	void Optimize(const char* orgFileName, 
 		const char* newFileName = NULL);
@@ -182,6 +185,20 @@ public: /* equivalent to MP4 library API */
 		MP4Duration* pRenderingOffset = NULL, 
 		bool* pIsSyncSample = NULL);
 
+	void ReadSamplePtr(
+		// input parameters
+		MP4TrackId trackId, 
+		MP4SampleId sampleId,
+		// output parameters
+		const u_int8_t** ppBytes, 
+		u_int32_t* pNumBytes, 
+		MP4Timestamp* pStartTime = NULL, 
+		MP4Duration* pDuration = NULL,
+		MP4Duration* pRenderingOffset = NULL, 
+		bool* pIsSyncSample = NULL);
+
+	MP4SampleCursor* OpenSampleCursor(MP4TrackId trackId);
+
 	void WriteSample(
 		MP4TrackId trackId,
 		const u_int8_t* pBytes, 
@@ -190,6 +207,25 @@ public: /* equivalent to MP4 library API */
 		MP4Duration renderingOffset = 0, 
 		bool isSyncSample = true);
 
+	void WriteSampleV(
+		MP4TrackId trackId,
+		const struct iovec* pIov,
+		u_int32_t iovCount,
+		MP4Duration duration = 0,
+		MP4Duration renderingOffset = 0, 
+		bool isSyncSample = true);
+
+	u_int8_t* BeginWriteSample(
+		MP4TrackId trackId,
+		u_int32_t maxBytes);
+
+	void EndWriteSample(
+		MP4TrackId trackId,
+		u_int32_t numBytes,
+		MP4Duration duration = 0,
+		MP4Duration renderingOffset = 0, 
+		bool isSyncSample = true);
+
 	void SetSampleRenderingOffset(
 		MP4TrackId trackId, 
 		MP4SampleId sampleId,
@@ -625,6 +661,17 @@ public: /* equivalent to MP4 library API */
 	void PeekBytes(
 		u_int8_t* pBytes, u_int32_t numBytes, FILE* pFile = NULL);
 
+	// numBytes at pos in the mapping of a file opened with
+	// MP4_READ_MAPPED, valid until the file is closed
+	bool IsMapped() {
+		return m_pMappedFile != NULL;
+	}
+	// true while a file opened with MP4_READ_LAZY_TABLES is parsed
+	bool IsDeferringTables() {
+		return m_deferTables;
+	}
+	const u_int8_t* GetMappedBytes(u_int64_t pos, u_int32_t numBytes);
+
 	void WriteBytes(u_int8_t* pBytes, u_int32_t numBytes, FILE* pFile = NULL);
 	void WriteUInt8(u_int8_t value);
 	void WriteUInt16(u_int16_t value);
@@ -655,6 +702,14 @@ public: /* equivalent to MP4 library API */
 
 	void UpdateDuration(MP4Duration duration);
 
+	bool IsFragmented() {
+		return m_fragmentMsecs != 0;
+	}
+
+	// called by a track before it adds a sample in fragmented mode,
+	// writes moov with the first sample and cuts fragments
+	void CheckFragment(MP4Track* pTrack, bool isSyncSample);
+
 	MP4Atom* FindAtom(const char* name);
 
 	MP4Atom* AddChildAtom(
@@ -690,8 +745,14 @@ protected:
 	#endif
 	void ReadFromFile();
 	void GenerateTracks();
+	void UpdateSampleTables();
 	void BeginWrite();
 	void FinishWrite();
+	void FinishFastStartWrite();
+	void BeginFragmentedWrite();
+	void WriteFragment();
+	void FinishFragmentedWrite();
+	void ShiftMdat(u_int64_t start, u_int64_t end, u_int64_t delta);
 	void CacheProperties();
 	void RewriteMdat(void* pReadFile, void* pWriteFile,
 			 Virtual_IO *readIO, Virtual_IO *writeIO);
@@ -798,6 +859,8 @@ protected:
 	#endif
 	void*			m_pFile;
 	Virtual_IO             *m_virtual_IO;
+	MP4MappedFile*	m_pMappedFile;	// m_pFile when reading through MMAP_virtual_IO
+	bool			m_deferTables;
 	u_int64_t		m_orgFileSize;
 	u_int64_t		m_fileSize;
 	MP4Atom*		m_pRootAtom;
@@ -809,6 +872,16 @@ protected:
 	u_int32_t               m_createFlags;
 	bool			m_useIsma;
 
+	// fast start, free atom holding the space reserved for moov
+	MP4Atom*		m_pMoovReserveAtom;
+
+	// fragmented writing, moof/mdat pairs after moov, mfra at the end
+	u_int32_t		m_fragmentMsecs;
+	bool			m_fragmentMoovWritten;
+	MP4Track*		m_pFragmentLeadTrack;	// fragments start at its sync samples
+	u_int32_t		m_fragmentSequence;
+	MP4Atom*		m_pMfraAtom;
+
 	// cached properties
 	MP4IntegerProperty*		m_pModificationProperty;
 	MP4Integer32Property*	m_pTimeScaleProperty;
@@ -26,6 +26,9 @@
 u_int64_t MP4File::GetPosition(FILE* pFile)
 {
 	if (m_memoryBuffer == NULL) {
+		if (pFile == NULL && m_pMappedFile) {
+			return m_pMappedFile->position;
+		}
 		if (pFile == NULL) {
 			ASSERT(m_pFile);
 			u_int64_t fpos;
@@ -50,7 +53,12 @@ u_int64_t MP4File::GetPosition(FILE* pFile)
 void MP4File::SetPosition(u_int64_t pos, FILE* pFile)
 {
 	if (m_memoryBuffer == NULL) {
-		if (pFile == NULL) {
+		if (pFile == NULL && m_pMappedFile) {
+			if (pos > m_pMappedFile->size) {
+				throw new MP4Error("position out of range", "MP4SetPosition");
+			}
+			m_pMappedFile->position = pos;
+		} else if (pFile == NULL) {
 			ASSERT(m_pFile);
 			if (m_virtual_IO->SetPosition(m_pFile, pos) != 0) {
 				throw new MP4Error("setting position via Virtual I/O", "MP4SetPosition");
@@ -63,7 +71,7 @@ void MP4File::SetPosition(u_int64_t pos, FILE* pFile)
 			}
 		}
 	} else {
-		if (pos >= m_memoryBufferSize) {
+		if (pos > m_memoryBufferSize) {
 		  //		  abort();
 			throw new MP4Error("position out of range", "MP4SetPosition");
 		}
@@ -95,7 +103,12 @@ void MP4File::ReadBytes(u_int8_t* pBytes, u_int32_t numBytes, FILE* pFile)
 	WARNING(m_numReadBits > 0);
 
 	if (m_memoryBuffer == NULL) {
-		if (pFile == NULL) {
+		if (pFile == NULL && m_pMappedFile) {
+			// atoms are parsed straight out of the mapping
+			memcpy(pBytes, GetMappedBytes(m_pMappedFile->position, numBytes),
+				numBytes);
+			m_pMappedFile->position += numBytes;
+		} else if (pFile == NULL) {
 			ASSERT(m_pFile);
 			if (m_virtual_IO->Read(m_pFile, pBytes, numBytes) != numBytes) {
 				throw new MP4Error("not enough bytes, reached end-of-file",		"MP4ReadBytes");
@@ -130,6 +143,19 @@ void MP4File::PeekBytes(u_int8_t* pBytes, u_int32_t numBytes, FILE* pFile)
 	SetPosition(pos, pFile);
 }
 
+const u_int8_t* MP4File::GetMappedBytes(u_int64_t pos, u_int32_t numBytes)
+{
+	if (m_pMappedFile == NULL) {
+		throw new MP4Error("file is not memory mapped", "MP4GetMappedBytes");
+	}
+	if (pos > m_pMappedFile->size || numBytes > m_pMappedFile->size - pos) {
+		throw new MP4Error(
+			"not enough bytes, reached end-of-file",
+			"MP4ReadBytes");
+	}
+	return m_pMappedFile->data + pos;
+}
+
 void MP4File::EnableMemoryBuffer(u_int8_t* pBytes, u_int64_t numBytes) 
 {
 	ASSERT(m_memoryBuffer == NULL);
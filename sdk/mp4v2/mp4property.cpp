@@ -647,6 +647,12 @@ void MP4TableProperty::Read(MP4File* pFile, u_int32_t index)
 		m_pProperties[j]->SetCount(numEntries);
 	}
 
+	u_int8_t valueSize = GetFixedValueSize(numEntries);
+	if (valueSize) {
+		ReadFixedEntries(pFile, numEntries, valueSize);
+		return;
+	}
+
 	for (u_int32_t i = 0; i < numEntries; i++) {
 		ReadEntry(pFile, i);
 	}
@@ -685,6 +691,12 @@ void MP4TableProperty::Write(MP4File* pFile, u_int32_t index)
 	  ASSERT(m_pProperties[0]->GetCount() == numEntries);
 	}
 
+	u_int8_t valueSize = GetFixedValueSize(numEntries);
+	if (valueSize) {
+		WriteFixedEntries(pFile, numEntries, valueSize);
+		return;
+	}
+
 	for (u_int32_t i = 0; i < numEntries; i++) {
 		WriteEntry(pFile, i);
 	}
@@ -697,6 +709,126 @@ void MP4TableProperty::WriteEntry(MP4File* pFile, u_int32_t index)
 	}
 }
 
+// tables with more columns go through ReadEntry() and WriteEntry()
+#define FIXED_MAX_COLUMNS	8
+
+// values converted at a time when a table has more than one column
+#define FIXED_BLOCK_VALUES	2048
+
+// largest single read of a one column table
+#define FIXED_MAX_READ		(64 << 20)
+
+u_int8_t MP4TableProperty::GetFixedValueSize(u_int32_t numEntries)
+{
+	u_int8_t valueSize = 0;
+	u_int32_t numColumns = 0;
+
+	for (u_int32_t j = 0; j < m_pProperties.Size(); j++) {
+		MP4Property* pProperty = m_pProperties[j];
+		if (pProperty->IsImplicit()) {
+			continue;	// not stored in the file
+		}
+		u_int8_t size = pProperty->GetStoredSize();
+		if (size == 0 || (valueSize && size != valueSize)
+		  || pProperty->GetCount() < numEntries
+		  || ++numColumns > FIXED_MAX_COLUMNS) {
+			return 0;
+		}
+		valueSize = size;
+	}
+	return valueSize;
+}
+
+u_int32_t MP4TableProperty::GetFixedColumns(u_int8_t** ppColumns, 
+	u_int8_t valueSize)
+{
+	u_int32_t numColumns = 0;
+
+	for (u_int32_t j = 0; j < m_pProperties.Size(); j++) {
+		MP4Property* pProperty = m_pProperties[j];
+		if (pProperty->IsImplicit()) {
+			continue;
+		}
+		if (valueSize == 4) {
+			ppColumns[numColumns++] = (u_int8_t*)
+				((MP4Integer32Property*)pProperty)->GetValues();
+		} else {
+			ppColumns[numColumns++] = (u_int8_t*)
+				((MP4Integer64Property*)pProperty)->GetValues();
+		}
+	}
+	return numColumns;
+}
+
+void MP4TableProperty::ReadFixedEntries(MP4File* pFile,
+	u_int32_t numEntries, u_int8_t valueSize)
+{
+	u_int8_t* pColumns[FIXED_MAX_COLUMNS];
+	u_int32_t numColumns = GetFixedColumns(pColumns, valueSize);
+
+	if ((u_int64_t)numEntries * numColumns * valueSize
+	  > pFile->GetSize() - pFile->GetPosition()) {
+		throw new MP4Error(
+			"not enough bytes, reached end-of-file",
+			"MP4TableProperty::Read");
+	}
+
+	if (numColumns == 1) {
+		// stsz, stco, co64 and stss, read straight into the column
+		u_int32_t maxEntries = FIXED_MAX_READ / valueSize;
+		for (u_int32_t i = 0; i < numEntries; i += maxEntries) {
+			u_int32_t n = MIN(maxEntries, numEntries - i);
+			u_int8_t* pValues = pColumns[0] + (u_int64_t)i * valueSize;
+			pFile->ReadBytes(pValues, n * valueSize);
+			MP4SwapBigEndian(pValues, n, valueSize);
+		}
+		return;
+	}
+
+	// convert a block of entries, then deal the values out to the columns
+	u_int64_t block[FIXED_BLOCK_VALUES];
+	u_int32_t blockEntries = FIXED_BLOCK_VALUES / numColumns;
+
+	for (u_int32_t i = 0; i < numEntries; i += blockEntries) {
+		u_int32_t n = MIN(blockEntries, numEntries - i);
+		pFile->ReadBytes((u_int8_t*)block, n * numColumns * valueSize);
+		MP4SwapBigEndian(block, n * numColumns, valueSize);
+
+		u_int8_t* pValue = (u_int8_t*)block;
+		for (u_int32_t k = i; k < i + n; k++) {
+			for (u_int32_t j = 0; j < numColumns; j++) {
+				memcpy(pColumns[j] + (u_int64_t)k * valueSize, pValue, valueSize);
+				pValue += valueSize;
+			}
+		}
+	}
+}
+
+void MP4TableProperty::WriteFixedEntries(MP4File* pFile,
+	u_int32_t numEntries, u_int8_t valueSize)
+{
+	u_int8_t* pColumns[FIXED_MAX_COLUMNS];
+	u_int32_t numColumns = GetFixedColumns(pColumns, valueSize);
+
+	// the columns stay in host order, only the copy in block is converted
+	u_int64_t block[FIXED_BLOCK_VALUES];
+	u_int32_t blockEntries = FIXED_BLOCK_VALUES / numColumns;
+
+	for (u_int32_t i = 0; i < numEntries; i += blockEntries) {
+		u_int32_t n = MIN(blockEntries, numEntries - i);
+
+		u_int8_t* pValue = (u_int8_t*)block;
+		for (u_int32_t k = i; k < i + n; k++) {
+			for (u_int32_t j = 0; j < numColumns; j++) {
+				memcpy(pValue, pColumns[j] + (u_int64_t)k * valueSize, valueSize);
+				pValue += valueSize;
+			}
+		}
+		MP4SwapBigEndian(block, n * numColumns, valueSize);
+		pFile->WriteBytes((u_int8_t*)block, n * numColumns * valueSize);
+	}
+}
+
 void MP4TableProperty::Dump(FILE* pFile, u_int8_t indent,
 	bool dumpImplicits, u_int32_t index)
 {
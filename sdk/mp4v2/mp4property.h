@@ -79,6 +79,10 @@ public:
 
 	virtual void Generate() { /* default is a no-op */ };
 
+	// size of a value stored as a plain 32 or 64 bit big endian integer,
+	// 0 for anything else. tables of such values are read in bulk
+	virtual u_int8_t GetStoredSize() { return 0; }
+
 	virtual void Read(MP4File* pFile, u_int32_t index = 0) = 0;
 
 	virtual void Write(MP4File* pFile, u_int32_t index = 0) = 0;
@@ -157,6 +161,12 @@ public:
 		void IncrementValue(int32_t increment = 1, u_int32_t index = 0) { \
 			m_values[index] += increment; \
 		} \
+		u_int##isize##_t* GetValues() { \
+			return m_values.Size() ? &m_values[0] : NULL; \
+		} \
+		u_int8_t GetStoredSize() { \
+			return (xsize == 32 || xsize == 64) ? xsize / 8 : 0; \
+		} \
 		void Read(MP4File* pFile, u_int32_t index = 0) { \
 			if (m_implicit) { \
 				return; \
@@ -202,6 +212,10 @@ public:
 		m_numBits = numBits;
 	}
 
+	u_int8_t GetStoredSize() {
+		return 0;
+	}
+
 	void Read(MP4File* pFile, u_int32_t index = 0);
 	void Write(MP4File* pFile, u_int32_t index = 0);
 	void Dump(FILE* pFile, u_int8_t indent,
@@ -459,6 +473,13 @@ protected:
 	virtual void ReadEntry(MP4File* pFile, u_int32_t index);
 	virtual void WriteEntry(MP4File* pFile, u_int32_t index);
 
+	// sample tables, all columns 32 or all 64 bit integers, are moved
+	// between the file and the column arrays a block of entries at a time
+	u_int8_t GetFixedValueSize(u_int32_t numEntries);
+	u_int32_t GetFixedColumns(u_int8_t** ppColumns, u_int8_t valueSize);
+	void ReadFixedEntries(MP4File* pFile, u_int32_t numEntries, u_int8_t size);
+	void WriteFixedEntries(MP4File* pFile, u_int32_t numEntries, u_int8_t size);
+
 	bool FindContainedProperty(const char* name,
 		MP4Property** ppProperty, u_int32_t* pIndex);
 
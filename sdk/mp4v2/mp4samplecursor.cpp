@@ -0,0 +1,302 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ * 
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ * 
+ * The Original Code is MPEG4IP.
+ */
+
+#include "mp4common.h"
+
+// most bytes read at once from a chunk, unless one sample is larger
+static const u_int32_t MaxBatchSize = 1024 * 1024;
+
+MP4SampleCursor::MP4SampleCursor(MP4Track* pTrack)
+{
+	m_pTrack = pTrack;
+	m_pFile = pTrack->GetFile();
+
+	m_pBuffer = NULL;
+	m_bufferSize = 0;
+
+	Seek(1);
+}
+
+MP4SampleCursor::~MP4SampleCursor()
+{
+	MP4Free(m_pBuffer);
+}
+
+void MP4SampleCursor::Seek(MP4SampleId sampleId)
+{
+	if (sampleId == MP4_INVALID_SAMPLE_ID) {
+		throw new MP4Error("sample id can't be zero", 
+			"MP4SampleCursor::Seek");
+	}
+
+	// the tables may not cover sampleId yet while the track is written,
+	// so they are only searched when the sample is read
+	m_sampleId = sampleId;
+	m_located = false;
+	m_pBatch = NULL;
+	m_batchEndSampleId = sampleId;
+}
+
+void MP4SampleCursor::Locate()
+{
+	MP4Track* pTrack = m_pTrack;
+
+	// chunk and offset of the sample, like GetSampleFileOffset
+	pTrack->ReadDeferredTable(pTrack->m_pChunkOffsetProperty);
+
+	m_stscIndex = pTrack->GetSampleStscIndex(m_sampleId);
+
+	MP4ChunkId firstChunk = 
+		pTrack->m_pStscFirstChunkProperty->GetValue(m_stscIndex);
+	MP4SampleId firstSample = 
+		pTrack->m_pStscFirstSampleProperty->GetValue(m_stscIndex);
+	u_int32_t samplesPerChunk = 
+		pTrack->m_pStscSamplesPerChunkProperty->GetValue(m_stscIndex);
+
+	m_chunkId = firstChunk + ((m_sampleId - firstSample) / samplesPerChunk);
+
+	MP4SampleId firstSampleInChunk = 
+		m_sampleId - ((m_sampleId - firstSample) % samplesPerChunk);
+	m_chunkEndSampleId = firstSampleInChunk + samplesPerChunk;
+
+	m_fileOffset = pTrack->m_pChunkOffsetProperty->GetValue(m_chunkId - 1);
+	for (MP4SampleId sid = firstSampleInChunk; sid < m_sampleId; sid++) {
+		m_fileOffset += pTrack->GetSampleSize(sid);
+	}
+	m_batchEndSampleId = m_sampleId;
+
+	// stts entry and start time
+	m_sttsIndex = pTrack->GetSampleSttsIndex(m_sampleId);
+	m_sttsFirstSampleId = pTrack->m_sttsFirstSamples[m_sttsIndex];
+	m_startTime = (m_sampleId - m_sttsFirstSampleId);
+	m_startTime *= pTrack->m_pSttsSampleDeltaProperty->GetValue(m_sttsIndex);
+	m_startTime += pTrack->m_sttsStartTimes[m_sttsIndex];
+
+	// ctts entry, Next walks from the first one if there is no ctts yet
+	m_cttsIndex = 0;
+	m_cttsFirstSampleId = 1;
+	if (pTrack->m_pCttsCountProperty
+	  && pTrack->m_pCttsCountProperty->GetValue()) {
+		m_cttsIndex = pTrack->GetSampleCttsIndex(m_sampleId,
+			&m_cttsFirstSampleId);
+	}
+
+	// binary search for the first sync sample at or after the sample
+	m_stssIndex = 0;
+	if (pTrack->m_pStssCountProperty) {
+		pTrack->ReadDeferredTable(pTrack->m_pStssSampleProperty);
+
+		u_int32_t stssRIndex = pTrack->m_pStssCountProperty->GetValue();
+
+		while (m_stssIndex < stssRIndex) {
+			u_int32_t stssIndex = (m_stssIndex + stssRIndex) >> 1;
+			if (pTrack->m_pStssSampleProperty->GetValue(stssIndex) 
+			  < m_sampleId) {
+				m_stssIndex = stssIndex + 1;
+			} else {
+				stssRIndex = stssIndex;
+			}
+		}
+	}
+
+	m_located = true;
+}
+
+void MP4SampleCursor::NextChunk()
+{
+	MP4Track* pTrack = m_pTrack;
+
+	m_chunkId++;
+
+	if (m_stscIndex + 1 < pTrack->m_pStscCountProperty->GetValue()
+	  && m_chunkId >= 
+	    pTrack->m_pStscFirstChunkProperty->GetValue(m_stscIndex + 1)) {
+		m_stscIndex++;
+	}
+
+	m_chunkEndSampleId += 
+		pTrack->m_pStscSamplesPerChunkProperty->GetValue(m_stscIndex);
+
+	m_fileOffset = pTrack->m_pChunkOffsetProperty->GetValue(m_chunkId - 1);
+}
+
+void MP4SampleCursor::ReadBatch()
+{
+	MP4Track* pTrack = m_pTrack;
+
+	while (m_sampleId >= m_chunkEndSampleId) {
+		NextChunk();
+	}
+
+	FILE* pFile = pTrack->GetSampleFile(m_sampleId);
+
+	if (pFile == (FILE*)-1) {
+		throw new MP4Error("sample is located in an inaccessible file",
+			"MP4SampleCursor::ReadBatch");
+	}
+
+	// the rest of the chunk, in pieces of up to MaxBatchSize
+	u_int32_t numSamples = pTrack->GetNumberOfSamples();
+	u_int32_t batchSize = pTrack->GetSampleSize(m_sampleId);
+	MP4SampleId batchEndSampleId = m_sampleId + 1;
+
+	while (batchEndSampleId < m_chunkEndSampleId 
+	  && batchEndSampleId <= numSamples) {
+		u_int32_t sampleSize = pTrack->GetSampleSize(batchEndSampleId);
+		if (batchSize >= MaxBatchSize 
+		  || sampleSize > MaxBatchSize - batchSize) {
+			break;
+		}
+		batchSize += sampleSize;
+		batchEndSampleId++;
+	}
+
+	VERBOSE_READ_SAMPLE(m_pFile->GetVerbosity(),
+		printf("ReadBatch: track %u id %u-%u offset 0x"X64" size %u (0x%x)\n",
+			pTrack->GetId(), m_sampleId, batchEndSampleId - 1, 
+			m_fileOffset, batchSize, batchSize));
+
+	if (pFile == NULL && m_pFile->IsMapped()) {
+		m_pBatch = m_pFile->GetMappedBytes(m_fileOffset, batchSize);
+
+	} else {
+		if (batchSize > m_bufferSize) {
+			m_bufferSize = MAX(batchSize, 2 * m_bufferSize);
+			m_pBuffer = (u_int8_t*)MP4Realloc(m_pBuffer, m_bufferSize);
+		}
+
+		u_int64_t oldPos = m_pFile->GetPosition(pFile); // only used in mode == 'w'
+		try {
+			m_pFile->SetPosition(m_fileOffset, pFile);
+			m_pFile->ReadBytes(m_pBuffer, batchSize, pFile);
+		}
+		catch (MP4Error* e) {
+			if (m_pFile->GetMode() == 'w') {
+				m_pFile->SetPosition(oldPos, pFile);
+			}
+			throw e;
+		}
+
+		if (m_pFile->GetMode() == 'w') {
+			m_pFile->SetPosition(oldPos, pFile);
+		}
+		m_pBatch = m_pBuffer;
+	}
+
+	m_batchEndSampleId = batchEndSampleId;
+	m_fileOffset += batchSize;
+}
+
+MP4SampleId MP4SampleCursor::Next(
+	const u_int8_t** ppBytes, 
+	u_int32_t* pNumBytes, 
+	MP4Timestamp* pStartTime, 
+	MP4Duration* pDuration,
+	MP4Duration* pRenderingOffset, 
+	bool* pIsSyncSample)
+{
+	MP4Track* pTrack = m_pTrack;
+
+	pTrack->UpdateSampleTables();
+
+	if (m_sampleId > pTrack->GetNumberOfSamples()) {
+		*ppBytes = NULL;
+		*pNumBytes = 0;
+		return MP4_INVALID_SAMPLE_ID;
+	}
+
+	// handle unusual case of wanting to read a sample
+	// that is still sitting in the write chunk buffer
+	if (pTrack->m_chunkSamples 
+	  && m_sampleId >= pTrack->m_writeSampleId - pTrack->m_chunkSamples) {
+		pTrack->WriteChunkBuffer();
+	}
+
+	if (!m_located) {
+		Locate();
+	}
+	if (m_sampleId == m_batchEndSampleId) {
+		ReadBatch();
+	}
+
+	MP4SampleId sampleId = m_sampleId;
+	u_int32_t sampleSize = pTrack->GetSampleSize(sampleId);
+
+	// the last entries grow while the track is written, 
+	// so their sample counts are read again for every sample
+	u_int32_t numStts = pTrack->m_pSttsCountProperty->GetValue();
+	while (m_sttsIndex < numStts && sampleId >= m_sttsFirstSampleId 
+	  + pTrack->m_pSttsSampleCountProperty->GetValue(m_sttsIndex)) {
+		m_sttsFirstSampleId += 
+			pTrack->m_pSttsSampleCountProperty->GetValue(m_sttsIndex);
+		m_sttsIndex++;
+	}
+	if (m_sttsIndex == numStts) {
+		throw new MP4Error("sample id out of range", 
+			"MP4SampleCursor::Next");
+	}
+	MP4Duration duration = 
+		pTrack->m_pSttsSampleDeltaProperty->GetValue(m_sttsIndex);
+
+	if (pStartTime) {
+		*pStartTime = m_startTime;
+	}
+	if (pDuration) {
+		*pDuration = duration;
+	}
+
+	if (pTrack->m_pCttsCountProperty 
+	  && pTrack->m_pCttsCountProperty->GetValue()) {
+		u_int32_t numCtts = pTrack->m_pCttsCountProperty->GetValue();
+		while (m_cttsIndex < numCtts && sampleId >= m_cttsFirstSampleId
+		  + pTrack->m_pCttsSampleCountProperty->GetValue(m_cttsIndex)) {
+			m_cttsFirstSampleId += 
+				pTrack->m_pCttsSampleCountProperty->GetValue(m_cttsIndex);
+			m_cttsIndex++;
+		}
+		if (pRenderingOffset) {
+			if (m_cttsIndex == numCtts) {
+				throw new MP4Error("sample id out of range", 
+					"MP4SampleCursor::Next");
+			}
+			*pRenderingOffset = 
+				pTrack->m_pCttsSampleOffsetProperty->GetValue(m_cttsIndex);
+		}
+	} else if (pRenderingOffset) {
+		*pRenderingOffset = 0;
+	}
+
+	bool isSyncSample = true;
+	if (pTrack->m_pStssCountProperty) {
+		u_int32_t numStss = pTrack->m_pStssCountProperty->GetValue();
+		while (m_stssIndex < numStss 
+		  && pTrack->m_pStssSampleProperty->GetValue(m_stssIndex) < sampleId) {
+			m_stssIndex++;
+		}
+		isSyncSample = m_stssIndex < numStss
+			&& pTrack->m_pStssSampleProperty->GetValue(m_stssIndex) == sampleId;
+	}
+	if (pIsSyncSample) {
+		*pIsSyncSample = isSyncSample;
+	}
+
+	*ppBytes = m_pBatch;
+	*pNumBytes = sampleSize;
+
+	m_pBatch += sampleSize;
+	m_startTime += duration;
+	m_sampleId++;
+
+	return sampleId;
+}
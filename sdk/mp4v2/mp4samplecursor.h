@@ -0,0 +1,80 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ * 
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ * 
+ * The Original Code is MPEG4IP.
+ */
+
+#ifndef __MP4_SAMPLE_CURSOR_INCLUDED__
+#define __MP4_SAMPLE_CURSOR_INCLUDED__
+
+// Reads the samples of a track in order. The cursor keeps its place in
+// stsc, stco, stsz, stts, ctts and stss and steps each of them along
+// with the samples, so a sample costs O(1) instead of the lookups
+// ReadSample does. The bytes of a chunk are read in one go, in batches
+// of up to a megabyte, or pointed to in the mapping of a mapped file.
+class MP4SampleCursor {
+public:
+	MP4SampleCursor(MP4Track* pTrack);
+	~MP4SampleCursor();
+
+	// the next sample, MP4_INVALID_SAMPLE_ID after the last one.
+	// *ppBytes stays valid until the next call to Next or Seek
+	MP4SampleId Next(
+		const u_int8_t** ppBytes, 
+		u_int32_t* pNumBytes, 
+		MP4Timestamp* pStartTime = NULL, 
+		MP4Duration* pDuration = NULL,
+		MP4Duration* pRenderingOffset = NULL, 
+		bool* pIsSyncSample = NULL);
+
+	// makes sampleId the next sample, also needed after samples
+	// the cursor has passed are changed, e.g. by SetSampleRenderingOffset
+	void Seek(MP4SampleId sampleId);
+
+	MP4File* GetFile() {
+		return m_pFile;
+	}
+
+protected:
+	void Locate();
+	void NextChunk();
+	void ReadBatch();
+
+protected:
+	MP4Track*		m_pTrack;
+	MP4File*		m_pFile;
+
+	MP4SampleId		m_sampleId;		// the next sample
+	bool			m_located;		// the table positions below are valid
+
+	// chunk of the next sample, from stsc and stco
+	u_int32_t		m_stscIndex;
+	MP4ChunkId		m_chunkId;
+	MP4SampleId		m_chunkEndSampleId;	// first sample of the next chunk
+	u_int64_t		m_fileOffset;	// of the next sample
+
+	// bytes of the samples m_sampleId up to m_batchEndSampleId
+	const u_int8_t*	m_pBatch;
+	u_int8_t*		m_pBuffer;
+	u_int32_t		m_bufferSize;
+	MP4SampleId		m_batchEndSampleId;
+
+	u_int32_t		m_sttsIndex;
+	MP4SampleId		m_sttsFirstSampleId;
+	MP4Timestamp	m_startTime;	// of the next sample
+
+	u_int32_t		m_cttsIndex;
+	MP4SampleId		m_cttsFirstSampleId;
+
+	u_int32_t		m_stssIndex;	// first sync sample >= m_sampleId
+};
+
+#endif /* __MP4_SAMPLE_CURSOR_INCLUDED__ */
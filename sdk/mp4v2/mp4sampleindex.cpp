@@ -0,0 +1,162 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ * 
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ * 
+ * The Original Code is MPEG4IP.
+ */
+
+#include "mp4common.h"
+
+MP4RunColumn::MP4RunColumn()
+{
+	m_pBytes = NULL;
+	m_numBytes = 0;
+	m_maxNumBytes = 0;
+	m_count = 0;
+	m_numRuns = 0;
+	m_codedValue = 0;
+	m_runValue = 0;
+	m_runLength = 0;
+}
+
+MP4RunColumn::~MP4RunColumn()
+{
+	MP4Free(m_pBytes);
+}
+
+void MP4RunColumn::Add(u_int64_t value)
+{
+	if (m_runLength && value == m_runValue) {
+		m_runLength++;
+	} else {
+		if (m_runLength) {
+			CodeRun();
+		}
+		m_runValue = value;
+		m_runLength = 1;
+	}
+	m_count++;
+}
+
+void MP4RunColumn::CodeRun()
+{
+	// difference, flag and low bits of the difference, repeat count
+	Reserve(16);
+
+	u_int64_t delta = m_runValue - m_codedValue;
+	u_int64_t zigzag = (delta << 1) ^ (u_int64_t)((int64_t)delta >> 63);
+	u_int8_t* pBytes = &m_pBytes[m_numBytes];
+
+	u_int8_t first = (u_int8_t)(((zigzag & 0x3F) << 1) | (m_runLength > 1));
+	zigzag >>= 6;
+	*pBytes++ = first | (zigzag ? 0x80 : 0);
+	while (zigzag) {
+		u_int8_t b = (u_int8_t)(zigzag & 0x7F);
+		zigzag >>= 7;
+		*pBytes++ = b | (zigzag ? 0x80 : 0);
+	}
+
+	if (m_runLength > 1) {
+		u_int32_t repeats = m_runLength - 2;
+		do {
+			u_int8_t b = (u_int8_t)(repeats & 0x7F);
+			repeats >>= 7;
+			*pBytes++ = b | (repeats ? 0x80 : 0);
+		} while (repeats);
+	}
+
+	m_numBytes = pBytes - m_pBytes;
+	m_codedValue = m_runValue;
+	m_numRuns++;
+}
+
+void MP4RunColumn::Reserve(u_int32_t numBytes)
+{
+	u_int64_t needed = (u_int64_t)m_numBytes + numBytes;
+
+	if (needed <= m_maxNumBytes) {
+		return;
+	}
+	if (needed > 0xFFFFFFFF) {
+		throw new MP4Error("too many samples", "MP4RunColumn::Reserve");
+	}
+
+	u_int64_t maxNumBytes = m_maxNumBytes ? m_maxNumBytes : 256;
+	while (maxNumBytes < needed) {
+		maxNumBytes *= 2;
+	}
+	if (maxNumBytes > 0xFFFFFFFF) {
+		maxNumBytes = 0xFFFFFFFF;
+	}
+
+	m_pBytes = (u_int8_t*)MP4Realloc(m_pBytes, (u_int32_t)maxNumBytes);
+	m_maxNumBytes = (u_int32_t)maxNumBytes;
+}
+
+template <class T> static inline void SwapValues(T& a, T& b)
+{
+	T t = a;
+	a = b;
+	b = t;
+}
+
+void MP4RunColumn::Swap(MP4RunColumn& column)
+{
+	SwapValues(m_pBytes, column.m_pBytes);
+	SwapValues(m_numBytes, column.m_numBytes);
+	SwapValues(m_maxNumBytes, column.m_maxNumBytes);
+	SwapValues(m_count, column.m_count);
+	SwapValues(m_numRuns, column.m_numRuns);
+	SwapValues(m_codedValue, column.m_codedValue);
+	SwapValues(m_runValue, column.m_runValue);
+	SwapValues(m_runLength, column.m_runLength);
+}
+
+MP4RunColumnCursor::MP4RunColumnCursor(MP4RunColumn* pColumn)
+{
+	m_pColumn = pColumn;
+	m_position = 0;
+	m_value = 0;
+	m_remaining = 0;
+}
+
+void MP4RunColumnCursor::NextRun()
+{
+	if (m_position < m_pColumn->m_numBytes) {
+		const u_int8_t* pBytes = &m_pColumn->m_pBytes[m_position];
+
+		bool repeated = (*pBytes & 1) != 0;
+		u_int64_t zigzag = (*pBytes >> 1) & 0x3F;
+		u_int8_t shift = 6;
+		while (*pBytes++ & 0x80) {
+			zigzag |= (u_int64_t)(*pBytes & 0x7F) << shift;
+			shift += 7;
+		}
+		m_value += (zigzag >> 1) ^ (0 - (zigzag & 1));
+
+		m_remaining = 1;
+		if (repeated) {
+			u_int32_t repeats = 0;
+			shift = 0;
+			do {
+				repeats |= (u_int32_t)(*pBytes & 0x7F) << shift;
+				shift += 7;
+			} while (*pBytes++ & 0x80);
+			m_remaining = repeats + 2;
+		}
+
+		m_position = pBytes - m_pColumn->m_pBytes;
+	} else {
+		// the open run
+		ASSERT(m_pColumn->m_runLength);
+		m_value = m_pColumn->m_runValue;
+		m_remaining = m_pColumn->m_runLength;
+	}
+}
@@ -0,0 +1,154 @@
+/*
+ * The contents of this file are subject to the Mozilla Public
+ * License Version 1.1 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of
+ * the License at http://www.mozilla.org/MPL/
+ * 
+ * Software distributed under the License is distributed on an "AS
+ * IS" basis, WITHOUT WARRANTY OF ANY KIND, either express or
+ * implied. See the License for the specific language governing
+ * rights and limitations under the License.
+ * 
+ * The Original Code is MPEG4IP.
+ */
+
+#ifndef __MP4_SAMPLE_INDEX_INCLUDED__
+#define __MP4_SAMPLE_INDEX_INCLUDED__
+
+// A column of integers kept as runs of equal values. Each run is coded
+// as the zigzag varint difference to the value of the run before, with
+// a flag for a varint repeat count following it, so constant columns
+// take a few bytes and slowly changing ones about a byte per value.
+// The last run stays open until a different value is added.
+class MP4RunColumn {
+public:
+	MP4RunColumn();
+	~MP4RunColumn();
+
+	void Add(u_int64_t value);
+
+	u_int32_t GetCount() {
+		return m_count;
+	}
+	u_int32_t GetNumberOfRuns() {
+		return m_numRuns + (m_runLength ? 1 : 0);
+	}
+	u_int64_t GetLastValue() {
+		return m_runValue;
+	}
+	u_int32_t GetNumberOfBytes() {
+		return m_numBytes;
+	}
+
+	void Swap(MP4RunColumn& column);
+
+protected:
+	void CodeRun();
+	void Reserve(u_int32_t numBytes);
+
+protected:
+	u_int8_t*	m_pBytes;
+	u_int32_t	m_numBytes;
+	u_int32_t	m_maxNumBytes;
+	u_int32_t	m_count;
+	u_int32_t	m_numRuns;		// coded in m_pBytes
+	u_int64_t	m_codedValue;	// value of the last coded run
+	u_int64_t	m_runValue;		// the open run
+	u_int32_t	m_runLength;
+
+	friend class MP4RunColumnCursor;
+};
+
+// reads the values of a column in order, O(1) per value or run
+class MP4RunColumnCursor {
+public:
+	MP4RunColumnCursor(MP4RunColumn* pColumn);
+
+	u_int64_t GetNext() {
+		if (m_remaining == 0) {
+			NextRun();
+		}
+		m_remaining--;
+		return m_value;
+	}
+
+	// the rest of the current run, returns the number of values
+	u_int32_t GetNextRun(u_int64_t* pValue) {
+		if (m_remaining == 0) {
+			NextRun();
+		}
+		u_int32_t numValues = m_remaining;
+		m_remaining = 0;
+		*pValue = m_value;
+		return numValues;
+	}
+
+protected:
+	void NextRun();
+
+protected:
+	MP4RunColumn*	m_pColumn;
+	u_int32_t		m_position;
+	u_int64_t		m_value;
+	u_int32_t		m_remaining;	// values left in the current run
+};
+
+// The sizes, durations, rendering offsets and sync flags of the samples
+// a track has written but not yet put into its stsz, stts, ctts and stss
+// tables, in one run column each.
+class MP4SampleIndex {
+public:
+	void Add(u_int32_t numBytes, MP4Duration duration,
+		MP4Duration renderingOffset, bool isSyncSample) {
+		m_sizes.Add(numBytes);
+		m_durations.Add(duration);
+		m_renderingOffsets.Add(renderingOffset);
+		m_syncFlags.Add(isSyncSample ? 1 : 0);
+	}
+
+	u_int32_t GetCount() {
+		return m_sizes.GetCount();
+	}
+	u_int32_t GetNumberOfBytes() {
+		return m_sizes.GetNumberOfBytes() + m_durations.GetNumberOfBytes()
+			+ m_renderingOffsets.GetNumberOfBytes()
+			+ m_syncFlags.GetNumberOfBytes();
+	}
+
+	// true if all samples have the same duration
+	bool GetFixedDuration(MP4Duration* pDuration) {
+		if (m_durations.GetNumberOfRuns() != 1) {
+			return false;
+		}
+		*pDuration = m_durations.GetLastValue();
+		return true;
+	}
+
+	void Swap(MP4SampleIndex& index) {
+		m_sizes.Swap(index.m_sizes);
+		m_durations.Swap(index.m_durations);
+		m_renderingOffsets.Swap(index.m_renderingOffsets);
+		m_syncFlags.Swap(index.m_syncFlags);
+	}
+
+	MP4RunColumn* GetSizes() {
+		return &m_sizes;
+	}
+	MP4RunColumn* GetDurations() {
+		return &m_durations;
+	}
+	MP4RunColumn* GetRenderingOffsets() {
+		return &m_renderingOffsets;
+	}
+	MP4RunColumn* GetSyncFlags() {
+		return &m_syncFlags;
+	}
+
+protected:
+	MP4RunColumn	m_sizes;
+	MP4RunColumn	m_durations;
+	MP4RunColumn	m_renderingOffsets;
+	MP4RunColumn	m_syncFlags;
+};
+
+#endif /* __MP4_SAMPLE_INDEX_INCLUDED__ */
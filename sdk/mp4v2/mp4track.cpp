@@ -49,9 +49,18 @@ MP4Track::MP4Track(MP4File* pFile, MP4Atom* pTrakAtom)
 	m_fixedSampleDuration = 0;
 	m_pChunkBuffer = NULL;
 	m_chunkBufferSize = 0;
+	m_chunkBufferCapacity = 0;
+	m_writeSampleMaxBytes = 0;
 	m_chunkSamples = 0;
 	m_chunkDuration = 0;
 
+	m_fragmentSamples = 0;
+	m_fragmentStartTime = 0;
+	m_fragmentDuration = 0;
+	m_fragmentSyncSample = 0;
+	m_fragmentSyncTime = 0;
+	m_pTfraAtom = NULL;
+
 	// m_bytesPerSample should be set to 1, except for the
 	// quicktime audio constant bit rate samples, which have non-1 values
 	m_bytesPerSample = 1;
@@ -60,7 +69,9 @@ MP4Track::MP4Track(MP4File* pFile, MP4Atom* pTrakAtom)
 	m_isAmr = AMR_UNINITIALIZED;
 	m_curMode = 0;
 	
-	m_cachedSttsSid = MP4_INVALID_SAMPLE_ID;
+	m_sampleSizeSumCount = 0;
+	m_sttsIndexCount = 0;
+	m_cttsIndexCount = 0;
 
 	bool success = true;
 
@@ -301,28 +312,8 @@ void MP4Track::ReadSample(
 		m_pFile->SetPosition(fileOffset, pFile);
 		m_pFile->ReadBytes(*ppBytes, *pNumBytes, pFile);
 
-		if (pStartTime || pDuration) {
-			GetSampleTimes(sampleId, pStartTime, pDuration);
-
-			VERBOSE_READ_SAMPLE(m_pFile->GetVerbosity(),
-				printf("ReadSample:  start "U64" duration "D64"\n",
-					(pStartTime ? *pStartTime : 0), 
-					(pDuration ? *pDuration : 0)));
-		}
-		if (pRenderingOffset) {
-			*pRenderingOffset = GetSampleRenderingOffset(sampleId);
-
-			VERBOSE_READ_SAMPLE(m_pFile->GetVerbosity(),
-				printf("ReadSample:  renderingOffset "D64"\n",
-					*pRenderingOffset));
-		}
-		if (pIsSyncSample) {
-			*pIsSyncSample = IsSyncSample(sampleId);
-
-			VERBOSE_READ_SAMPLE(m_pFile->GetVerbosity(),
-				printf("ReadSample:  isSyncSample %u\n",
-					*pIsSyncSample));
-		}
+		ReadSampleInfo(sampleId, 
+			pStartTime, pDuration, pRenderingOffset, pIsSyncSample);
 	}
 
 	catch (MP4Error* e) {
@@ -342,6 +333,76 @@ void MP4Track::ReadSample(
 	}
 }
 
+void MP4Track::ReadSamplePtr(
+	MP4SampleId sampleId,
+	const u_int8_t** ppBytes, 
+	u_int32_t* pNumBytes, 
+	MP4Timestamp* pStartTime, 
+	MP4Duration* pDuration,
+	MP4Duration* pRenderingOffset, 
+	bool* pIsSyncSample)
+{
+	if (sampleId == MP4_INVALID_SAMPLE_ID) {
+		throw new MP4Error("sample id can't be zero", 
+			"MP4Track::ReadSamplePtr");
+	}
+
+	if (!m_pFile->IsMapped()) {
+		throw new MP4Error("file is not memory mapped",
+			"MP4Track::ReadSamplePtr");
+	}
+
+	// samples in other files can only be copied by ReadSample
+	if (GetSampleFile(sampleId) != NULL) {
+		throw new MP4Error("sample is located in another file",
+			"MP4Track::ReadSamplePtr");
+	}
+
+	u_int64_t fileOffset = GetSampleFileOffset(sampleId);
+	u_int32_t sampleSize = GetSampleSize(sampleId);
+
+	VERBOSE_READ_SAMPLE(m_pFile->GetVerbosity(),
+		printf("ReadSamplePtr: track %u id %u offset 0x"X64" size %u (0x%x)\n",
+			m_trackId, sampleId, fileOffset, sampleSize, sampleSize));
+
+	*ppBytes = m_pFile->GetMappedBytes(fileOffset, sampleSize);
+	*pNumBytes = sampleSize;
+
+	ReadSampleInfo(sampleId, 
+		pStartTime, pDuration, pRenderingOffset, pIsSyncSample);
+}
+
+void MP4Track::ReadSampleInfo(
+	MP4SampleId sampleId,
+	MP4Timestamp* pStartTime, 
+	MP4Duration* pDuration,
+	MP4Duration* pRenderingOffset, 
+	bool* pIsSyncSample)
+{
+	if (pStartTime || pDuration) {
+		GetSampleTimes(sampleId, pStartTime, pDuration);
+
+		VERBOSE_READ_SAMPLE(m_pFile->GetVerbosity(),
+			printf("ReadSample:  start "U64" duration "D64"\n",
+				(pStartTime ? *pStartTime : 0), 
+				(pDuration ? *pDuration : 0)));
+	}
+	if (pRenderingOffset) {
+		*pRenderingOffset = GetSampleRenderingOffset(sampleId);
+
+		VERBOSE_READ_SAMPLE(m_pFile->GetVerbosity(),
+			printf("ReadSample:  renderingOffset "D64"\n",
+				*pRenderingOffset));
+	}
+	if (pIsSyncSample) {
+		*pIsSyncSample = IsSyncSample(sampleId);
+
+		VERBOSE_READ_SAMPLE(m_pFile->GetVerbosity(),
+			printf("ReadSample:  isSyncSample %u\n",
+				*pIsSyncSample));
+	}
+}
+
 void MP4Track::ReadSampleFragment(
 	MP4SampleId sampleId,
 	u_int32_t sampleOffset,
@@ -381,6 +442,67 @@ void MP4Track::WriteSample(
 	MP4Duration duration, 
 	MP4Duration renderingOffset, 
 	bool isSyncSample)
+{
+	if (pBytes == NULL && numBytes > 0) {
+		throw new MP4Error("no sample data", "MP4WriteSample");
+	}
+
+	// append sample bytes to chunk buffer
+	u_int8_t* pDest = BeginWriteSample(numBytes);
+	if (numBytes > 0) {
+		memcpy(pDest, pBytes, numBytes);
+	}
+
+	EndWriteSample(numBytes, duration, renderingOffset, isSyncSample);
+}
+
+void MP4Track::WriteSampleV(
+	const struct iovec* pIov,
+	u_int32_t iovCount,
+	MP4Duration duration, 
+	MP4Duration renderingOffset, 
+	bool isSyncSample)
+{
+	if (pIov == NULL && iovCount > 0) {
+		throw new MP4Error("no sample data", "MP4WriteSampleV");
+	}
+
+	u_int64_t numBytes = 0;
+	for (u_int32_t i = 0; i < iovCount; i++) {
+		if (pIov[i].iov_base == NULL && pIov[i].iov_len > 0) {
+			throw new MP4Error("no sample data", "MP4WriteSampleV");
+		}
+		numBytes += pIov[i].iov_len;
+	}
+	if (numBytes > 0xFFFFFFFF) {
+		throw new MP4Error("sample is too large", "MP4WriteSampleV");
+	}
+
+	// gather the pieces into the chunk buffer as one sample
+	u_int8_t* pDest = BeginWriteSample((u_int32_t)numBytes);
+	for (u_int32_t i = 0; i < iovCount; i++) {
+		if (pIov[i].iov_len > 0) {
+			memcpy(pDest, pIov[i].iov_base, pIov[i].iov_len);
+			pDest += pIov[i].iov_len;
+		}
+	}
+
+	EndWriteSample((u_int32_t)numBytes, duration, renderingOffset, isSyncSample);
+}
+
+u_int8_t* MP4Track::BeginWriteSample(u_int32_t maxBytes)
+{
+	ReserveChunkBuffer(maxBytes);
+	m_writeSampleMaxBytes = maxBytes;
+
+	return &m_pChunkBuffer[m_chunkBufferSize];
+}
+
+void MP4Track::EndWriteSample(
+	u_int32_t numBytes,
+	MP4Duration duration, 
+	MP4Duration renderingOffset, 
+	bool isSyncSample)
 {
 	u_int8_t curMode = 0;
 
@@ -388,10 +510,17 @@ void MP4Track::WriteSample(
 		printf("WriteSample: track %u id %u size %u (0x%x) ",
 			m_trackId, m_writeSampleId, numBytes, numBytes));
 
-	if (pBytes == NULL && numBytes > 0) {
-		throw new MP4Error("no sample data", "MP4WriteSample");
+	// each reservation is good for one sample
+	u_int32_t maxBytes = m_writeSampleMaxBytes;
+	m_writeSampleMaxBytes = 0;
+	if (numBytes > maxBytes) {
+		throw new MP4Error("sample is larger than the reserved space",
+			"MP4EndWriteSample");
 	}
 
+	// the sample bytes are already in place after the pending chunk
+	const u_int8_t* pBytes = &m_pChunkBuffer[m_chunkBufferSize];
+
 	if (m_isAmr == AMR_UNINITIALIZED ) {
 		// figure out if this is an AMR audio track
 		if (m_pTrakAtom->FindAtom("trak.mdia.minf.stbl.stsd.samr") ||
@@ -414,28 +543,39 @@ void MP4Track::WriteSample(
 	VERBOSE_WRITE_SAMPLE(m_pFile->GetVerbosity(),
 		printf("duration "U64"\n", duration));
 
+	if (m_pFile->IsFragmented()) {
+		// the file may cut a fragment first, this sample then
+		// starts the next one
+		u_int32_t pendingBytes = m_chunkBufferSize;
+		m_pFile->CheckFragment(this, isSyncSample);
+		if (m_chunkBufferSize != pendingBytes) {
+			memmove(m_pChunkBuffer, &m_pChunkBuffer[pendingBytes], numBytes);
+		}
+
+		AddFragmentSample(numBytes, duration, renderingOffset, isSyncSample);
+
+		UpdateDurations(duration);
+
+		UpdateModificationTimes();
+
+		m_writeSampleId++;
+		return;
+	}
+
 	if ((m_isAmr == AMR_TRUE) &&
 		(m_curMode != curMode)) {
+		// flush the pending chunk, then move this sample to the front
+		u_int32_t pendingBytes = m_chunkBufferSize;
 		WriteChunkBuffer();
+		memmove(m_pChunkBuffer, &m_pChunkBuffer[pendingBytes], numBytes);
 		m_curMode = curMode;
 	}
 
-	// append sample bytes to chunk buffer
-	m_pChunkBuffer = (u_int8_t*)MP4Realloc(m_pChunkBuffer, 
-		m_chunkBufferSize + numBytes);
-	if (m_pChunkBuffer == NULL) return;
-	memcpy(&m_pChunkBuffer[m_chunkBufferSize], pBytes, numBytes);
 	m_chunkBufferSize += numBytes;
 	m_chunkSamples++;
 	m_chunkDuration += duration;
 
-	UpdateSampleSizes(m_writeSampleId, numBytes);
-
-	UpdateSampleTimes(duration);
-
-	UpdateRenderingOffsets(m_writeSampleId, renderingOffset);
-
-	UpdateSyncSamples(m_writeSampleId, isSyncSample);
+	m_sampleIndex.Add(numBytes, duration, renderingOffset, isSyncSample);
 
 	if (IsChunkFull(m_writeSampleId)) {
 		WriteChunkBuffer();
@@ -449,6 +589,31 @@ void MP4Track::WriteSample(
 	m_writeSampleId++;
 }
 
+void MP4Track::ReserveChunkBuffer(u_int32_t numBytes)
+{
+	u_int64_t needed = (u_int64_t)m_chunkBufferSize + numBytes;
+
+	if (needed <= m_chunkBufferCapacity && m_pChunkBuffer) {
+		return;
+	}
+	if (needed > 0xFFFFFFFF) {
+		throw new MP4Error("chunk is too large", "MP4Track::ReserveChunkBuffer");
+	}
+
+	// grow geometrically, the buffer is reused for every chunk
+	// so a track settles after a few chunks and stops reallocating
+	u_int64_t capacity = m_chunkBufferCapacity ? m_chunkBufferCapacity : 4096;
+	while (capacity < needed) {
+		capacity *= 2;
+	}
+	if (capacity > 0xFFFFFFFF) {
+		capacity = 0xFFFFFFFF;
+	}
+
+	m_pChunkBuffer = (u_int8_t*)MP4Realloc(m_pChunkBuffer, (u_int32_t)capacity);
+	m_chunkBufferCapacity = (u_int32_t)capacity;
+}
+
 void MP4Track::WriteChunkBuffer()
 {
 	if (m_chunkBufferSize == 0) {
@@ -465,15 +630,15 @@ void MP4Track::WriteChunkBuffer()
 			m_trackId, chunkOffset, m_chunkBufferSize, 
 			m_chunkBufferSize, m_chunkSamples));
 
-	UpdateSampleToChunk(m_writeSampleId, 
+	// the chunk ends with the last sample counted so far, which is not
+	// m_writeSampleId when the buffer is flushed outside EndWriteSample
+	UpdateSampleToChunk(GetNumberOfSamples(), 
 		m_pChunkCountProperty->GetValue() + 1, 
 		m_chunkSamples);
 
 	UpdateChunkOffsets(chunkOffset);
 
-	// clean up chunk buffer
-	MP4Free(m_pChunkBuffer);
-	m_pChunkBuffer = NULL;
+	// reset chunk buffer, the memory is kept for the next chunk
 	m_chunkBufferSize = 0;
 	m_chunkSamples = 0;
 	m_chunkDuration = 0;
@@ -484,6 +649,8 @@ void MP4Track::FinishWrite()
 	// write out any remaining samples in chunk buffer
 	WriteChunkBuffer();
 
+	UpdateSampleTables();
+
 	if (m_pStszFixedSampleSizeProperty == NULL &&
 	    m_stsz_sample_bits == 4) {
 	  if (m_have_stz2_4bit_sample) {
@@ -528,11 +695,134 @@ bool MP4Track::IsChunkFull(MP4SampleId sampleId)
 
 u_int32_t MP4Track::GetNumberOfSamples()
 {
-	return m_pStszSampleCountProperty->GetValue();
+	return m_pStszSampleCountProperty->GetValue() + m_sampleIndex.GetCount();
+}
+
+void MP4Track::MoveSampleIndex()
+{
+	// the index is emptied first, so the tables count every sample
+	// taken from it as the last one written, as if it was written now
+	MP4SampleIndex samples;
+	samples.Swap(m_sampleIndex);
+
+	u_int32_t numSamples = samples.GetCount();
+	MP4SampleId firstSampleId = GetNumberOfSamples() + 1;
+	MP4SampleId endSampleId = firstSampleId + numSamples;
+	MP4SampleId sampleId;
+
+	// sizes a run at a time while they fit a fixed size, then straight
+	// into the stsz table once it holds a size per sample
+	MP4RunColumnCursor sizes(samples.GetSizes());
+	for (sampleId = firstSampleId; sampleId < endSampleId; ) {
+		u_int64_t sampleSize;
+		u_int32_t runLength = sizes.GetNextRun(&sampleSize);
+
+		UpdateSampleSizes(sampleId, (u_int32_t)sampleSize);
+		sampleId++;
+		runLength--;
+
+		if (m_pStszFixedSampleSizeProperty != NULL
+		  && m_pStszFixedSampleSizeProperty->GetValue() != 0) {
+			m_pStszSampleCountProperty->IncrementValue(runLength);
+			sampleId += runLength;
+			continue;
+		}
+
+		if (m_pStszSampleSizeProperty->GetType() != Integer32Property
+		  || m_bytesPerSample > 1) {
+			for (; runLength > 0; runLength--) {
+				UpdateSampleSizes(sampleId++, (u_int32_t)sampleSize);
+			}
+			continue;
+		}
+
+		MP4Integer32Property* pSizes = 
+			(MP4Integer32Property*)m_pStszSampleSizeProperty;
+		u_int32_t numSizes = endSampleId - sampleId;
+		u_int32_t firstSize = pSizes->GetCount();
+		pSizes->SetCount(firstSize + numSizes);
+		u_int32_t* pValues = pSizes->GetValues() + firstSize;
+
+		for (u_int32_t i = 0; i < numSizes; i++) {
+			pValues[i] = i < runLength ? (u_int32_t)sampleSize : 
+				(u_int32_t)sizes.GetNext();
+		}
+		m_pStszSampleCountProperty->IncrementValue(numSizes);
+		break;
+	}
+
+	MP4RunColumnCursor durations(samples.GetDurations());
+	AppendSampleRuns(durations, samples.GetDurations()->GetNumberOfRuns(),
+		numSamples, m_pSttsCountProperty, m_pSttsSampleCountProperty,
+		m_pSttsSampleDeltaProperty);
+
+	// rendering offsets through UpdateRenderingOffsets until it has
+	// created the ctts atom
+	MP4RunColumnCursor renderingOffsets(samples.GetRenderingOffsets());
+	for (sampleId = firstSampleId; 
+	  sampleId < endSampleId && m_pCttsCountProperty == NULL; ) {
+		MP4Duration renderingOffset;
+		u_int32_t runLength = 
+			renderingOffsets.GetNextRun(&renderingOffset);
+
+		UpdateRenderingOffsets(sampleId, renderingOffset, runLength);
+		sampleId += runLength;
+	}
+	if (sampleId < endSampleId) {
+		AppendSampleRuns(renderingOffsets, 
+			samples.GetRenderingOffsets()->GetNumberOfRuns(),
+			endSampleId - sampleId, m_pCttsCountProperty, 
+			m_pCttsSampleCountProperty, m_pCttsSampleOffsetProperty);
+	}
+
+	MP4RunColumnCursor syncFlags(samples.GetSyncFlags());
+	for (sampleId = firstSampleId; sampleId < endSampleId; ) {
+		u_int64_t isSyncSample;
+		u_int32_t runLength = syncFlags.GetNextRun(&isSyncSample);
+
+		UpdateSyncSamples(sampleId, isSyncSample != 0, runLength);
+		sampleId += runLength;
+	}
+}
+
+void MP4Track::AppendSampleRuns(MP4RunColumnCursor& cursor, 
+	u_int32_t maxNumRuns, u_int32_t numSamples,
+	MP4Integer32Property* pCountProperty,
+	MP4Integer32Property* pSampleCountProperty,
+	MP4Integer32Property* pValueProperty)
+{
+	// the entries grow once for every run, a run equal to the last
+	// entry adds to its sample count like UpdateSampleTimes does
+	u_int32_t firstEntry = pCountProperty->GetValue();
+	u_int32_t numEntries = firstEntry;
+	pSampleCountProperty->SetCount(firstEntry + maxNumRuns);
+	pValueProperty->SetCount(firstEntry + maxNumRuns);
+	u_int32_t* pSampleCounts = pSampleCountProperty->GetValues();
+	u_int32_t* pValues = pValueProperty->GetValues();
+
+	while (numSamples) {
+		u_int64_t value;
+		u_int32_t runLength = cursor.GetNextRun(&value);
+
+		if (numEntries && value == pValues[numEntries - 1]) {
+			pSampleCounts[numEntries - 1] += runLength;
+		} else {
+			pSampleCounts[numEntries] = runLength;
+			pValues[numEntries] = (u_int32_t)value;
+			numEntries++;
+		}
+		numSamples -= runLength;
+	}
+
+	pSampleCountProperty->SetCount(numEntries);
+	pValueProperty->SetCount(numEntries);
+	pCountProperty->IncrementValue(numEntries - firstEntry);
 }
 
 u_int32_t MP4Track::GetSampleSize(MP4SampleId sampleId)
 {
+  UpdateSampleTables();
+
   if (m_pStszFixedSampleSizeProperty != NULL) {
 	u_int32_t fixedSampleSize = 
 		m_pStszFixedSampleSizeProperty->GetValue(); 
@@ -541,6 +831,8 @@ u_int32_t MP4Track::GetSampleSize(MP4SampleId sampleId)
 	  return fixedSampleSize * m_bytesPerSample;
 	}
   }
+  ReadDeferredTable(m_pStszSampleSizeProperty);
+
   // will have to check for 4 bit sample size here
   if (m_stsz_sample_bits == 4) {
     uint8_t value = m_pStszSampleSizeProperty->GetValue((sampleId - 1) / 2);
@@ -555,6 +847,8 @@ u_int32_t MP4Track::GetSampleSize(MP4SampleId sampleId)
 
 u_int32_t MP4Track::GetMaxSampleSize()
 {
+  UpdateSampleTables();
+
   if (m_pStszFixedSampleSizeProperty != NULL) {
 	u_int32_t fixedSampleSize = 
 		m_pStszFixedSampleSizeProperty->GetValue(); 
@@ -564,6 +858,8 @@ u_int32_t MP4Track::GetMaxSampleSize()
 	}
   }
 
+	ReadDeferredTable(m_pStszSampleSizeProperty);
+
 	u_int32_t maxSampleSize = 0;
 	u_int32_t numSamples = m_pStszSampleSizeProperty->GetCount();
 	for (MP4SampleId sid = 1; sid <= numSamples; sid++) {
@@ -579,6 +875,8 @@ u_int32_t MP4Track::GetMaxSampleSize()
 u_int64_t MP4Track::GetTotalOfSampleSizes()
 {
   uint64_t retval;
+  UpdateSampleTables();
+
   if (m_pStszFixedSampleSizeProperty != NULL) {
 	u_int32_t fixedSampleSize = 
 		m_pStszFixedSampleSizeProperty->GetValue(); 
@@ -593,6 +891,8 @@ u_int64_t MP4Track::GetTotalOfSampleSizes()
   }
 
 	// else non-fixed sample size, sum them
+	ReadDeferredTable(m_pStszSampleSizeProperty);
+
 	u_int64_t totalSampleSizes = 0;
 	u_int32_t numSamples = m_pStszSampleSizeProperty->GetCount();
 	for (MP4SampleId sid = 1; sid <= numSamples; sid++) {
@@ -769,28 +1069,39 @@ u_int32_t MP4Track::GetMaxBitrate()
 	return maxBytesPerSec * 8;
 }
 
+void MP4Track::ReadDeferredTable(MP4Property* pProperty)
+{
+	MP4Atom* pAtom = pProperty->GetParentAtom();
+
+	if (pAtom->IsDeferred()) {
+		pAtom->ReadDeferred();
+	}
+}
+
 u_int32_t MP4Track::GetSampleStscIndex(MP4SampleId sampleId)
 {
-	u_int32_t stscIndex;
+	ReadDeferredTable(m_pStscFirstChunkProperty);
+
 	u_int32_t numStscs = m_pStscCountProperty->GetValue();
 
 	if (numStscs == 0) {
 		throw new MP4Error("No data chunks exist", "GetSampleStscIndex");
 	}
 
-	for (stscIndex = 0; stscIndex < numStscs; stscIndex++) {
+	// binary search for the last entry starting at or before sampleId
+	u_int32_t stscLIndex = 0;
+	u_int32_t stscRIndex = numStscs;
+
+	while (stscRIndex - stscLIndex > 1) {
+		u_int32_t stscIndex = (stscLIndex + stscRIndex) >> 1;
 		if (sampleId < m_pStscFirstSampleProperty->GetValue(stscIndex)) {
-			ASSERT(stscIndex != 0);
-			stscIndex -= 1;
-			break;
+			stscRIndex = stscIndex;
+		} else {
+			stscLIndex = stscIndex;
 		}
 	}
-	if (stscIndex == numStscs) {
-		ASSERT(stscIndex != 0);
-		stscIndex -= 1;
-	}
 
-	return stscIndex;
+	return stscLIndex;
 }
 
 FILE* MP4Track::GetSampleFile(MP4SampleId sampleId)
@@ -881,6 +1192,8 @@ FILE* MP4Track::GetSampleFile(MP4SampleId sampleId)
 
 u_int64_t MP4Track::GetSampleFileOffset(MP4SampleId sampleId)
 {
+	ReadDeferredTable(m_pChunkOffsetProperty);
+
 	u_int32_t stscIndex =
 		GetSampleStscIndex(sampleId);
 
@@ -908,14 +1221,47 @@ u_int64_t MP4Track::GetSampleFileOffset(MP4SampleId sampleId)
 		sampleId - ((sampleId - firstSample) % samplesPerChunk);
 
 	// need cumulative samples sizes from firstSample to sampleId - 1
-	u_int32_t sampleOffset = 0;
-	for (MP4SampleId i = firstSampleInChunk; i < sampleId; i++) {
-		sampleOffset += GetSampleSize(i);
-	}
+	u_int64_t sampleOffset = 
+		GetSampleSizesBefore(sampleId) - GetSampleSizesBefore(firstSampleInChunk);
 
 	return chunkOffset + sampleOffset;
 }
 
+u_int64_t MP4Track::GetSampleSizesBefore(MP4SampleId sampleId)
+{
+	UpdateSampleTables();
+
+	if (m_pStszFixedSampleSizeProperty != NULL) {
+		u_int32_t fixedSampleSize = 
+			m_pStszFixedSampleSizeProperty->GetValue(); 
+
+		if (fixedSampleSize != 0) {
+			u_int64_t sizes = m_bytesPerSample;
+			sizes *= fixedSampleSize;
+			sizes *= (sampleId - 1);
+			return sizes;
+		}
+	}
+
+	// sample sizes never change once written, so the sums only
+	// ever need to be extended up to the requested sample
+	while (m_sampleSizeSumCount < sampleId) {
+		u_int64_t sum = 0;
+		if (m_sampleSizeSumCount > 0) {
+			sum = m_sampleSizeSums[m_sampleSizeSumCount - 1] 
+				+ GetSampleSize(m_sampleSizeSumCount);
+		}
+		if (m_sampleSizeSumCount < m_sampleSizeSums.Size()) {
+			m_sampleSizeSums[m_sampleSizeSumCount] = sum;
+		} else {
+			m_sampleSizeSums.Add(sum);
+		}
+		m_sampleSizeSumCount++;
+	}
+
+	return m_sampleSizeSums[sampleId - 1];
+}
+
 void MP4Track::UpdateSampleToChunk(MP4SampleId sampleId,
 	 MP4ChunkId chunkId, u_int32_t samplesPerChunk)
 {
@@ -952,12 +1298,28 @@ MP4Duration MP4Track::GetFixedSampleDuration()
 {
 	u_int32_t numStts = m_pSttsCountProperty->GetValue();
 
+	// samples still in the index have to agree with the ones in stts
+	if (m_sampleIndex.GetCount()) {
+		MP4Duration duration;
+
+		if (!m_sampleIndex.GetFixedDuration(&duration) || numStts > 1) {
+			return MP4_INVALID_DURATION;
+		}
+		if (numStts == 1
+		  && m_pSttsSampleDeltaProperty->GetValue(0) != duration) {
+			return MP4_INVALID_DURATION;
+		}
+		return duration;
+	}
+
 	if (numStts == 0) {
 		return m_fixedSampleDuration;
 	}
 	if (numStts != 1) {
 		return MP4_INVALID_DURATION;	// sample duration is not fixed
 	}
+	ReadDeferredTable(m_pSttsSampleDeltaProperty);
+
 	return m_pSttsSampleDeltaProperty->GetValue(0);
 }
 
@@ -966,105 +1328,162 @@ void MP4Track::SetFixedSampleDuration(MP4Duration duration)
 	u_int32_t numStts = m_pSttsCountProperty->GetValue();
 
 	// setting this is only allowed before samples have been written
-	if (numStts != 0) {
+	if (numStts != 0 || m_sampleIndex.GetCount() != 0) {
 		return;
 	}
 	m_fixedSampleDuration = duration;
 	return;
 }
 
+void MP4Track::UpdateSttsIndex()
+{
+	UpdateSampleTables();
+	ReadDeferredTable(m_pSttsSampleDeltaProperty);
+
+	u_int32_t numStts = m_pSttsCountProperty->GetValue();
+
+	// only the sample count of the last entry changes while writing,
+	// which doesn't move the start of any entry
+	while (m_sttsIndexCount < numStts) {
+		u_int32_t i = m_sttsIndexCount;
+		MP4SampleId sid = 1;
+		MP4Timestamp elapsed = 0;
+
+		if (i > 0) {
+			u_int32_t sampleCount = 
+				m_pSttsSampleCountProperty->GetValue(i - 1);
+			u_int32_t sampleDelta = 
+				m_pSttsSampleDeltaProperty->GetValue(i - 1);
+
+			sid = m_sttsFirstSamples[i - 1] + sampleCount;
+			elapsed = m_sttsStartTimes[i - 1];
+			elapsed += (u_int64_t)sampleCount * sampleDelta;
+		}
+
+		if (i < m_sttsFirstSamples.Size()) {
+			m_sttsFirstSamples[i] = sid;
+			m_sttsStartTimes[i] = elapsed;
+		} else {
+			m_sttsFirstSamples.Add(sid);
+			m_sttsStartTimes.Add(elapsed);
+		}
+		m_sttsIndexCount++;
+	}
+}
+
+u_int32_t MP4Track::GetSampleSttsIndex(MP4SampleId sampleId)
+{
+	UpdateSttsIndex();
+
+	u_int32_t numStts = m_sttsIndexCount;
+
+	if (numStts == 0 || sampleId == MP4_INVALID_SAMPLE_ID
+	  || sampleId >= m_sttsFirstSamples[numStts - 1] 
+	    + m_pSttsSampleCountProperty->GetValue(numStts - 1)) {
+		throw new MP4Error("sample id out of range", 
+			"MP4Track::GetSampleTimes");
+	}
+
+	// binary search for the last entry starting at or before sampleId
+	u_int32_t sttsLIndex = 0;
+	u_int32_t sttsRIndex = numStts;
+
+	while (sttsRIndex - sttsLIndex > 1) {
+		u_int32_t sttsIndex = (sttsLIndex + sttsRIndex) >> 1;
+		if (sampleId < m_sttsFirstSamples[sttsIndex]) {
+			sttsRIndex = sttsIndex;
+		} else {
+			sttsLIndex = sttsIndex;
+		}
+	}
+
+	return sttsLIndex;
+}
+
 void MP4Track::GetSampleTimes(MP4SampleId sampleId,
 	MP4Timestamp* pStartTime, MP4Duration* pDuration)
 {
-	u_int32_t numStts = m_pSttsCountProperty->GetValue();
-	MP4SampleId sid;
-	MP4Duration elapsed;
-	
-	
-	if (m_cachedSttsSid != MP4_INVALID_SAMPLE_ID && sampleId >= m_cachedSttsSid) {
-		sid	  = m_cachedSttsSid;
-		elapsed	  = m_cachedSttsElapsed;
-	} else {
-		m_cachedSttsIndex = 0;
-		sid	  = 1;
-		elapsed	  = 0;
+	u_int32_t sttsIndex = GetSampleSttsIndex(sampleId);
+
+	u_int32_t sampleDelta = 
+		m_pSttsSampleDeltaProperty->GetValue(sttsIndex);
+
+	if (pStartTime) {
+	  *pStartTime = (sampleId - m_sttsFirstSamples[sttsIndex]);
+	  *pStartTime *= sampleDelta;
+	  *pStartTime += m_sttsStartTimes[sttsIndex];
+	}
+	if (pDuration) {
+		*pDuration = sampleDelta;
 	}
+}
 
-	for (u_int32_t sttsIndex = m_cachedSttsIndex; sttsIndex < numStts; sttsIndex++) {
-		u_int32_t sampleCount = 
-			m_pSttsSampleCountProperty->GetValue(sttsIndex);
-		u_int32_t sampleDelta = 
-			m_pSttsSampleDeltaProperty->GetValue(sttsIndex);
+u_int32_t MP4Track::GetTimeSttsIndex(MP4Timestamp when)
+{
+	UpdateSttsIndex();
 
-		if (sampleId <= sid + sampleCount - 1) {
-			if (pStartTime) {
-			  *pStartTime = (sampleId - sid);
-			  *pStartTime *= sampleDelta;
-			  *pStartTime += elapsed;
-			}
-			if (pDuration) {
-				*pDuration = sampleDelta;
-			}
+	u_int32_t numStts = m_sttsIndexCount;
 
-			m_cachedSttsIndex = sttsIndex;
-			m_cachedSttsSid = sid;
-			m_cachedSttsElapsed = elapsed;
+	if (numStts == 0) {
+		throw new MP4Error("time out of range", 
+			"MP4Track::GetSampleIdFromTime");
+	}
 
-			return;
+	// the first entry whose end is at or after when
+	u_int32_t sttsLIndex = 0;
+	u_int32_t sttsRIndex = numStts - 1;
+
+	while (sttsLIndex < sttsRIndex) {
+		u_int32_t sttsIndex = (sttsLIndex + sttsRIndex) >> 1;
+		if (when <= m_sttsStartTimes[sttsIndex + 1]) {
+			sttsRIndex = sttsIndex;
+		} else {
+			sttsLIndex = sttsIndex + 1;
 		}
-		sid += sampleCount;
-		elapsed += sampleCount * sampleDelta;
 	}
 
-	throw new MP4Error("sample id out of range", 
-		"MP4Track::GetSampleTimes");
+	MP4Timestamp end = m_sttsStartTimes[sttsLIndex];
+	end += (u_int64_t)m_pSttsSampleCountProperty->GetValue(sttsLIndex)
+		* m_pSttsSampleDeltaProperty->GetValue(sttsLIndex);
+
+	if (when > end) {
+		throw new MP4Error("time out of range", 
+			"MP4Track::GetSampleIdFromTime");
+	}
+
+	return sttsLIndex;
 }
 
 MP4SampleId MP4Track::GetSampleIdFromTime(
 	MP4Timestamp when, 
 	bool wantSyncSample) 
 {
-	u_int32_t numStts = m_pSttsCountProperty->GetValue();
-	MP4SampleId sid = 1;
-	MP4Duration elapsed = 0;
-
-	for (u_int32_t sttsIndex = 0; sttsIndex < numStts; sttsIndex++) {
-		u_int32_t sampleCount = 
-			m_pSttsSampleCountProperty->GetValue(sttsIndex);
-		u_int32_t sampleDelta = 
-			m_pSttsSampleDeltaProperty->GetValue(sttsIndex);
-
-		if (sampleDelta == 0 && sttsIndex < numStts - 1) {
-			VERBOSE_READ(m_pFile->GetVerbosity(),
-				printf("Warning: Zero sample duration, stts entry %u\n",
-				sttsIndex));
-		}
+	u_int32_t sttsIndex = GetTimeSttsIndex(when);
 
-		MP4Duration d = when - elapsed;
+	u_int32_t sampleDelta = 
+		m_pSttsSampleDeltaProperty->GetValue(sttsIndex);
 
-		if (d <= sampleCount * sampleDelta) {
-			MP4SampleId sampleId = sid;
-			if (sampleDelta) {
-				sampleId += (d / sampleDelta);
-			}
+	if (sampleDelta == 0 && sttsIndex < m_sttsIndexCount - 1) {
+		VERBOSE_READ(m_pFile->GetVerbosity(),
+			printf("Warning: Zero sample duration, stts entry %u\n",
+			sttsIndex));
+	}
 
-			if (wantSyncSample) {
-				return GetNextSyncSample(sampleId);
-			}
-			return sampleId;
-		}
+	MP4Duration d = when - m_sttsStartTimes[sttsIndex];
 
-		sid += sampleCount;
-		elapsed += sampleCount * sampleDelta;
+	MP4SampleId sampleId = m_sttsFirstSamples[sttsIndex];
+	if (sampleDelta) {
+		sampleId += (d / sampleDelta);
 	}
 
-	throw new MP4Error("time out of range", 
-		"MP4Track::GetSampleIdFromTime");
-
-	return 0; // satisfy MS compiler
+	if (wantSyncSample) {
+		return GetNextSyncSample(sampleId);
+	}
+	return sampleId;
 }
 
-void MP4Track::UpdateSampleTimes(MP4Duration duration)
+void MP4Track::UpdateSampleTimes(MP4Duration duration,
+	u_int32_t numSamples)
 {
 	u_int32_t numStts = m_pSttsCountProperty->GetValue();
 
@@ -1072,43 +1491,78 @@ void MP4Track::UpdateSampleTimes(MP4Duration duration)
 	if (numStts 
 	  && duration == m_pSttsSampleDeltaProperty->GetValue(numStts-1)) {
 		// increment last entry sampleCount
-		m_pSttsSampleCountProperty->IncrementValue(1, numStts-1);
+		m_pSttsSampleCountProperty->IncrementValue(numSamples, numStts-1);
 
 	} else {
-		// add stts entry, sampleCount = 1, sampleDuration = duration
-		m_pSttsSampleCountProperty->AddValue(1);
+		// add stts entry, sampleCount = numSamples, sampleDuration = duration
+		m_pSttsSampleCountProperty->AddValue(numSamples);
 		m_pSttsSampleDeltaProperty->AddValue(duration);
 		m_pSttsCountProperty->IncrementValue();;
 	}
 }
 
+void MP4Track::UpdateCttsIndex()
+{
+	UpdateSampleTables();
+	ReadDeferredTable(m_pCttsSampleOffsetProperty);
+
+	u_int32_t numCtts = m_pCttsCountProperty->GetValue();
+
+	while (m_cttsIndexCount < numCtts) {
+		u_int32_t i = m_cttsIndexCount;
+		MP4SampleId sid = 1;
+
+		if (i > 0) {
+			sid = m_cttsFirstSamples[i - 1] 
+				+ m_pCttsSampleCountProperty->GetValue(i - 1);
+		}
+
+		if (i < m_cttsFirstSamples.Size()) {
+			m_cttsFirstSamples[i] = sid;
+		} else {
+			m_cttsFirstSamples.Add(sid);
+		}
+		m_cttsIndexCount++;
+	}
+}
+
 u_int32_t MP4Track::GetSampleCttsIndex(MP4SampleId sampleId, 
 	MP4SampleId* pFirstSampleId)
 {
-	u_int32_t numCtts = m_pCttsCountProperty->GetValue();
+	UpdateCttsIndex();
 
-	MP4SampleId sid = 1;
-	
-	for (u_int32_t cttsIndex = 0; cttsIndex < numCtts; cttsIndex++) {
-		u_int32_t sampleCount = 
-			m_pCttsSampleCountProperty->GetValue(cttsIndex);
+	u_int32_t numCtts = m_cttsIndexCount;
 
-		if (sampleId <= sid + sampleCount - 1) {
-			if (pFirstSampleId) {
-				*pFirstSampleId = sid;
-			}
-			return cttsIndex;
+	if (numCtts == 0 || sampleId == MP4_INVALID_SAMPLE_ID
+	  || sampleId >= m_cttsFirstSamples[numCtts - 1] 
+	    + m_pCttsSampleCountProperty->GetValue(numCtts - 1)) {
+		throw new MP4Error("sample id out of range", 
+			"MP4Track::GetSampleCttsIndex");
+	}
+
+	// binary search for the last entry starting at or before sampleId
+	u_int32_t cttsLIndex = 0;
+	u_int32_t cttsRIndex = numCtts;
+
+	while (cttsRIndex - cttsLIndex > 1) {
+		u_int32_t cttsIndex = (cttsLIndex + cttsRIndex) >> 1;
+		if (sampleId < m_cttsFirstSamples[cttsIndex]) {
+			cttsRIndex = cttsIndex;
+		} else {
+			cttsLIndex = cttsIndex;
 		}
-		sid += sampleCount;
 	}
 
-	throw new MP4Error("sample id out of range", 
-		"MP4Track::GetSampleCttsIndex");
-	return 0; // satisfy MS compiler
+	if (pFirstSampleId) {
+		*pFirstSampleId = m_cttsFirstSamples[cttsLIndex];
+	}
+	return cttsLIndex;
 }
 
 MP4Duration MP4Track::GetSampleRenderingOffset(MP4SampleId sampleId)
 {
+	UpdateSampleTables();
+
 	if (m_pCttsCountProperty == NULL) {
 		return 0;
 	}
@@ -1122,7 +1576,7 @@ MP4Duration MP4Track::GetSampleRenderingOffset(MP4SampleId sampleId)
 }
 
 void MP4Track::UpdateRenderingOffsets(MP4SampleId sampleId, 
-	MP4Duration renderingOffset)
+	MP4Duration renderingOffset, u_int32_t numSamples)
 {
 	// if ctts atom doesn't exist
 	if (m_pCttsCountProperty == NULL) {
@@ -1167,11 +1621,12 @@ void MP4Track::UpdateRenderingOffsets(MP4SampleId sampleId,
 	   == m_pCttsSampleOffsetProperty->GetValue(numCtts-1)) {
 
 		// increment last entry sampleCount
-		m_pCttsSampleCountProperty->IncrementValue(1, numCtts-1);
+		m_pCttsSampleCountProperty->IncrementValue(numSamples, numCtts-1);
 
 	} else {
-		// add ctts entry, sampleCount = 1, sampleOffset = renderingOffset
-		m_pCttsSampleCountProperty->AddValue(1);
+		// add ctts entry, sampleCount = numSamples, 
+		// sampleOffset = renderingOffset
+		m_pCttsSampleCountProperty->AddValue(numSamples);
 		m_pCttsSampleOffsetProperty->AddValue(renderingOffset);
 		m_pCttsCountProperty->IncrementValue();
 	}
@@ -1180,6 +1635,8 @@ void MP4Track::UpdateRenderingOffsets(MP4SampleId sampleId,
 void MP4Track::SetSampleRenderingOffset(MP4SampleId sampleId,
 	 MP4Duration renderingOffset)
 {
+	UpdateSampleTables();
+
 	// check if any ctts entries exist
 	if (m_pCttsCountProperty == NULL
 	  || m_pCttsCountProperty->GetValue() == 0) {
@@ -1213,6 +1670,12 @@ void MP4Track::SetSampleRenderingOffset(MP4SampleId sampleId,
 	u_int32_t sampleCount =
 		m_pCttsSampleCountProperty->GetValue(cttsIndex);
 
+	// entries from cttsIndex on are split below, the ones before keep
+	// their first sample ids
+	if (m_cttsIndexCount > cttsIndex) {
+		m_cttsIndexCount = cttsIndex;
+	}
+
 	// if this sample has it's own ctts entry
 	if (sampleCount == 1) {
 		// then just set the value, 
@@ -1276,9 +1739,12 @@ void MP4Track::SetSampleRenderingOffset(MP4SampleId sampleId,
 
 bool MP4Track::IsSyncSample(MP4SampleId sampleId)
 {
+	UpdateSampleTables();
+
 	if (m_pStssCountProperty == NULL) {
 		return true;
 	}
+	ReadDeferredTable(m_pStssSampleProperty);
 
 	u_int32_t numStss = m_pStssCountProperty->GetValue();
 	u_int32_t stssLIndex = 0;
@@ -1306,20 +1772,30 @@ bool MP4Track::IsSyncSample(MP4SampleId sampleId)
 // N.B. "next" is inclusive of this sample id
 MP4SampleId MP4Track::GetNextSyncSample(MP4SampleId sampleId)
 {
+	UpdateSampleTables();
+
 	if (m_pStssCountProperty == NULL) {
 		return sampleId;
 	}
+	ReadDeferredTable(m_pStssSampleProperty);
 
 	u_int32_t numStss = m_pStssCountProperty->GetValue();
-	
-	for (u_int32_t stssIndex = 0; stssIndex < numStss; stssIndex++) {
-		MP4SampleId syncSampleId = 
-			m_pStssSampleProperty->GetValue(stssIndex);
 
-		if (sampleId > syncSampleId) {
-			continue;
+	// binary search for the first sync sample at or after sampleId
+	u_int32_t stssLIndex = 0;
+	u_int32_t stssRIndex = numStss;
+
+	while (stssLIndex < stssRIndex) {
+		u_int32_t stssIndex = (stssLIndex + stssRIndex) >> 1;
+		if (m_pStssSampleProperty->GetValue(stssIndex) < sampleId) {
+			stssLIndex = stssIndex + 1;
+		} else {
+			stssRIndex = stssIndex;
 		}
-		return syncSampleId;
+	}
+
+	if (stssLIndex < numStss) {
+		return m_pStssSampleProperty->GetValue(stssLIndex);
 	}
 
 	// LATER check stsh for alternate sample
@@ -1327,13 +1803,24 @@ MP4SampleId MP4Track::GetNextSyncSample(MP4SampleId sampleId)
 	return MP4_INVALID_SAMPLE_ID;
 }
 
-void MP4Track::UpdateSyncSamples(MP4SampleId sampleId, bool isSyncSample)
+void MP4Track::UpdateSyncSamples(MP4SampleId sampleId, bool isSyncSample,
+	u_int32_t numSamples)
 {
   if (isSyncSample) {
-    // if stss atom exists, add entry
+    // if stss atom exists, add entries
     if (m_pStssCountProperty) {
-      m_pStssSampleProperty->AddValue(sampleId);
-      m_pStssCountProperty->IncrementValue();
+      if (numSamples == 1) {
+	m_pStssSampleProperty->AddValue(sampleId);
+      } else {
+	// a run of sync samples grows the table once
+	u_int32_t count = m_pStssSampleProperty->GetCount();
+	m_pStssSampleProperty->SetCount(count + numSamples);
+	u_int32_t* pValues = m_pStssSampleProperty->GetValues() + count;
+	for (u_int32_t i = 0; i < numSamples; i++) {
+	  pValues[i] = sampleId + i;
+	}
+      }
+      m_pStssCountProperty->IncrementValue(numSamples);
     } // else nothing to do (yet)
 
   } else { // !isSyncSample
@@ -1351,11 +1838,13 @@ void MP4Track::UpdateSyncSamples(MP4SampleId sampleId, bool isSyncSample)
 			      (MP4Property**)&m_pStssSampleProperty));
 
       // set values for all samples that came before this one
-      uint32_t samples = GetNumberOfSamples();
-      for (MP4SampleId sid = 1; sid < samples; sid++) {
-	m_pStssSampleProperty->AddValue(sid);
-	m_pStssCountProperty->IncrementValue();
+      u_int32_t count = m_pStssSampleProperty->GetCount();
+      m_pStssSampleProperty->SetCount(count + sampleId - 1);
+      u_int32_t* pValues = m_pStssSampleProperty->GetValues() + count;
+      for (MP4SampleId sid = 1; sid < sampleId; sid++) {
+	pValues[sid - 1] = sid;
       }
+      m_pStssCountProperty->IncrementValue(sampleId - 1);
     } // else nothing to do
   }
 }
@@ -1413,24 +1902,34 @@ void MP4Track::UpdateModificationTimes()
 
 u_int32_t MP4Track::GetNumberOfChunks()
 {
+	ReadDeferredTable(m_pChunkOffsetProperty);
+
 	return m_pChunkOffsetProperty->GetCount();
 }
 
 u_int32_t MP4Track::GetChunkStscIndex(MP4ChunkId chunkId)
 {
-	u_int32_t stscIndex;
+	ReadDeferredTable(m_pStscFirstChunkProperty);
+
 	u_int32_t numStscs = m_pStscCountProperty->GetValue();
 
 	ASSERT(chunkId);
 	ASSERT(numStscs > 0);
 
-	for (stscIndex = 0; stscIndex < numStscs; stscIndex++) {
+	// binary search for the last entry starting at or before chunkId
+	u_int32_t stscLIndex = 0;
+	u_int32_t stscRIndex = numStscs;
+
+	while (stscRIndex - stscLIndex > 1) {
+		u_int32_t stscIndex = (stscLIndex + stscRIndex) >> 1;
 		if (chunkId < m_pStscFirstChunkProperty->GetValue(stscIndex)) {
-			ASSERT(stscIndex != 0);
-			break;
+			stscRIndex = stscIndex;
+		} else {
+			stscLIndex = stscIndex;
 		}
 	}
-	return stscIndex - 1;
+
+	return stscLIndex;
 }
 
 MP4Timestamp MP4Track::GetChunkTime(MP4ChunkId chunkId)
@@ -1473,12 +1972,11 @@ u_int32_t MP4Track::GetChunkSize(MP4ChunkId chunkId)
 		firstSample + ((chunkId - firstChunkId) * samplesPerChunk);
 
 	// need cumulative sizes of samples in chunk 
-	u_int32_t chunkSize = 0;
-	for (u_int32_t i = 0; i < samplesPerChunk; i++) {
-		chunkSize += GetSampleSize(firstSampleInChunk + i);
-	}
+	u_int64_t chunkSize = 
+		GetSampleSizesBefore(firstSampleInChunk + samplesPerChunk)
+		- GetSampleSizesBefore(firstSampleInChunk);
 
-	return chunkSize;
+	return (u_int32_t)chunkSize;
 }
 
 void MP4Track::ReadChunk(MP4ChunkId chunkId, 
@@ -1488,6 +1986,8 @@ void MP4Track::ReadChunk(MP4ChunkId chunkId,
 	ASSERT(ppChunk);
 	ASSERT(pChunkSize);
 
+	ReadDeferredTable(m_pChunkOffsetProperty);
+
 	u_int64_t chunkOffset = 
 		m_pChunkOffsetProperty->GetValue(chunkId - 1);
 
@@ -1533,6 +2033,177 @@ void MP4Track::RewriteChunk(MP4ChunkId chunkId,
 			m_trackId, chunkId, chunkOffset, chunkSize, chunkSize)); 
 }
 
+bool MP4Track::CanShiftChunkOffsets(u_int64_t delta)
+{
+	u_int32_t numChunks = GetNumberOfChunks();
+
+	if (numChunks == 0 
+	  || m_pChunkOffsetProperty->GetType() != Integer32Property) {
+		return true;
+	}
+
+	// chunks are written in file order, the last one is the furthest
+	u_int64_t lastOffset = m_pChunkOffsetProperty->GetValue(numChunks - 1);
+
+	return lastOffset + delta <= 0xFFFFFFFF;
+}
+
+void MP4Track::ShiftChunkOffsets(u_int64_t delta)
+{
+	u_int32_t numChunks = GetNumberOfChunks();
+
+	for (u_int32_t i = 0; i < numChunks; i++) {
+		m_pChunkOffsetProperty->SetValue(
+			m_pChunkOffsetProperty->GetValue(i) + delta, i);
+	}
+}
+
+void MP4Track::BeginFragmentedWrite(MP4Atom* pMvexAtom, MP4Atom* pMfraAtom)
+{
+	// samples carry their own description index, duration, size and flags
+	MP4Atom* pTrexAtom = m_pFile->AddChildAtom(pMvexAtom, "trex");
+	MP4Integer32Property* pProperty;
+
+	(void)pTrexAtom->FindProperty("trex.trackId", 
+		(MP4Property**)&pProperty);
+	pProperty->SetValue(m_trackId);
+	(void)pTrexAtom->FindProperty("trex.defaultSampleDesriptionIndex", 
+		(MP4Property**)&pProperty);
+	pProperty->SetValue(1);
+
+	// mfro stays the last child of mfra
+	m_pTfraAtom = (MP4TfraAtom*)m_pFile->InsertChildAtom(pMfraAtom, "tfra",
+		pMfraAtom->GetNumberOfChildAtoms() - 1);
+	(void)m_pTfraAtom->FindProperty("tfra.trackId", 
+		(MP4Property**)&pProperty);
+	pProperty->SetValue(m_trackId);
+}
+
+void MP4Track::AddFragmentSample(
+	u_int32_t numBytes,
+	MP4Duration duration, 
+	MP4Duration renderingOffset, 
+	bool isSyncSample)
+{
+	if (duration > 0xFFFFFFFF || renderingOffset > 0xFFFFFFFF) {
+		throw new MP4Error("duration or rendering offset is too large",
+			"MP4Track::AddFragmentSample");
+	}
+
+	// sync samples don't depend on others, the rest do
+	u_int32_t flags = isSyncSample ? 0x02000000 : 0x01010000;
+	u_int32_t i = m_fragmentSamples;
+
+	if (i < m_fragmentSampleSizes.Size()) {
+		m_fragmentSampleSizes[i] = numBytes;
+		m_fragmentSampleDurations[i] = (u_int32_t)duration;
+		m_fragmentSampleFlags[i] = flags;
+		m_fragmentRenderingOffsets[i] = (u_int32_t)renderingOffset;
+	} else {
+		m_fragmentSampleSizes.Add(numBytes);
+		m_fragmentSampleDurations.Add((u_int32_t)duration);
+		m_fragmentSampleFlags.Add(flags);
+		m_fragmentRenderingOffsets.Add((u_int32_t)renderingOffset);
+	}
+
+	if (isSyncSample && m_fragmentSyncSample == 0) {
+		m_fragmentSyncSample = i + 1;
+		m_fragmentSyncTime = 
+			m_fragmentStartTime + m_fragmentDuration + renderingOffset;
+	}
+
+	m_fragmentSamples++;
+	m_fragmentDuration += duration;
+	m_chunkBufferSize += numBytes;
+}
+
+MP4Atom* MP4Track::AddFragmentTraf(MP4Atom* pMoofAtom)
+{
+	MP4Atom* pTrafAtom = m_pFile->AddChildAtom(pMoofAtom, "traf");
+	MP4Integer32Property* pProperty;
+
+	// absolute data offset, the file sets it once the moof size is known
+	MP4TfhdAtom* pTfhdAtom = (MP4TfhdAtom*)pTrafAtom->FindAtom("traf.tfhd");
+	pTfhdAtom->SetFlags(0x01);
+	pTfhdAtom->AddProperties(0x01);
+	(void)pTfhdAtom->FindProperty("tfhd.trackId", 
+		(MP4Property**)&pProperty);
+	pProperty->SetValue(m_trackId);
+
+	MP4Integer64Property* pTimeProperty;
+	MP4Atom* pTfdtAtom = m_pFile->AddChildAtom(pTrafAtom, "tfdt");
+	(void)pTfdtAtom->FindProperty("tfdt.baseMediaDecodeTime", 
+		(MP4Property**)&pTimeProperty);
+	pTimeProperty->SetValue(m_fragmentStartTime);
+
+	// composition offsets only when some sample has one
+	u_int32_t flags = 0x100 | 0x200 | 0x400;
+	for (u_int32_t i = 0; i < m_fragmentSamples; i++) {
+		if (m_fragmentRenderingOffsets[i] != 0) {
+			flags |= 0x800;
+			break;
+		}
+	}
+
+	MP4TrunAtom* pTrunAtom = 
+		(MP4TrunAtom*)m_pFile->AddChildAtom(pTrafAtom, "trun");
+	pTrunAtom->SetFlags(flags);
+	(void)pTrunAtom->FindProperty("trun.sampleCount", 
+		(MP4Property**)&pProperty);
+	pProperty->SetValue(m_fragmentSamples);
+	pTrunAtom->AddProperties(flags);
+
+	MP4Integer32Property* pDurationProperty;
+	MP4Integer32Property* pSizeProperty;
+	MP4Integer32Property* pFlagsProperty;
+	MP4Integer32Property* pOffsetProperty = NULL;
+
+	(void)pTrunAtom->FindProperty("trun.samples.sampleDuration", 
+		(MP4Property**)&pDurationProperty);
+	(void)pTrunAtom->FindProperty("trun.samples.sampleSize", 
+		(MP4Property**)&pSizeProperty);
+	(void)pTrunAtom->FindProperty("trun.samples.sampleFlags", 
+		(MP4Property**)&pFlagsProperty);
+	if (flags & 0x800) {
+		(void)pTrunAtom->FindProperty("trun.samples.sampleCompositionTimeOffset", 
+			(MP4Property**)&pOffsetProperty);
+	}
+
+	for (u_int32_t i = 0; i < m_fragmentSamples; i++) {
+		pDurationProperty->AddValue(m_fragmentSampleDurations[i]);
+		pSizeProperty->AddValue(m_fragmentSampleSizes[i]);
+		pFlagsProperty->AddValue(m_fragmentSampleFlags[i]);
+		if (pOffsetProperty) {
+			pOffsetProperty->AddValue(m_fragmentRenderingOffsets[i]);
+		}
+	}
+
+	return pTrafAtom;
+}
+
+void MP4Track::WriteFragmentData(u_int64_t moofOffset, u_int32_t trafNumber)
+{
+	m_pFile->WriteBytes(m_pChunkBuffer, m_chunkBufferSize);
+
+	VERBOSE_WRITE_SAMPLE(m_pFile->GetVerbosity(),
+		printf("WriteFragment: track %u moof 0x"X64" size %u (0x%x) numSamples %u\n",
+			m_trackId, moofOffset, m_chunkBufferSize, 
+			m_chunkBufferSize, m_fragmentSamples));
+
+	// index the fragment by its first sync sample, in the only trun
+	if (m_fragmentSyncSample) {
+		m_pTfraAtom->AddEntry(m_fragmentSyncTime, moofOffset,
+			trafNumber, 1, m_fragmentSyncSample);
+	}
+
+	// start the next fragment, the memory is kept for it
+	m_chunkBufferSize = 0;
+	m_fragmentSamples = 0;
+	m_fragmentStartTime += m_fragmentDuration;
+	m_fragmentDuration = 0;
+	m_fragmentSyncSample = 0;
+}
+
 // map track type name aliases to official names
 
 
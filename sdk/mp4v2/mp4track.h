@@ -40,6 +40,7 @@ class MP4Integer16Property;
 class MP4Integer32Property;
 class MP4Integer64Property;
 class MP4StringProperty;
+class MP4TfraAtom;
 
 class MP4Track {
 public:
@@ -74,6 +75,19 @@ public:
 		MP4Duration* pRenderingOffset = NULL, 
 		bool* pIsSyncSample = NULL);
 
+	// like ReadSample, but points into the mapping of
+	// a file opened with MP4_READ_MAPPED instead of copying the sample
+	void ReadSamplePtr(
+		// input parameters
+		MP4SampleId sampleId,
+		// output parameters
+		const u_int8_t** ppBytes, 
+		u_int32_t* pNumBytes, 
+		MP4Timestamp* pStartTime = NULL, 
+		MP4Duration* pDuration = NULL,
+		MP4Duration* pRenderingOffset = NULL, 
+		bool* pIsSyncSample = NULL);
+
 	void WriteSample(
 		const u_int8_t* pBytes, 
 		u_int32_t numBytes,
@@ -81,8 +95,34 @@ public:
 		MP4Duration renderingOffset = 0, 
 		bool isSyncSample = true);
 
+	void WriteSampleV(
+		const struct iovec* pIov,
+		u_int32_t iovCount,
+		MP4Duration duration = 0,
+		MP4Duration renderingOffset = 0, 
+		bool isSyncSample = true);
+
+	// direct writing into the chunk buffer, BeginWriteSample returns
+	// room for maxBytes that stays valid until the matching EndWriteSample
+	u_int8_t* BeginWriteSample(u_int32_t maxBytes);
+
+	void EndWriteSample(
+		u_int32_t numBytes,
+		MP4Duration duration = 0,
+		MP4Duration renderingOffset = 0, 
+		bool isSyncSample = true);
+
 	virtual void FinishWrite();
 
+	// moves the samples written since the last call from m_sampleIndex
+	// into the stsz, stts, ctts and stss tables, which then describe
+	// every sample of the track
+	void UpdateSampleTables() {
+		if (m_sampleIndex.GetCount()) {
+			MoveSampleIndex();
+		}
+	}
+
 	u_int64_t 	GetDuration();		// in track timeScale units
 	u_int32_t	GetTimeScale();
 	u_int32_t	GetNumberOfSamples();
@@ -144,10 +184,34 @@ public:
 	void RewriteChunk(MP4ChunkId chunkId, 
 		u_int8_t* pChunk, u_int32_t chunkSize);
 
+	// move all chunks by delta bytes, e.g. when the mdat is shifted
+	bool CanShiftChunkOffsets(u_int64_t delta);
+	void ShiftChunkOffsets(u_int64_t delta);
+
+	// fragmented writing, samples are collected per fragment instead of
+	// in the sample tables, the file cuts fragments and writes them out
+	void BeginFragmentedWrite(MP4Atom* pMvexAtom, MP4Atom* pMfraAtom);
+
+	u_int32_t GetFragmentSamples() {
+		return m_fragmentSamples;
+	}
+	MP4Duration GetFragmentDuration() {
+		return m_fragmentDuration;
+	}
+	u_int32_t GetFragmentDataSize() {
+		return m_chunkBufferSize;
+	}
+
+	MP4Atom* AddFragmentTraf(MP4Atom* pMoofAtom);
+	void WriteFragmentData(u_int64_t moofOffset, u_int32_t trafNumber);
+
 protected:
 	bool		InitEditListProperties();
 
 	FILE*		GetSampleFile(MP4SampleId sampleId);
+	void		ReadSampleInfo(MP4SampleId sampleId,
+					MP4Timestamp* pStartTime, MP4Duration* pDuration,
+					MP4Duration* pRenderingOffset, bool* pIsSyncSample);
 	u_int64_t	GetSampleFileOffset(MP4SampleId sampleId);
 	u_int32_t	GetSampleStscIndex(MP4SampleId sampleId);
 	u_int32_t	GetChunkStscIndex(MP4ChunkId chunkId);
@@ -156,17 +220,36 @@ protected:
 					MP4SampleId* pFirstSampleId = NULL);
 	MP4SampleId	GetNextSyncSample(MP4SampleId sampleId);
 
+	// reads the table of pProperty if MP4_READ_LAZY_TABLES left it
+	// in the file
+	void		ReadDeferredTable(MP4Property* pProperty);
+
+	// lookup indexes, built on first use and extended as the tables grow
+	u_int64_t	GetSampleSizesBefore(MP4SampleId sampleId);
+	u_int32_t	GetSampleSttsIndex(MP4SampleId sampleId);
+	u_int32_t	GetTimeSttsIndex(MP4Timestamp when);
+	void		UpdateSttsIndex();
+	void		UpdateCttsIndex();
+
+	void MoveSampleIndex();
+	void AppendSampleRuns(MP4RunColumnCursor& cursor, 
+		u_int32_t maxNumRuns, u_int32_t numSamples,
+		MP4Integer32Property* pCountProperty,
+		MP4Integer32Property* pSampleCountProperty,
+		MP4Integer32Property* pValueProperty);
+
 	void UpdateSampleSizes(MP4SampleId sampleId, 
 		u_int32_t numBytes);
 	bool IsChunkFull(MP4SampleId sampleId);
 	void UpdateSampleToChunk(MP4SampleId sampleId,
 		 MP4ChunkId chunkId, u_int32_t samplesPerChunk);
 	void UpdateChunkOffsets(u_int64_t chunkOffset);
-	void UpdateSampleTimes(MP4Duration duration);
+	void UpdateSampleTimes(MP4Duration duration,
+		u_int32_t numSamples = 1);
 	void UpdateRenderingOffsets(MP4SampleId sampleId, 
-		MP4Duration renderingOffset);
+		MP4Duration renderingOffset, u_int32_t numSamples = 1);
 	void UpdateSyncSamples(MP4SampleId sampleId, 
-		bool isSyncSample);
+		bool isSyncSample, u_int32_t numSamples = 1);
 
 	MP4Atom* AddAtom(char* parentName, char* childName);
 
@@ -176,6 +259,10 @@ protected:
 	void UpdateModificationTimes();
 
 	void WriteChunkBuffer();
+	void ReserveChunkBuffer(u_int32_t numBytes);
+
+	void AddFragmentSample(u_int32_t numBytes, MP4Duration duration,
+		MP4Duration renderingOffset, bool isSyncSample);
 
 	void CalculateBytesPerSample();
 protected:
@@ -197,9 +284,24 @@ protected:
 	MP4Duration m_fixedSampleDuration;
 	u_int8_t* 	m_pChunkBuffer;
 	u_int32_t	m_chunkBufferSize;
+	u_int32_t	m_chunkBufferCapacity;	// kept across chunks
+	u_int32_t	m_writeSampleMaxBytes;	// reserved by BeginWriteSample
 	u_int32_t	m_chunkSamples;
 	MP4Duration m_chunkDuration;
 
+	// samples of the fragment being collected, the chunk buffer holds
+	// their bytes. the arrays are reused, m_fragmentSamples is valid
+	MP4Integer32Array m_fragmentSampleSizes;
+	MP4Integer32Array m_fragmentSampleDurations;
+	MP4Integer32Array m_fragmentSampleFlags;
+	MP4Integer32Array m_fragmentRenderingOffsets;
+	u_int32_t	m_fragmentSamples;
+	MP4Timestamp m_fragmentStartTime;	// decode time of the first sample
+	MP4Duration m_fragmentDuration;
+	u_int32_t	m_fragmentSyncSample;	// first sync sample, 0 if none
+	MP4Timestamp m_fragmentSyncTime;
+	MP4TfraAtom* m_pTfraAtom;
+
 	// controls for chunking
 	u_int32_t 	m_samplesPerChunk;
 	MP4Duration m_durationPerChunk;
@@ -238,23 +340,37 @@ protected:
 	MP4Integer32Property* m_pSttsSampleCountProperty;
 	MP4Integer32Property* m_pSttsSampleDeltaProperty;
 
-	// for improve sequental timestamp index access
-	u_int32_t	m_cachedSttsIndex;
-	MP4SampleId	m_cachedSttsSid;
-	MP4Timestamp	m_cachedSttsElapsed;
+	// sizes of samples 1..n at index n, for O(1) offsets inside a chunk
+	MP4Integer64Array m_sampleSizeSums;
+	u_int32_t	m_sampleSizeSumCount;
+
+	// first sample id and start time of each stts entry
+	MP4Integer32Array m_sttsFirstSamples;
+	MP4Integer64Array m_sttsStartTimes;
+	u_int32_t	m_sttsIndexCount;
 
 	MP4Integer32Property* m_pCttsCountProperty;
 	MP4Integer32Property* m_pCttsSampleCountProperty;
 	MP4Integer32Property* m_pCttsSampleOffsetProperty;
 
+	// first sample id of each ctts entry
+	MP4Integer32Array m_cttsFirstSamples;
+	u_int32_t	m_cttsIndexCount;
+
 	MP4Integer32Property* m_pStssCountProperty;
 	MP4Integer32Property* m_pStssSampleProperty;
 
+	// samples written after the last UpdateSampleTables(), the tables
+	// only get them once something reads the tables or at write time
+	MP4SampleIndex	m_sampleIndex;
+
 	MP4Integer32Property* m_pElstCountProperty;
 	MP4IntegerProperty*   m_pElstMediaTimeProperty;		// 32 or 64 bits
 	MP4IntegerProperty*   m_pElstDurationProperty;		// 32 or 64 bits
 	MP4Integer16Property* m_pElstRateProperty;
 	MP4Integer16Property* m_pElstReservedProperty;
+
+	friend class MP4SampleCursor;
 };
 
 MP4ARRAY_DECL(MP4Track, MP4Track*);
@@ -22,6 +22,15 @@
 
 #include "mp4common.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MP4_SSE2 1
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define MP4_BIG_ENDIAN_HOST 1
+#endif
+
 static lib_message_func_t libfunc = NULL;
 extern "C"   void MP4SetLibFunc(lib_message_func_t libf)
 {
@@ -320,6 +329,68 @@ u_int64_t MP4ConvertTime(u_int64_t t,
 	return (u_int64_t)d;
 }
 
+#ifdef MP4_SSE2
+// swaps the bytes of every 16 bit lane, the word shuffles finish the job
+static inline __m128i SwapBytes16(__m128i v)
+{
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static inline __m128i SwapBytes32(__m128i v)
+{
+	v = SwapBytes16(v);
+	v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+	return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+static inline __m128i SwapBytes64(__m128i v)
+{
+	v = SwapBytes16(v);
+	v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+	return _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+#endif
+
+void MP4SwapBigEndian(void* pValues, u_int32_t count, u_int8_t valueSize)
+{
+#ifndef MP4_BIG_ENDIAN_HOST
+	u_int8_t* p = (u_int8_t*)pValues;
+	u_int8_t* pEnd = p + (u_int64_t)count * valueSize;
+
+	if (valueSize == 4) {
+#ifdef MP4_SSE2
+		for (; pEnd - p >= 32; p += 32) {
+			__m128i a = _mm_loadu_si128((__m128i*)p);
+			__m128i b = _mm_loadu_si128((__m128i*)(p + 16));
+			_mm_storeu_si128((__m128i*)p, SwapBytes32(a));
+			_mm_storeu_si128((__m128i*)(p + 16), SwapBytes32(b));
+		}
+#endif
+		for (; p < pEnd; p += 4) {
+			u_int32_t value = ((u_int32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+			memcpy(p, &value, 4);
+		}
+	} else {
+		ASSERT(valueSize == 8);
+#ifdef MP4_SSE2
+		for (; pEnd - p >= 32; p += 32) {
+			__m128i a = _mm_loadu_si128((__m128i*)p);
+			__m128i b = _mm_loadu_si128((__m128i*)(p + 16));
+			_mm_storeu_si128((__m128i*)p, SwapBytes64(a));
+			_mm_storeu_si128((__m128i*)(p + 16), SwapBytes64(b));
+		}
+#endif
+		for (; p < pEnd; p += 8) {
+			u_int64_t value = 0;
+			for (int i = 0; i < 8; i++) {
+				value = (value << 8) | p[i];
+			}
+			memcpy(p, &value, 8);
+		}
+	}
+#endif
+}
+
 const char* MP4NormalizeTrackType (const char* type,
 				   uint32_t verbosity)
 {
@@ -224,6 +224,10 @@ inline MP4Timestamp MP4GetAbsTimestamp() {
 u_int64_t MP4ConvertTime(u_int64_t t, 
 	u_int32_t oldTimeScale, u_int32_t newTimeScale);
 
+// converts count 4 or 8 byte values in place between big endian file
+// order and host order
+void MP4SwapBigEndian(void* pValues, u_int32_t count, u_int8_t valueSize);
+
 bool MP4NameFirstMatches(const char* s1, const char* s2);
 
 bool MP4NameFirstIndex(const char* s, u_int32_t* pIndex);
@@ -108,6 +108,7 @@
 #include <ctype.h>
 #include <netdb.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #ifdef TIME_WITH_SYS_TIME
 #include <sys/time.h>
 #include <time.h>
@@ -120,6 +121,7 @@
 #endif
 #include <sys/param.h>
 
+#ifndef HAVE_STRCASESTR
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -127,6 +129,7 @@ char *strcasestr(const char *haystack, const char *needle);
 #ifdef __cplusplus
 }
 #endif
+#endif
 
 #define OPEN_RDWR O_RDWR
 #define OPEN_CREAT O_CREAT 
@@ -169,9 +172,9 @@ char *strcasestr(const char *haystack, const char *needle);
 /*****************************************************************************
  *             Generic type includes used in the whole package               *
  *****************************************************************************/
-#define D64  "%"D64F
-#define U64  "%"U64F
-#define X64 "%"X64F
+#define D64  "%" D64F
+#define U64  "%" U64F
+#define X64 "%" X64F
 
 #define M_LLU TO_U64(1000)
 #define M_64 TO_U64(1000)
@@ -0,0 +1,29 @@
+/* mpeg4ip_config.h for Linux/glibc builds without autoconf.
+ * Windows builds use mpeg4ip_win32.h instead. */
+
+#ifndef __MPEG4IP_CONFIG_H__
+#define __MPEG4IP_CONFIG_H__
+
+#define HAVE_INTTYPES_H 1
+#define HAVE_STDINT_H 1
+#define HAVE_SYS_TIME_H 1
+#define TIME_WITH_SYS_TIME 1
+
+#define HAVE_IN_PORT_T 1
+#define HAVE_SOCKLEN_T 1
+#define HAVE_STRSEP 1
+#define HAVE_STRCASESTR 1
+#define HAVE_RINT 1
+
+#ifdef __linux__
+#define HAVE_FPOS_T___POS 1
+#endif
+
+#if defined(__LP64__) || defined(_LP64)
+#define SIZEOF_LONG 8
+#else
+#define SIZEOF_LONG 4
+#endif
+#define SIZEOF_BOOL 1
+
+#endif /* __MPEG4IP_CONFIG_H__ */
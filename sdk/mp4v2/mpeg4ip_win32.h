@@ -55,6 +55,10 @@ typedef unsigned short in_port_t;
 typedef int socklen_t;
 typedef int ssize_t;
 typedef unsigned int uint;
+struct iovec {
+  void* iov_base;
+  size_t iov_len;
+};
 static inline int snprintf(char *buffer, size_t count,
 			  const char *format, ...) {
   va_list ap;
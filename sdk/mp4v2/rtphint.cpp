@@ -342,7 +342,7 @@ void MP4RtpHintTrack::GetPayload(
 			  pSlash = strchr(pSlash, '/');
 			  if (pSlash != NULL) {
 			    pSlash++;
-			    if (pSlash != '\0') {
+			    if (*pSlash != '\0') {
 			      length = strlen(pRtpMap) - (pSlash - pRtpMap);
 			      *ppEncodingParams = (char *)MP4Calloc(length + 1);
 			      strncpy(*ppEncodingParams, pSlash, length);
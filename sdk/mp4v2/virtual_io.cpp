@@ -24,6 +24,10 @@
 #include "mp4common.h"
 #include "virtual_io.h"
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
 /* --------- Virtual IO for FILE * --------- */
 
 u_int64_t FILE_GetFileLength(void *user)
@@ -90,3 +94,157 @@ Virtual_IO FILE_virtual_IO =
 		FILE_EndOfFile,
 		FILE_Close,
 };
+
+/* --------- Virtual IO for a read only memory mapping --------- */
+
+MP4MappedFile* MP4MapFile(const char* fileName)
+{
+	MP4MappedFile* pMap = (MP4MappedFile*)calloc(1, sizeof(MP4MappedFile));
+	if (pMap == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+#ifdef _WIN32
+	pMap->file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	LARGE_INTEGER length;
+	if (pMap->file == INVALID_HANDLE_VALUE
+	  || !GetFileSizeEx(pMap->file, &length)) {
+		if (pMap->file != INVALID_HANDLE_VALUE) {
+			CloseHandle(pMap->file);
+		}
+		free(pMap);
+		errno = ENOENT;
+		return NULL;
+	}
+	pMap->size = length.QuadPart;
+	if (pMap->size > 0) {
+		pMap->mapping = CreateFileMapping(pMap->file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (pMap->mapping != NULL) {
+			pMap->data = (const u_int8_t*)
+				MapViewOfFile(pMap->mapping, FILE_MAP_READ, 0, 0, 0);
+		}
+		if (pMap->data == NULL) {
+			if (pMap->mapping != NULL) {
+				CloseHandle(pMap->mapping);
+			}
+			CloseHandle(pMap->file);
+			free(pMap);
+			errno = ENOMEM;
+			return NULL;
+		}
+	}
+#else
+	pMap->fd = open(fileName, O_RDONLY);
+	struct stat s;
+	if (pMap->fd < 0 || fstat(pMap->fd, &s) < 0) {
+		int err = errno;
+		if (pMap->fd >= 0) {
+			close(pMap->fd);
+		}
+		free(pMap);
+		errno = err;
+		return NULL;
+	}
+	pMap->size = s.st_size;
+	if (pMap->size > 0) {
+		// an empty file can't be mapped, it reads as zero bytes
+		void* data = mmap(NULL, pMap->size, PROT_READ, MAP_SHARED, pMap->fd, 0);
+		if (data == MAP_FAILED) {
+			int err = errno;
+			close(pMap->fd);
+			free(pMap);
+			errno = err;
+			return NULL;
+		}
+		// atoms are parsed front to back, samples are mostly read in order
+		madvise(data, pMap->size, MADV_SEQUENTIAL);
+		pMap->data = (const u_int8_t*)data;
+	}
+#endif
+	return pMap;
+}
+
+u_int64_t MMAP_GetFileLength(void *user)
+{
+	MP4MappedFile *pMap = (MP4MappedFile *)user;
+	return pMap->size;
+}
+
+int MMAP_SetPosition(void *user, u_int64_t position)
+{
+	MP4MappedFile *pMap = (MP4MappedFile *)user;
+	if (position > pMap->size) {
+		return -1;
+	}
+	pMap->position = position;
+	return 0;
+}
+
+int MMAP_GetPosition(void *user, u_int64_t *position)
+{
+	MP4MappedFile *pMap = (MP4MappedFile *)user;
+	*position = pMap->position;
+	return 0;
+}
+
+size_t MMAP_Read(void *user, void *buffer, size_t size)
+{
+	MP4MappedFile *pMap = (MP4MappedFile *)user;
+	if (size > pMap->size - pMap->position) {
+		size = (size_t)(pMap->size - pMap->position);
+	}
+	if (size > 0) {
+		memcpy(buffer, pMap->data + pMap->position, size);
+		pMap->position += size;
+	}
+	return size;
+}
+
+size_t MMAP_Write(void *user, void *buffer, size_t size)
+{
+	// the mapping is read only
+	return 0;
+}
+
+int MMAP_EndOfFile(void *user)
+{
+	MP4MappedFile *pMap = (MP4MappedFile *)user;
+	return pMap->position >= pMap->size;
+}
+
+int MMAP_Close(void *user)
+{
+	MP4MappedFile *pMap = (MP4MappedFile *)user;
+	int rc = 0;
+#ifdef _WIN32
+	if (pMap->data != NULL && !UnmapViewOfFile(pMap->data)) {
+		rc = -1;
+	}
+	if (pMap->mapping != NULL) {
+		CloseHandle(pMap->mapping);
+	}
+	CloseHandle(pMap->file);
+#else
+	if (pMap->data != NULL && munmap((void*)pMap->data, pMap->size) < 0) {
+		rc = -1;
+	}
+	if (close(pMap->fd) < 0) {
+		rc = -1;
+	}
+#endif
+	free(pMap);
+	return rc;
+}
+
+Virtual_IO MMAP_virtual_IO =
+{
+	MMAP_GetFileLength,
+		MMAP_SetPosition,
+		MMAP_GetPosition,
+		MMAP_Read,
+		MMAP_Write,
+		MMAP_EndOfFile,
+		MMAP_Close,
+};
@@ -28,4 +28,22 @@
 
 extern Virtual_IO FILE_virtual_IO;
 
+/* read only mapping of a whole file, the user pointer of MMAP_virtual_IO */
+struct MP4MappedFile {
+	const u_int8_t*	data;
+	u_int64_t		size;
+	u_int64_t		position;
+#ifdef _WIN32
+	HANDLE			file;
+	HANDLE			mapping;
+#else
+	int				fd;
+#endif
+};
+
+/* maps fileName, returns NULL with errno set on failure */
+MP4MappedFile* MP4MapFile(const char* fileName);
+
+extern Virtual_IO MMAP_virtual_IO;
+
 #endif
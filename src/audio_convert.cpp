@@ -0,0 +1,54 @@
+#include "audio_convert.h"
+
+#include "cpu.h"
+
+#ifdef XFMP4_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+static void s16_to_float_scalar(const int16_t *src, float *dst, size_t count) {
+  for (size_t i = 0; i < count; i++)
+    dst[i] = src[i];
+}
+
+#ifdef XFMP4_X86
+
+static void s16_to_float_sse2(const int16_t *src, float *dst, size_t count) {
+  const size_t simd_count = count & ~(size_t)7;
+  for (size_t i = 0; i < simd_count; i += 8) {
+    __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+    // move each sample to the high half of a 32 bit lane, then sign extend.
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(_mm_setzero_si128(), s), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(_mm_setzero_si128(), s), 16);
+    _mm_storeu_ps(dst + i + 0, _mm_cvtepi32_ps(lo));
+    _mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(hi));
+  }
+  s16_to_float_scalar(src + simd_count, dst + simd_count, count - simd_count);
+}
+
+XFMP4_TARGET_AVX2
+static void s16_to_float_avx2(const int16_t *src, float *dst, size_t count) {
+  const size_t simd_count = count & ~(size_t)15;
+  for (size_t i = 0; i < simd_count; i += 16) {
+    __m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i + 0)));
+    __m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i + 8)));
+    _mm256_storeu_ps(dst + i + 0, _mm256_cvtepi32_ps(lo));
+    _mm256_storeu_ps(dst + i + 8, _mm256_cvtepi32_ps(hi));
+  }
+  s16_to_float_scalar(src + simd_count, dst + simd_count, count - simd_count);
+}
+
+#endif
+
+void s16_to_float(const int16_t *src, float *dst, size_t count) {
+#ifdef XFMP4_X86
+  const uint32_t flags = cpu_flags();
+  if (flags & CPU_AVX2)
+    s16_to_float_avx2(src, dst, count);
+  else if (flags & CPU_SSE2)
+    s16_to_float_sse2(src, dst, count);
+  else
+#endif
+    s16_to_float_scalar(src, dst, count);
+}
@@ -0,0 +1,12 @@
+#ifndef XFMP4_AUDIO_CONVERT_H
+#define XFMP4_AUDIO_CONVERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Converts count signed 16 bit samples to float, keeping the 16 bit range
+// (faac's FAAC_INPUT_FLOAT expects -32768..32767). Uses the widest simd
+// kernel the running cpu supports.
+void s16_to_float(const int16_t *src, float *dst, size_t count);
+
+#endif  // XFMP4_AUDIO_CONVERT_H
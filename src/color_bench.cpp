@@ -0,0 +1,91 @@
+// Checks the BGR24 to I420 kernels of every instruction set the cpu
+// supports against the scalar one on a random frame, then times them and
+// reports MPix/s. Fails if any output byte differs from the scalar kernel.
+//
+//   color_bench [iterations] [width height]
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "color_convert.h"
+
+// one converted frame, padded strides like x264_picture_alloc leaves them.
+struct i420_frame {
+  int width, height;
+  int y_stride, uv_stride;
+  std::vector<uint8_t> y, u, v;
+
+  i420_frame(int w, int h)
+      : width(w), height(h), y_stride((w + 63) & ~63), uv_stride((w / 2 + 31) & ~31),
+        y(y_stride * h), u(uv_stride * h / 2), v(uv_stride * h / 2) {
+  }
+
+  void convert(color_convert_fn fn, const uint8_t *bgr) {
+    fn(bgr, width * 3, width, height, &y[0], y_stride, &u[0], uv_stride, &v[0], uv_stride);
+  }
+
+  bool same(const i420_frame &o) const {
+    return y == o.y && u == o.u && v == o.v;
+  }
+};
+
+static double time_kernel(color_convert_fn fn, const uint8_t *bgr, i420_frame *out, int iterations) {
+  // warm up caches and the cpu clock before timing.
+  for (int i = 0; i < iterations / 10 + 1; i++)
+    out->convert(fn, bgr);
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < iterations; i++)
+    out->convert(fn, bgr);
+  std::chrono::nanoseconds elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::high_resolution_clock::now() - start);
+  return (double)elapsed.count() / iterations;
+}
+
+int main(int argc, char *argv[]) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 200;
+  int width = argc > 3 ? atoi(argv[2]) : 1920;
+  int height = argc > 3 ? atoi(argv[3]) : 1080;
+  if (iterations <= 0 || width <= 0 || height <= 0 || (width | height) & 1) {
+    fprintf(stderr, "usage: color_bench [iterations] [width height], width and height even\n");
+    return 1;
+  }
+
+  std::vector<uint8_t> bgr((size_t)width * height * 3);
+  srand(1);
+  for (size_t i = 0; i < bgr.size(); i++)
+    bgr[i] = (uint8_t)rand();
+
+  i420_frame reference(width, height);
+  reference.convert(color_convert_get(COLOR_CONVERT_SCALAR), &bgr[0]);
+
+  printf("%dx%d, best: %s\n", width, height, color_convert_isa_name(color_convert_best_isa()));
+  bool ok = true;
+  double scalar_ns = 0.0;
+  for (int isa = 0; isa < COLOR_CONVERT_ISA_COUNT; isa++) {
+    color_convert_fn fn = color_convert_get((color_convert_isa_t)isa);
+    const char *name = color_convert_isa_name((color_convert_isa_t)isa);
+    if (!fn) {
+      printf("%-6s not supported\n", name);
+      continue;
+    }
+    i420_frame out(width, height);
+    out.convert(fn, &bgr[0]);
+    bool exact = out.same(reference);
+    ok = ok && exact;
+
+    double ns = time_kernel(fn, &bgr[0], &out, iterations);
+    if (isa == COLOR_CONVERT_SCALAR)
+      scalar_ns = ns;
+    printf("%-6s exact: %-3s %8.0f MPix/s %5.2fx\n", name, exact ? "yes" : "NO",
+           (double)width * height * 1e3 / ns, scalar_ns / ns);
+  }
+
+  if (!ok) {
+    fprintf(stderr, "a kernel differs from the scalar one\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,252 @@
+#include "color_convert.h"
+
+#include <string.h>
+
+#include "cpu.h"
+
+#ifdef XFMP4_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+// BT.601 full range coefficients, scaled by 256.
+//   y = ( 77 * r + 151 * g +  28 * b) >> 8
+//   u = (-43 * r -  85 * g + 128 * b) >> 8 + 128
+//   v = (128 * r - 107 * g -  21 * b) >> 8 + 128
+// y fits in an unsigned and u/v in a signed 16 bit lane.
+enum {
+  YR = 77,  YG = 151,  YB = 28,
+  UR = -43, UG = -85,  UB = 128,
+  VR = 128, VG = -107, VB = -21
+};
+
+// convert 2x2 blocks [x_begin, width) of a pair of rows.
+static void convert_blocks_scalar(const uint8_t *row0, const uint8_t *row1, int x_begin, int width,
+                                  uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v) {
+  for (int x = x_begin; x < width; x += 2) {
+    const uint8_t *p0 = row0 + x * 3;
+    const uint8_t *p1 = row1 + x * 3;
+
+    y0[x + 0] = (uint8_t)((YR * p0[2] + YG * p0[1] + YB * p0[0]) >> 8);
+    y0[x + 1] = (uint8_t)((YR * p0[5] + YG * p0[4] + YB * p0[3]) >> 8);
+    y1[x + 0] = (uint8_t)((YR * p1[2] + YG * p1[1] + YB * p1[0]) >> 8);
+    y1[x + 1] = (uint8_t)((YR * p1[5] + YG * p1[4] + YB * p1[3]) >> 8);
+
+    int b = (p0[0] + p0[3] + p1[0] + p1[3]) >> 2;
+    int g = (p0[1] + p0[4] + p1[1] + p1[4]) >> 2;
+    int r = (p0[2] + p0[5] + p1[2] + p1[5]) >> 2;
+    // arithmetic shift, matches psraw in the simd kernels.
+    u[x / 2] = (uint8_t)(((UR * r + UG * g + UB * b) >> 8) + 128);
+    v[x / 2] = (uint8_t)(((VR * r + VG * g + VB * b) >> 8) + 128);
+  }
+}
+
+static void convert_scalar(const uint8_t *bgr, int pitch, int width, int height,
+                           uint8_t *y, int y_stride,
+                           uint8_t *u, int u_stride,
+                           uint8_t *v, int v_stride) {
+  for (int j = 0; j < height / 2; j++) {
+    const uint8_t *row0 = bgr + pitch * j * 2;
+    convert_blocks_scalar(row0, row0 + pitch, 0, width,
+                          y + y_stride * j * 2, y + y_stride * (j * 2 + 1),
+                          u + u_stride * j, v + v_stride * j);
+  }
+}
+
+#ifdef XFMP4_X86
+
+static inline __m128i luma_sse2(__m128i b, __m128i g, __m128i r) {
+  __m128i s = _mm_mullo_epi16(r, _mm_set1_epi16(YR));
+  s = _mm_add_epi16(s, _mm_mullo_epi16(g, _mm_set1_epi16(YG)));
+  s = _mm_add_epi16(s, _mm_mullo_epi16(b, _mm_set1_epi16(YB)));
+  return _mm_srli_epi16(s, 8);
+}
+
+static inline __m128i chroma_sse2(__m128i b, __m128i g, __m128i r, short cr, short cg, short cb) {
+  __m128i s = _mm_mullo_epi16(r, _mm_set1_epi16(cr));
+  s = _mm_add_epi16(s, _mm_mullo_epi16(g, _mm_set1_epi16(cg)));
+  s = _mm_add_epi16(s, _mm_mullo_epi16(b, _mm_set1_epi16(cb)));
+  return _mm_add_epi16(_mm_srai_epi16(s, 8), _mm_set1_epi16(128));
+}
+
+// sum of horizontal pairs of two rows divided by 4, as 32 bit lanes.
+static inline __m128i average_2x2_sse2(__m128i row0, __m128i row1) {
+  return _mm_srli_epi32(_mm_madd_epi16(_mm_add_epi16(row0, row1), _mm_set1_epi16(1)), 2);
+}
+
+// gather one channel of 8 packed pixels into 16 bit lanes.
+static inline __m128i load_channel_sse2(const uint8_t *p) {
+  return _mm_setr_epi16(p[0], p[3], p[6], p[9], p[12], p[15], p[18], p[21]);
+}
+
+static void convert_sse2(const uint8_t *bgr, int pitch, int width, int height,
+                         uint8_t *y, int y_stride,
+                         uint8_t *u, int u_stride,
+                         uint8_t *v, int v_stride) {
+  const int simd_width = width & ~7;
+
+  for (int j = 0; j < height / 2; j++) {
+    const uint8_t *row0 = bgr + pitch * j * 2;
+    const uint8_t *row1 = row0 + pitch;
+    uint8_t *y0 = y + y_stride * j * 2;
+    uint8_t *y1 = y0 + y_stride;
+    uint8_t *uline = u + u_stride * j;
+    uint8_t *vline = v + v_stride * j;
+
+    for (int x = 0; x < simd_width; x += 8) {
+      const uint8_t *p0 = row0 + x * 3;
+      const uint8_t *p1 = row1 + x * 3;
+      __m128i b0 = load_channel_sse2(p0 + 0), b1 = load_channel_sse2(p1 + 0);
+      __m128i g0 = load_channel_sse2(p0 + 1), g1 = load_channel_sse2(p1 + 1);
+      __m128i r0 = load_channel_sse2(p0 + 2), r1 = load_channel_sse2(p1 + 2);
+
+      __m128i l0 = luma_sse2(b0, g0, r0);
+      __m128i l1 = luma_sse2(b1, g1, r1);
+      _mm_storel_epi64((__m128i *)(y0 + x), _mm_packus_epi16(l0, l0));
+      _mm_storel_epi64((__m128i *)(y1 + x), _mm_packus_epi16(l1, l1));
+
+      __m128i b = average_2x2_sse2(b0, b1);
+      __m128i g = average_2x2_sse2(g0, g1);
+      __m128i r = average_2x2_sse2(r0, r1);
+      b = _mm_packs_epi32(b, b);
+      g = _mm_packs_epi32(g, g);
+      r = _mm_packs_epi32(r, r);
+
+      __m128i cu = chroma_sse2(b, g, r, UR, UG, UB);
+      __m128i cv = chroma_sse2(b, g, r, VR, VG, VB);
+      int packed_u = _mm_cvtsi128_si32(_mm_packus_epi16(cu, cu));
+      int packed_v = _mm_cvtsi128_si32(_mm_packus_epi16(cv, cv));
+      memcpy(uline + x / 2, &packed_u, 4);
+      memcpy(vline + x / 2, &packed_v, 4);
+    }
+
+    convert_blocks_scalar(row0, row1, simd_width, width, y0, y1, uline, vline);
+  }
+}
+
+// pshufb masks picking one channel of 16 packed pixels out of three
+// 16 byte loads.
+static const int8_t avx2_shuffle[3][3][16] = {
+  { { 0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    {-1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14, -1, -1, -1, -1, -1 },
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  1,  4,  7, 10, 13 } },
+  { { 1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    {-1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1 },
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14 } },
+  { { 2,  5,  8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    {-1, -1, -1, -1, -1,  1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1 },
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15 } },
+};
+
+XFMP4_TARGET_AVX2
+static inline __m256i load_channel_avx2(__m128i c0, __m128i c1, __m128i c2, int channel) {
+  __m128i s = _mm_shuffle_epi8(c0, _mm_loadu_si128((const __m128i *)avx2_shuffle[channel][0]));
+  s = _mm_or_si128(s, _mm_shuffle_epi8(c1, _mm_loadu_si128((const __m128i *)avx2_shuffle[channel][1])));
+  s = _mm_or_si128(s, _mm_shuffle_epi8(c2, _mm_loadu_si128((const __m128i *)avx2_shuffle[channel][2])));
+  return _mm256_cvtepu8_epi16(s);
+}
+
+XFMP4_TARGET_AVX2
+static inline __m128i luma_avx2(__m256i b, __m256i g, __m256i r) {
+  __m256i s = _mm256_mullo_epi16(r, _mm256_set1_epi16(YR));
+  s = _mm256_add_epi16(s, _mm256_mullo_epi16(g, _mm256_set1_epi16(YG)));
+  s = _mm256_add_epi16(s, _mm256_mullo_epi16(b, _mm256_set1_epi16(YB)));
+  s = _mm256_srli_epi16(s, 8);
+  return _mm_packus_epi16(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+}
+
+// 2x2 averages of 16 pixels as 8 ordered 16 bit lanes.
+XFMP4_TARGET_AVX2
+static inline __m128i average_2x2_avx2(__m256i row0, __m256i row1) {
+  __m256i s = _mm256_madd_epi16(_mm256_add_epi16(row0, row1), _mm256_set1_epi16(1));
+  s = _mm256_srli_epi32(s, 2);
+  return _mm_packs_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+}
+
+XFMP4_TARGET_AVX2
+static void convert_avx2(const uint8_t *bgr, int pitch, int width, int height,
+                         uint8_t *y, int y_stride,
+                         uint8_t *u, int u_stride,
+                         uint8_t *v, int v_stride) {
+  const int simd_width = width & ~15;
+
+  for (int j = 0; j < height / 2; j++) {
+    const uint8_t *row0 = bgr + pitch * j * 2;
+    const uint8_t *row1 = row0 + pitch;
+    uint8_t *y0 = y + y_stride * j * 2;
+    uint8_t *y1 = y0 + y_stride;
+    uint8_t *uline = u + u_stride * j;
+    uint8_t *vline = v + v_stride * j;
+
+    for (int x = 0; x < simd_width; x += 16) {
+      const __m128i *p0 = (const __m128i *)(row0 + x * 3);
+      const __m128i *p1 = (const __m128i *)(row1 + x * 3);
+      __m128i c00 = _mm_loadu_si128(p0 + 0), c01 = _mm_loadu_si128(p0 + 1), c02 = _mm_loadu_si128(p0 + 2);
+      __m128i c10 = _mm_loadu_si128(p1 + 0), c11 = _mm_loadu_si128(p1 + 1), c12 = _mm_loadu_si128(p1 + 2);
+
+      __m256i b0 = load_channel_avx2(c00, c01, c02, 0), b1 = load_channel_avx2(c10, c11, c12, 0);
+      __m256i g0 = load_channel_avx2(c00, c01, c02, 1), g1 = load_channel_avx2(c10, c11, c12, 1);
+      __m256i r0 = load_channel_avx2(c00, c01, c02, 2), r1 = load_channel_avx2(c10, c11, c12, 2);
+
+      _mm_storeu_si128((__m128i *)(y0 + x), luma_avx2(b0, g0, r0));
+      _mm_storeu_si128((__m128i *)(y1 + x), luma_avx2(b1, g1, r1));
+
+      __m128i b = average_2x2_avx2(b0, b1);
+      __m128i g = average_2x2_avx2(g0, g1);
+      __m128i r = average_2x2_avx2(r0, r1);
+
+      __m128i cu = chroma_sse2(b, g, r, UR, UG, UB);
+      __m128i cv = chroma_sse2(b, g, r, VR, VG, VB);
+      _mm_storel_epi64((__m128i *)(uline + x / 2), _mm_packus_epi16(cu, cu));
+      _mm_storel_epi64((__m128i *)(vline + x / 2), _mm_packus_epi16(cv, cv));
+    }
+
+    convert_blocks_scalar(row0, row1, simd_width, width, y0, y1, uline, vline);
+  }
+}
+
+#endif
+
+color_convert_isa_t color_convert_best_isa() {
+  const uint32_t flags = cpu_flags();
+  if (flags & CPU_AVX2)
+    return COLOR_CONVERT_AVX2;
+  if (flags & CPU_SSE2)
+    return COLOR_CONVERT_SSE2;
+  return COLOR_CONVERT_SCALAR;
+}
+
+color_convert_fn color_convert_get(color_convert_isa_t isa) {
+  if (isa > color_convert_best_isa())
+    return NULL;
+
+  switch (isa) {
+  case COLOR_CONVERT_SCALAR:
+    return convert_scalar;
+#ifdef XFMP4_X86
+  case COLOR_CONVERT_SSE2:
+    return convert_sse2;
+  case COLOR_CONVERT_AVX2:
+    return convert_avx2;
+#endif
+  default:
+    return NULL;
+  }
+}
+
+const char *color_convert_isa_name(color_convert_isa_t isa) {
+  switch (isa) {
+  case COLOR_CONVERT_SCALAR: return "scalar";
+  case COLOR_CONVERT_SSE2:   return "sse2";
+  case COLOR_CONVERT_AVX2:   return "avx2";
+  default:                   return "unknown";
+  }
+}
+
+void bgr24_to_i420(const uint8_t *bgr, int pitch, int width, int height,
+                   uint8_t *y, int y_stride,
+                   uint8_t *u, int u_stride,
+                   uint8_t *v, int v_stride) {
+  color_convert_fn convert = color_convert_get(color_convert_best_isa());
+  convert(bgr, pitch, width, height, y, y_stride, u, u_stride, v, v_stride);
+}
@@ -0,0 +1,39 @@
+#ifndef XFMP4_COLOR_CONVERT_H
+#define XFMP4_COLOR_CONVERT_H
+
+#include <stdint.h>
+
+// Packed 24 bit BGR to planar I420 conversion.
+//
+// Uses 8 bit fixed-point full range BT.601 coefficients, chroma is taken
+// from the average of each 2x2 block. Every implementation produces the
+// same output, which is within 1 LSB of the old rgbtoy/rgbtouv macros.
+
+enum color_convert_isa_t {
+  COLOR_CONVERT_SCALAR = 0,
+  COLOR_CONVERT_SSE2,
+  COLOR_CONVERT_AVX2,
+  COLOR_CONVERT_ISA_COUNT
+};
+
+typedef void (*color_convert_fn)(const uint8_t *bgr, int pitch, int width, int height,
+                                 uint8_t *y, int y_stride,
+                                 uint8_t *u, int u_stride,
+                                 uint8_t *v, int v_stride);
+
+// returns the kernel for an isa level, or NULL if the cpu doesn't support it.
+color_convert_fn color_convert_get(color_convert_isa_t isa);
+
+// best isa level supported by the running cpu.
+color_convert_isa_t color_convert_best_isa();
+
+const char *color_convert_isa_name(color_convert_isa_t isa);
+
+// converts with the best kernel for the running cpu. width and height
+// must be even.
+void bgr24_to_i420(const uint8_t *bgr, int pitch, int width, int height,
+                   uint8_t *y, int y_stride,
+                   uint8_t *u, int u_stride,
+                   uint8_t *v, int v_stride);
+
+#endif  // XFMP4_COLOR_CONVERT_H
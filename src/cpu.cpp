@@ -0,0 +1,66 @@
+#include "cpu.h"
+
+#ifdef XFMP4_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+static void cpuid(int info[4], int leaf) {
+#if defined(_MSC_VER)
+  __cpuidex(info, leaf, 0);
+#else
+  unsigned int a, b, c, d;
+  __cpuid_count(leaf, 0, a, b, c, d);
+  info[0] = a; info[1] = b; info[2] = c; info[3] = d;
+#endif
+}
+
+static uint64_t xgetbv0() {
+#if defined(_MSC_VER)
+  return _xgetbv(0);
+#else
+  uint32_t eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static uint32_t detect_flags() {
+  uint32_t flags = 0;
+  int info[4];
+  cpuid(info, 0);
+  const int max_leaf = info[0];
+
+  cpuid(info, 1);
+  if (!(info[3] & (1 << 26)))
+    return flags;
+  flags |= CPU_SSE2;
+
+  // avx2 also needs the os to save ymm registers (osxsave + xcr0).
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx = (info[2] & (1 << 28)) != 0;
+  if (max_leaf >= 7 && osxsave && avx && (xgetbv0() & 6) == 6) {
+    cpuid(info, 7);
+    if (info[1] & (1 << 5))
+      flags |= CPU_AVX2;
+  }
+  return flags;
+}
+
+#else
+
+static uint32_t detect_flags() {
+  return 0;
+}
+
+#endif
+
+uint32_t cpu_flags() {
+  // racing threads all store the same value.
+  static volatile int64_t flags = -1;
+  if (flags < 0)
+    flags = detect_flags();
+  return (uint32_t)flags;
+}
@@ -0,0 +1,25 @@
+#ifndef XFMP4_CPU_H
+#define XFMP4_CPU_H
+
+#include <stdint.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define XFMP4_X86 1
+#endif
+
+// gcc and clang only emit avx2 code in functions marked for it.
+#if defined(__GNUC__)
+#define XFMP4_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define XFMP4_TARGET_AVX2
+#endif
+
+enum {
+  CPU_SSE2 = 1 << 0,
+  CPU_AVX2 = 1 << 1
+};
+
+// CPU_* flags supported by the running cpu and os, detected once.
+uint32_t cpu_flags();
+
+#endif  // XFMP4_CPU_H
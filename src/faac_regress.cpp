@@ -0,0 +1,272 @@
+// Precision regression harness for libfaac: encodes raw signed 16 bit
+// interleaved pcm with the xfmp4 encoder settings and reports the encode
+// time per stage, the bitstream throughput and the quantization snr. Built twice, against the
+// default double libfaac (faac_regress) and the FAAC_PRECISION_SINGLE one
+// (faac_regress_float). Fails if the encoder allocates memory after the
+// first frame.
+//
+//   faac_regress [--tns] [--ltp] [--adts] [--threads N] input.raw channels sample_rate out_prefix [reference_prefix]
+//
+// writes out_prefix.aac (raw frames, each preceded by its 32 bit length)
+// and out_prefix.snr (quantizer signal and noise energy per frame). Given
+// the prefix of another run, the bitstreams and snr are compared to it.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "frame.h"
+
+static const char *stage_names[STAGE_COUNT] = {
+  "input", "psych", "filterbank", "tns", "prediction",
+  "midside", "quantize", "reconstruct", "bitstream"
+};
+
+struct frame_snr {
+  double signal;
+  double noise;
+};
+
+struct run_output {
+  std::vector<std::vector<unsigned char> > frames;
+  std::vector<frame_snr> snr;
+};
+
+static double snr_db(double signal, double noise) {
+  if (noise <= 0.0)
+    return 999.0;
+  return 10.0 * log10(signal / noise);
+}
+
+static bool write_output(const std::string &prefix, const run_output &out) {
+  FILE *aac = fopen((prefix + ".aac").c_str(), "wb");
+  FILE *snr = fopen((prefix + ".snr").c_str(), "wb");
+  bool ok = aac && snr;
+
+  for (size_t i = 0; ok && i < out.frames.size(); i++) {
+    uint32_t size = (uint32_t)out.frames[i].size();
+    ok = fwrite(&size, sizeof(size), 1, aac) == 1 &&
+         (size == 0 || fwrite(&out.frames[i][0], size, 1, aac) == 1);
+  }
+  if (ok && !out.snr.empty())
+    ok = fwrite(&out.snr[0], sizeof(frame_snr), out.snr.size(), snr) == out.snr.size();
+
+  if (aac) fclose(aac);
+  if (snr) fclose(snr);
+  return ok;
+}
+
+static bool read_output(const std::string &prefix, run_output *out) {
+  FILE *aac = fopen((prefix + ".aac").c_str(), "rb");
+  FILE *snr = fopen((prefix + ".snr").c_str(), "rb");
+  bool ok = aac && snr;
+
+  uint32_t size;
+  while (ok && fread(&size, sizeof(size), 1, aac) == 1) {
+    out->frames.push_back(std::vector<unsigned char>(size));
+    ok = size == 0 || fread(&out->frames.back()[0], size, 1, aac) == 1;
+  }
+  frame_snr s;
+  while (ok && fread(&s, sizeof(s), 1, snr) == 1)
+    out->snr.push_back(s);
+
+  if (aac) fclose(aac);
+  if (snr) fclose(snr);
+  return ok;
+}
+
+static void compare(const run_output &out, const run_output &ref) {
+  size_t frames = out.frames.size() < ref.frames.size() ? out.frames.size() : ref.frames.size();
+  size_t identical = 0;
+  size_t bytes = 0, ref_bytes = 0;
+  for (size_t i = 0; i < out.frames.size(); i++)
+    bytes += out.frames[i].size();
+  for (size_t i = 0; i < ref.frames.size(); i++)
+    ref_bytes += ref.frames[i].size();
+  for (size_t i = 0; i < frames; i++) {
+    if (out.frames[i] == ref.frames[i])
+      identical++;
+  }
+
+  printf("reference:   %u frames, %u bytes\n", (unsigned)ref.frames.size(), (unsigned)ref_bytes);
+  printf("identical:   %u of %u frames, %+d bytes\n", (unsigned)identical, (unsigned)frames,
+         (int)bytes - (int)ref_bytes);
+
+  // snr difference per frame, frames without signal in either run are skipped.
+  size_t snr_frames = out.snr.size() < ref.snr.size() ? out.snr.size() : ref.snr.size();
+  double signal = 0.0, noise = 0.0, ref_signal = 0.0, ref_noise = 0.0;
+  double sum_diff = 0.0, worst_diff = 0.0;
+  size_t counted = 0, worst_frame = 0;
+  for (size_t i = 0; i < snr_frames; i++) {
+    signal += out.snr[i].signal;
+    noise += out.snr[i].noise;
+    ref_signal += ref.snr[i].signal;
+    ref_noise += ref.snr[i].noise;
+    if (out.snr[i].signal <= 0.0 || ref.snr[i].signal <= 0.0)
+      continue;
+    double diff = snr_db(out.snr[i].signal, out.snr[i].noise) -
+                  snr_db(ref.snr[i].signal, ref.snr[i].noise);
+    sum_diff += diff;
+    if (fabs(diff) > fabs(worst_diff)) {
+      worst_diff = diff;
+      worst_frame = i;
+    }
+    counted++;
+  }
+  printf("snr:         %.3f dB, reference %.3f dB\n", snr_db(signal, noise),
+         snr_db(ref_signal, ref_noise));
+  if (counted) {
+    printf("snr diff:    mean %+.4f dB, worst %+.4f dB (frame %u)\n", sum_diff / counted,
+           worst_diff, (unsigned)worst_frame);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  bool use_tns = false;
+  bool use_ltp = false;
+  bool use_adts = false;
+  unsigned int threads = 1;
+  int arg = 1;
+  for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++) {
+    if (strcmp(argv[arg], "--tns") == 0)
+      use_tns = true;
+    else if (strcmp(argv[arg], "--ltp") == 0)
+      use_ltp = true;
+    else if (strcmp(argv[arg], "--adts") == 0)
+      use_adts = true;
+    else if (strcmp(argv[arg], "--threads") == 0 && arg + 1 < argc)
+      threads = (unsigned int)atoi(argv[++arg]);
+    else
+      break;
+  }
+  if (argc - arg != 4 && argc - arg != 5) {
+    fprintf(stderr, "usage: faac_regress [--tns] [--ltp] [--adts] [--threads N] input.raw channels sample_rate out_prefix [reference_prefix]\n");
+    return 1;
+  }
+  const char *input_name = argv[arg];
+  unsigned int channels = (unsigned int)atoi(argv[arg + 1]);
+  unsigned long sample_rate = (unsigned long)atol(argv[arg + 2]);
+  std::string out_prefix = argv[arg + 3];
+  const char *ref_prefix = argc - arg == 5 ? argv[arg + 4] : NULL;
+
+  FILE *input = fopen(input_name, "rb");
+  if (!input) {
+    fprintf(stderr, "can't open %s\n", input_name);
+    return 1;
+  }
+
+  unsigned long input_samples = 0, output_size = 0;
+  faacEncHandle encoder = faacEncOpen(sample_rate, channels, &input_samples, &output_size);
+  if (!encoder) {
+    fprintf(stderr, "can't open the encoder\n");
+    fclose(input);
+    return 1;
+  }
+
+  // same settings as xfmp4, which writes raw frames.
+  faacEncConfigurationPtr config = faacEncGetCurrentConfiguration(encoder);
+  config->inputFormat = FAAC_INPUT_16BIT;
+  config->outputFormat = use_adts ? 1 : 0;
+  config->mpegVersion = MPEG4;
+  config->aacObjectType = use_ltp ? LTP : LOW;
+  config->allowMidside = 1;
+  config->useTns = use_tns ? 1 : 0;
+  config->useLfe = 0;
+  config->quantqual = 100;
+  config->numThreads = threads;
+  if (!faacEncSetConfiguration(encoder, config)) {
+    fprintf(stderr, "unsupported parameters\n");
+    faacEncClose(encoder);
+    fclose(input);
+    return 1;
+  }
+
+  // FAAC_INPUT_16BIT takes shorts in the int32_t buffer.
+  std::vector<int32_t> pcm(input_samples);
+  std::vector<unsigned char> buffer(output_size);
+  run_output out;
+  double last_signal = 0.0, last_noise = 0.0;
+  unsigned long first_frame_allocs = 0;
+  bool first_frame = true;
+  double start_time = GetTimer();
+
+  for (;;) {
+    size_t samples = fread(&pcm[0], sizeof(short), input_samples, input);
+    int bytes = faacEncEncode(encoder, &pcm[0], (unsigned int)samples, &buffer[0],
+                              (unsigned int)output_size);
+    if (first_frame) {
+      first_frame_allocs = faacAllocCount;
+      first_frame = false;
+    }
+    if (bytes < 0) {
+      fprintf(stderr, "encode failed\n");
+      break;
+    }
+    if (bytes == 0) {
+      // the first frames only fill the encoder delay.
+      if (samples == 0)
+        break;
+      continue;
+    }
+    out.frames.push_back(std::vector<unsigned char>(buffer.begin(), buffer.begin() + bytes));
+    frame_snr s = { encoder->stats.quantSignal - last_signal,
+                    encoder->stats.quantNoise - last_noise };
+    out.snr.push_back(s);
+    last_signal = encoder->stats.quantSignal;
+    last_noise = encoder->stats.quantNoise;
+  }
+  double wall_time = GetTimer() - start_time;
+  fclose(input);
+
+  size_t total_bytes = 0;
+  for (size_t i = 0; i < out.frames.size(); i++)
+    total_bytes += out.frames[i].size();
+
+  printf("precision:   %s\n", sizeof(faac_real) == sizeof(float) ? "single" : "double");
+  printf("threads:     %u\n", threads);
+  printf("encoded:     %u frames, %u bytes\n", (unsigned)out.frames.size(), (unsigned)total_bytes);
+
+  double total_time = 0.0;
+  for (int i = 0; i < STAGE_COUNT; i++)
+    total_time += encoder->stats.time[i];
+  size_t frames = out.frames.empty() ? 1 : out.frames.size();
+  // stage times are summed over all threads, wall is the elapsed time.
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    printf("  %-12s %8.2f us/frame %5.1f%%\n", stage_names[i], encoder->stats.time[i] * 1e6 / frames,
+           total_time > 0.0 ? 100.0 * encoder->stats.time[i] / total_time : 0.0);
+  }
+  printf("  %-12s %8.2f us/frame\n", "total", total_time * 1e6 / frames);
+  printf("  %-12s %8.2f us/frame\n", "wall", wall_time * 1e6 / frames);
+  // output bits per second of the bitstream writer and of the whole encoder.
+  double bits = 8.0 * total_bytes;
+  double write_time = encoder->stats.time[STAGE_BITSTREAM];
+  printf("throughput:  %.1f Mbit/s bitstream, %.3f Mbit/s encode\n",
+         write_time > 0.0 ? bits / write_time * 1e-6 : 0.0,
+         wall_time > 0.0 ? bits / wall_time * 1e-6 : 0.0);
+  printf("snr:         %.3f dB\n", snr_db(encoder->stats.quantSignal, encoder->stats.quantNoise));
+  unsigned long steady_allocs = faacAllocCount - first_frame_allocs;
+  printf("allocations: %lu after the first frame\n", steady_allocs);
+  faacEncClose(encoder);
+
+  if (!write_output(out_prefix, out)) {
+    fprintf(stderr, "can't write %s.aac/.snr\n", out_prefix.c_str());
+    return 1;
+  }
+
+  if (ref_prefix) {
+    run_output ref;
+    if (!read_output(ref_prefix, &ref)) {
+      fprintf(stderr, "can't read %s.aac/.snr\n", ref_prefix);
+      return 1;
+    }
+    compare(out, ref);
+  }
+  if (steady_allocs) {
+    fprintf(stderr, "the encoder allocated memory after the first frame\n");
+    return 1;
+  }
+  return 0;
+}
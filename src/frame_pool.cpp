@@ -0,0 +1,56 @@
+#include "frame_pool.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+static const size_t frame_alignment = 64;
+
+frame_pool::frame_pool(size_t frame_size, uint32_t count)
+    : frame_size_(frame_size),
+      frame_stride_((frame_size + frame_alignment - 1) & ~(frame_alignment - 1)),
+      count_(count), memory_(NULL), acquired_(0), free_(count) {
+  // page granular allocation, every frame starts on a cache line.
+  const size_t total = frame_stride_ * count_;
+#ifdef _WIN32
+  memory_ = (uint8_t *)VirtualAlloc(NULL, total, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+  void *mapping = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  memory_ = mapping == MAP_FAILED ? NULL : (uint8_t *)mapping;
+#endif
+  if (memory_ == NULL) {
+    count_ = 0;
+    return;
+  }
+
+  for (uint32_t i = 0; i < count_; i++)
+    free_.push(memory_ + frame_stride_ * i);
+}
+
+frame_pool::~frame_pool() {
+  if (memory_ == NULL)
+    return;
+#ifdef _WIN32
+  VirtualFree(memory_, 0, MEM_RELEASE);
+#else
+  munmap(memory_, frame_stride_ * count_);
+#endif
+}
+
+uint8_t *frame_pool::acquire() {
+  uint8_t *frame;
+  if (!free_.pop(&frame))
+    return NULL;
+  acquired_++;
+  return frame;
+}
+
+void frame_pool::release(uint8_t *frame) {
+  free_.push(frame);
+}
+
+void frame_pool::cancel() {
+  free_.cancel();
+}
@@ -0,0 +1,44 @@
+#ifndef XFMP4_FRAME_POOL_H
+#define XFMP4_FRAME_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#include "spsc_queue.h"
+
+// Fixed set of preallocated, cache line aligned frame buffers.
+//
+// All buffers are carved out of a single allocation made by the
+// constructor, so a pipeline that recycles its frames through acquire()
+// and release() does no heap allocation per frame. acquire() blocks while
+// every buffer is in flight. One thread acquires, one thread releases.
+class frame_pool {
+ public:
+  frame_pool(size_t frame_size, uint32_t count);
+  ~frame_pool();
+
+  // returns NULL once the pool is cancelled.
+  uint8_t *acquire();
+  void release(uint8_t *frame);
+  void cancel();
+
+  size_t frame_size() const { return frame_size_; }
+  uint32_t count() const { return count_; }
+
+  // number of frames handed out by acquire().
+  uint64_t acquired() const { return acquired_; }
+
+ private:
+  frame_pool(const frame_pool &);
+  frame_pool &operator=(const frame_pool &);
+
+  size_t   frame_size_;
+  size_t   frame_stride_;
+  uint32_t count_;
+  uint8_t *memory_;
+  std::atomic<uint64_t> acquired_;
+  spsc_queue<uint8_t *> free_;
+};
+
+#endif  // XFMP4_FRAME_POOL_H
@@ -0,0 +1,189 @@
+#include "input_stream.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+// read-ahead size, reads at least this big bypass the buffer.
+static const size_t read_ahead_size = 64 * 1024;
+
+#ifdef _WIN32
+// how long to wait for the pipe server to create a named pipe.
+static const DWORD pipe_wait_ms = 5000;
+#endif
+
+input_stream::input_stream()
+    :
+#ifdef _WIN32
+      handle_(INVALID_HANDLE_VALUE),
+#else
+      fd_(-1), fifo_(false), connected_(true),
+#endif
+      owned_(true), eof_(false),
+      buffer_(new uint8_t[read_ahead_size]), buffer_pos_(0), buffer_len_(0), os_reads_(0) {
+}
+
+input_stream::~input_stream() {
+#ifdef _WIN32
+  if (owned_ && handle_ != INVALID_HANDLE_VALUE)
+    CloseHandle(handle_);
+#else
+  if (owned_ && fd_ >= 0)
+    close(fd_);
+#endif
+  delete[] buffer_;
+}
+
+#ifdef _WIN32
+
+input_stream *input_stream::open(const char *name) {
+  input_stream *in = new input_stream;
+
+  if (strcmp(name, "-") == 0) {
+    in->handle_ = GetStdHandle(STD_INPUT_HANDLE);
+    in->owned_ = false;
+  } else {
+    for (;;) {
+      in->handle_ = CreateFileA(name, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL);
+      if (in->handle_ != INVALID_HANDLE_VALUE)
+        break;
+
+      // the server may not have created (or freed an instance of) the pipe yet.
+      DWORD error = GetLastError();
+      if (error != ERROR_PIPE_BUSY && error != ERROR_FILE_NOT_FOUND)
+        break;
+      if (!WaitNamedPipeA(name, pipe_wait_ms))
+        break;
+    }
+  }
+
+  if (in->handle_ == INVALID_HANDLE_VALUE || in->handle_ == NULL) {
+    in->handle_ = INVALID_HANDLE_VALUE;
+    delete in;
+    return NULL;
+  }
+  return in;
+}
+
+size_t input_stream::read_some(void *buffer, size_t size, bool) {
+  if (eof_)
+    return 0;
+
+  DWORD read_size = 0;
+  os_reads_++;
+  // a closed pipe fails with ERROR_BROKEN_PIPE, a file returns 0 bytes.
+  if (!ReadFile(handle_, buffer, (DWORD)size, &read_size, NULL) || read_size == 0) {
+    eof_ = true;
+    return 0;
+  }
+  return read_size;
+}
+
+#else
+
+input_stream *input_stream::open(const char *name) {
+  input_stream *in = new input_stream;
+
+  if (strcmp(name, "-") == 0) {
+    in->fd_ = STDIN_FILENO;
+    in->owned_ = false;
+  } else {
+    struct stat st;
+    in->fifo_ = stat(name, &st) == 0 && S_ISFIFO(st.st_mode);
+    // opening a fifo blocks until the writer shows up, open it
+    // non-blocking and wait in poll() on the first read instead.
+    in->fd_ = ::open(name, O_RDONLY | (in->fifo_ ? O_NONBLOCK : 0));
+    in->connected_ = !in->fifo_;
+  }
+
+  if (in->fd_ < 0) {
+    delete in;
+    return NULL;
+  }
+  return in;
+}
+
+size_t input_stream::read_some(void *buffer, size_t size, bool read_ahead) {
+  if (eof_)
+    return 0;
+
+  // a fifo reads 0 bytes until the first writer connects, poll() only
+  // reports the hangup once a writer has been there.
+  if (!connected_) {
+    struct pollfd pfd = { fd_, POLLIN, 0 };
+    while (poll(&pfd, 1, -1) < 0 && errno == EINTR) {
+    }
+    connected_ = true;
+  }
+
+  struct iovec iov[2] = { { buffer, size }, { buffer_, read_ahead_size } };
+  for (;;) {
+    os_reads_++;
+    ssize_t n = ::readv(fd_, iov, read_ahead ? 2 : 1);
+    if (n > 0 && (size_t)n > size) {
+      buffer_pos_ = 0;
+      buffer_len_ = (size_t)n - size;
+      return size;
+    }
+    if (n > 0)
+      return (size_t)n;
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      struct pollfd pfd = { fd_, POLLIN, 0 };
+      if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+        break;
+      continue;
+    }
+    break;
+  }
+
+  eof_ = true;
+  return 0;
+}
+
+#endif
+
+size_t input_stream::read(void *buffer, size_t size) {
+  uint8_t *dst = (uint8_t *)buffer;
+  size_t done = 0;
+
+  while (done < size) {
+    // serve from the read-ahead buffer first
+    if (buffer_pos_ < buffer_len_) {
+      size_t n = buffer_len_ - buffer_pos_;
+      if (n > size - done)
+        n = size - done;
+      memcpy(dst + done, buffer_ + buffer_pos_, n);
+      buffer_pos_ += n;
+      done += n;
+      continue;
+    }
+
+    // large reads go directly into the destination, the read-ahead
+    // buffer is empty and takes what the os has beyond them.
+    if (size - done >= read_ahead_size) {
+      size_t n = read_some(dst + done, size - done, true);
+      if (n == 0)
+        break;
+      done += n;
+      continue;
+    }
+
+    buffer_pos_ = 0;
+    buffer_len_ = read_some(buffer_, read_ahead_size, false);
+    if (buffer_len_ == 0)
+      break;
+  }
+
+  return done;
+}
@@ -0,0 +1,55 @@
+#ifndef XFMP4_INPUT_STREAM_H
+#define XFMP4_INPUT_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Sequential raw input: a named pipe, fifo, regular file or stdin ("-").
+//
+// Small reads are served from an internal read-ahead buffer that is
+// refilled with one large read, large reads go straight into the caller's
+// memory, such as a pooled frame, and on POSIX refill the read-ahead buffer
+// in the same readv(). read() only comes back short at the end of the
+// stream. Pipes
+// without a writer yet are waited for (WaitNamedPipe, poll) instead of
+// failing or spinning.
+class input_stream {
+ public:
+  // returns NULL if the input can't be opened.
+  static input_stream *open(const char *name);
+  ~input_stream();
+
+  // fills buffer completely unless the stream ends, returns bytes read.
+  size_t read(void *buffer, size_t size);
+
+  bool eof() const { return eof_ && buffer_pos_ == buffer_len_; }
+
+  // number of reads issued to the os.
+  uint64_t os_reads() const { return os_reads_; }
+
+ private:
+  input_stream();
+  input_stream(const input_stream &);
+  input_stream &operator=(const input_stream &);
+
+  // one os read of up to size bytes, 0 at the end of the stream. with
+  // read_ahead set, bytes past size may refill the read-ahead buffer.
+  size_t read_some(void *buffer, size_t size, bool read_ahead);
+
+#ifdef _WIN32
+  void *handle_;
+#else
+  int  fd_;
+  bool fifo_;
+  bool connected_;
+#endif
+  bool owned_;
+  bool eof_;
+
+  uint8_t *buffer_;
+  size_t   buffer_pos_;
+  size_t   buffer_len_;
+  uint64_t os_reads_;
+};
+
+#endif  // XFMP4_INPUT_STREAM_H
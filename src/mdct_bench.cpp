@@ -0,0 +1,70 @@
+// Times the libfaac transforms on random input and reports ns per call:
+// the 2048 and 256 point MDCT and IMDCT and the 256 point real fft of the
+// psychoacoustic model.
+//
+//   mdct_bench [iterations]
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "filtbank.h"
+
+typedef void (*transform_fn)(FFT_Tables *tables, faac_real *data, int n, ScratchArena *scratch);
+
+static void rfft_transform(FFT_Tables *tables, faac_real *data, int n, ScratchArena *) {
+  int logm = 0;
+  while ((1 << logm) < n)
+    logm++;
+  rfft(tables, data, logm);
+}
+
+static void run(const char *name, transform_fn fn, FFT_Tables *tables, ScratchArena *scratch, int n,
+                int iterations) {
+  faac_real *data = new faac_real[n];
+  for (int i = 0; i < n; i++)
+    data[i] = (rand() / (double)RAND_MAX - 0.5) * 32768.0;
+
+  // warm up caches and the cpu clock before timing.
+  for (int i = 0; i < iterations / 10 + 1; i++)
+    fn(tables, data, n, scratch);
+
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    // keep the values bounded, the transforms aren't normalized.
+    if ((i & 63) == 0) {
+      for (int j = 0; j < n; j++)
+        data[j] = (rand() / (double)RAND_MAX - 0.5) * 32768.0;
+    }
+    fn(tables, data, n, scratch);
+  }
+  std::chrono::nanoseconds elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::high_resolution_clock::now() - start);
+
+  printf("%-6s %4d: %8.0f ns\n", name, n, (double)elapsed.count() / iterations);
+  delete[] data;
+}
+
+int main(int argc, char *argv[]) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 100000;
+  if (iterations <= 0) {
+    fprintf(stderr, "usage: mdct_bench [iterations]\n");
+    return 1;
+  }
+
+  FFT_Tables tables;
+  fft_initialize(&tables);
+  ScratchArena scratch;
+  ScratchInit(&scratch, ENC_SCRATCH_SIZE);
+  srand(1);
+
+  run("mdct", MDCT, &tables, &scratch, 2 * BLOCK_LEN_LONG, iterations);
+  run("imdct", IMDCT, &tables, &scratch, 2 * BLOCK_LEN_LONG, iterations);
+  run("mdct", MDCT, &tables, &scratch, 2 * BLOCK_LEN_SHORT, iterations);
+  run("imdct", IMDCT, &tables, &scratch, 2 * BLOCK_LEN_SHORT, iterations);
+  run("rfft", rfft_transform, &tables, &scratch, 256, iterations);
+
+  ScratchEnd(&scratch);
+  fft_terminate(&tables);
+  return 0;
+}
@@ -0,0 +1,252 @@
+// Times mp4v2 on files with large sample tables: writes one video track of
+// many tiny samples with varying sizes, durations and rendering offsets,
+// so stsz, stts and ctts get an entry per sample, then reports the time
+// MP4WriteSample takes, the time MP4Close spends building and writing the
+// tables and the time MP4Read and
+// MP4ReadMapped take to open the file, and MP4_READ_LAZY_TABLES takes to
+// open it and get the track duration. Then times reading every sample
+// with MP4ReadSample and with a sample cursor. The sample sizes and sync
+// flags read back are checked against the ones written.
+//
+// With --random it writes a 10 hour 30 fps track instead and times random
+// access: a sample id from a random time, the sample itself and its
+// rendering offset, all checked.
+//
+//   mp4open_bench [--co64] [--random] [samples] [rounds] [file]
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mp4.h"
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// size and sync flag of sample id, 1 based like MP4SampleId.
+static uint32_t sample_size(uint32_t id) {
+  return 1 + (id * 2654435761u >> 28);
+}
+
+static bool is_sync(uint32_t id) {
+  return id % 30 == 1;
+}
+
+// start time of sample id, the durations alternate 3000 and 3001.
+static MP4Timestamp sample_time(uint32_t id) {
+  return (MP4Timestamp)3000 * (id - 1) + id / 2;
+}
+
+static bool write_file(const char *name, uint32_t samples, bool co64, double *write_time, double *close_time) {
+  MP4FileHandle file = MP4Create(name, 0, co64 ? MP4_CREATE_64BIT_DATA : 0);
+  if (file == MP4_INVALID_FILE_HANDLE)
+    return false;
+  MP4SetTimeScale(file, 90000);
+  MP4TrackId track = MP4AddVideoTrack(file, 90000, MP4_INVALID_DURATION, 64, 48);
+  uint8_t data[16];
+  memset(data, 0, sizeof(data));
+  bool ok = track != MP4_INVALID_TRACK_ID;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint32_t id = 1; ok && id <= samples; id++) {
+    // alternating durations and offsets, nothing run length codes.
+    ok = MP4WriteSample(file, track, data, sample_size(id), 3000 + (id & 1), (id % 3) * 3000, is_sync(id));
+  }
+  *write_time = seconds_since(start);
+  start = std::chrono::steady_clock::now();
+  MP4Close(file);
+  *close_time = seconds_since(start);
+  return ok;
+}
+
+static bool check_file(MP4FileHandle file, uint32_t samples) {
+  MP4TrackId track = MP4FindTrackId(file, 0);
+  if (MP4GetTrackNumberOfSamples(file, track) != samples) {
+    fprintf(stderr, "%u samples read back, %u written\n", MP4GetTrackNumberOfSamples(file, track), samples);
+    return false;
+  }
+  for (uint32_t id = 1; id <= samples; id++) {
+    if (MP4GetSampleSize(file, track, id) != sample_size(id) || MP4GetSampleSync(file, track, id) != is_sync(id)) {
+      fprintf(stderr, "sample %u differs\n", id);
+      return false;
+    }
+  }
+  return true;
+}
+
+// best time of rounds opens with MP4ReadWithFlags, the last one is
+// checked. With MP4_READ_LAZY_TABLES the time includes getting the track
+// duration, which is all a metadata only reader needs.
+static bool time_open(const char *name, uint32_t flags, uint32_t samples, int rounds, double *best) {
+  *best = 0.0;
+  for (int r = 0; r < rounds; r++) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    MP4FileHandle file = MP4ReadWithFlags(name, 0, flags);
+    if (file != MP4_INVALID_FILE_HANDLE && (flags & MP4_READ_LAZY_TABLES))
+      MP4GetTrackDuration(file, MP4FindTrackId(file, 0));
+    double elapsed = seconds_since(start);
+    if (file == MP4_INVALID_FILE_HANDLE) {
+      fprintf(stderr, "can't open %s\n", name);
+      return false;
+    }
+    if (r == 0 || elapsed < *best)
+      *best = elapsed;
+    bool ok = r != rounds - 1 || check_file(file, samples);
+    MP4Close(file);
+    if (!ok)
+      return false;
+  }
+  return true;
+}
+
+// best time of rounds reads of every sample with its times and sync flag,
+// through MP4ReadSample or through a sample cursor.
+static bool time_read(const char *name, uint32_t flags, bool cursor, uint32_t samples, int rounds, double *best) {
+  MP4FileHandle file = MP4ReadWithFlags(name, 0, flags);
+  if (file == MP4_INVALID_FILE_HANDLE) {
+    fprintf(stderr, "can't open %s\n", name);
+    return false;
+  }
+  MP4TrackId track = MP4FindTrackId(file, 0);
+  uint8_t buffer[64];
+  bool ok = true;
+  *best = 0.0;
+  for (int r = 0; ok && r < rounds; r++) {
+    MP4Timestamp start_time, expected_time = 0;
+    MP4Duration duration, offset;
+    bool sync;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (cursor) {
+      MP4SampleCursorHandle samples_cursor = MP4OpenSampleCursor(file, track);
+      const uint8_t *bytes;
+      uint32_t size;
+      uint32_t id = 1;
+      for (; ok && MP4NextSample(samples_cursor, &bytes, &size, &start_time, &duration, &offset, &sync); id++) {
+        ok = size == sample_size(id) && sync == is_sync(id) && start_time == expected_time;
+        expected_time += duration;
+      }
+      ok = ok && id == samples + 1;
+      MP4CloseSampleCursor(samples_cursor);
+    } else {
+      for (uint32_t id = 1; ok && id <= samples; id++) {
+        uint8_t *bytes = buffer;
+        uint32_t size = sizeof(buffer);
+        ok = MP4ReadSample(file, track, id, &bytes, &size, &start_time, &duration, &offset, &sync) &&
+             size == sample_size(id) && sync == is_sync(id) && start_time == expected_time;
+        expected_time += duration;
+      }
+    }
+    double elapsed = seconds_since(start);
+    if (r == 0 || elapsed < *best)
+      *best = elapsed;
+  }
+  MP4Close(file);
+  if (!ok)
+    fprintf(stderr, "samples read back differ\n");
+  return ok;
+}
+
+static const uint32_t random_queries = 100000;
+
+// best time of rounds of random_queries lookups, each finds the sample
+// at a random time, reads it and gets its rendering offset.
+static bool time_random(const char *name, uint32_t samples, int rounds, double *best) {
+  MP4FileHandle file = MP4Read(name, 0);
+  if (file == MP4_INVALID_FILE_HANDLE) {
+    fprintf(stderr, "can't open %s\n", name);
+    return false;
+  }
+  MP4TrackId track = MP4FindTrackId(file, 0);
+  uint8_t buffer[64];
+  bool ok = true;
+  *best = 0.0;
+  for (int r = 0; ok && r < rounds; r++) {
+    srand(1);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t q = 0; ok && q < random_queries; q++) {
+      uint32_t expected = 1 + (uint32_t)rand() % samples;
+      MP4Timestamp when = sample_time(expected) + (uint32_t)rand() % 3000;
+      MP4SampleId id = MP4GetSampleIdFromTime(file, track, when, false);
+      uint8_t *bytes = buffer;
+      uint32_t size = sizeof(buffer);
+      MP4Timestamp start_time;
+      ok = id == expected &&
+           MP4ReadSample(file, track, id, &bytes, &size, &start_time, NULL, NULL, NULL) &&
+           size == sample_size(id) && start_time == sample_time(id) &&
+           MP4GetSampleRenderingOffset(file, track, id) == (MP4Duration)(id % 3) * 3000;
+    }
+    double elapsed = seconds_since(start);
+    if (r == 0 || elapsed < *best)
+      *best = elapsed;
+  }
+  MP4Close(file);
+  if (!ok)
+    fprintf(stderr, "random access results differ\n");
+  return ok;
+}
+
+int main(int argc, char *argv[]) {
+  bool co64 = false;
+  bool random = false;
+  int arg = 1;
+  for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++) {
+    if (strcmp(argv[arg], "--co64") == 0)
+      co64 = true;
+    else if (strcmp(argv[arg], "--random") == 0)
+      random = true;
+    else
+      break;
+  }
+  // 10 hours at 30 fps for random access.
+  uint32_t samples = arg < argc ? (uint32_t)atol(argv[arg++]) : random ? 10 * 3600 * 30 : 2000000;
+  int rounds = arg < argc ? atoi(argv[arg++]) : random ? 3 : 5;
+  const char *name = arg < argc ? argv[arg++] : "mp4open_bench.mp4";
+  if (samples == 0 || rounds <= 0 || arg != argc) {
+    fprintf(stderr, "usage: mp4open_bench [--co64] [--random] [samples] [rounds] [file]\n");
+    return 1;
+  }
+
+  double write_time, close_time;
+  if (!write_file(name, samples, co64, &write_time, &close_time)) {
+    fprintf(stderr, "can't write %s\n", name);
+    return 1;
+  }
+  printf("samples:       %u, %s\n", samples, co64 ? "co64" : "stco");
+  printf("write:         %8.2f ms, %6.1f ns per sample\n", write_time * 1e3, write_time * 1e9 / samples);
+  printf("close:         %8.2f ms\n", close_time * 1e3);
+
+  if (random) {
+    double random_time;
+    bool ok = time_random(name, samples, rounds, &random_time);
+    if (ok) {
+      printf("random access: %8.2f ms for %u queries, %6.2f us per query\n", random_time * 1e3,
+             random_queries, random_time * 1e6 / random_queries);
+    }
+    remove(name);
+    return ok ? 0 : 1;
+  }
+
+  double read_time, mapped_time, lazy_time;
+  bool ok = time_open(name, 0, samples, rounds, &read_time) &&
+            time_open(name, MP4_READ_MAPPED, samples, rounds, &mapped_time) &&
+            time_open(name, MP4_READ_LAZY_TABLES, samples, rounds, &lazy_time);
+  if (ok) {
+    printf("MP4Read:       %8.2f ms, %6.1f ns per sample\n", read_time * 1e3, read_time * 1e9 / samples);
+    printf("MP4ReadMapped: %8.2f ms, %6.1f ns per sample\n", mapped_time * 1e3, mapped_time * 1e9 / samples);
+    printf("lazy tables:   %8.2f ms, %6.1f ns per sample\n", lazy_time * 1e3, lazy_time * 1e9 / samples);
+  }
+
+  double sample_time, cursor_time, mapped_cursor_time;
+  ok = ok && time_read(name, 0, false, samples, rounds, &sample_time) &&
+       time_read(name, 0, true, samples, rounds, &cursor_time) &&
+       time_read(name, MP4_READ_MAPPED, true, samples, rounds, &mapped_cursor_time);
+  if (ok) {
+    printf("MP4ReadSample: %8.2f ms, %6.1f ns per sample\n", sample_time * 1e3, sample_time * 1e9 / samples);
+    printf("cursor:        %8.2f ms, %6.1f ns per sample\n", cursor_time * 1e3, cursor_time * 1e9 / samples);
+    printf("mapped cursor: %8.2f ms, %6.1f ns per sample\n", mapped_cursor_time * 1e3,
+           mapped_cursor_time * 1e9 / samples);
+  }
+  remove(name);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+// Checks the libfaac quantizer kernels of every instruction set the cpu
+// supports against the scalar ones on random spectra, then times them
+// and reports ns per 1024 coefficients. Fails if any result differs from
+// the scalar kernels in a single bit.
+//
+//   quant_bench [iterations]
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aacquant.h"
+
+static const int coefs = FRAME_LEN;
+
+// random band boundaries, including odd starts and lengths for the tails.
+static void random_band(int *start, int *end) {
+  *start = rand() % coefs;
+  *end = *start + 1 + rand() % (coefs - *start);
+  if (*end - *start > 96)
+    *end = *start + 1 + rand() % 96;
+}
+
+static double random_unit() {
+  return rand() / (double)RAND_MAX;
+}
+
+// mdct like spectrum: mostly small values, a few large ones, exact zeros
+// and values around the 1e-20 silence threshold.
+static void random_spectrum(faac_real *xr) {
+  double scale = pow(10.0, -3.0 + 8.0 * random_unit());
+  for (int i = 0; i < coefs; i++) {
+    double v = (random_unit() - 0.5) * scale;
+    switch (rand() % 16) {
+      case 0: v = 0.0; break;
+      case 1: v = (random_unit() - 0.5) * 4e-20; break;
+      case 2: v *= 100.0; break;
+    }
+    xr[i] = (faac_real)v;
+  }
+}
+
+// xr_pow as FixNoise() quantizes it, below IXMAX_VAL, with some values on
+// the rounding boundaries.
+static void random_xr_pow(faac_real *x, const faac_real *adj43) {
+  double scale = random_unit() < 0.5 ? IXMAX_VAL - 1 : pow(2.0, 12.0 * random_unit());
+  for (int i = 0; i < coefs; i++) {
+    double v = random_unit() * scale;
+    switch (rand() % 8) {
+      case 0: v = 0.0; break;
+      case 1: v = floor(v) + 0.5; break;
+      case 2: v = floor(v) + 0.5 - adj43[(int)v + 1]; break;
+    }
+    x[i] = (faac_real)v;
+  }
+}
+
+static bool check(const QuantKernels *ref, const QuantKernels *k, const faac_real *adj43, int rounds) {
+  faac_real xr[coefs], a[coefs], b[coefs];
+  int xi_a[coefs], xi_b[coefs];
+  int failures = 0;
+
+  for (int r = 0; r < rounds && failures < 10; r++) {
+    int start, end;
+    random_spectrum(xr);
+
+    int n = r & 1 ? coefs : 1 + rand() % coefs;
+    int any_a = ref->XrPow(xr, a, n);
+    int any_b = k->XrPow(xr, b, n);
+    if (memcmp(a, b, n * sizeof(faac_real)) != 0 || !any_a != !any_b) {
+      fprintf(stderr, "%s XrPow differs, %d coefficients\n", k->name, n);
+      failures++;
+    }
+
+    random_band(&start, &end);
+    if (ref->BandMax(a, start, end) != k->BandMax(a, start, end)) {
+      fprintf(stderr, "%s BandMax differs, band %d..%d\n", k->name, start, end);
+      failures++;
+    }
+
+    random_band(&start, &end);
+    double fac = pow(2.0, -8.0 + 16.0 * random_unit());
+    memcpy(b, a, sizeof(a));
+    ref->ScaleBand(a, fac, start, end);
+    k->ScaleBand(b, fac, start, end);
+    if (memcmp(a, b, sizeof(a)) != 0) {
+      fprintf(stderr, "%s ScaleBand differs, band %d..%d, fac %g\n", k->name, start, end, fac);
+      failures++;
+    }
+
+    random_xr_pow(a, adj43);
+    random_band(&start, &end);
+    faac_real istep = (faac_real)(r & 2 ? IPOW20(0) : IPOW20((rand() % 4)));
+    memset(xi_a, 0, sizeof(xi_a));
+    memset(xi_b, 0, sizeof(xi_b));
+    ref->QuantizeBand(a, xi_a, istep, start, end, adj43);
+    k->QuantizeBand(a, xi_b, istep, start, end, adj43);
+    if (memcmp(xi_a, xi_b, sizeof(xi_a)) != 0) {
+      fprintf(stderr, "%s QuantizeBand differs, band %d..%d\n", k->name, start, end);
+      failures++;
+    }
+
+    for (int i = 0; i < coefs; i++)
+      xi_a[i] = rand() % (2 * IXMAX_VAL + 1) - IXMAX_VAL;
+    random_band(&start, &end);
+    if (ref->BandEnergy(xi_a, start, end) != k->BandEnergy(xi_a, start, end)) {
+      fprintf(stderr, "%s BandEnergy differs, band %d..%d\n", k->name, start, end);
+      failures++;
+    }
+  }
+  return failures == 0;
+}
+
+// ns per call of fn over the whole frame, in 16 coefficient bands for the
+// band kernels like FixNoise() calls them.
+template <typename Fn>
+static double time_kernel(Fn fn, int iterations) {
+  for (int i = 0; i < iterations / 10 + 1; i++)
+    fn();
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < iterations; i++)
+    fn();
+  std::chrono::nanoseconds elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::high_resolution_clock::now() - start);
+  return (double)elapsed.count() / iterations;
+}
+
+static const int band = 16;
+
+// returns the last timed result, read so the timed calls can't be dropped.
+static double bench(const QuantKernels *k, const faac_real *adj43, int iterations, double *ns) {
+  static faac_real xr[coefs], x[coefs];
+  static int xi[coefs];
+  static volatile double sink;
+  random_spectrum(xr);
+  random_xr_pow(x, adj43);
+  for (int i = 0; i < coefs; i++)
+    xi[i] = rand() % (2 * IXMAX_VAL + 1) - IXMAX_VAL;
+
+  ns[0] = time_kernel([&] { sink = k->XrPow(xr, x, coefs); }, iterations);
+  ns[1] = time_kernel([&] {
+    double m = 0.0;
+    for (int s = 0; s < coefs; s += band)
+      m += k->BandMax(x, s, s + band);
+    sink = m;
+  }, iterations);
+  ns[2] = time_kernel([&] {
+    for (int s = 0; s < coefs; s += band)
+      k->ScaleBand(x, (s & band) ? 0.5 : 2.0, s, s + band);
+  }, iterations);
+  random_xr_pow(x, adj43);
+  ns[3] = time_kernel([&] {
+    for (int s = 0; s < coefs; s += band)
+      k->QuantizeBand(x, xi, 1.0, s, s + band, adj43);
+  }, iterations);
+  ns[4] = time_kernel([&] {
+    double e = 0.0;
+    for (int s = 0; s < coefs; s += band)
+      e += k->BandEnergy(xi, s, s + band);
+    sink = e;
+  }, iterations);
+  return sink;
+}
+
+int main(int argc, char *argv[]) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 20000;
+  if (iterations <= 0) {
+    fprintf(stderr, "usage: quant_bench [iterations]\n");
+    return 1;
+  }
+
+  AACQuantCfg cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  AACQuantizeInit(NULL, 0, &cfg);
+  srand(1);
+
+  static const char *kernel_names[] = { "xr_pow", "band_max", "scale_band", "quantize", "energy" };
+  const QuantKernels *scalar = GetQuantKernels(QUANT_KERNELS_SCALAR);
+  double scalar_ns[5];
+  double sink = bench(scalar, cfg.adj43, iterations, scalar_ns);
+
+  printf("precision: %s, ns per %d coefficients, bands of %d\n",
+         sizeof(faac_real) == sizeof(float) ? "single" : "double", coefs, band);
+  bool ok = true;
+  for (int isa = 0; isa < QUANT_KERNELS_COUNT; isa++) {
+    const QuantKernels *k = GetQuantKernels(isa);
+    if (!k)
+      continue;
+    double ns[5];
+    if (isa != QUANT_KERNELS_SCALAR) {
+      bool exact = check(scalar, k, cfg.adj43, 20000);
+      printf("%-6s bit-exact: %s\n", k->name, exact ? "yes" : "NO");
+      ok = ok && exact;
+      sink += bench(k, cfg.adj43, iterations, ns);
+    } else {
+      memcpy(ns, scalar_ns, sizeof(ns));
+    }
+    for (int i = 0; i < 5; i++)
+      printf("%-6s %-10s: %8.0f ns %5.2fx\n", k->name, kernel_names[i], ns[i], scalar_ns[i] / ns[i]);
+  }
+  printf("energy checksum: %g\n", sink);
+
+  AACQuantizeEnd(NULL, 0, &cfg);
+  return ok ? 0 : 1;
+}
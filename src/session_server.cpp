@@ -0,0 +1,218 @@
+#include "session_server.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
+
+// longest request line, flags and file names of one session.
+static const size_t max_request_size = 4096;
+
+// connections waiting for a session thread, per session thread.
+static const size_t backlog_per_session = 2;
+
+#ifdef _WIN32
+
+struct session_server::state {
+};
+
+session_server::session_server(uint32_t max_sessions, session_handler handler)
+    : state_(NULL), max_sessions_(max_sessions), handler_(handler) {
+}
+
+session_server::~session_server() {
+}
+
+bool session_server::run(const char *path) {
+  fprintf(stderr, "server mode needs unix sockets, not supported on windows\n");
+  return false;
+}
+
+#else
+
+struct pending_session {
+  int fd;
+  uint64_t id;
+};
+
+struct session_server::state {
+  std::mutex lock;
+  std::condition_variable wake;
+  std::deque<pending_session> pending;
+  std::vector<std::thread> threads;
+  bool stopping;
+};
+
+session_server::session_server(uint32_t max_sessions, session_handler handler)
+    : state_(new state), max_sessions_(max_sessions ? max_sessions : 1), handler_(handler) {
+  state_->stopping = false;
+}
+
+session_server::~session_server() {
+  {
+    std::lock_guard<std::mutex> guard(state_->lock);
+    state_->stopping = true;
+  }
+  state_->wake.notify_all();
+  for (size_t i = 0; i < state_->threads.size(); i++)
+    state_->threads[i].join();
+  for (size_t i = 0; i < state_->pending.size(); i++)
+    close(state_->pending[i].fd);
+  delete state_;
+}
+
+static bool write_all(int fd, const std::string &text) {
+  size_t done = 0;
+  while (done < text.size()) {
+    ssize_t n = ::write(fd, text.data() + done, text.size() - done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    done += (size_t)n;
+  }
+  return true;
+}
+
+// reads up to the first newline, false if the client hangs up first or
+// the line doesn't fit.
+static bool read_request(int fd, std::string *request) {
+  char buffer[256];
+  for (;;) {
+    ssize_t n = ::read(fd, buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    const char *newline = (const char *)memchr(buffer, '\n', (size_t)n);
+    request->append(buffer, newline ? newline - buffer : n);
+    if (request->size() > max_request_size)
+      return false;
+    if (newline)
+      return true;
+  }
+}
+
+void session_server::serve(int fd, uint64_t id) {
+  std::string request, reply;
+  if (!read_request(fd, &request)) {
+    fprintf(stderr, "session %llu: bad request\n", (unsigned long long)id);
+    write_all(fd, "error bad request\n");
+    close(fd);
+    return;
+  }
+  if (!request.empty() && request[request.size() - 1] == '\r')
+    request.erase(request.size() - 1);
+  fprintf(stderr, "session %llu: %s\n", (unsigned long long)id, request.c_str());
+
+  // split into argv like a command line, file names can't contain blanks.
+  std::vector<std::string> words(1, "xfmp4");
+  for (size_t pos = 0; ; ) {
+    pos = request.find_first_not_of(" \t", pos);
+    if (pos == std::string::npos)
+      break;
+    size_t end = request.find_first_of(" \t", pos);
+    words.push_back(request.substr(pos, end == std::string::npos ? std::string::npos : end - pos));
+    pos = end;
+  }
+  std::vector<char *> argv(words.size() + 1, (char *)NULL);
+  for (size_t i = 0; i < words.size(); i++)
+    argv[i] = &words[i][0];
+
+  if (handler_((int)words.size(), &argv[0], &reply) != 0 && reply.empty())
+    reply = "error";
+  fprintf(stderr, "session %llu: %s\n", (unsigned long long)id, reply.c_str());
+  write_all(fd, reply + "\n");
+  close(fd);
+}
+
+void session_server::session_thread() {
+  for (;;) {
+    pending_session session;
+    {
+      std::unique_lock<std::mutex> guard(state_->lock);
+      while (state_->pending.empty() && !state_->stopping)
+        state_->wake.wait(guard);
+      if (state_->stopping)
+        return;
+      session = state_->pending.front();
+      state_->pending.pop_front();
+    }
+    serve(session.fd, session.id);
+  }
+}
+
+bool session_server::run(const char *path) {
+  struct sockaddr_un addr;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "socket path too long: %s\n", path);
+    return false;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    fprintf(stderr, "can't create socket: %s\n", strerror(errno));
+    return false;
+  }
+  unlink(path);
+  if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(listen_fd, (int)(max_sessions_ * backlog_per_session)) < 0) {
+    fprintf(stderr, "can't listen on %s: %s\n", path, strerror(errno));
+    close(listen_fd);
+    return false;
+  }
+
+  // clients that hang up early must not kill the server.
+  signal(SIGPIPE, SIG_IGN);
+
+  for (uint32_t i = 0; i < max_sessions_; i++)
+    state_->threads.push_back(std::thread(&session_server::session_thread, this));
+  fprintf(stderr, "listening on %s, %u sessions at a time\n", path, max_sessions_);
+
+  for (uint64_t id = 1; ; id++) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      fprintf(stderr, "accept failed: %s\n", strerror(errno));
+      break;
+    }
+
+    bool queued = false;
+    {
+      std::lock_guard<std::mutex> guard(state_->lock);
+      if (state_->pending.size() < max_sessions_ * backlog_per_session) {
+        pending_session session = { fd, id };
+        state_->pending.push_back(session);
+        queued = true;
+      }
+    }
+    if (queued) {
+      state_->wake.notify_one();
+    } else {
+      write_all(fd, "error busy\n");
+      close(fd);
+    }
+  }
+
+  close(listen_fd);
+  unlink(path);
+  return true;
+}
+
+#endif
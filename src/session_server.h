@@ -0,0 +1,41 @@
+#ifndef XFMP4_SESSION_SERVER_H
+#define XFMP4_SESSION_SERVER_H
+
+#include <stdint.h>
+#include <string>
+
+// Runs one session: argv[1..argc-1] are the flags the client sent, reply
+// gets the status line sent back. Returns 0 on success.
+typedef int (*session_handler)(int argc, char *argv[], std::string *reply);
+
+// Long running encoder serving sessions from a local unix socket.
+//
+// A client connects, sends the xfmp4 flags of one recording on a single
+// line ("--video_input v.fifo --audio_input a.fifo --output out.mp4\n"),
+// and reads one status line back once the recording is finished. The
+// sessions run on a fixed set of max_sessions threads, connections beyond
+// that wait in a bounded backlog and are turned away once it is full.
+// Not available on windows, run() fails there.
+class session_server {
+ public:
+  session_server(uint32_t max_sessions, session_handler handler);
+  ~session_server();
+
+  // listens on path, replacing a stale socket file. serves until the
+  // listening socket fails, returns false if it can't be set up.
+  bool run(const char *path);
+
+ private:
+  session_server(const session_server &);
+  session_server &operator=(const session_server &);
+
+  void session_thread();
+  void serve(int fd, uint64_t id);
+
+  struct state;
+  state *state_;
+  uint32_t max_sessions_;
+  session_handler handler_;
+};
+
+#endif  // XFMP4_SESSION_SERVER_H
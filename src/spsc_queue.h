@@ -0,0 +1,128 @@
+#ifndef XFMP4_SPSC_QUEUE_H
+#define XFMP4_SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+// spin, then yield, then sleep. used by consumers polling several queues.
+inline void spsc_backoff(uint32_t spin) {
+  if (spin < 64)
+    return;
+  if (spin < 256)
+    std::this_thread::yield();
+  else
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+// Bounded lock-free single producer / single consumer queue.
+//
+// push() blocks while the queue is full, so a slow consumer applies
+// backpressure to its producer instead of growing memory. pop() blocks
+// while the queue is empty and returns false once the producer closed the
+// queue and every element has been consumed. cancel() wakes both sides
+// and makes every further push()/pop() fail, used to tear down the
+// pipeline when one stage fails.
+template <typename T>
+class spsc_queue {
+ public:
+  explicit spsc_queue(uint32_t capacity)
+      : capacity_(capacity + 1), slots_(new T[capacity + 1]),
+        head_(0), tail_(0), closed_(false), cancelled_(false) {
+  }
+
+  ~spsc_queue() {
+    delete[] slots_;
+  }
+
+  uint32_t capacity() const {
+    return capacity_ - 1;
+  }
+
+  uint32_t size() const {
+    uint32_t head = head_.load(std::memory_order_acquire);
+    uint32_t tail = tail_.load(std::memory_order_acquire);
+    return tail >= head ? tail - head : capacity_ - head + tail;
+  }
+
+  bool try_push(const T &value) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    uint32_t next = tail + 1 == capacity_ ? 0 : tail + 1;
+    if (next == head_.load(std::memory_order_acquire))
+      return false;
+    slots_[tail] = value;
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool try_pop(T *value) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire))
+      return false;
+    *value = slots_[head];
+    head_.store(head + 1 == capacity_ ? 0 : head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool push(const T &value) {
+    for (uint32_t spin = 0; ; spin++) {
+      if (cancelled_.load(std::memory_order_acquire))
+        return false;
+      if (try_push(value))
+        return true;
+      spsc_backoff(spin);
+    }
+  }
+
+  bool pop(T *value) {
+    for (uint32_t spin = 0; ; spin++) {
+      if (cancelled_.load(std::memory_order_acquire))
+        return false;
+      if (try_pop(value))
+        return true;
+      // check closed before retrying, so the last push is never missed.
+      if (closed_.load(std::memory_order_acquire))
+        return try_pop(value);
+      spsc_backoff(spin);
+    }
+  }
+
+  // called by the producer after the last push.
+  void close() {
+    closed_.store(true, std::memory_order_release);
+  }
+
+  void cancel() {
+    cancelled_.store(true, std::memory_order_release);
+  }
+
+  bool cancelled() const {
+    return cancelled_.load(std::memory_order_acquire);
+  }
+
+  // true once the producer closed the queue and it has been emptied.
+  bool drained() const {
+    if (!closed_.load(std::memory_order_acquire))
+      return false;
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+  }
+
+ private:
+  spsc_queue(const spsc_queue &);
+  spsc_queue &operator=(const spsc_queue &);
+
+  const uint32_t capacity_;
+  T *slots_;
+
+  // producer and consumer indices live on separate cache lines.
+  char pad0_[64];
+  std::atomic<uint32_t> head_;
+  char pad1_[64];
+  std::atomic<uint32_t> tail_;
+  char pad2_[64];
+  std::atomic<bool> closed_;
+  std::atomic<bool> cancelled_;
+};
+
+#endif  // XFMP4_SPSC_QUEUE_H
@@ -6,179 +6,673 @@ extern "C" {
 #include <x264.h>
 }
 
-#include <Windows.h>
 #include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "audio_convert.h"
+#include "color_convert.h"
+#include "frame_pool.h"
+#include "input_stream.h"
+#include "session_server.h"
+#include "spsc_queue.h"
 
 static void show_error(const char *msg) {
   fprintf(stderr, "%s\n", msg);
 }
 
-// color convert
-#define rgbtoy(b, g, r, y) \
-  y = (unsigned char)(((int)(30 * r) + (int)(59 * g) + (int)(11 * b)) / 100)
-
-#define rgbtouv(b, g, r, u, v) \
-  u = (unsigned char)(((int)(-17 * r) - (int)(33 * g) + (int)(50 * b) + 12800) / 100); \
-  v = (unsigned char)(((int)(50 * r) - (int)(42 * g) - (int)(8 * b) + 12800) / 100)
-
-typedef struct {
-  struct {
-    int size_min;
-    int next;
-    int cnt;
-    int idx[17];
-    int poc[17];
-  } dpb;
-  int cnt;
-  int cnt_max;
-  int *frame;
-} h264_dpb_t;
-
-static void dpb_init(h264_dpb_t *p) {
-  p->dpb.cnt = 0;
-  p->dpb.next = 0;
-  p->dpb.size_min = 0;
-  p->cnt = 0;
-  p->cnt_max = 0;
-  p->frame = NULL;
+struct mp4_convert_param_t {
+  input_stream *video_input;
+  int     video_width;
+  int     video_height;
+  int     video_framerate;
+
+  input_stream *audio_input;
+  int     audio_samplerate;
+
+  // 0 writes one moov and mdat, otherwise moof/mdat fragments of about
+  // this length. the x264 keyframe interval is capped to it.
+  int     fragment_ms;
+
+  // recording length the moov reservation of an unfragmented file is
+  // sized for, longer recordings shift the mdat once at close.
+  int     expected_seconds;
+
+  // x264 threads, 0 lets x264 pick from the number of cores.
+  int     encoder_threads;
+
+  // zero latency x264 without b-frames and the shortest queues.
+  bool    low_latency;
+
+  // x264 preset and tune, empty for none, and the options applied on top
+  // of them through x264_param_parse, in command line order.
+  std::string x264_preset;
+  std::string x264_tune;
+  std::vector<std::pair<std::string, std::string> > x264_options;
+};
+
+// what a finished mp4_convert did, for the server's session reply.
+struct mp4_convert_stats_t {
+  uint64_t video_frames;
+  uint64_t audio_frames;
+  double   setup_seconds;
+  double   encode_seconds;
+  // time spent in x264_encoder_encode.
+  double   x264_seconds;
+  // video frame latency from being read to being written to the file.
+  double   latency_p50_ms;
+  double   latency_p99_ms;
+  double   latency_max_ms;
+};
+
+// Latencies in microseconds, 16 buckets per power of two, so a percentile
+// is within about 3% of the exact value without keeping every sample.
+class latency_histogram {
+ public:
+  latency_histogram() : count_(0), max_(0) {
+    memset(buckets_, 0, sizeof(buckets_));
+  }
+
+  void add(uint64_t us) {
+    buckets_[bucket(us)]++;
+    count_++;
+    if (us > max_)
+      max_ = us;
+  }
+
+  // middle of the bucket holding the p-th fraction of the samples, at
+  // most the largest sample.
+  uint64_t percentile(double p) const {
+    uint64_t rank = (uint64_t)ceil(p * count_);
+    uint64_t seen = 0;
+    for (int i = 0; i < bucket_count; i++) {
+      seen += buckets_[i];
+      if (seen >= rank && seen > 0) {
+        uint64_t us = i < 16 ? i : ((uint64_t)(16 + i % 16) << (i / 16 - 1)) + ((uint64_t)1 << (i / 16 - 1)) / 2;
+        return us < max_ ? us : max_;
+      }
+    }
+    return 0;
+  }
+
+  uint64_t count() const { return count_; }
+  uint64_t max() const { return max_; }
+
+ private:
+  static const int bucket_count = 16 * 61;
+
+  static int bucket(uint64_t us) {
+    if (us < 16)
+      return (int)us;
+    int exponent = 4;
+    while (exponent < 63 && (us >> (exponent + 1)) != 0)
+      exponent++;
+    // the top 5 bits of us select one of 16 buckets between 2^exponent
+    // and 2^(exponent + 1).
+    return (exponent - 3) * 16 + (int)((us >> (exponent - 4)) & 15);
+  }
+
+  uint32_t buckets_[bucket_count];
+  uint64_t count_;
+  uint64_t max_;
+};
+
+// encoded H.264 access unit, handed from the video encoder to the muxer.
+struct video_packet_t {
+  int64_t pts;
+  int64_t dts;
+  bool    keyframe;
+  std::vector<uint8_t>  data;
+  std::vector<uint32_t> nal_size;
+};
+
+// encoded AAC frame, handed from the audio encoder to the muxer.
+struct audio_packet_t {
+  std::vector<uint8_t> data;
+  MP4Duration duration;
+  MP4Duration offset;
+};
+
+// Encoding pipeline. Every stage runs on its own thread and talks to its
+// neighbours through bounded spsc queues:
+//
+//   reader -> raw_frames -> convert -> pictures -> video encode -> video_packets -> mux
+//          -> audio_frames ------------------------> audio encode -> audio_packets -/
+//
+// Raw frames come from a preallocated frame_pool, pictures, audio buffers
+// and packets are recycled through the *_free queues. Packet buffers only
+// grow until they hold the largest frame seen, allocations counts every
+// buffer the stages allocate after setup. x264, faac and mp4v2 manage
+// their own memory and are not counted. The muxer is the only stage that
+// touches the mp4 file. The reader stamps every video frame with its capture time, indexed
+// by pts, and the muxer measures the latency once the frame is written.
+struct mp4_pipeline_t {
+  mp4_convert_param_t *args;
+  x264_param_t   param;
+  x264_t        *x264_encoder;
+  faacEncHandle  faac_encoder;
+  MP4FileHandle  file;
+  MP4TrackId     audio_track;
+  MP4TrackId     video_track;
+
+  uint32_t mp4_time_scale;
+  uint32_t input_samples;
+  uint32_t output_size;
+  uint64_t audio_encoded;
+  double   x264_seconds;
+
+  // capture times in steady_clock ns by pts modulo capture_ring_size, far
+  // more than the frames x264 and the queues can hold.
+  static const uint32_t capture_ring_size = 1024;
+  int64_t capture_ns[capture_ring_size];
+  latency_histogram latency;
+
+  frame_pool                   *frames;
+  spsc_queue<uint8_t *>         raw_frames;
+  spsc_queue<x264_picture_t *>  pictures;
+  spsc_queue<x264_picture_t *>  pictures_free;
+  spsc_queue<float *>           audio_frames;
+  spsc_queue<float *>           audio_free;
+  spsc_queue<video_packet_t *>  video_packets;
+  spsc_queue<video_packet_t *>  video_packets_free;
+  spsc_queue<audio_packet_t *>  audio_packets;
+  spsc_queue<audio_packet_t *>  audio_packets_free;
+
+  // packet and iovec buffers allocated or grown while encoding.
+  std::atomic<uint64_t> allocations;
+  std::atomic<int> result;
+
+  mp4_pipeline_t(uint32_t depth, uint32_t packet_depth, uint32_t pool_size)
+      : raw_frames(depth), pictures(depth), pictures_free(pool_size), audio_frames(depth),
+        audio_free(pool_size), video_packets(packet_depth), video_packets_free(packet_depth + 2),
+        audio_packets(packet_depth), audio_packets_free(packet_depth + 2), allocations(0), result(0) {
+  }
+
+  // stop every stage, used when one of them fails.
+  void abort(const char *msg) {
+    show_error(msg);
+    result = 1;
+    frames->cancel();
+    raw_frames.cancel();
+    pictures.cancel();
+    pictures_free.cancel();
+    audio_frames.cancel();
+    audio_free.cancel();
+    video_packets.cancel();
+    video_packets_free.cancel();
+    audio_packets.cancel();
+    audio_packets_free.cancel();
+  }
+};
+
+// frames queued between two stages and packets queued for the muxer.
+// every queued frame can add a frame time of latency, low latency mode
+// keeps one in flight per stage.
+static const uint32_t queue_depth = 4;
+static const uint32_t packet_queue_depth = 16;
+static const uint32_t low_latency_queue_depth = 1;
+static const uint32_t low_latency_packet_queue_depth = 2;
+
+// nals a packet holds before its size list grows, x264 emits one per
+// slice besides the sei and parameter sets.
+static const uint32_t max_frame_nals = 16;
+
+static int64_t steady_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void reader_stage(mp4_pipeline_t *p) {
+  mp4_convert_param_t *convert_args = p->args;
+  const uint64_t samples_per_sec = convert_args->audio_samplerate;
+  const uint64_t frames_per_sec = convert_args->video_framerate;
+  const uint32_t frame_size = p->input_samples / 2;
+  const size_t pcm_size = p->input_samples * sizeof(int16_t);
+
+  // one aac frame of interleaved stereo pcm, read with a single call.
+  std::vector<int16_t> pcm(p->input_samples);
+
+  // the audio clock drives video capture: frame n is due once more than
+  // n / frames_per_sec seconds of audio have been read.
+  uint64_t total_samples = 0;
+  uint64_t capture_frames = 0;
+
+  for (;; ) {
+    if (convert_args->video_input == NULL &&
+      convert_args->audio_input == NULL)
+      break;
+
+    float *input_buffer;
+    if (!p->audio_free.pop(&input_buffer))
+      break;
+
+    // read audio data
+    size_t read_size = 0;
+    if (convert_args->audio_input != NULL) {
+      read_size = convert_args->audio_input->read(&pcm[0], pcm_size);
+      if (convert_args->audio_input->eof()) {
+        delete convert_args->audio_input;
+        convert_args->audio_input = NULL;
+      }
+    }
+    if (read_size < pcm_size)
+      memset((uint8_t *)&pcm[0] + read_size, 0, pcm_size - read_size);
+
+    // convert audio data to float
+    s16_to_float(&pcm[0], input_buffer, p->input_samples);
+    total_samples += frame_size;
+
+    while (total_samples * frames_per_sec > capture_frames * samples_per_sec) {
+      // capture image from display
+      size_t size = p->frames->frame_size();
+      uint8_t *data = p->frames->acquire();
+      if (data == NULL)
+        return;
+
+      // read video data straight into the pooled frame
+      size_t read_size = 0;
+      if (convert_args->video_input != NULL) {
+        read_size = convert_args->video_input->read(data, size);
+        if (convert_args->video_input->eof()) {
+          delete convert_args->video_input;
+          convert_args->video_input = NULL;
+        }
+      }
+      if (read_size < size)
+        memset(data + read_size, 0, size - read_size);
+
+      // convert_stage numbers the frames in this order.
+      p->capture_ns[capture_frames % mp4_pipeline_t::capture_ring_size] = steady_ns();
+      if (!p->raw_frames.push(data))
+        return;
+
+      capture_frames++;
+    }
+
+    if (!p->audio_frames.push(input_buffer))
+      return;
+  }
+
+  p->raw_frames.close();
+  p->audio_frames.close();
+}
+
+static void convert_stage(mp4_pipeline_t *p) {
+  const int width = p->param.i_width;
+  const int height = p->param.i_height;
+  int64_t pts = 0;
+
+  for (uint8_t *data; p->raw_frames.pop(&data); ) {
+    x264_picture_t *picture;
+    if (!p->pictures_free.pop(&picture))
+      return;
+
+    // convert from RGB to yuv
+    bgr24_to_i420(data, width * 3, width, height,
+                  picture->img.plane[0], picture->img.i_stride[0],
+                  picture->img.plane[1], picture->img.i_stride[1],
+                  picture->img.plane[2], picture->img.i_stride[2]);
+
+    p->frames->release(data);
+
+    picture->i_pts = pts++;
+    if (!p->pictures.push(picture))
+      return;
+  }
+
+  p->pictures.close();
 }
 
-static void dpb_clean(h264_dpb_t *p) {
-  free(p->frame);
+static bool emit_video_packet(mp4_pipeline_t *p, x264_nal_t *nal, int i_nal, x264_picture_t *pic_out) {
+  video_packet_t *packet;
+  if (!p->video_packets_free.pop(&packet))
+    return false;
+  const size_t data_capacity = packet->data.capacity();
+  const size_t nal_capacity = packet->nal_size.capacity();
+  packet->data.clear();
+  packet->nal_size.clear();
+  packet->pts = pic_out->i_pts;
+  packet->dts = pic_out->i_dts;
+  packet->keyframe = pic_out->b_keyframe != 0;
+
+  for (int nal_id = 0; nal_id < i_nal; ++nal_id) {
+    uint32_t size = nal[nal_id].i_payload;
+    uint8_t *nalu = nal[nal_id].p_payload;
+
+    nalu[0] = ((size - 4) >> 24) & 0xff;
+    nalu[1] = ((size - 4) >> 16) & 0xff;
+    nalu[2] = ((size - 4) >> 8) & 0xff;
+    nalu[3] = ((size - 4) >> 0) & 0xff;
+
+    // the nal payloads are only valid until the next encoder call.
+    packet->data.insert(packet->data.end(), nalu, nalu + size);
+    packet->nal_size.push_back(size);
+  }
+  if (packet->data.capacity() != data_capacity)
+    p->allocations++;
+  if (packet->nal_size.capacity() != nal_capacity)
+    p->allocations++;
+
+  return p->video_packets.push(packet);
 }
 
-static void dpb_update(h264_dpb_t *p, int is_forced) {
-  int i;
-  int pos;
-  if (!is_forced && p->dpb.cnt < 16)
+static void video_encode_stage(mp4_pipeline_t *p) {
+  x264_nal_t *nal;
+  int i_nal;
+  int i_frame_size;
+  x264_picture_t pic_out;
+
+  for (x264_picture_t *picture; p->pictures.pop(&picture); ) {
+    // x264 copies the input picture, so it can go back to the pool right away.
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    i_frame_size = x264_encoder_encode(p->x264_encoder, &nal, &i_nal, picture, &pic_out);
+    p->x264_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!p->pictures_free.push(picture))
+      return;
+
+    if (i_frame_size < 0) {
+      p->abort("Encode h264 error.");
+      return;
+    }
+    if (i_frame_size > 0 && !emit_video_packet(p, nal, i_nal, &pic_out))
+      return;
+  }
+
+  if (p->pictures.cancelled())
     return;
-  /* find the lowest poc */
-  pos = 0;
-  for (i = 1; i < p->dpb.cnt; i++) {
-    if (p->dpb.poc[i] < p->dpb.poc[pos])
-      pos = i;
-  }
-  //fprintf(stderr, "lowest=%d\n", pos);
-  /* save the idx */
-  if (p->dpb.idx[pos] >= p->cnt_max) {
-    int inc = 1000 + (p->dpb.idx[pos] - p->cnt_max);
-    p->cnt_max += inc;
-    p->frame = (int *)realloc(p->frame, sizeof(int) * p->cnt_max);
-    for (i = 0; i < inc; i++)
-      p->frame[p->cnt_max - inc + i] = -1;   /* To detect errors latter */
-  }
-  p->frame[p->dpb.idx[pos]] = p->cnt++;
-  /* Update the dpb minimal size */
-  if (pos > p->dpb.size_min)
-    p->dpb.size_min = pos;
-  /* update dpb */
-  for (i = pos; i < p->dpb.cnt - 1; i++) {
-    p->dpb.idx[i] = p->dpb.idx[i + 1];
-    p->dpb.poc[i] = p->dpb.poc[i + 1];
-  }
-  p->dpb.cnt--;
+
+  //Flush delayed frames
+  while (x264_encoder_delayed_frames(p->x264_encoder))
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    i_frame_size = x264_encoder_encode(p->x264_encoder, &nal, &i_nal, NULL, &pic_out);
+    p->x264_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if( i_frame_size < 0 ) {
+      break;
+    }
+    else if (i_frame_size) {
+      if (!emit_video_packet(p, nal, i_nal, &pic_out))
+        return;
+    }
+  }
+
+  p->video_packets.close();
 }
 
-static void dpb_flush(h264_dpb_t *p) {
-  while (p->dpb.cnt > 0)
-    dpb_update(p, true);
+static void audio_encode_stage(mp4_pipeline_t *p) {
+  const uint32_t frame_size = p->input_samples / 2;
+  const uint32_t delay_samples = frame_size;
+  uint32_t total_samples = 0;
+  uint32_t encoded_samples = 0;
+  unsigned char *faac_buffer = new unsigned char[p->output_size];
+
+  for (float *input_buffer; p->audio_frames.pop(&input_buffer); ) {
+    total_samples += frame_size;
+    p->audio_encoded++;
+
+    // call the actual encoding routine
+    int bytes_encoded = faacEncEncode(p->faac_encoder, (int32_t *)input_buffer, p->input_samples, faac_buffer, p->output_size);
+    if (!p->audio_free.push(input_buffer))
+      break;
+
+    if (bytes_encoded < 0) {
+      p->abort("Encode aac error.");
+      break;
+    }
+
+    // write to mp4 stream
+    if (bytes_encoded > 0) {
+      uint32_t samples_left = total_samples - encoded_samples + delay_samples;
+
+      audio_packet_t *packet;
+      if (!p->audio_packets_free.pop(&packet))
+        break;
+      const size_t data_capacity = packet->data.capacity();
+      packet->data.assign(faac_buffer, faac_buffer + bytes_encoded);
+      if (packet->data.capacity() != data_capacity)
+        p->allocations++;
+      packet->duration = samples_left > frame_size ? frame_size : samples_left;
+      packet->offset = encoded_samples > 0 ? 0 : delay_samples;
+      encoded_samples += (uint32_t)packet->duration;
+
+      if (!p->audio_packets.push(packet))
+        break;
+    }
+  }
+
+  delete[] faac_buffer;
+  p->audio_packets.close();
 }
 
-static void dpb_add(h264_dpb_t *p, int poc, int is_idr) {
-  if (is_idr)
-    dpb_flush(p);
-  p->dpb.idx[p->dpb.cnt] = p->dpb.next;
-  p->dpb.poc[p->dpb.cnt] = poc;
-  p->dpb.cnt++;
-  p->dpb.next++;
+static void mux_stage(mp4_pipeline_t *p) {
+  const MP4Duration video_duration = p->mp4_time_scale / p->args->video_framerate;
+  std::vector<struct iovec> nal_iov;
+  nal_iov.reserve(max_frame_nals);
+
+  for (uint32_t spin = 0; ; spin++) {
+    bool idle = true;
+
+    video_packet_t *video;
+    if (p->video_packets.try_pop(&video)) {
+      // all nals of a frame go into one sample. the encoders run on their
+      // own threads and MP4BeginWriteSample space is only valid until the
+      // next write on the file, so the packet is gathered in with one copy.
+      uint8_t *nalu = &video->data[0];
+      const size_t iov_capacity = nal_iov.capacity();
+      nal_iov.resize(video->nal_size.size());
+      if (nal_iov.capacity() != iov_capacity)
+        p->allocations++;
+      for (size_t nal_id = 0; nal_id < video->nal_size.size(); ++nal_id) {
+        nal_iov[nal_id].iov_base = nalu;
+        nal_iov[nal_id].iov_len = video->nal_size[nal_id];
+        nalu += video->nal_size[nal_id];
+      }
 
-  dpb_update(p, false);
+      // composition offset straight from the encoder's reordering,
+      // consecutive equal offsets share one ctts entry.
+      MP4Duration offset = (video->pts - video->dts) * video_duration;
+
+      if (!MP4WriteSampleV(p->file, p->video_track, &nal_iov[0], (uint32_t)nal_iov.size(),
+                           video_duration, offset, video->keyframe)) {
+        p->abort("Encode mp4 error.");
+        return;
+      }
+      int64_t captured = p->capture_ns[video->pts % mp4_pipeline_t::capture_ring_size];
+      p->latency.add((uint64_t)(steady_ns() - captured) / 1000);
+
+      if (!p->video_packets_free.push(video))
+        return;
+      idle = false;
+    }
+
+    audio_packet_t *audio;
+    if (p->audio_packets.try_pop(&audio)) {
+      if (!MP4WriteSample(p->file, p->audio_track, &audio->data[0], (uint32_t)audio->data.size(),
+                          audio->duration, audio->offset, 1)) {
+        p->abort("Encode mp4 error.");
+        return;
+      }
+      if (!p->audio_packets_free.push(audio))
+        return;
+      idle = false;
+    }
+
+    if (idle) {
+      if (p->video_packets.drained() && p->audio_packets.drained())
+        break;
+      if (p->video_packets.cancelled())
+        break;
+      spsc_backoff(spin);
+    } else {
+      spin = 0;
+    }
+  }
 }
 
-static int dpb_frame_offset(h264_dpb_t *p, int idx) {
-  if (idx >= p->cnt)
-    return 0;
-  if (p->frame[idx] < 0)
-    return p->dpb.size_min;     /* We have an error (probably broken/truncated bitstream) */
-  return p->dpb.size_min + p->frame[idx] - idx;
+// estimated moov size for a recording of expected_seconds.
+static uint32_t moov_reserve_size(const mp4_convert_param_t *args, uint32_t audio_frame_size) {
+  // stsz + ctts per video frame, stsz per aac frame.
+  uint64_t video_bytes = (uint64_t)args->video_framerate * 12;
+  uint64_t audio_bytes = (uint64_t)args->audio_samplerate / audio_frame_size * 4;
+  // stco + stsc for one chunk per track and second.
+  uint64_t chunk_bytes = 2 * 16;
+  uint64_t size = 64 * 1024 + (video_bytes + audio_bytes + chunk_bytes) * args->expected_seconds;
+  return (uint32_t)std::min<uint64_t>(size, UINT32_MAX);
 }
 
-struct mp4_convert_param_t {
-  HANDLE  video_input;
-  int     video_width;
-  int     video_height;
-  int     video_framerate;
+// the x264 tune, with zerolatency added in low latency mode.
+static std::string x264_tune_name(const mp4_convert_param_t *args) {
+  if (!args->low_latency || args->x264_tune.find("zerolatency") != std::string::npos)
+    return args->x264_tune;
+  return args->x264_tune.empty() ? "zerolatency" : args->x264_tune + ",zerolatency";
+}
 
-  HANDLE  audio_input;
-  int     audio_samplerate;
-};
+// the settings x264 actually runs with, after the preset and its own
+// adjustments such as the automatic thread count.
+static void show_x264_settings(const mp4_convert_param_t *args, const x264_param_t *param) {
+  char rate[64];
+  if (param->rc.i_rc_method == X264_RC_CRF)
+    sprintf(rate, "crf %.1f", param->rc.f_rf_constant);
+  else if (param->rc.i_rc_method == X264_RC_ABR)
+    sprintf(rate, "bitrate %d kbps", param->rc.i_bitrate);
+  else
+    sprintf(rate, "qp %d", param->rc.i_qp_constant);
+
+  const std::string tune = x264_tune_name(args);
+  fprintf(stderr, "x264: preset %s, tune %s, %d %sthreads, lookahead %d, bframes %d, keyint %d, %s",
+          args->x264_preset.empty() ? "none" : args->x264_preset.c_str(),
+          tune.empty() ? "none" : tune.c_str(), param->i_threads,
+          param->b_sliced_threads ? "sliced " : "", param->rc.i_lookahead, param->i_bframe,
+          param->i_keyint_max, rate);
+  if (param->rc.i_vbv_max_bitrate > 0)
+    fprintf(stderr, ", vbv %d kbps / %d kbit", param->rc.i_vbv_max_bitrate, param->rc.i_vbv_buffer_size);
+  fprintf(stderr, "\n");
+}
 
-int mp4_convert(mp4_convert_param_t *convert_args, const char* filename) {
+// stats may be NULL.
+int mp4_convert(mp4_convert_param_t *convert_args, const char* filename, mp4_convert_stats_t *stats) {
 
   // temp buffer for vsti process
   const int samples_per_sec = convert_args->audio_samplerate;
   const int frames_per_sec = convert_args->video_framerate;
   const int mp4_time_scale = 90000;
+  const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
 
   unsigned int result = 0;
   unsigned long input_samples;
   unsigned long output_size;
-  faacEncHandle faac_encoder = NULL;
-  x264_t *x264_encoder = NULL;
-  unsigned char *faac_buffer = NULL;
+  const uint32_t depth = convert_args->low_latency ? low_latency_queue_depth : queue_depth;
+  const uint32_t pool_size = depth > 2 ? depth : 2;
+  mp4_pipeline_t *pipeline = new mp4_pipeline_t(
+      depth, convert_args->low_latency ? low_latency_packet_queue_depth : packet_queue_depth, pool_size);
+  pipeline->args = convert_args;
+  pipeline->x264_encoder = NULL;
+  pipeline->faac_encoder = NULL;
+  pipeline->file = NULL;
+  pipeline->audio_track = 0;
+  pipeline->video_track = 0;
+  pipeline->mp4_time_scale = mp4_time_scale;
+  pipeline->audio_encoded = 0;
+  pipeline->x264_seconds = 0.0;
+  pipeline->frames = NULL;
+  x264_param_t &param = pipeline->param;
+  MP4FileHandle &file = pipeline->file;
+  std::vector<x264_picture_t> pictures(pool_size);
+  // one packet being filled and one being written besides the queued ones.
+  std::vector<video_packet_t> video_packets(pipeline->video_packets_free.capacity());
+  std::vector<audio_packet_t> audio_packets(pipeline->audio_packets_free.capacity());
   float *input_buffer = NULL;
-  MP4FileHandle file = NULL;
-  MP4TrackId audio_track = 0;
-  MP4TrackId video_track = 0;
-
 
-  // x264 encoder param
-  x264_param_t param;
+  // x264 encoder param, the preset, tune and options were checked by
+  // parse_args().
+  const std::string tune = x264_tune_name(convert_args);
   x264_param_default(&param);
-  x264_param_default_preset(&param, "medium", NULL);
+  x264_param_default_preset(&param, convert_args->x264_preset.empty() ? NULL : convert_args->x264_preset.c_str(),
+                            tune.empty() ? NULL : tune.c_str());
+  for (size_t i = 0; i < convert_args->x264_options.size(); i++) {
+    x264_param_parse(&param, convert_args->x264_options[i].first.c_str(),
+                     convert_args->x264_options[i].second.c_str());
+  }
+  if (convert_args->low_latency) {
+    // no b-frames, so no reordering delay and pts == dts, and no
+    // lookahead. sliced threads encode each frame on all threads.
+    param.i_bframe = 0;
+    param.rc.i_lookahead = 0;
+    param.i_sync_lookahead = 0;
+    param.b_sliced_threads = 1;
+  }
   param.i_csp = X264_CSP_I420;
   param.b_repeat_headers = 0;
   param.i_width = convert_args->video_width;
   param.i_height = convert_args->video_height;
+  param.i_fps_num = convert_args->video_framerate;
+  param.i_fps_den = 1;
+  if (convert_args->fragment_ms > 0) {
+    // fragments are cut at video keyframes only, so a keyframe interval
+    // longer than fragment_ms would stretch every fragment to it.
+    int fragment_frames = std::max(1, (int)((int64_t)convert_args->fragment_ms * param.i_fps_num / 1000));
+    param.i_keyint_max = std::min(param.i_keyint_max, fragment_frames);
+  }
+  if (convert_args->encoder_threads > 0)
+    param.i_threads = convert_args->encoder_threads;
 
-  // create x264 encoder
-  x264_picture_t picture;
-  x264_picture_init(&picture);
-  x264_picture_alloc(&picture, param.i_csp, param.i_width, param.i_height);
-  picture.i_type = X264_TYPE_AUTO;
-  picture.i_qpplus1 = 0;
+  // create raw frame pool, one frame being read and one being converted
+  // besides the queued ones.
+  pipeline->frames = new frame_pool(param.i_width * param.i_height * 3, pipeline->raw_frames.capacity() + 2);
+  if (pipeline->frames->count() == 0) {
+    show_error("Faild allocate buffer");
+    result = 1;
+  }
 
-  h264_dpb_t h264_dpb;
-  dpb_init(&h264_dpb);
+  // create x264 picture pool
+  for (uint32_t i = 0; i < pool_size; i++) {
+    x264_picture_init(&pictures[i]);
+    x264_picture_alloc(&pictures[i], param.i_csp, param.i_width, param.i_height);
+    pictures[i].i_type = X264_TYPE_AUTO;
+    pictures[i].i_qpplus1 = 0;
+    pipeline->pictures_free.push(&pictures[i]);
+  }
 
-  x264_encoder = x264_encoder_open(&param);
-  if (!x264_encoder) {
+  // create packet pool, a quarter of a raw i420 frame covers the usual
+  // keyframe, larger ones grow the buffer once.
+  for (size_t i = 0; i < video_packets.size(); i++) {
+    video_packets[i].data.reserve(param.i_width * param.i_height * 3 / 8);
+    video_packets[i].nal_size.reserve(max_frame_nals);
+    pipeline->video_packets_free.push(&video_packets[i]);
+  }
+
+  // create x264 encoder
+  pipeline->x264_encoder = x264_encoder_open(&param);
+  if (!pipeline->x264_encoder) {
     show_error("Can't create x264 encoder.");
     result = 1;
   }
 
-  if (x264_encoder) {
-    x264_encoder_parameters(x264_encoder, &param);
+  if (pipeline->x264_encoder) {
+    x264_encoder_parameters(pipeline->x264_encoder, &param);
+    show_x264_settings(convert_args, &param);
   }
 
   // create faac encoder.
-  faac_encoder = faacEncOpen(samples_per_sec, 2, &input_samples, &output_size);
-  if (faac_encoder == NULL) {
+  pipeline->faac_encoder = faacEncOpen(samples_per_sec, 2, &input_samples, &output_size);
+  if (pipeline->faac_encoder == NULL) {
     show_error("Failed create faac encoder.");
     result = 1;
   }
-
-  // allocate output buffer
-  faac_buffer = new unsigned char[output_size];
-  if (faac_buffer == NULL) {
-    show_error("Faild allocate buffer");
-    result = 1;
-  }
+  pipeline->input_samples = input_samples;
+  pipeline->output_size = output_size;
 
   // allocate input buffer
-  const uint32_t input_buffer_count = 4;
-  uint32_t input_buffer_id = 0;
-  input_buffer = new float[input_buffer_count * input_samples];
+  input_buffer = new float[pool_size * input_samples];
   if (input_buffer == NULL) {
     show_error("Faild allocate buffer");
     result = 1;
@@ -186,13 +680,20 @@ int mp4_convert(mp4_convert_param_t *convert_args, const char* filename) {
 
   if (result == 0) {
     if (input_buffer) {
-      memset(input_buffer, 0, input_buffer_count * input_samples * sizeof(float));
+      memset(input_buffer, 0, pool_size * input_samples * sizeof(float));
+    }
+    for (uint32_t i = 0; i < pool_size; i++)
+      pipeline->audio_free.push(input_buffer + i * input_samples);
+    // faac never writes more than output_size bytes per frame.
+    for (size_t i = 0; i < audio_packets.size(); i++) {
+      audio_packets[i].data.reserve(output_size);
+      pipeline->audio_packets_free.push(&audio_packets[i]);
     }
   }
 
   // get format.
   if (result == 0) {
-    faacEncConfigurationPtr faac_format = faacEncGetCurrentConfiguration(faac_encoder);
+    faacEncConfigurationPtr faac_format = faacEncGetCurrentConfiguration(pipeline->faac_encoder);
     faac_format->inputFormat = FAAC_INPUT_FLOAT;
     faac_format->outputFormat = 0;   //0:RAW
     faac_format->mpegVersion = MPEG4;
@@ -202,14 +703,20 @@ int mp4_convert(mp4_convert_param_t *convert_args, const char* filename) {
     faac_format->useLfe = 0;
     faac_format->quantqual = 100;
 
-    if (!faacEncSetConfiguration(faac_encoder, faac_format)) {
+    if (!faacEncSetConfiguration(pipeline->faac_encoder, faac_format)) {
       show_error("Unsupported parameters!");
       result = 1;
     }
   }
 
   if (result == 0) {
-    file = MP4Create(filename);
+    if (convert_args->fragment_ms > 0) {
+      // nothing but the last fragment is lost if the recording is cut off.
+      file = MP4CreateFragmented(filename, convert_args->fragment_ms);
+    } else {
+      // moov goes into space reserved up front, no MP4Optimize pass needed.
+      file = MP4CreateFastStart(filename, moov_reserve_size(convert_args, input_samples / 2));
+    }
     if (file == MP4_INVALID_FILE_HANDLE) {
       show_error("Can't create file.");
       result = 1;
@@ -218,399 +725,497 @@ int mp4_convert(mp4_convert_param_t *convert_args, const char* filename) {
 
   if (result == 0) {
     MP4SetTimeScale(file, mp4_time_scale);
-    audio_track = MP4AddAudioTrack(file, samples_per_sec, input_samples / 2, MP4_MPEG4_AUDIO_TYPE);
+    pipeline->audio_track = MP4AddAudioTrack(file, samples_per_sec, input_samples / 2, MP4_MPEG4_AUDIO_TYPE);
     MP4SetAudioProfileLevel(file, 0x0F);
 
-    BYTE *ASC = 0;
-    DWORD ASCLength = 0;
-    faacEncGetDecoderSpecificInfo(faac_encoder, &ASC, &ASCLength);
-    MP4SetTrackESConfiguration(file, audio_track, (unsigned __int8 *)ASC, ASCLength);
+    unsigned char *ASC = 0;
+    unsigned long ASCLength = 0;
+    faacEncGetDecoderSpecificInfo(pipeline->faac_encoder, &ASC, &ASCLength);
+    MP4SetTrackESConfiguration(file, pipeline->audio_track, (uint8_t *)ASC, ASCLength);
   }
 
   if (result == 0) {
     x264_nal_t *nal;
     int i_nal;
-    x264_encoder_headers(x264_encoder, &nal, &i_nal);
+    x264_encoder_headers(pipeline->x264_encoder, &nal, &i_nal);
 
     uint8_t *sps = nal[0].p_payload;
-    video_track = MP4AddH264VideoTrack(file, mp4_time_scale, mp4_time_scale / frames_per_sec, param.i_width, param.i_height,
-                                       sps[5], sps[6], sps[7], 3);
+    pipeline->video_track = MP4AddH264VideoTrack(file, mp4_time_scale, mp4_time_scale / frames_per_sec, param.i_width, param.i_height,
+                                                 sps[5], sps[6], sps[7], 3);
     MP4SetVideoProfileLevel(file, 0x7f);
-    MP4AddH264SequenceParameterSet(file, video_track, nal[0].p_payload + 4, nal[0].i_payload - 4);
-    MP4AddH264PictureParameterSet(file, video_track, nal[1].p_payload + 4, nal[0].i_payload - 4);
+    MP4AddH264SequenceParameterSet(file, pipeline->video_track, nal[0].p_payload + 4, nal[0].i_payload - 4);
+    MP4AddH264PictureParameterSet(file, pipeline->video_track, nal[1].p_payload + 4, nal[0].i_payload - 4);
   }
 
-  uint32_t frame_count = 0;
-
-  if (result == 0) {
-    uint32_t frame_size = input_samples / 2;
-    uint32_t delay_samples = frame_size;
-    uint32_t total_samples = 0;
-    uint32_t encoded_samples = 0;
-    uint32_t progress = 0;
-
-    double total_time = 0;
-    double capture_time = 0;
-    double capture_delta = 1.0 / (double)frames_per_sec;
-
-    for (;; ) {
-      float *input_position = input_buffer + input_samples * input_buffer_id;
-      input_buffer_id = (input_buffer_id + 1) % input_buffer_count;
-
-      if (convert_args->video_input == INVALID_HANDLE_VALUE && 
-        convert_args->audio_input == INVALID_HANDLE_VALUE)
-        break;
-
-      // generate frame data
-      for (int samples_left = frame_size; samples_left; ) {
-        int samples = samples_left < 32 ? samples_left : 32;
-        samples_left -= samples;
-
-        double delta_time = (double)samples / (double)samples_per_sec;
-
-        // clear data
-        short temp_buffer[32 * 2];
-        memset(temp_buffer, 0, sizeof(temp_buffer));
-
-        // read audio data
-        if (convert_args->audio_input != INVALID_HANDLE_VALUE) {
-          DWORD read_size = 0;
-          BOOL success = ReadFile(convert_args->audio_input, temp_buffer, samples * 2 * sizeof(short), &read_size, NULL);
-          if (!success) {
-            CloseHandle(convert_args->audio_input);
-            convert_args->audio_input = INVALID_HANDLE_VALUE;
-          }
-        }
-
-        // convert audio data to float
-        for (int i = 0; i < samples; i++) {
-          input_position[0] = temp_buffer[i * 2 + 0];
-          input_position[1] = temp_buffer[i * 2 + 1];
-          input_position += 2;
-        }
-
-        total_time += delta_time;
-        if (total_time > capture_time) {
-          // capture image from display
-          int width = param.i_width;
-          int height = param.i_height;
-          size_t size = width * height * 3;
-          byte* data = new byte[size];
-          memset(data, 0, size);
-
-          // read video data
-          if (convert_args->video_input != INVALID_HANDLE_VALUE) {
-            DWORD read_size = 0;
-            BOOL success = ReadFile(convert_args->video_input, data, size, &read_size, NULL);
-            if (!success) {
-              CloseHandle(convert_args->video_input);
-              convert_args->video_input = INVALID_HANDLE_VALUE;
-            }
-          }
-
-          // convert from RGB to yuv
-          for (int y = 0; y < height / 2; y++) {
-            uint32_t pitch = size / height;
-            BYTE *yline = picture.img.plane[0] + y * 2 * picture.img.i_stride[0];
-            BYTE *uline = picture.img.plane[1] + y * picture.img.i_stride[1];
-            BYTE *vline = picture.img.plane[2] + y * picture.img.i_stride[2];
-            BYTE *rgb = (BYTE *)data + pitch * y * 2;
-
-            for (int x = 0; x < width / 2; x++) {
-              uint32_t sr = 0, sg = 0, sb = 0;
-              rgbtoy(rgb[0], rgb[1], rgb[2], yline[0]); sr += rgb[0]; sg += rgb[1]; sb += rgb[2];
-              rgb += pitch; yline += picture.img.i_stride[0];
-              rgbtoy(rgb[0], rgb[1], rgb[2], yline[0]); sr += rgb[0]; sg += rgb[1]; sb += rgb[2];
-              rgb += 3; yline++;
-              rgbtoy(rgb[0], rgb[1], rgb[2], yline[0]); sr += rgb[0]; sg += rgb[1]; sb += rgb[2];
-              rgb -= pitch; yline -= picture.img.i_stride[0];
-              rgbtoy(rgb[0], rgb[1], rgb[2], yline[0]); sr += rgb[0]; sg += rgb[1]; sb += rgb[2];
-
-              rgb += 3; yline++;
-              sr /= 4; sg /= 4; sb /= 4;
-              rgbtouv(sr, sg, sb, *uline, *vline);
-              uline++;
-              vline++;
-            }
-          }
-
-          delete[] data;
-
-          // encode image to H.264
-          x264_nal_t *nal;
-          int i_nal;
-          int i_frame_size;
-          x264_picture_t pic_out;
-
-          i_frame_size = x264_encoder_encode(x264_encoder, &nal, &i_nal, &picture, &pic_out);
-          picture.i_pts++;
-
-          for (int nal_id = 0; nal_id < i_nal; ++nal_id) {
-            uint32_t size = nal[nal_id].i_payload;
-            uint8_t *nalu = nal[nal_id].p_payload;
-
-            nalu[0] = ((size - 4) >> 24) & 0xff;
-            nalu[1] = ((size - 4) >> 16) & 0xff;
-            nalu[2] = ((size - 4) >> 8) & 0xff;
-            nalu[3] = ((size - 4) >> 0) & 0xff;
-
-            // write samples
-            MP4Duration dur = mp4_time_scale / frames_per_sec;
-            if (!MP4WriteSample(file, video_track, nalu, size, dur, 0, pic_out.b_keyframe != 0)) {
-              show_error("Encode mp4 error.");
-              goto done;
-            }
-
-            bool slice_is_idr = nal[nal_id].i_type == 5;
-            dpb_add(&h264_dpb, pic_out.i_pts, slice_is_idr);
-            frame_count++;
-          }
-
-          capture_time += capture_delta;
-        }
-      }
-
-      total_samples += frame_size;
-
-      // call the actual encoding routine
-      int32_t *src = (int32_t *)input_buffer + input_buffer_id * input_samples;
-      int bytes_encoded = faacEncEncode(faac_encoder, src, input_samples, faac_buffer, output_size);
-      if (bytes_encoded < 0) {
-        show_error("Encode aac error.");
-        goto done;
-      }
-
-      // write to mp4 stream
-      if (bytes_encoded > 0) {
-        uint32_t samples_left = total_samples - encoded_samples + delay_samples;
-        MP4Duration dur = samples_left > frame_size ? frame_size : samples_left;
-        MP4Duration ofs = encoded_samples > 0 ? 0 : delay_samples;
-
-        if (!MP4WriteSample(file, audio_track, faac_buffer, (DWORD)bytes_encoded, dur, ofs, 1)) {
-          show_error("Encode mp4 error.");
-          goto done;
-        }
-
-        encoded_samples += dur;
-      }
-    }
+  if (stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->setup_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
   }
 
-  //Flush delayed frames
-  while (x264_encoder_delayed_frames(x264_encoder))
-  {
-    x264_nal_t *nal;
-    int i_nal;
-    int i_frame_size;
-    x264_picture_t pic_out;
-
-    i_frame_size = x264_encoder_encode(x264_encoder, &nal, &i_nal, NULL, &pic_out);
-
-    if( i_frame_size < 0 ) {
-      break;
-    }
-    else if (i_frame_size) {
-      for (int nal_id = 0; nal_id < i_nal; ++nal_id) {
-        uint32_t size = nal[nal_id].i_payload;
-        uint8_t *nalu = nal[nal_id].p_payload;
-
-        nalu[0] = ((size - 4) >> 24) & 0xff;
-        nalu[1] = ((size - 4) >> 16) & 0xff;
-        nalu[2] = ((size - 4) >> 8) & 0xff;
-        nalu[3] = ((size - 4) >> 0) & 0xff;
-
-        // write samples
-        MP4Duration dur = mp4_time_scale / frames_per_sec;
-        if (!MP4WriteSample(file, video_track, nalu, size, dur, 0, pic_out.b_keyframe != 0)) {
-          show_error("Encode mp4 error.");
-          goto done;
-        }
-
-        bool slice_is_idr = nal[nal_id].i_type == 5;
-        dpb_add(&h264_dpb, pic_out.i_pts, slice_is_idr);
-        frame_count++;
-      }
+  if (result == 0) {
+    std::chrono::steady_clock::time_point encode_time = std::chrono::steady_clock::now();
+    std::thread reader(reader_stage, pipeline);
+    std::thread convert(convert_stage, pipeline);
+    std::thread video_encode(video_encode_stage, pipeline);
+    std::thread audio_encode(audio_encode_stage, pipeline);
+    std::thread mux(mux_stage, pipeline);
+
+    reader.join();
+    convert.join();
+    video_encode.join();
+    audio_encode.join();
+    mux.join();
+
+    result = pipeline->result;
+    if (stats) {
+      stats->video_frames = pipeline->frames->acquired();
+      stats->audio_frames = pipeline->audio_encoded;
+      stats->encode_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - encode_time).count();
+      stats->x264_seconds = pipeline->x264_seconds;
+      stats->latency_p50_ms = pipeline->latency.percentile(0.50) / 1000.0;
+      stats->latency_p99_ms = pipeline->latency.percentile(0.99) / 1000.0;
+      stats->latency_max_ms = pipeline->latency.max() / 1000.0;
     }
-  }
 
-done:
-  dpb_flush(&h264_dpb);
-  if (h264_dpb.dpb.size_min > 0) {
-    for (uint32_t ix = 0; ix < frame_count; ix++) {
-      const int offset = dpb_frame_offset(&h264_dpb, ix);
-      const uint32_t frame_duration = mp4_time_scale / frames_per_sec;
-      MP4SetSampleRenderingOffset(file, video_track, 1 + ix, offset * frame_duration);
-    }
+    // packet buffers only grow on frames larger than any before, steady
+    // state adds none.
+    fprintf(stderr, "frames: %u read, %u buffer allocations while encoding\n",
+            (uint32_t)pipeline->frames->acquired(), (uint32_t)pipeline->allocations);
   }
-  dpb_clean(&h264_dpb);
 
-  x264_picture_clean(&picture);
+  for (uint32_t i = 0; i < pool_size; i++)
+    x264_picture_clean(&pictures[i]);
   if (file) {
     MP4Close(file);
-    MP4Optimize(filename);
   }
-  if (faac_encoder) faacEncClose(faac_encoder);
-  if (faac_buffer) delete[] faac_buffer;
+  if (pipeline->faac_encoder) faacEncClose(pipeline->faac_encoder);
   if (input_buffer) delete[] input_buffer;
-  if (x264_encoder) x264_encoder_close(x264_encoder);
+  if (pipeline->x264_encoder) x264_encoder_close(pipeline->x264_encoder);
+  delete pipeline->frames;
+  delete pipeline;
 
   return result;
 }
 
-static void show_usage() {
-  char buff[MAX_PATH];
-  GetModuleFileNameA(NULL, buff, sizeof(buff));
-  char *filename = strrchr(buff, '\\');
-  if (filename == NULL) filename = buff;
+static void show_usage(const char *argv0) {
+  const char *filename = argv0;
+  for (const char *c = argv0; *c; c++) {
+    if (*c == '\\' || *c == '/')
+      filename = c + 1;
+  }
   fprintf(stderr, "Raw to x264-faac-mp4 encoder.\n");
   fprintf(stderr, "  this free program converts raw video input (in RGB format)"
                   "  and audio input (in 16 bit PCM format) to a MP4 file.\n\n");
   fprintf(stderr, "Usage: %s flags\n", filename);
-  fprintf(stderr, "  --video_input video_filename\n");
+  fprintf(stderr, "  --video_input video_filename, named pipe or fifo. '-' for stdin\n");
   fprintf(stderr, "  --video_width width\n");
   fprintf(stderr, "  --video_height height\n");
   fprintf(stderr, "  --video_framerate framerate. [default: 30]\n");
-  fprintf(stderr, "  --audio_input audio_filename\n");
+  fprintf(stderr, "  --audio_input audio_filename, named pipe or fifo. '-' for stdin\n");
   fprintf(stderr, "  --audio_samplerate samplerate [default: 44100]\n");
   fprintf(stderr, "  --output output_filename\n");
+  fprintf(stderr, "  --fragment_ms duration, write a fragmented mp4 with fragments of about this length.\n"
+                  "    also caps the keyframe interval at this length. [default: 0, not fragmented]\n");
+  fprintf(stderr, "  --expected_seconds duration, recording length the moov space at the start of an unfragmented\n"
+                  "    file is reserved for, longer recordings move the mdat once at close. [default: 1800]\n");
+  fprintf(stderr, "  --threads count, x264 threads. [default: 0, one and a half per core]\n");
+  fprintf(stderr, "  --preset name, x264 preset, ultrafast to placebo. [default: medium]\n");
+  fprintf(stderr, "  --tune name, x264 tune such as zerolatency, film or animation. [default: none]\n");
+  fprintf(stderr, "  --sliced_threads, x264 threads split frames into slices, lower latency.\n");
+  fprintf(stderr, "  --lookahead frames, x264 rate control lookahead.\n");
+  fprintf(stderr, "  --bframes count, x264 consecutive b-frames.\n");
+  fprintf(stderr, "  --keyint frames, maximum keyframe interval.\n");
+  fprintf(stderr, "  --crf factor, constant quality rate control. [default: 23]\n");
+  fprintf(stderr, "  --bitrate kbps, average bitrate rate control.\n");
+  fprintf(stderr, "  --vbv_maxrate kbps, --vbv_bufsize kbit, x264 vbv limits.\n");
+  fprintf(stderr, "  --low_latency, zerolatency x264 with sliced threads and no b-frames or lookahead,\n"
+                  "    one frame queued per stage.\n");
+  fprintf(stderr, "  --x264_config filename, lines of name=value x264 options as in the x264 command line,\n"
+                  "    preset and tune included, applied in place of the flag.\n");
+  fprintf(stderr, "\nServer mode: %s --server socket_path [--max_sessions count] [--threads count]\n", filename);
+  fprintf(stderr, "  serves recordings from a unix socket, a client sends the flags above on one line\n"
+                  "  and gets a status line with the session's throughput back once it is done.\n");
+  fprintf(stderr, "  --max_sessions count, recordings encoded at a time. [default: 4]\n");
+  fprintf(stderr, "  --threads count, x264 threads shared by all sessions, a session gets an even share of\n"
+                  "    them with the sessions running when it starts, at least one. [default: one per core]\n");
 }
 
-int main(int argc, char* argv[]) {
-  // hack to wait pipe ready
-  Sleep(100);
+// x264_param_parse names of the x264 flags, flags without a value are
+// switches.
+static const struct {
+  const char *flag;
+  const char *option;
+  bool has_value;
+} x264_flags[] = {
+  { "--sliced_threads", "sliced-threads", false },
+  { "--lookahead", "rc-lookahead", true },
+  { "--bframes", "bframes", true },
+  { "--keyint", "keyint", true },
+  { "--crf", "crf", true },
+  { "--bitrate", "bitrate", true },
+  { "--vbv_maxrate", "vbv-maxrate", true },
+  { "--vbv_bufsize", "vbv-bufsize", true },
+};
 
-  if (argc < 2) {
-    show_usage();
-    return 0;
+// checks an x264 option on scratch parameters and queues it for
+// mp4_convert().
+static bool add_x264_option(mp4_convert_param_t &param, const std::string &name, const std::string &value) {
+  x264_param_t check;
+  x264_param_default(&check);
+  int error = x264_param_parse(&check, name.c_str(), value.c_str());
+  if (error == X264_PARAM_BAD_NAME) {
+    fprintf(stderr, "Unknown x264 option: %s\n", name.c_str());
+    return false;
   }
+  if (error != 0) {
+    fprintf(stderr, "Invalid value for x264 option %s: %s\n", name.c_str(), value.c_str());
+    return false;
+  }
+  param.x264_options.push_back(std::make_pair(name, value));
+  return true;
+}
 
+// reads name=value lines, blank lines and lines starting with # are skipped.
+static bool read_x264_config(mp4_convert_param_t &param, const char *filename) {
+  FILE *file = fopen(filename, "r");
+  if (file == NULL) {
+    fprintf(stderr, "Failed to open x264 config: %s\n", filename);
+    return false;
+  }
 
-  int result = 1;
-  const char* output_filename = NULL;
+  static const char *blanks = " \t\r\n";
+  bool ok = true;
+  char line[1024];
+  for (int number = 1; ok && fgets(line, sizeof(line), file); number++) {
+    std::string text = line;
+    size_t first = text.find_first_not_of(blanks);
+    if (first == std::string::npos || text[first] == '#')
+      continue;
+    text = text.substr(first, text.find_last_not_of(blanks) + 1 - first);
+
+    size_t equals = text.find('=');
+    if (equals == std::string::npos) {
+      fprintf(stderr, "%s:%d: expected name=value\n", filename, number);
+      ok = false;
+      break;
+    }
+    std::string name = text.substr(0, text.find_last_not_of(blanks, equals - 1) + 1);
+    std::string value = equals + 1 < text.size() ? text.substr(text.find_first_not_of(blanks, equals + 1)) : "";
+    if (name == "preset")
+      param.x264_preset = value;
+    else if (name == "tune")
+      param.x264_tune = value;
+    else
+      ok = add_x264_option(param, name, value);
+  }
 
-  mp4_convert_param_t param;
-  param.audio_input = INVALID_HANDLE_VALUE;
-  param.video_input = INVALID_HANDLE_VALUE;
-  param.video_width = 640;
-  param.video_height = 480;
-  param.video_framerate = 30;
-  param.audio_samplerate = 44100;
+  fclose(file);
+  return ok;
+}
+
+struct server_param_t {
+  const char *socket_path;
+  int max_sessions;
+};
 
+static void default_convert_param(mp4_convert_param_t *param) {
+  param->audio_input = NULL;
+  param->video_input = NULL;
+  param->video_width = 640;
+  param->video_height = 480;
+  param->video_framerate = 30;
+  param->audio_samplerate = 44100;
+  param->fragment_ms = 0;
+  param->expected_seconds = 30 * 60;
+  param->encoder_threads = 0;
+  param->low_latency = false;
+  param->x264_preset = "medium";
+  param->x264_tune.clear();
+  param->x264_options.clear();
+}
+
+// parses the flags of one recording, and the server flags unless server
+// is NULL. opened inputs are left in param for the caller to delete.
+static bool parse_args(int argc, char *argv[], mp4_convert_param_t &param,
+                       const char **output_filename, server_param_t *server) {
   // prase arguments
   for (int i = 1; i < argc; i++) {
     if (strcmp(argv[i], "--help") == 0) {
-      show_usage();
-      goto cleanup;
+      show_usage(argv[0]);
+      return false;
     }
 
     if (strcmp(argv[i], "--output") == 0) {
       if (++i >= argc) {
-        show_usage();
-        goto cleanup;
+        show_usage(argv[0]);
+        return false;
       }
 
-      output_filename = argv[i];
+      *output_filename = argv[i];
     }
 
     if (strcmp(argv[i], "--video_input") == 0) {
       if (++i >= argc) {
         fprintf(stderr, "Missing argument for video_input.\n");
-        goto cleanup;
+        return false;
       }
 
       // open file
       const char* filename = argv[i];
-      param.video_input = CreateFile(filename, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL);
-      if (param.video_input == INVALID_HANDLE_VALUE) {
+      param.video_input = input_stream::open(filename);
+      if (param.video_input == NULL) {
         fprintf(stderr, "Failed to open video input: %s\n", filename);
-        goto cleanup;
+        return false;
       }
     }
 
     if (strcmp(argv[i], "--audio_input") == 0) {
       if (++i >= argc) {
         fprintf(stderr, "Missing argument for audio_input.\n");
-        goto cleanup;
+        return false;
       }
 
       // open file
       const char* filename = argv[i];
-      param.audio_input = CreateFile(filename, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL);
-      if (param.audio_input == INVALID_HANDLE_VALUE) {
+      param.audio_input = input_stream::open(filename);
+      if (param.audio_input == NULL) {
         fprintf(stderr, "Failed to open audio input: %s\n", filename);
-        goto cleanup;
+        return false;
       }
     }
 
     if (strcmp(argv[i], "--video_width") == 0) {
       if (++i >= argc) {
         fprintf(stderr, "Missing argument for video_width.\n");
-        goto cleanup;
+        return false;
       }
       if (sscanf(argv[i], "%d", &param.video_width) != 1) {
         fprintf(stderr, "Invalid argument for video_width\n");
-        goto cleanup;
+        return false;
       }
       if (param.video_width == 0) {
         fprintf(stderr, "video width can not be 0\n");
-        goto cleanup;
+        return false;
       }
       if (param.video_width % 4 != 0) {
         fprintf(stderr, "Video width must be muliply of 4\n");
-        goto cleanup;
+        return false;
       }
     }
 
     if (strcmp(argv[i], "--video_height") == 0) {
       if (++i >= argc) {
         fprintf(stderr, "Missing argument for video_height.\n");
-        goto cleanup;
+        return false;
       }
       if (sscanf(argv[i], "%d", &param.video_height) != 1) {
         fprintf(stderr, "Invalid argument for video_height\n");
-        goto cleanup;
+        return false;
       }
       if (param.video_height == 0) {
         fprintf(stderr, "video height can not be 0\n");
-        goto cleanup;
+        return false;
       }
       if (param.video_height % 4 != 0) {
         fprintf(stderr, "Video height must be muliply of 4\n");
-        goto cleanup;
+        return false;
       }
     }
 
     if (strcmp(argv[i], "--video_framerate") == 0) {
       if (++i >= argc) {
         fprintf(stderr, "Missing argument for video_framerate.\n");
-        goto cleanup;
+        return false;
       }
       if (sscanf(argv[i], "%d", &param.video_framerate) != 1) {
         fprintf(stderr, "Missing argument for video_framerate.\n");
-        goto cleanup;
+        return false;
       }
       if (param.video_framerate == 0) {
         fprintf(stderr, "Video framerate can not be 0\n");
-        goto cleanup;
+        return false;
       }
     }
 
     if (strcmp(argv[i], "--audio_samplerate") == 0) {
       if (++i >= argc) {
         fprintf(stderr, "Missing argument for audio_samplerate.\n");
-        goto cleanup;
+        return false;
       }
       if (sscanf(argv[i], "%d", &param.audio_samplerate) != 1) {
         fprintf(stderr, "Invalid argument for audio_samplerate\n");
-        goto cleanup;
+        return false;
       }
       if (param.audio_samplerate == 0) {
         fprintf(stderr, "Audio samplerate can not be 0\n");
-        goto cleanup;
+        return false;
+      }
+    }
+
+    if (strcmp(argv[i], "--fragment_ms") == 0) {
+      if (++i >= argc) {
+        fprintf(stderr, "Missing argument for fragment_ms.\n");
+        return false;
+      }
+      if (sscanf(argv[i], "%d", &param.fragment_ms) != 1 || param.fragment_ms < 0) {
+        fprintf(stderr, "Invalid argument for fragment_ms\n");
+        return false;
+      }
+    }
+
+    if (strcmp(argv[i], "--expected_seconds") == 0) {
+      if (++i >= argc) {
+        fprintf(stderr, "Missing argument for expected_seconds.\n");
+        return false;
+      }
+      if (sscanf(argv[i], "%d", &param.expected_seconds) != 1 || param.expected_seconds < 0) {
+        fprintf(stderr, "Invalid argument for expected_seconds\n");
+        return false;
+      }
+    }
+
+    if (strcmp(argv[i], "--threads") == 0) {
+      if (++i >= argc) {
+        fprintf(stderr, "Missing argument for threads.\n");
+        return false;
+      }
+      if (sscanf(argv[i], "%d", &param.encoder_threads) != 1 || param.encoder_threads < 0) {
+        fprintf(stderr, "Invalid argument for threads\n");
+        return false;
+      }
+    }
+
+    if (strcmp(argv[i], "--preset") == 0 || strcmp(argv[i], "--tune") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "Missing argument for %s.\n", argv[i] + 2);
+        return false;
+      }
+      if (strcmp(argv[i], "--preset") == 0)
+        param.x264_preset = argv[++i];
+      else
+        param.x264_tune = argv[++i];
+    }
+
+    for (size_t flag = 0; flag < sizeof(x264_flags) / sizeof(x264_flags[0]); flag++) {
+      if (strcmp(argv[i], x264_flags[flag].flag) != 0)
+        continue;
+      if (x264_flags[flag].has_value && ++i >= argc) {
+        fprintf(stderr, "Missing argument for %s.\n", x264_flags[flag].flag + 2);
+        return false;
+      }
+      if (!add_x264_option(param, x264_flags[flag].option, x264_flags[flag].has_value ? argv[i] : "1"))
+        return false;
+      break;
+    }
+
+    if (strcmp(argv[i], "--low_latency") == 0)
+      param.low_latency = true;
+
+    if (strcmp(argv[i], "--x264_config") == 0) {
+      if (++i >= argc) {
+        fprintf(stderr, "Missing argument for x264_config.\n");
+        return false;
+      }
+      if (!read_x264_config(param, argv[i]))
+        return false;
+    }
+
+    if (strcmp(argv[i], "--server") == 0 || strcmp(argv[i], "--max_sessions") == 0) {
+      if (server == NULL) {
+        fprintf(stderr, "%s is not a session flag\n", argv[i]);
+        return false;
+      }
+      if (i + 1 >= argc) {
+        fprintf(stderr, "Missing argument for %s.\n", argv[i] + 2);
+        return false;
+      }
+      if (strcmp(argv[i], "--server") == 0) {
+        server->socket_path = argv[++i];
+      } else if (sscanf(argv[++i], "%d", &server->max_sessions) != 1 || server->max_sessions <= 0) {
+        fprintf(stderr, "Invalid argument for max_sessions\n");
+        return false;
       }
     }
   }
 
+  x264_param_t check;
+  const std::string tune = x264_tune_name(&param);
+  if (x264_param_default_preset(&check, param.x264_preset.empty() ? NULL : param.x264_preset.c_str(),
+                                tune.empty() ? NULL : tune.c_str()) < 0) {
+    fprintf(stderr, "Unknown x264 preset or tune: %s %s\n", param.x264_preset.c_str(), tune.c_str());
+    return false;
+  }
+  return true;
+}
+
+// the server's --threads budget and the sessions encoding right now. x264
+// fixes its thread count when the encoder is opened, so a session takes
+// its share of the budget among the sessions running as it starts.
+static int server_encoder_threads = 0;
+static std::atomic<int> active_sessions(0);
+
+static int run_session(int argc, char *argv[], std::string *reply) {
+  mp4_convert_param_t param;
+  default_convert_param(&param);
+  const char *output_filename = NULL;
+  int result = 1;
+  char text[256];
+
+  if (!parse_args(argc, argv, param, &output_filename, NULL)) {
+    *reply = "error invalid flags";
+  } else if (output_filename == NULL) {
+    *reply = "error no output filename";
+  } else {
+    // a session may ask for fewer threads than its share, not more.
+    int share = std::max(1, server_encoder_threads / ++active_sessions);
+    if (param.encoder_threads == 0 || param.encoder_threads > share)
+      param.encoder_threads = share;
+
+    mp4_convert_stats_t stats;
+    result = mp4_convert(&param, output_filename, &stats);
+    active_sessions--;
+    double seconds = stats.encode_seconds > 0.0 ? stats.encode_seconds : 1e-9;
+    sprintf(text, "%s %llu video frames, %llu audio frames, setup %.1f ms, "
+                  "encode %.3f s, %.1f fps, %.2fx realtime, latency p50 %.2f ms p99 %.2f ms",
+            result == 0 ? "ok" : "error", (unsigned long long)stats.video_frames,
+            (unsigned long long)stats.audio_frames, stats.setup_seconds * 1e3, stats.encode_seconds,
+            stats.video_frames / seconds, stats.video_frames / (double)param.video_framerate / seconds,
+            stats.latency_p50_ms, stats.latency_p99_ms);
+    *reply = text;
+  }
+
+  delete param.audio_input;
+  delete param.video_input;
+  return result;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    show_usage(argv[0]);
+    return 0;
+  }
+
+
+  int result = 1;
+  const char* output_filename = NULL;
+
+  mp4_convert_param_t param;
+  default_convert_param(&param);
+  server_param_t server;
+  server.socket_path = NULL;
+  server.max_sessions = 4;
+
+  if (!parse_args(argc, argv, param, &output_filename, &server))
+    goto cleanup;
+
+  if (server.socket_path) {
+    int threads = param.encoder_threads > 0 ? param.encoder_threads : (int)std::thread::hardware_concurrency();
+    server_encoder_threads = std::max(1, threads);
+    session_server sessions((uint32_t)server.max_sessions, run_session);
+    result = sessions.run(server.socket_path) ? 0 : 1;
+    goto cleanup;
+  }
+
   if (output_filename == NULL) {
     fprintf(stderr, "No output filename");
     goto cleanup;
@@ -622,16 +1227,22 @@ int main(int argc, char* argv[]) {
 #endif
 
   // do convertion
-  result = mp4_convert(&param, output_filename);
+  {
+    mp4_convert_stats_t stats;
+    result = mp4_convert(&param, output_filename, &stats);
+    double seconds = stats.encode_seconds > 0.0 ? stats.encode_seconds : 1e-9;
+    double x264_seconds = stats.x264_seconds > 0.0 ? stats.x264_seconds : 1e-9;
+    fprintf(stderr, "video: %llu frames in %.3f s, %.1f fps, x264 busy %.3f s, %.1f fps\n",
+            (unsigned long long)stats.video_frames, stats.encode_seconds, stats.video_frames / seconds,
+            stats.x264_seconds, stats.video_frames / x264_seconds);
+    fprintf(stderr, "latency: capture to mux p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+            stats.latency_p50_ms, stats.latency_p99_ms, stats.latency_max_ms);
+  }
 
 cleanup:
   // free resources
-  if (param.audio_input != INVALID_HANDLE_VALUE) {
-    CloseHandle(param.audio_input);
-  }
-  if (param.video_input != INVALID_HANDLE_VALUE) {
-    CloseHandle(param.video_input);
-  }
+  delete param.audio_input;
+  delete param.video_input;
 
   return result;
 }
\ No newline at end of file